@@ -2,17 +2,38 @@
  * ailive_audio.cpp - JNI Bridge for whisper.cpp in AILive
  *
  * Provides a bridge between Kotlin and the whisper.cpp library for
- * high-performance, on-device speech-to-text.
+ * high-performance, on-device speech-to-text: one-shot transcription of a
+ * clip (nativeProcess) and streaming transcription of microphone audio
+ * (nativeStream*, see whisper_stream.h). Both are gated by voice activity
+ * detection (voice_activity.h): only speech reaches the Whisper encoder.
+ *
+ * Recordings on disk or in mapped buffers are transcribed in parallel by
+ * nativeTranscribeBatch (see whisper_batch.h).
+ *
+ * Microphone audio can be handed over as 16-bit PCM in a direct ByteBuffer
+ * at the device's native rate (the *Direct entry points): it is read in
+ * place, converted and resampled to 16 kHz here, with no JVM array copies.
  */
 
 #include <jni.h>
 #include <string>
 #include <vector>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
 #include <cstdio>
 #include <cerrno>
 #include <cstring>
 #include <android/log.h>
 #include "whisper.h"
+#include "audio_dsp.h"
+#include "keyword_spotter.h"
+#include "voice_activity.h"
+#include "whisper_batch.h"
+#include "whisper_profile.h"
+#include "whisper_stream.h"
 
 // Piper TTS is temporarily disabled due to ExternalProject incompatibility with Android NDK
 // Will be re-enabled once we have pre-built piper libs for ARM64 Android
@@ -29,6 +50,124 @@
 // Global context for the Whisper model
 static whisper_context* g_whisper_ctx = nullptr;
 
+// Streaming transcriber on g_whisper_ctx. Push, decode and batch
+// transcription run concurrently (shared lock); creating or releasing the
+// stream or the context waits for all of them (exclusive lock).
+static std::unique_ptr<WhisperStream> g_whisper_stream;
+static std::shared_mutex g_stream_lock;
+
+// nativeProcess decodes on the context's default whisper_state (streams
+// and batches have their own), so clips are transcribed one at a time.
+// Taken after g_stream_lock.
+static std::mutex g_clip_lock;
+
+// Decoding profile for nativeProcess (see whisper_profile.h)
+static std::atomic<const WhisperProfile*> g_profile{&default_whisper_profile()};
+
+// Voice activity detection settings for nativeProcess and new streams
+static VadParams g_vad_params;
+static bool g_vad_enabled = true;
+
+// Silence inserted between speech spans transcribed together
+static constexpr int kSpanGapSamples = WhisperStream::kSampleRate / 10;
+
+// Direct-buffer stream input: resampler state and reused conversion buffers.
+// One microphone thread pushes at a time.
+static std::mutex g_input_lock;
+static std::unique_ptr<dsp::Resampler> g_input_resampler;
+static std::vector<float> g_input_float;
+static std::vector<float> g_input_16k;
+
+/**
+ * 16-bit PCM of a direct ByteBuffer, or nullptr (logged) if the buffer is
+ * not direct. `byte_count` is clamped to the capacity.
+ */
+static const int16_t* direct_pcm(JNIEnv* env, jobject buffer, jint byte_count, size_t* n_samples) {
+    void* address = buffer != nullptr ? env->GetDirectBufferAddress(buffer) : nullptr;
+    if (address == nullptr) {
+        LOGE_AUDIO("❌ PCM buffer is not a direct ByteBuffer");
+        return nullptr;
+    }
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    *n_samples = (size_t) std::max<jlong>(0, std::min<jlong>(byte_count, capacity)) / sizeof(int16_t);
+    return (const int16_t*) address;
+}
+
+/**
+ * Free the stream, then the context it decodes with. The caller holds
+ * g_stream_lock exclusively, so no decode or batch is using them.
+ *
+ * @return false if there was no context
+ */
+static bool release_context_locked() {
+    if (g_whisper_ctx == nullptr) return false;
+    g_whisper_stream.reset();
+    whisper_free(g_whisper_ctx);
+    g_whisper_ctx = nullptr;
+    return true;
+}
+
+/**
+ * Transcribe a complete 16 kHz clip with g_whisper_ctx and g_profile; only
+ * its speech spans are decoded when VAD is on. Holds g_stream_lock shared,
+ * so the context cannot be released mid-decode, and g_clip_lock.
+ */
+static std::string transcribe_clip(const float* audio_buf, int len) {
+    std::shared_lock<std::shared_mutex> lock(g_stream_lock);
+    if (g_whisper_ctx == nullptr) {
+        LOGE_AUDIO("Whisper context not initialized. Cannot process audio.");
+        return "";
+    }
+    std::lock_guard<std::mutex> clip_lock(g_clip_lock);
+    LOGI_AUDIO("Processing %d audio samples.", len);
+
+    // Transcribe only the speech spans, joined by short gaps
+    std::vector<float> speech;
+    const float* input = audio_buf;
+    int n_input = len;
+    if (g_vad_enabled) {
+        std::vector<VadSegment> spans = VoiceActivityDetector::detect(audio_buf, (size_t) len, g_vad_params);
+        if (spans.empty()) {
+            LOGI_AUDIO("🔇 No speech detected, skipping Whisper.");
+            return "";
+        }
+        for (const VadSegment& span : spans) {
+            if (!speech.empty()) speech.resize(speech.size() + kSpanGapSamples, 0.0f);
+            speech.insert(speech.end(), audio_buf + span.start, audio_buf + span.end);
+        }
+        input = speech.data();
+        n_input = (int) speech.size();
+        LOGI_AUDIO("   %zu speech span(s), %d of %d samples", spans.size(), n_input, len);
+    }
+
+    whisper_full_params params = whisper_profile_params(*g_profile.load(), g_whisper_ctx, (size_t) n_input);
+
+    // Run the model
+    if (whisper_full(g_whisper_ctx, params, input, n_input) != 0) {
+        LOGE_AUDIO("Failed to process audio with Whisper.");
+        return "";
+    }
+
+    // Get the transcribed text
+    const int n_segments = whisper_full_n_segments(g_whisper_ctx);
+    std::string result_text;
+    for (int i = 0; i < n_segments; ++i) {
+        const char* text = whisper_full_get_segment_text(g_whisper_ctx, i);
+        result_text += text;
+    }
+
+    LOGI_AUDIO("Transcription result: %s", result_text.c_str());
+    return result_text;
+}
+
+/** True if a stream created with `a` can be reused for `b` */
+static bool same_stream_settings(const WhisperStreamParams& a, const WhisperStreamParams& b) {
+    return a.step_ms == b.step_ms && a.max_window_ms == b.max_window_ms && a.use_vad == b.use_vad
+           && a.vad.threshold_db == b.vad.threshold_db && a.vad.min_energy_db == b.vad.min_energy_db
+           && a.vad.hangover_ms == b.vad.hangover_ms && a.vad.min_speech_ms == b.vad.min_speech_ms
+           && a.vad.padding_ms == b.vad.padding_ms;
+}
+
 #ifdef ENABLE_PIPER
 // Global context for the Piper model
 static piper::Voice* g_piper_voice = nullptr;
@@ -52,10 +191,11 @@ Java_com_ailive_audio_WhisperProcessor_nativeInit(
         jobject thiz,
         jstring model_path) {
 
+    // Streams and batches wait until the new context is in place
+    std::unique_lock<std::shared_mutex> lock(g_stream_lock);
     if (g_whisper_ctx != nullptr) {
         LOGI_AUDIO("Whisper context already initialized. Releasing first.");
-        whisper_free(g_whisper_ctx);
-        g_whisper_ctx = nullptr;
+        release_context_locked();
     }
 
     // CRITICAL: Validate input
@@ -125,44 +265,144 @@ Java_com_ailive_audio_WhisperProcessor_nativeProcess(
         jobject thiz,
         jfloatArray audio_data) {
 
-    if (g_whisper_ctx == nullptr) {
-        LOGE_AUDIO("Whisper context not initialized. Cannot process audio.");
+    jsize len = env->GetArrayLength(audio_data);
+    jfloat* audio_buf = env->GetFloatArrayElements(audio_data, nullptr);
+
+    if (audio_buf == nullptr) {
         return env->NewStringUTF("");
     }
 
-    jsize len = env->GetArrayLength(audio_data);
-    jfloat* audio_buf = env->GetFloatArrayElements(audio_data, nullptr);
+    std::string result_text = transcribe_clip(audio_buf, len);
+    env->ReleaseFloatArrayElements(audio_data, audio_buf, JNI_ABORT);
 
-    LOGI_AUDIO("Processing %d audio samples.", len);
+    return env->NewStringUTF(result_text.c_str());
+}
 
-    // Set up whisper parameters
-    whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
-    params.print_progress = false;
-    params.print_special = false;
-    params.print_timestamps = false;
-    params.print_realtime = false;
-    params.language = "en"; // Set language to English
+/**
+ * Transcribes a clip of 16-bit mono PCM read in place from a direct
+ * ByteBuffer (native byte order) and resampled to 16 kHz here.
+ *
+ * @param pcm Direct ByteBuffer holding the samples from position 0
+ * @param byte_count Valid bytes in `pcm`
+ * @param sample_rate Rate the clip was recorded at
+ * @return The transcribed text
+ */
+JNIEXPORT jstring JNICALL
+Java_com_ailive_audio_WhisperProcessor_nativeProcessDirect(
+        JNIEnv* env,
+        jobject thiz,
+        jobject pcm,
+        jint byte_count,
+        jint sample_rate) {
 
-    // Run the model
-    if (whisper_full(g_whisper_ctx, params, audio_buf, len) != 0) {
-        LOGE_AUDIO("Failed to process audio with Whisper.");
-        env->ReleaseFloatArrayElements(audio_data, audio_buf, JNI_ABORT);
+    size_t n = 0;
+    const int16_t* samples = direct_pcm(env, pcm, byte_count, &n);
+    if (samples == nullptr || n == 0 || sample_rate <= 0) {
         return env->NewStringUTF("");
     }
 
-    // Get the transcribed text
-    const int n_segments = whisper_full_n_segments(g_whisper_ctx);
-    std::string result_text;
-    for (int i = 0; i < n_segments; ++i) {
-        const char* text = whisper_full_get_segment_text(g_whisper_ctx, i);
-        result_text += text;
+    std::vector<float> audio(n);
+    dsp::pcm16_to_float(samples, n, audio.data());
+    if (sample_rate != WhisperStream::kSampleRate) {
+        audio = dsp::Resampler::convert(audio.data(), n, sample_rate, WhisperStream::kSampleRate);
     }
 
-    LOGI_AUDIO("Transcription result: %s", result_text.c_str());
+    std::string result_text = transcribe_clip(audio.data(), (int) audio.size());
+    return env->NewStringUTF(result_text.c_str());
+}
+
+/**
+ * Select the decoding profile used by nativeProcess ("command",
+ * "dictation" or "background").
+ *
+ * @return false (profile unchanged) if the name is unknown
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_audio_WhisperProcessor_nativeSetProfile(
+        JNIEnv* env,
+        jobject thiz,
+        jstring name) {
 
-    env->ReleaseFloatArrayElements(audio_data, audio_buf, 0);
+    const char* chars = env->GetStringUTFChars(name, nullptr);
+    if (chars == nullptr) return JNI_FALSE;
+    const WhisperProfile* profile = find_whisper_profile(chars);
+    env->ReleaseStringUTFChars(name, chars);
 
-    return env->NewStringUTF(result_text.c_str());
+    if (profile == nullptr) {
+        LOGE_AUDIO("Unknown Whisper profile");
+        return JNI_FALSE;
+    }
+    g_profile = profile;
+    LOGI_AUDIO("⚙️ Whisper profile: %s (%d threads, %s%s, audio_ctx %s)",
+               profile->name, whisper_profile_threads(*profile),
+               profile->strategy == WHISPER_SAMPLING_BEAM_SEARCH ? "beam search" : "greedy",
+               profile->temperature_inc > 0.0f ? " + fallback" : "",
+               profile->fit_audio_ctx ? "fitted" : "full");
+    return JNI_TRUE;
+}
+
+/**
+ * Configure voice activity detection. Applies to nativeProcess right away
+ * and to the stream from the next nativeStreamStart.
+ *
+ * @param threshold_db Frame energy above the noise floor that counts as speech
+ * @param hangover_ms Speech continues this long after the last speech frame
+ * @param padding_ms Audio kept before and after each speech segment
+ * @param min_speech_ms Shorter bursts are ignored
+ */
+JNIEXPORT void JNICALL
+Java_com_ailive_audio_WhisperProcessor_nativeSetVadParams(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean enabled,
+        jfloat threshold_db,
+        jint hangover_ms,
+        jint padding_ms,
+        jint min_speech_ms) {
+
+    std::unique_lock<std::shared_mutex> lock(g_stream_lock);
+    g_vad_enabled = enabled == JNI_TRUE;
+    g_vad_params.threshold_db = threshold_db;
+    g_vad_params.hangover_ms = hangover_ms;
+    g_vad_params.padding_ms = padding_ms;
+    g_vad_params.min_speech_ms = min_speech_ms;
+
+    LOGI_AUDIO("🔊 VAD %s: threshold %.1f dB, hangover %d ms, padding %d ms, min speech %d ms",
+               g_vad_enabled ? "on" : "off", threshold_db, hangover_ms, padding_ms, min_speech_ms);
+}
+
+/**
+ * Speech segments of a clip (16 kHz mono).
+ *
+ * @return [start0, end0, start1, end1, ...] in samples, padded
+ */
+JNIEXPORT jintArray JNICALL
+Java_com_ailive_audio_WhisperProcessor_nativeDetectSpeech(
+        JNIEnv* env,
+        jobject thiz,
+        jfloatArray audio_data) {
+
+    jsize len = env->GetArrayLength(audio_data);
+    jfloat* audio_buf = env->GetFloatArrayElements(audio_data, nullptr);
+    if (audio_buf == nullptr) return nullptr;
+
+    VadParams vad_params;
+    {
+        std::shared_lock<std::shared_mutex> lock(g_stream_lock);
+        vad_params = g_vad_params;
+    }
+    std::vector<VadSegment> spans = VoiceActivityDetector::detect(audio_buf, (size_t) len, vad_params);
+    env->ReleaseFloatArrayElements(audio_data, audio_buf, JNI_ABORT);
+
+    std::vector<jint> bounds;
+    bounds.reserve(spans.size() * 2);
+    for (const VadSegment& span : spans) {
+        bounds.push_back((jint) span.start);
+        bounds.push_back((jint) span.end);
+    }
+    jintArray result = env->NewIntArray((jsize) bounds.size());
+    env->SetIntArrayRegion(result, 0, (jsize) bounds.size(), bounds.data());
+    return result;
 }
 
 /**
@@ -173,13 +413,338 @@ Java_com_ailive_audio_WhisperProcessor_nativeRelease(
         JNIEnv* env,
         jobject thiz) {
 
-    if (g_whisper_ctx != nullptr) {
-        whisper_free(g_whisper_ctx);
-        g_whisper_ctx = nullptr;
+    std::unique_lock<std::shared_mutex> lock(g_stream_lock);
+    if (release_context_locked()) {
         LOGI_AUDIO("✅ Whisper context released.");
     }
 }
 
+/**
+ * Start a streaming transcription: creates the stream on first use or
+ * when the window or VAD settings changed, and otherwise clears its
+ * buffered audio and text context.
+ *
+ * @param step_ms New audio required between decodes
+ * @param window_ms Longest stretch of uncommitted audio decoded at once
+ * @return true if the stream is ready for nativeStreamPush
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_audio_WhisperProcessor_nativeStreamStart(
+        JNIEnv* env,
+        jobject thiz,
+        jint step_ms,
+        jint window_ms) {
+
+    std::unique_lock<std::shared_mutex> lock(g_stream_lock);
+    if (g_whisper_ctx == nullptr) {
+        LOGE_AUDIO("Whisper context not initialized. Cannot stream.");
+        return JNI_FALSE;
+    }
+    {
+        // New recording: no history from the previous one
+        std::lock_guard<std::mutex> input_lock(g_input_lock);
+        if (g_input_resampler != nullptr) g_input_resampler->reset();
+    }
+
+    WhisperStreamParams params;
+    params.step_ms = step_ms;
+    params.max_window_ms = window_ms;
+    params.use_vad = g_vad_enabled;
+    params.vad = g_vad_params;
+    if (g_whisper_stream != nullptr && same_stream_settings(g_whisper_stream->params(), params)) {
+        g_whisper_stream->reset();
+        return JNI_TRUE;
+    }
+
+    // First stream, or the window or VAD settings changed since it was created
+    g_whisper_stream = WhisperStream::create(g_whisper_ctx, params);
+    return g_whisper_stream != nullptr ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * Append `count` samples of 16 kHz mono PCM to the stream.
+ */
+JNIEXPORT void JNICALL
+Java_com_ailive_audio_WhisperProcessor_nativeStreamPush(
+        JNIEnv* env,
+        jobject thiz,
+        jshortArray pcm,
+        jint count) {
+
+    std::shared_lock<std::shared_mutex> lock(g_stream_lock);
+    if (g_whisper_stream == nullptr || count <= 0) return;
+
+    jsize n = std::min<jint>(count, env->GetArrayLength(pcm));
+    jshort* samples = env->GetShortArrayElements(pcm, nullptr);
+    if (samples == nullptr) return;
+    g_whisper_stream->push(samples, (size_t) n);
+    env->ReleaseShortArrayElements(pcm, samples, JNI_ABORT);
+}
+
+/**
+ * Append 16-bit mono PCM from a direct ByteBuffer (native byte order) to
+ * the stream. The samples are read in place; audio at another rate goes
+ * through a streaming resampler to 16 kHz.
+ *
+ * @param pcm Direct ByteBuffer holding the samples from position 0
+ * @param byte_count Valid bytes in `pcm`
+ * @param sample_rate Capture rate; keep it constant within a stream
+ */
+JNIEXPORT void JNICALL
+Java_com_ailive_audio_WhisperProcessor_nativeStreamPushDirect(
+        JNIEnv* env,
+        jobject thiz,
+        jobject pcm,
+        jint byte_count,
+        jint sample_rate) {
+
+    std::shared_lock<std::shared_mutex> lock(g_stream_lock);
+    if (g_whisper_stream == nullptr || byte_count <= 0 || sample_rate <= 0) return;
+
+    size_t n = 0;
+    const int16_t* samples = direct_pcm(env, pcm, byte_count, &n);
+    if (samples == nullptr || n == 0) return;
+
+    if (sample_rate == WhisperStream::kSampleRate) {
+        g_whisper_stream->push(samples, n);
+        return;
+    }
+
+    std::lock_guard<std::mutex> input_lock(g_input_lock);
+    if (g_input_resampler == nullptr || g_input_resampler->in_rate() != sample_rate) {
+        g_input_resampler.reset(new dsp::Resampler(sample_rate, WhisperStream::kSampleRate));
+        LOGI_AUDIO("🎚️ Resampling microphone input %d -> %d Hz (%s)",
+                   sample_rate, WhisperStream::kSampleRate, dsp::kernel_name());
+    }
+    g_input_float.resize(n);
+    dsp::pcm16_to_float(samples, n, g_input_float.data());
+    g_input_16k.clear();
+    g_input_resampler->process(g_input_float.data(), n, &g_input_16k);
+    g_whisper_stream->push(g_input_16k.data(), g_input_16k.size());
+}
+
+/**
+ * Decode the stream's current window if enough new audio arrived (or
+ * unconditionally with `flush`, which also commits everything).
+ *
+ * @return [committed, stable, pending] text, or null if nothing was decoded
+ */
+JNIEXPORT jobjectArray JNICALL
+Java_com_ailive_audio_WhisperProcessor_nativeStreamDecode(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean flush) {
+
+    std::shared_lock<std::shared_mutex> lock(g_stream_lock);
+    if (g_whisper_stream == nullptr) return nullptr;
+
+    WhisperStreamUpdate update;
+    if (!g_whisper_stream->decode(&update, flush == JNI_TRUE)) {
+        return nullptr;
+    }
+    if (!update.committed.empty()) {
+        LOGI_AUDIO("📝 Committed: %s (%.1f s window in %.0f ms)",
+                   update.committed.c_str(), update.window_ms / 1000.0f, update.decode_ms);
+    }
+
+    jobjectArray result = env->NewObjectArray(3, env->FindClass("java/lang/String"), nullptr);
+    env->SetObjectArrayElement(result, 0, env->NewStringUTF(update.committed.c_str()));
+    env->SetObjectArrayElement(result, 1, env->NewStringUTF(update.stable.c_str()));
+    env->SetObjectArrayElement(result, 2, env->NewStringUTF(update.pending.c_str()));
+    return result;
+}
+
+/**
+ * Transcribe recordings in parallel, each split at speech boundaries.
+ * Sources are WAV files (16-bit PCM) or raw 16-bit mono PCM; files are
+ * memory-mapped, buffers must be direct (e.g. FileChannel.map).
+ *
+ * @param paths Files to transcribe, or null
+ * @param buffers Direct buffers to transcribe after the files, or null
+ * @param buffer_rates Sample rate of each buffer without a WAV header
+ * @param profile Decoding profile name; null or unknown uses the current one
+ * @param max_parallel Decoder states, 0 = half the cores
+ * @return TimedSegment[] ordered by source (files first, then buffers) and
+ *         time, or null if the model is not loaded
+ */
+JNIEXPORT jobjectArray JNICALL
+Java_com_ailive_audio_WhisperProcessor_nativeTranscribeBatch(
+        JNIEnv* env,
+        jobject thiz,
+        jobjectArray paths,
+        jobjectArray buffers,
+        jintArray buffer_rates,
+        jstring profile,
+        jint max_parallel) {
+
+    std::shared_lock<std::shared_mutex> lock(g_stream_lock);
+    if (g_whisper_ctx == nullptr) {
+        LOGE_AUDIO("Whisper context not initialized. Cannot transcribe batch.");
+        return nullptr;
+    }
+
+    std::vector<BatchSource> sources;
+    std::vector<std::unique_ptr<MappedFile>> files;
+    const jsize n_paths = paths != nullptr ? env->GetArrayLength(paths) : 0;
+    for (jsize i = 0; i < n_paths; ++i) {
+        auto path = (jstring) env->GetObjectArrayElement(paths, i);
+        const char* chars = env->GetStringUTFChars(path, nullptr);
+        std::unique_ptr<MappedFile> file = chars != nullptr ? MappedFile::open(chars) : nullptr;
+        if (chars != nullptr) env->ReleaseStringUTFChars(path, chars);
+        env->DeleteLocalRef(path);
+        // An unreadable file keeps its index with no audio
+        sources.push_back(file != nullptr ? file->source() : BatchSource());
+        files.push_back(std::move(file));
+    }
+
+    const jsize n_buffers = buffers != nullptr ? env->GetArrayLength(buffers) : 0;
+    std::vector<jint> rates((size_t) n_buffers, WhisperStream::kSampleRate);
+    if (buffer_rates != nullptr) {
+        env->GetIntArrayRegion(buffer_rates, 0, std::min(n_buffers, env->GetArrayLength(buffer_rates)), rates.data());
+    }
+    for (jsize i = 0; i < n_buffers; ++i) {
+        jobject buffer = env->GetObjectArrayElement(buffers, i);
+        BatchSource source;
+        void* address = buffer != nullptr ? env->GetDirectBufferAddress(buffer) : nullptr;
+        if (address != nullptr) {
+            source.data = static_cast<const uint8_t*>(address);
+            source.bytes = (size_t) env->GetDirectBufferCapacity(buffer);
+            source.sample_rate = rates[i];
+        } else {
+            LOGE_AUDIO("❌ Batch buffer %d is not a direct ByteBuffer", (int) i);
+        }
+        sources.push_back(source);
+        env->DeleteLocalRef(buffer);
+    }
+
+    BatchParams params;
+    params.max_parallel = max_parallel;
+    params.use_vad = g_vad_enabled;
+    params.vad = g_vad_params;
+    params.profile = g_profile.load();
+    if (profile != nullptr) {
+        const char* chars = env->GetStringUTFChars(profile, nullptr);
+        if (chars != nullptr) {
+            if (const WhisperProfile* named = find_whisper_profile(chars)) params.profile = named;
+            env->ReleaseStringUTFChars(profile, chars);
+        }
+    }
+
+    std::vector<BatchSegment> segments = transcribe_batch(g_whisper_ctx, sources, params);
+
+    jclass segment_class = env->FindClass("com/ailive/audio/WhisperProcessor$TimedSegment");
+    jmethodID constructor = env->GetMethodID(segment_class, "<init>", "(IJJLjava/lang/String;)V");
+    jobjectArray result = env->NewObjectArray((jsize) segments.size(), segment_class, nullptr);
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const BatchSegment& segment = segments[i];
+        jstring text = env->NewStringUTF(segment.text.c_str());
+        jobject item = env->NewObject(segment_class, constructor, (jint) segment.source,
+                                      (jlong) segment.t0_ms, (jlong) segment.t1_ms, text);
+        env->SetObjectArrayElement(result, (jsize) i, item);
+        env->DeleteLocalRef(item);
+        env->DeleteLocalRef(text);
+    }
+    return result;
+}
+
+
+// --- Keyword spotter JNI Functions ---
+// Handles are KeywordSpotter*; each instance is used from one thread at a time.
+
+JNIEXPORT jlong JNICALL
+Java_com_ailive_audio_KeywordSpotter_nativeCreate(
+        JNIEnv* env,
+        jobject thiz) {
+    return (jlong) new KeywordSpotter();
+}
+
+JNIEXPORT void JNICALL
+Java_com_ailive_audio_KeywordSpotter_nativeDestroy(
+        JNIEnv* env,
+        jobject thiz,
+        jlong handle) {
+    delete (KeywordSpotter*) handle;
+}
+
+/**
+ * Enroll one recording of the wake phrase (mono PCM at `sample_rate`).
+ *
+ * @return false if the recording holds no usable speech
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_audio_KeywordSpotter_nativeAddTemplate(
+        JNIEnv* env,
+        jobject thiz,
+        jlong handle,
+        jshortArray pcm,
+        jint sample_rate) {
+
+    jsize len = env->GetArrayLength(pcm);
+    jshort* samples = env->GetShortArrayElements(pcm, nullptr);
+    if (samples == nullptr) return JNI_FALSE;
+    bool ok = ((KeywordSpotter*) handle)->add_template(samples, (size_t) len, sample_rate);
+    env->ReleaseShortArrayElements(pcm, samples, JNI_ABORT);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * @return the detection threshold derived from the enrolled templates
+ */
+JNIEXPORT jfloat JNICALL
+Java_com_ailive_audio_KeywordSpotter_nativeCalibrate(
+        JNIEnv* env,
+        jobject thiz,
+        jlong handle) {
+    return ((KeywordSpotter*) handle)->calibrate();
+}
+
+JNIEXPORT void JNICALL
+Java_com_ailive_audio_KeywordSpotter_nativeSetSensitivity(
+        JNIEnv* env,
+        jobject thiz,
+        jlong handle,
+        jfloat scale) {
+    ((KeywordSpotter*) handle)->set_sensitivity(scale);
+}
+
+/**
+ * Feed `count` samples of 16 kHz mono PCM.
+ *
+ * @return true if the wake phrase was spotted
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_audio_KeywordSpotter_nativeProcess(
+        JNIEnv* env,
+        jobject thiz,
+        jlong handle,
+        jshortArray pcm,
+        jint count) {
+
+    jsize n = std::min<jint>(count, env->GetArrayLength(pcm));
+    if (n <= 0) return JNI_FALSE;
+    jshort* samples = env->GetShortArrayElements(pcm, nullptr);
+    if (samples == nullptr) return JNI_FALSE;
+    bool detected = ((KeywordSpotter*) handle)->process(samples, (size_t) n);
+    env->ReleaseShortArrayElements(pcm, samples, JNI_ABORT);
+    return detected ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jfloat JNICALL
+Java_com_ailive_audio_KeywordSpotter_nativeTakeBestScore(
+        JNIEnv* env,
+        jobject thiz,
+        jlong handle) {
+    return ((KeywordSpotter*) handle)->take_best_score();
+}
+
+JNIEXPORT void JNICALL
+Java_com_ailive_audio_KeywordSpotter_nativeReset(
+        JNIEnv* env,
+        jobject thiz,
+        jlong handle) {
+    ((KeywordSpotter*) handle)->reset();
+}
+
 
 // --- Piper TTS JNI Functions ---
 // Temporarily disabled - will use Android system TTS as fallback
@@ -6,6 +6,8 @@
  *
  * This version contains critical fixes for tokenization, state management,
  * and sampling to resolve issues with token production and response coherence.
+ * Model, context and sessions live in LlmEngine (llm_engine.cpp); the
+ * vision projector and its image-embedding cache in MultimodalEngine.
  *
  * @author AILive Team (with fixes by Gemini)
  * @since Phase 7.9 - GGUF Support
@@ -14,20 +16,59 @@
 #include <jni.h>
 #include <string>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cinttypes>
+#include <cstdio>
 #include <android/log.h>
 #include "llama.h"
-// #include "llama_image.h" // TODO: Not available in current llama.cpp - vision features temporarily disabled
+#include "llm_engine.h"
+#include "embedding_engine.h"
+#include "multimodal_engine.h"
+#include "session_state.h"
 
 #define LOG_TAG "AILive-LLM"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
-// Global context (one model at a time)
-static llama_model* g_model = nullptr;
-static llama_context* g_ctx = nullptr;
-
-// Forward declaration
-static std::string llama_decode_and_generate(const std::string& prompt_str, int max_tokens);
+// Global engine (one model at a time, shared by all sessions). A hot swap
+// replaces it while generations are running: callers take a reference with
+// current_engine(), so the old engine is freed once the last of them returns.
+static std::shared_ptr<LlmEngine> g_engine;
+static std::mutex g_engine_mutex;
+
+// Embedding engine: a dedicated GGUF from nativeLoadEmbeddingModel, or created
+// lazily on the chat model (then it borrows g_engine's model and is freed with it)
+static std::unique_ptr<EmbeddingEngine> g_embedder;
+static std::mutex g_embedder_mutex;
+
+// Vision projector for the chat model (nativeLoadVisionProjector), freed with it.
+// Shared so a generation in flight keeps it alive across a reload. It is only
+// replaced with g_engine_mutex held (then g_vision_mutex), so current_vision()
+// never pairs a projector with another model than the one it was loaded for.
+static std::shared_ptr<MultimodalEngine> g_vision;
+static ImageEncodeStats g_last_image_stats;
+static std::mutex g_vision_mutex;
+
+// Kept here so settings pushed before a model is loaded apply to the next engine
+static SamplingParams g_sampling_params;
+static std::mutex g_sampling_mutex;
+
+// Asynchronous load (nativeLoadModelAsync, nativeSwapModelAsync): at most one
+// worker at a time. g_load_mutex guards g_load_thread and g_load_timings.
+static std::thread g_load_thread;
+static std::atomic<bool> g_load_cancel{false};
+static LoadTimings g_load_timings;
+static std::mutex g_load_mutex;
+
+// Hot swap refuses to load a second model unless its planned weights, KV cache
+// and compute buffers plus this margin fit in MemAvailable
+static constexpr int64_t kSwapMarginBytes = 256ll << 20;
+
+// Forward declarations
+static jstring utf8_to_jstring(JNIEnv* env, const std::string& text);
 
 // Fallback JNI function declarations (implemented in ailive_llm_fallback.cpp)
 extern "C" {
@@ -39,8 +80,344 @@ extern "C" {
     jboolean Java_com_ailive_ai_llm_LLMBridge_fallbackIsLoaded(JNIEnv* env, jobject thiz);
 }
 
-// Global flag to track if we're using fallback mode
-static bool g_using_fallback = false;
+// Global flag to track if we're using fallback mode (set by the async load worker)
+static std::atomic<bool> g_using_fallback{false};
+
+static std::shared_ptr<LlmEngine> current_engine() {
+    std::lock_guard<std::mutex> lock(g_engine_mutex);
+    return g_engine;
+}
+
+/**
+ * The current engine and its vision projector (null without one), read
+ * together so a hot swap cannot come in between.
+ */
+static std::shared_ptr<LlmEngine> current_vision(std::shared_ptr<MultimodalEngine>* vision) {
+    std::lock_guard<std::mutex> lock(g_engine_mutex);
+    std::lock_guard<std::mutex> vision_lock(g_vision_mutex);
+    *vision = g_vision;
+    return g_engine;
+}
+
+/**
+ * LLMBridge.SPECULATION_* to Speculation; unknown values mean Auto.
+ */
+static Speculation to_speculation(jint speculation) {
+    switch (speculation) {
+        case (jint) Speculation::Off:          return Speculation::Off;
+        case (jint) Speculation::PromptLookup: return Speculation::PromptLookup;
+        default:                               return Speculation::Auto;
+    }
+}
+
+/**
+ * Shared body of the generate JNI functions: runs `session` with an optional
+ * streaming callback and converts the result to a Java string.
+ */
+static jstring generate_for_session(JNIEnv* env, LlmEngine& engine, jint session, jstring prompt, jint max_tokens,
+                                    Speculation speculation, jobject callback) {
+    TokenCallback deliver = nullptr;
+    if (callback != nullptr) {
+        jclass callback_class = env->GetObjectClass(callback);
+        jmethodID on_token = env->GetMethodID(callback_class, "onToken", "(Ljava/lang/String;)Z");
+        env->DeleteLocalRef(callback_class);
+        if (on_token == nullptr) {
+            LOGE("TokenCallback.onToken not found");
+            return env->NewStringUTF("");
+        }
+
+        deliver = [env, callback, on_token](const std::string& piece) -> bool {
+            jstring jpiece = utf8_to_jstring(env, piece);
+            jboolean keep_going = env->CallBooleanMethod(callback, on_token, jpiece);
+            env->DeleteLocalRef(jpiece);
+            if (env->ExceptionCheck()) {
+                LOGE("Exception thrown by TokenCallback, stopping generation");
+                return false;
+            }
+            return keep_going == JNI_TRUE;
+        };
+    }
+
+    const char* prompt_cstr = env->GetStringUTFChars(prompt, nullptr);
+    std::string result = engine.generate(session, prompt_cstr, max_tokens, deliver, speculation);
+    env->ReleaseStringUTFChars(prompt, prompt_cstr);
+
+    // Let a pending callback exception propagate to Kotlin
+    if (env->ExceptionCheck()) {
+        return nullptr;
+    }
+    return utf8_to_jstring(env, result);
+}
+
+/**
+ * Initialize the llama.cpp backend once per process; it outlives model reloads
+ * (and a dedicated embedding model may still be using it).
+ */
+static void ensure_backend() {
+    static std::once_flag once;
+    std::call_once(once, llama_backend_init);
+}
+
+/**
+ * Cancel an asynchronous load and wait for its worker, before the engine is
+ * replaced or freed. From the worker itself (a listener callback loading
+ * again) there is nothing to wait for: it is about to exit.
+ */
+static void finish_async_load() {
+    std::thread worker;
+    {
+        std::lock_guard<std::mutex> lock(g_load_mutex);
+        worker = std::move(g_load_thread);
+    }
+    if (!worker.joinable()) {
+        return;
+    }
+    if (worker.get_id() == std::this_thread::get_id()) {
+        worker.detach();
+        return;
+    }
+    g_load_cancel = true;
+    worker.join();
+}
+
+/**
+ * Drop an embedding engine that borrows the chat model, before that model is freed.
+ */
+static void release_borrowed_embedder() {
+    std::lock_guard<std::mutex> lock(g_embedder_mutex);
+    if (g_embedder != nullptr && !g_embedder->owns_model()) {
+        g_embedder.reset();
+    }
+}
+
+/**
+ * Detach the vision projector of the model being replaced; the caller holds
+ * g_engine_mutex and frees it (outside the lock) before that model.
+ */
+static std::shared_ptr<MultimodalEngine> take_vision_locked() {
+    std::lock_guard<std::mutex> lock(g_vision_mutex);
+    return std::move(g_vision);
+}
+
+/**
+ * Make `engine` the current engine. A replaced engine keeps serving the
+ * generations already running on it and is freed when the last one returns;
+ * the projector and borrowed embedder of its model are dropped here.
+ */
+static void install_engine(std::unique_ptr<LlmEngine> engine, const LoadTimings& timings) {
+    std::shared_ptr<LlmEngine> previous;
+    std::shared_ptr<MultimodalEngine> previous_vision;
+    {
+        std::lock_guard<std::mutex> sampling_lock(g_sampling_mutex);
+        engine->set_sampling_params(g_sampling_params);
+        std::lock_guard<std::mutex> lock(g_engine_mutex);
+        previous = std::move(g_engine);
+        g_engine = std::move(engine);
+        previous_vision = take_vision_locked();
+    }
+    g_using_fallback = false;
+    {
+        std::lock_guard<std::mutex> lock(g_load_mutex);
+        g_load_timings = timings;
+    }
+    previous_vision.reset();
+    if (previous != nullptr) {
+        release_borrowed_embedder();
+        LOGI("🔁 Model swapped; previous model freed once %ld in-flight generation(s) finish",
+             previous.use_count() - 1);
+    }
+}
+
+/**
+ * Free the current engine (and what depends on its model) before loading
+ * another in its place.
+ */
+static void free_engine() {
+    std::shared_ptr<LlmEngine> previous;
+    std::shared_ptr<MultimodalEngine> previous_vision;
+    {
+        std::lock_guard<std::mutex> lock(g_engine_mutex);
+        previous = std::move(g_engine);
+        previous_vision = take_vision_locked();
+    }
+    previous_vision.reset();
+    if (previous != nullptr) {
+        LOGI("Model already loaded. Freeing old model first.");
+        release_borrowed_embedder();
+    }
+    std::lock_guard<std::mutex> lock(g_load_mutex);
+    g_load_timings = LoadTimings();
+}
+
+/**
+ * MemAvailable from /proc/meminfo in bytes, or -1 if it cannot be read.
+ */
+static int64_t available_memory_bytes() {
+    FILE* meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo == nullptr) {
+        return -1;
+    }
+    char line[128];
+    int64_t available_kb = -1;
+    while (fgets(line, sizeof(line), meminfo) != nullptr) {
+        if (sscanf(line, "MemAvailable: %" SCNd64 " kB", &available_kb) == 1) {
+            break;
+        }
+    }
+    fclose(meminfo);
+    return available_kb >= 0 ? available_kb * 1024 : -1;
+}
+
+/**
+ * Whether `path` can be loaded while `current` stays resident. The current
+ * model's weights are file pages that MemAvailable counts as reclaimable,
+ * but evicting them would stall the generations it is still serving, so
+ * they are taken out of the budget.
+ */
+static bool swap_fits(const LlmEngine& current, const std::string& path, const LoadOptions& options) {
+    ContextPlan plan;
+    if (!plan_context_for_file(path.c_str(), options.n_ctx, options.memory_budget, plan)) {
+        return false;
+    }
+    const int64_t available = available_memory_bytes();
+    if (available < 0) {
+        LOGI("MemAvailable unknown, allowing swap");
+        return true;
+    }
+    const int64_t required = plan.total_bytes() + kSwapMarginBytes;
+    const int64_t budget = available - (int64_t) llama_model_size(current.model());
+    LOGI("Swap memory check: need ~%" PRId64 " MB, have ~%" PRId64 " MB", required >> 20, budget >> 20);
+    return required <= budget;
+}
+
+/**
+ * Body of the background load worker: loads with progress reported to
+ * the Kotlin ModelLoadListener, installs the engine and reports completion.
+ */
+static void async_load_worker(JavaVM* vm, jobject listener, std::string path, LoadOptions options) {
+    JNIEnv* env = nullptr;
+    if (vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+        LOGE("❌ Failed to attach model loading thread");
+        return;
+    }
+    jclass listener_class = env->GetObjectClass(listener);
+    jmethodID on_progress = env->GetMethodID(listener_class, "onProgress", "(F)Z");
+    jmethodID on_loaded = env->GetMethodID(listener_class, "onLoaded", "(Z)V");
+    env->DeleteLocalRef(listener_class);
+    if (on_progress == nullptr || on_loaded == nullptr) {
+        env->ExceptionClear();
+        LOGE("ModelLoadListener methods not found");
+    }
+
+    // llama.cpp reports every tensor; pass on whole percents only
+    int last_percent = -1;
+    options.on_progress = [env, listener, on_progress, &last_percent](float progress) -> bool {
+        if (g_load_cancel) {
+            return false;
+        }
+        const int percent = (int) (progress * 100.0f);
+        if (on_progress == nullptr || percent == last_percent) {
+            return true;
+        }
+        last_percent = percent;
+        const jboolean keep_going = env->CallBooleanMethod(listener, on_progress, (jfloat) progress);
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+            LOGE("Exception thrown by ModelLoadListener.onProgress, cancelling load");
+            return false;
+        }
+        return keep_going == JNI_TRUE;
+    };
+
+    LoadTimings timings;
+    std::unique_ptr<LlmEngine> engine = LlmEngine::load(path.c_str(), options, &timings);
+    const bool loaded = engine != nullptr && !g_load_cancel;
+    if (loaded) {
+        install_engine(std::move(engine), timings);
+        LOGI("✅ Model loaded in background: %s", path.c_str());
+    } else {
+        engine.reset();
+        LOGE("❌ Background model load %s: %s", g_load_cancel ? "cancelled" : "failed", path.c_str());
+    }
+
+    if (on_loaded != nullptr) {
+        env->CallVoidMethod(listener, on_loaded, loaded ? JNI_TRUE : JNI_FALSE);
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+            LOGE("Exception thrown by ModelLoadListener.onLoaded");
+        }
+    }
+    env->DeleteGlobalRef(listener);
+    vm->DetachCurrentThread();
+}
+
+/**
+ * Start async_load_worker for `path`; the caller has dealt with any current engine.
+ */
+static jboolean start_async_load(JNIEnv* env, std::string path, LoadOptions options, jobject listener) {
+    JavaVM* vm = nullptr;
+    if (listener == nullptr || env->GetJavaVM(&vm) != JNI_OK) {
+        LOGE("❌ Cannot start background load without a listener");
+        return JNI_FALSE;
+    }
+    LOGI("Loading model in background from: %s (context %d%s%s)", path.c_str(), options.n_ctx,
+         options.use_mlock ? ", mlock" : "", options.warmup ? ", warm-up" : "");
+
+    ensure_backend();
+    std::lock_guard<std::mutex> lock(g_load_mutex);
+    g_load_cancel = false;
+    g_load_thread = std::thread(async_load_worker, vm, env->NewGlobalRef(listener), std::move(path), std::move(options));
+    return JNI_TRUE;
+}
+
+static std::string jstring_to_string(JNIEnv* env, jstring text) {
+    const char* chars = env->GetStringUTFChars(text, nullptr);
+    std::string result(chars);
+    env->ReleaseStringUTFChars(text, chars);
+    return result;
+}
+
+/**
+ * The prompt with the image marker in it: as given if the caller placed the
+ * marker, otherwise one user turn in the model's chat template with the
+ * image ahead of the text.
+ */
+static std::string multimodal_prompt(const LlmEngine& engine, const std::string& prompt) {
+    const std::string marker = MultimodalEngine::marker();
+    if (prompt.find(marker) != std::string::npos) {
+        return prompt;
+    }
+    const std::string content = marker + "\n" + prompt;
+    const char* tmpl = llama_model_chat_template(engine.model(), nullptr);
+    if (tmpl == nullptr) {
+        return content;
+    }
+    llama_chat_message message = {"user", content.c_str()};
+    std::vector<char> buf(content.size() * 2 + 256);
+    int32_t n = llama_chat_apply_template(tmpl, &message, 1, true, buf.data(), (int32_t) buf.size());
+    if (n > (int32_t) buf.size()) {
+        buf.resize(n);
+        n = llama_chat_apply_template(tmpl, &message, 1, true, buf.data(), (int32_t) buf.size());
+    }
+    return n > 0 ? std::string(buf.data(), n) : content;
+}
+
+/**
+ * Embedding engine to use, creating one on the chat model if no dedicated
+ * embedding model is loaded. Caller holds g_embedder_mutex.
+ */
+static EmbeddingEngine* current_embedder() {
+    if (g_embedder == nullptr) {
+        // Under g_engine_mutex, so a swap cannot free the model in between;
+        // install_engine then drops the embedder with the old model
+        std::lock_guard<std::mutex> lock(g_engine_mutex);
+        if (g_engine != nullptr) {
+            LOGI("No dedicated embedding model, creating embedding context on the chat model");
+            g_embedder = EmbeddingEngine::create(g_engine->model(), g_engine->model_key(), LLAMA_POOLING_TYPE_MEAN);
+        }
+    }
+    return g_embedder.get();
+}
 
 extern "C" {
 
@@ -50,7 +427,7 @@ extern "C" {
  * @param env JNI environment
  * @param thiz Java object reference
  * @param model_path Path to .gguf model file
- * @param n_ctx Context size (default 2048)
+ * @param n_ctx Context size (default 2048), shared by all sessions
  * @return true if successful, false otherwise
  */
 JNIEXPORT jboolean JNICALL
@@ -60,59 +437,33 @@ Java_com_ailive_ai_llm_LLMBridge_nativeLoadModel(
         jstring model_path,
         jint n_ctx) {
 
-    if (g_model != nullptr || g_ctx != nullptr) {
-        LOGI("Model already loaded. Freeing old model first.");
-        if (g_ctx != nullptr) {
-            llama_free(g_ctx);
-            g_ctx = nullptr;
-        }
-        if (g_model != nullptr) {
-            llama_model_free(g_model);
-            g_model = nullptr;
-        }
-    }
+    finish_async_load();
+    free_engine();
 
     const char* path = env->GetStringUTFChars(model_path, nullptr);
     LOGI("Loading model from: %s", path);
     LOGI("Context size: %d", n_ctx);
 
     try {
-        llama_backend_init(); // Initialize backend
+        ensure_backend();
 
-        llama_model_params model_params = llama_model_default_params();
-        model_params.n_gpu_layers = 99; // Offload as much as possible
-
-        g_model = llama_model_load_from_file(path, model_params);
-        if (g_model == nullptr) {
-            LOGE("Failed to load model from %s", path);
+        LoadOptions options;
+        options.n_ctx = n_ctx;
+        LoadTimings timings;
+        std::unique_ptr<LlmEngine> engine = LlmEngine::load(path, options, &timings);
+        if (engine == nullptr) {
             env->ReleaseStringUTFChars(model_path, path);
-            
-            // FALLBACK: Try to use fallback implementation
-            LOGI("Attempting fallback implementation...");
-            g_using_fallback = true;
-            return Java_com_ailive_ai_llm_LLMBridge_fallbackLoadModel(env, thiz, model_path, n_ctx);
-        }
-
-        llama_context_params ctx_params = llama_context_default_params();
-        ctx_params.n_ctx = n_ctx > 0 ? n_ctx : 2048;
-        ctx_params.n_threads = 4;
-        ctx_params.n_batch = 512;
 
-        g_ctx = llama_init_from_model(g_model, ctx_params);
-        if (g_ctx == nullptr) {
-            LOGE("Failed to create context");
-            llama_model_free(g_model);
-            g_model = nullptr;
-            env->ReleaseStringUTFChars(model_path, path);
-            
             // FALLBACK: Try to use fallback implementation
             LOGI("Attempting fallback implementation...");
             g_using_fallback = true;
             return Java_com_ailive_ai_llm_LLMBridge_fallbackLoadModel(env, thiz, model_path, n_ctx);
         }
+        install_engine(std::move(engine), timings);
 
         LOGI("✅ Model loaded successfully!");
-        LOGI("   Context size: %d", llama_n_ctx(g_ctx));
+        LOGI("   Context size: %d", n_ctx);
+        LOGI("   Sessions: %d", LlmEngine::kMaxSessions);
 
         env->ReleaseStringUTFChars(model_path, path);
         return JNI_TRUE;
@@ -120,7 +471,8 @@ Java_com_ailive_ai_llm_LLMBridge_nativeLoadModel(
     } catch (const std::exception& e) {
         LOGE("Exception during model loading: %s", e.what());
         if (path != nullptr) env->ReleaseStringUTFChars(model_path, path);
-        
+        free_engine();
+
         // FALLBACK: Try to use fallback implementation
         LOGI("Attempting fallback implementation...");
         g_using_fallback = true;
@@ -128,23 +480,198 @@ Java_com_ailive_ai_llm_LLMBridge_nativeLoadModel(
     }
 }
 
+/**
+ * Load a GGUF model on a native worker thread
+ *
+ * Returns immediately. The worker reports tensor loading progress to
+ * listener.onProgress (0..1, whole percents; returning false cancels),
+ * optionally pins the weights with mlock, runs a warm-up decode so the first
+ * prompt runs at steady-state speed, installs the engine and then calls
+ * listener.onLoaded(success). Both callbacks run on the worker thread.
+ * A previous model is freed first (see nativeSwapModelAsync to keep it
+ * serving); a load already running is cancelled.
+ *
+ * @param model_path Path to .gguf model file
+ * @param n_ctx Context size, shared by all sessions
+ * @param use_mlock Pin the weights in RAM (subject to RLIMIT_MEMLOCK)
+ * @param warmup Run the warm-up decode
+ * @param memory_budget Bytes for weights plus context; the KV cache type, batch
+ *        sizes and if need be n_ctx are chosen to fit (0 = no budget)
+ * @param listener com.ailive.ai.llm.LLMBridge.ModelLoadListener
+ * @return false if the worker could not be started
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeLoadModelAsync(
+        JNIEnv* env,
+        jobject thiz,
+        jstring model_path,
+        jint n_ctx,
+        jboolean use_mlock,
+        jboolean warmup,
+        jlong memory_budget,
+        jobject listener) {
+
+    finish_async_load();
+    free_engine();
+
+    LoadOptions options;
+    options.n_ctx = n_ctx;
+    options.use_mlock = use_mlock;
+    options.warmup = warmup;
+    options.memory_budget = memory_budget;
+    return start_async_load(env, jstring_to_string(env, model_path), std::move(options), listener);
+}
+
+/**
+ * Replace the loaded model without downtime
+ *
+ * Like nativeLoadModelAsync, but the current model keeps serving while the
+ * new one loads and warms up. The new engine is then swapped in atomically;
+ * generations already running finish on the old one, which is freed when
+ * the last of them returns. Session handles of the old model become invalid.
+ * Without a loaded model this is a plain background load. The new model's
+ * context is planned first (as by nativePlanContext) and its weights, KV
+ * cache and compute buffers must fit next to the current weights.
+ *
+ * @return false if the worker could not be started, or if both models would
+ *         not fit in memory together (the current model is left untouched)
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeSwapModelAsync(
+        JNIEnv* env,
+        jobject thiz,
+        jstring model_path,
+        jint n_ctx,
+        jboolean use_mlock,
+        jlong memory_budget,
+        jobject listener) {
+
+    finish_async_load();
+    std::string path = jstring_to_string(env, model_path);
+    LoadOptions options;
+    options.n_ctx = n_ctx;
+    options.use_mlock = use_mlock;
+    options.warmup = true;  // the swap waits for it, so the first prompt after it is fast
+    options.memory_budget = memory_budget;
+
+    std::shared_ptr<LlmEngine> current = current_engine();
+    if (current != nullptr && !swap_fits(*current, path, options)) {
+        LOGE("❌ Not enough memory to load %s next to the current model, swap refused", path.c_str());
+        return JNI_FALSE;
+    }
+    current.reset();
+    return start_async_load(env, std::move(path), std::move(options), listener);
+}
+
+/**
+ * Cancel a background load; the listener still receives onLoaded(false)
+ */
+JNIEXPORT void JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeCancelLoad(JNIEnv* env, jobject thiz) {
+    g_load_cancel = true;
+}
+
+/**
+ * Get load timings of the current model
+ *
+ * @return long[5]: { model load us, context us, warm-up us, total us,
+ *         first token us (-1 until the first generation produced one) }
+ */
+JNIEXPORT jlongArray JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeGetLoadTimings(JNIEnv* env, jobject thiz) {
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    LoadTimings timings;
+    {
+        std::lock_guard<std::mutex> lock(g_load_mutex);
+        timings = g_load_timings;
+    }
+    jlong values[5] = {
+        timings.model_us,
+        timings.context_us,
+        timings.warmup_us,
+        timings.total_us,
+        engine != nullptr ? engine->first_token_us() : -1
+    };
+    jlongArray result = env->NewLongArray(5);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, 5, values);
+    }
+    return result;
+}
+
+static jlongArray plan_to_jlongs(JNIEnv* env, const ContextPlan& plan) {
+    jlong values[9] = {
+        plan.n_ctx,
+        plan.n_batch,
+        plan.n_ubatch,
+        (jlong) plan.type_k,
+        (jlong) plan.type_v,
+        plan.flash_attn ? 1 : 0,
+        plan.weights_bytes,
+        plan.kv_bytes,
+        plan.compute_bytes
+    };
+    jlongArray result = env->NewLongArray(9);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, 9, values);
+    }
+    return result;
+}
+
+/**
+ * Plan the context a model would get under a memory budget, without loading
+ * its weights (only hyperparameters and vocabulary are read)
+ *
+ * @return long[9]: { n_ctx, n_batch, n_ubatch, K type, V type (ggml_type),
+ *         flash attention forced (0/1), weights bytes, KV bytes, compute bytes },
+ *         or null if no context fits the budget
+ */
+JNIEXPORT jlongArray JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativePlanContext(
+        JNIEnv* env,
+        jobject thiz,
+        jstring model_path,
+        jint n_ctx,
+        jlong memory_budget) {
+    ensure_backend();
+    ContextPlan plan;
+    if (!plan_context_for_file(jstring_to_string(env, model_path).c_str(), n_ctx, memory_budget, plan)) {
+        return nullptr;
+    }
+    return plan_to_jlongs(env, plan);
+}
+
+/**
+ * Get the context plan of the current model (same layout as nativePlanContext)
+ *
+ * @return long[9], or null if no model is loaded
+ */
+JNIEXPORT jlongArray JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeGetContextPlan(JNIEnv* env, jobject thiz) {
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (engine == nullptr) {
+        return nullptr;
+    }
+    return plan_to_jlongs(env, engine->context_plan());
+}
+
 /**
  * Generate text completion
- * 
+ *
  * ===== NATIVE LLM RESPONSE GENERATION ENTRY POINT =====
  * This is the core JNI function that generates AI responses to user queries.
  * It bridges the Java/Kotlin layer to the native llama.cpp implementation.
- * 
+ *
  * RESPONSE GENERATION PROCESS:
  * 1. Validates model state and falls back if needed
- * 2. Calls llama_decode_and_generate for actual text generation
+ * 2. Calls LlmEngine::generate on the default session for actual text generation
  * 3. Returns generated text to Java layer for user display
- * 
+ *
  * ERROR HANDLING FOR USER EXPERIENCE:
  * - Falls back to alternative implementation if llama.cpp fails
  * - Returns empty string if no model is loaded (graceful degradation)
  * - Ensures user never sees crashes, only responses or error messages
- * 
+ *
  * PERFORMANCE CONSIDERATIONS:
  * - All heavy lifting done in native code for efficiency
  * - Token generation optimized for mobile devices
@@ -168,22 +695,329 @@ Java_com_ailive_ai_llm_LLMBridge_nativeGenerate(
         LOGI("Using fallback implementation for generation");
         return Java_com_ailive_ai_llm_LLMBridge_fallbackGenerate(env, thiz, prompt, max_tokens);
     }
-    
-    if (g_model == nullptr || g_ctx == nullptr) {
+
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (engine == nullptr) {
         LOGE("Model not loaded, cannot generate.");
         return env->NewStringUTF("");
     }
 
-    const char* prompt_cstr = env->GetStringUTFChars(prompt, nullptr);
-    std::string result = llama_decode_and_generate(prompt_cstr, max_tokens);
-    env->ReleaseStringUTFChars(prompt, prompt_cstr);
+    return generate_for_session(env, *engine, LlmEngine::kDefaultSession, prompt, max_tokens, Speculation::Auto,
+                                nullptr);
+}
+
+/**
+ * Generate text completion, streaming each piece to a Kotlin callback
+ *
+ * Pieces are delivered on the calling thread as soon as they are sampled.
+ * Bytes of a multi-byte UTF-8 character split across tokens are held back
+ * until the character is complete, so every piece is valid text.
+ *
+ * @param env JNI environment
+ * @param thiz Java object reference
+ * @param prompt Input text prompt
+ * @param max_tokens Maximum tokens to generate
+ * @param callback LLMBridge.TokenCallback; returning false cancels generation
+ * @return The complete generated text
+ */
+JNIEXPORT jstring JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeGenerateStream(
+        JNIEnv* env,
+        jobject thiz,
+        jstring prompt,
+        jint max_tokens,
+        jobject callback) {
+
+    // Check if we should use fallback implementation
+    if (g_using_fallback) {
+        LOGI("Using fallback implementation for streaming generation");
+        jclass callback_class = env->GetObjectClass(callback);
+        jmethodID on_token = env->GetMethodID(callback_class, "onToken", "(Ljava/lang/String;)Z");
+        env->DeleteLocalRef(callback_class);
+        jstring result = Java_com_ailive_ai_llm_LLMBridge_fallbackGenerate(env, thiz, prompt, max_tokens);
+        if (on_token != nullptr) {
+            env->CallBooleanMethod(callback, on_token, result);
+        }
+        return result;
+    }
+
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (engine == nullptr) {
+        LOGE("Model not loaded, cannot generate.");
+        return env->NewStringUTF("");
+    }
+
+    return generate_for_session(env, *engine, LlmEngine::kDefaultSession, prompt, max_tokens, Speculation::Auto,
+                                callback);
+}
+
+/**
+ * Create an inference session with its own KV sequence
+ *
+ * Sessions keep their prompt prefix cached independently, so e.g. the
+ * conversation and background fact extraction do not evict each other.
+ *
+ * @return Session handle, or -1 if no model is loaded or all slots are in use
+ */
+JNIEXPORT jint JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeCreateSession(JNIEnv* env, jobject thiz) {
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (g_using_fallback || engine == nullptr) {
+        return -1;
+    }
+    return engine->create_session();
+}
+
+/**
+ * Destroy a session and release its KV sequence
+ *
+ * The default session (0) and sessions that are currently generating
+ * cannot be destroyed.
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeDestroySession(JNIEnv* env, jobject thiz, jint session) {
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (g_using_fallback || engine == nullptr) {
+        return JNI_FALSE;
+    }
+    return engine->destroy_session(session) ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * Check whether a session handle is still valid (handles die with the model)
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeIsSessionActive(JNIEnv* env, jobject thiz, jint session) {
+    if (g_using_fallback) {
+        return session == LlmEngine::kDefaultSession ? JNI_TRUE : JNI_FALSE;
+    }
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (engine == nullptr) {
+        return JNI_FALSE;
+    }
+    return engine->is_session_active(session) ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * Pin the start of a session's prompts (the system prompt), so a conversation
+ * outgrowing the context window evicts its oldest turns and keeps this
+ *
+ * @param session Session handle (0 = default session)
+ * @param prefix Text every prompt of the session starts with; "" unpins
+ * @return false if the session is invalid or no model is loaded
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeSetPinnedPrefix(JNIEnv* env, jobject thiz, jint session, jstring prefix) {
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (engine == nullptr) {
+        return JNI_FALSE;
+    }
+    return engine->set_pinned_prefix(session, jstring_to_string(env, prefix)) ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * Attach a draft model for speculative decoding of the current model
+ *
+ * The draft must use the same tokenizer (e.g. a 0.5B model of the same
+ * family). Loads on the calling thread while generation continues; it is
+ * freed with the model, so attach it again after a reload or swap.
+ *
+ * @param path Draft GGUF file
+ * @param n_draft Tokens drafted per session and step (at most 8)
+ * @return false if no model is loaded or the draft cannot be used with it
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeLoadDraftModel(JNIEnv* env, jobject thiz, jstring path, jint n_draft) {
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (g_using_fallback || engine == nullptr) {
+        LOGE("Cannot load draft model: no model loaded");
+        return JNI_FALSE;
+    }
+    const std::string draft_path = jstring_to_string(env, path);
+    return engine->load_draft(draft_path.c_str(), n_draft) ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * Detach and free the draft model; decoding continues one token per step
+ */
+JNIEXPORT void JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeFreeDraftModel(JNIEnv* env, jobject thiz) {
+    if (std::shared_ptr<LlmEngine> engine = current_engine()) {
+        engine->free_draft();
+    }
+}
+
+/**
+ * Save a session's KV cache and token list to a snapshot file
+ *
+ * Only the copy out of the KV cache holds the engine; the file is written
+ * on the calling thread, so call this off the UI thread after a turn.
+ *
+ * @param session Session handle (0 = default session)
+ * @param path Snapshot file, replaced atomically
+ * @return false if the session is empty, generating, or the write failed
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeSaveSessionState(JNIEnv* env, jobject thiz, jint session, jstring path) {
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (g_using_fallback || engine == nullptr) {
+        return JNI_FALSE;
+    }
+    SessionSnapshot snapshot;
+    if (!engine->snapshot_session(session, snapshot)) {
+        return JNI_FALSE;
+    }
+    engine.reset();
+
+    const std::string file = jstring_to_string(env, path);
+    if (!write_session_snapshot(file, snapshot)) {
+        return JNI_FALSE;
+    }
+    LOGI("💾 Session %d saved: %zu tokens, %zu KB", session, snapshot.tokens.size(),
+         snapshot.state.size() / 1024);
+    return JNI_TRUE;
+}
+
+/**
+ * Restore a session from a snapshot written by nativeSaveSessionState
+ *
+ * The snapshot is used only if it was taken on the same model file and
+ * context size; its tokens then count as cached, so the next prompt that
+ * starts with them skips their prefill.
+ *
+ * @return Number of tokens restored, or -1 (no usable snapshot)
+ */
+JNIEXPORT jint JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeRestoreSessionState(JNIEnv* env, jobject thiz, jint session, jstring path) {
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (g_using_fallback || engine == nullptr) {
+        return -1;
+    }
+    SessionSnapshot snapshot;
+    const ContextPlan& plan = engine->context_plan();
+    if (!read_session_snapshot(jstring_to_string(env, path), engine->model_key(),
+                               llama_n_ctx(engine->context()), plan.type_k, plan.type_v, snapshot)) {
+        return -1;
+    }
+    return engine->restore_session(session, snapshot);
+}
+
+/**
+ * Generate text completion in a specific session
+ *
+ * @param session Handle from nativeCreateSession (0 = default session)
+ * @param prompt Input text prompt
+ * @param max_tokens Maximum tokens to generate
+ * @param speculation LLMBridge.SPECULATION_* (off, draft model if attached, prompt lookup)
+ * @return Generated text, or empty string for an invalid session
+ */
+JNIEXPORT jstring JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeGenerateSession(
+        JNIEnv* env,
+        jobject thiz,
+        jint session,
+        jstring prompt,
+        jint max_tokens,
+        jint speculation) {
+
+    if (g_using_fallback) {
+        LOGI("Using fallback implementation for generation");
+        return Java_com_ailive_ai_llm_LLMBridge_fallbackGenerate(env, thiz, prompt, max_tokens);
+    }
+
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (engine == nullptr) {
+        LOGE("Model not loaded, cannot generate.");
+        return env->NewStringUTF("");
+    }
+
+    return generate_for_session(env, *engine, session, prompt, max_tokens, to_speculation(speculation), nullptr);
+}
+
+/**
+ * Streaming variant of nativeGenerateSession
+ *
+ * @param session Handle from nativeCreateSession (0 = default session)
+ * @param prompt Input text prompt
+ * @param max_tokens Maximum tokens to generate
+ * @param speculation LLMBridge.SPECULATION_* (off, draft model if attached, prompt lookup)
+ * @param callback LLMBridge.TokenCallback; returning false cancels generation
+ * @return The complete generated text
+ */
+JNIEXPORT jstring JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeGenerateSessionStream(
+        JNIEnv* env,
+        jobject thiz,
+        jint session,
+        jstring prompt,
+        jint max_tokens,
+        jint speculation,
+        jobject callback) {
+
+    if (g_using_fallback) {
+        return Java_com_ailive_ai_llm_LLMBridge_nativeGenerateStream(env, thiz, prompt, max_tokens, callback);
+    }
+
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (engine == nullptr) {
+        LOGE("Model not loaded, cannot generate.");
+        return env->NewStringUTF("");
+    }
 
-    return env->NewStringUTF(result.c_str());
+    return generate_for_session(env, *engine, session, prompt, max_tokens, to_speculation(speculation), callback);
+}
+
+/**
+ * Load the vision projector (mmproj GGUF) matching the loaded chat model.
+ *
+ * @param mmproj_path Path to the projector .gguf file
+ * @param max_image_side Images are downscaled to this longer side before
+ *        encoding (fewer image tokens, faster encoder); 0 = default
+ * @return true if loaded
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeLoadVisionProjector(
+        JNIEnv* env,
+        jobject thiz,
+        jstring mmproj_path,
+        jint max_image_side) {
+
+    std::shared_ptr<LlmEngine> engine = current_engine();
+    if (g_using_fallback || engine == nullptr) {
+        LOGE("Load the chat model before its vision projector.");
+        return JNI_FALSE;
+    }
+
+    const char* path = env->GetStringUTFChars(mmproj_path, nullptr);
+    LOGI("Loading vision projector from: %s", path);
+    std::unique_ptr<MultimodalEngine> vision = MultimodalEngine::load(path, engine->model(), 4, max_image_side);
+    env->ReleaseStringUTFChars(mmproj_path, path);
+    if (vision == nullptr) {
+        return JNI_FALSE;
+    }
+
+    // Checked and installed under g_engine_mutex: a swap either happened
+    // before (refused here) or drops this projector with the old model
+    std::lock_guard<std::mutex> lock(g_engine_mutex);
+    if (g_engine != engine) {
+        LOGE("Model was swapped while loading its vision projector.");
+        return JNI_FALSE;
+    }
+    std::lock_guard<std::mutex> vision_lock(g_vision_mutex);
+    g_vision = std::move(vision);
+    g_last_image_stats = ImageEncodeStats();
+    return JNI_TRUE;
 }
 
 /**
  * Generate text completion with image input (multimodal).
  *
+ * The image goes where the prompt has the "<__media__>" marker; without
+ * one, the prompt is wrapped in the model's chat template with the image
+ * first. Embeddings of recent images are cached by content hash, so
+ * follow-up questions about the same frame skip the vision encoder.
+ * Per-call figures are available from nativeGetVisionStats.
+ *
  * @param env JNI environment
  * @param thiz Java object reference
  * @param prompt Input text prompt
@@ -204,32 +1038,103 @@ Java_com_ailive_ai_llm_LLMBridge_nativeGenerateWithImage(
         LOGI("Using fallback implementation for multimodal generation");
         return Java_com_ailive_ai_llm_LLMBridge_fallbackGenerateWithImage(env, thiz, prompt, image_bytes, max_tokens);
     }
-    
-    if (g_model == nullptr || g_ctx == nullptr) {
+
+    std::shared_ptr<MultimodalEngine> vision;
+    std::shared_ptr<LlmEngine> engine = current_vision(&vision);
+    if (engine == nullptr) {
         LOGE("Model not loaded, cannot generate with image.");
         return env->NewStringUTF("");
     }
+    if (vision == nullptr) {
+        LOGE("No vision projector loaded, cannot generate with image.");
+        return env->NewStringUTF("[ERROR: Vision projector (mmproj) not loaded]");
+    }
 
-    const char* prompt_cstr = env->GetStringUTFChars(prompt, nullptr);
+    // --- Image embeddings (cached by content) ---
+    ImageEncodeStats stats;
+    const jsize image_len = env->GetArrayLength(image_bytes);
     jbyte* image_data = env->GetByteArrayElements(image_bytes, nullptr);
-    jsize image_len = env->GetArrayLength(image_bytes);
+    std::shared_ptr<const ImageEmbedding> image =
+            vision->embed(reinterpret_cast<const uint8_t*>(image_data), (size_t) image_len, &stats);
+    env->ReleaseByteArrayElements(image_bytes, image_data, JNI_ABORT);
+    {
+        std::lock_guard<std::mutex> lock(g_vision_mutex);
+        g_last_image_stats = stats;
+    }
+    if (image == nullptr) {
+        return env->NewStringUTF("[ERROR: Image embedding failed]");
+    }
 
-    std::vector<uint8_t> image_vec(image_data, image_data + image_len);
+    // --- Text around the image ---
+    const char* prompt_cstr = env->GetStringUTFChars(prompt, nullptr);
+    const std::string full_prompt = multimodal_prompt(*engine, prompt_cstr);
+    env->ReleaseStringUTFChars(prompt, prompt_cstr);
 
-    // TODO: Vision features temporarily disabled - llama_image API not available in current llama.cpp
-    std::string result = "[ERROR: Vision/multimodal features not available in this build]";
-    // std::string result = llama_decode_and_generate_multimodal(prompt_cstr, image_vec, max_tokens);
+    const std::string marker = MultimodalEngine::marker();
+    const size_t at = full_prompt.find(marker);
+    std::vector<llama_token> before;
+    std::vector<llama_token> after;
+    engine->tokenize(full_prompt.substr(0, at), before, true, true);   // may be empty
+    engine->tokenize(full_prompt.substr(at + marker.size()), after, false, true);
+    before.insert(before.end(), image->before.begin(), image->before.end());
+    after.insert(after.begin(), image->after.begin(), image->after.end());
+
+    LOGI("🖼️ Image: %d tokens, %s, encoder %.1f ms",
+         stats.n_tokens, stats.cache_hit ? "cache hit" : "cache miss", stats.encode_us / 1000.0);
+
+    std::string result = engine->generate_with_embedding(
+            LlmEngine::kDefaultSession, before, vision->prompt_embedding(image), after, max_tokens);
+    return utf8_to_jstring(env, result);
+}
 
-    env->ReleaseStringUTFChars(prompt, prompt_cstr);
-    env->ReleaseByteArrayElements(image_bytes, image_data, JNI_ABORT);
+/**
+ * Vision statistics: the last image and the embedding cache
+ *
+ * @return long[7]: { image tokens, decode us, encoder us, cache hit (0/1),
+ *         cache hits, cache misses, cached bytes } - zeros without a projector
+ */
+JNIEXPORT jlongArray JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeGetVisionStats(JNIEnv* env, jobject thiz) {
+    ImageEncodeStats last;
+    MultimodalCacheStats cache;
+    {
+        std::lock_guard<std::mutex> lock(g_vision_mutex);
+        last = g_last_image_stats;
+        if (g_vision != nullptr) {
+            cache = g_vision->cache_stats();
+        }
+    }
+    jlong stats[7] = {
+        last.n_tokens,
+        last.decode_us,
+        last.encode_us,
+        last.cache_hit ? 1 : 0,
+        cache.hits,
+        cache.misses,
+        cache.bytes
+    };
+    jlongArray result = env->NewLongArray(7);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, 7, stats);
+    }
+    return result;
+}
 
-    return env->NewStringUTF(result.c_str());
+/**
+ * Check if a vision projector is loaded (model reloads free it)
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeIsVisionLoaded(JNIEnv* env, jobject thiz) {
+    std::lock_guard<std::mutex> lock(g_vision_mutex);
+    return g_vision != nullptr ? JNI_TRUE : JNI_FALSE;
 }
 
 
 /**
  * Generate an embedding vector for a given prompt.
  *
+ * Uses the embedding engine (pooled, L2-normalized); no chat session state is touched.
+ *
  * @param env JNI environment
  * @param thiz Java object reference
  * @param prompt Input text prompt
@@ -246,80 +1151,153 @@ Java_com_ailive_ai_llm_LLMBridge_nativeGenerateEmbedding(
         LOGI("Using fallback implementation for embedding generation");
         return Java_com_ailive_ai_llm_LLMBridge_fallbackGenerateEmbedding(env, thiz, prompt);
     }
-    
-    if (g_model == nullptr || g_ctx == nullptr) {
-        LOGE("Model not loaded, cannot generate embedding.");
-        return nullptr;
-    }
 
     const char* prompt_cstr = env->GetStringUTFChars(prompt, nullptr);
     LOGI("🧠 Generating embedding for: %.80s...", prompt_cstr);
+    std::vector<std::string> texts(1, prompt_cstr);
+    env->ReleaseStringUTFChars(prompt, prompt_cstr);
 
-    // Note: KV cache clearing function varies by llama.cpp version
-    // Skipping cache clear - will naturally overwrite with new tokens
-
-    // Tokenize the prompt
-    std::vector<llama_token> tokens;
-    tokens.resize(strlen(prompt_cstr) + 1); // Actually allocate memory
-    const llama_vocab* vocab = llama_model_get_vocab(g_model);
-    int n_tokens = llama_tokenize(vocab, prompt_cstr, strlen(prompt_cstr), tokens.data(), tokens.size(), true, false);
-    if (n_tokens < 0) {
-        tokens.resize(-n_tokens);
-        n_tokens = llama_tokenize(vocab, prompt_cstr, strlen(prompt_cstr), tokens.data(), tokens.size(), true, false);
-    } else {
-        tokens.resize(n_tokens);
+    std::vector<float> embedding;
+    {
+        std::lock_guard<std::mutex> lock(g_embedder_mutex);
+        EmbeddingEngine* embedder = current_embedder();
+        if (embedder == nullptr) {
+            LOGE("Model not loaded, cannot generate embedding.");
+            return nullptr;
+        }
+        if (!embedder->embed_batch(texts, embedding)) {
+            return nullptr;
+        }
     }
 
-    if (n_tokens <= 0) {
-        LOGE("Embedding tokenization failed.");
-        env->ReleaseStringUTFChars(prompt, prompt_cstr);
+    // Create and return the float array
+    const jsize n_embd = (jsize) embedding.size();
+    jfloatArray result = env->NewFloatArray(n_embd);
+    if (result == nullptr) {
+        LOGE("Failed to create new float array.");
         return nullptr;
     }
+    env->SetFloatArrayRegion(result, 0, n_embd, embedding.data());
 
-    // Create a batch for the prompt
-    llama_batch batch = llama_batch_init(n_tokens, 0, 1);
-    batch.n_tokens = n_tokens;
-    for (int i = 0; i < n_tokens; ++i) {
-        batch.token[i] = tokens[i];
-        batch.pos[i] = i;
-        batch.n_seq_id[i] = 1;
-        batch.seq_id[i][0] = 0;
-        batch.logits[i] = 0; // Logits not needed for embedding
-    }
+    LOGI("✅ Embedding generated successfully.");
+    return result;
+}
 
-    // Decode the prompt to update the context
-    if (llama_decode(g_ctx, batch) != 0) {
-        LOGE("llama_decode failed for embedding");
-        llama_batch_free(batch);
-        env->ReleaseStringUTFChars(prompt, prompt_cstr);
-        return nullptr;
+/**
+ * Load a dedicated embedding model (e.g. bge-small GGUF)
+ *
+ * @param model_path Path to the embedding .gguf file
+ * @param pooling 1 = mean, 2 = CLS, -1 = model default
+ * @return true if loaded successfully
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeLoadEmbeddingModel(
+        JNIEnv* env,
+        jobject thiz,
+        jstring model_path,
+        jint pooling) {
+
+    const char* path = env->GetStringUTFChars(model_path, nullptr);
+    LOGI("Loading embedding model from: %s (pooling %d)", path, pooling);
+
+    ensure_backend();
+    std::unique_ptr<EmbeddingEngine> embedder = EmbeddingEngine::load(path, pooling);
+    env->ReleaseStringUTFChars(model_path, path);
+
+    if (embedder == nullptr) {
+        LOGE("❌ Failed to load embedding model");
+        return JNI_FALSE;
     }
 
-    // Get the embedding for the last token
-    const int n_embd = llama_model_n_embd(g_model);
-    const float* embedding = llama_get_embeddings_ith(g_ctx, n_tokens - 1);
+    std::lock_guard<std::mutex> lock(g_embedder_mutex);
+    g_embedder = std::move(embedder);
+    LOGI("✅ Embedding model loaded (dim %d)", g_embedder->dim());
+    return JNI_TRUE;
+}
 
-    if (embedding == nullptr) {
-        LOGE("Failed to get embeddings.");
-        llama_batch_free(batch);
-        env->ReleaseStringUTFChars(prompt, prompt_cstr);
-        return nullptr;
+/**
+ * Embed many texts in as few batches as possible
+ *
+ * @param texts Texts to embed
+ * @return Contiguous float[texts.length * dim] (row i = texts[i], L2-normalized), or null on failure
+ */
+JNIEXPORT jfloatArray JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeEmbedBatch(
+        JNIEnv* env,
+        jobject thiz,
+        jobjectArray texts) {
+
+    const jsize n_texts = env->GetArrayLength(texts);
+    std::vector<std::string> inputs;
+    inputs.reserve(n_texts);
+    for (jsize i = 0; i < n_texts; ++i) {
+        jstring text = (jstring) env->GetObjectArrayElement(texts, i);
+        if (text == nullptr) {
+            inputs.emplace_back();
+            continue;
+        }
+        const char* text_cstr = env->GetStringUTFChars(text, nullptr);
+        inputs.emplace_back(text_cstr);
+        env->ReleaseStringUTFChars(text, text_cstr);
+        env->DeleteLocalRef(text);
     }
 
-    // Create and return the float array
-    jfloatArray result = env->NewFloatArray(n_embd);
+    std::vector<float> embeddings;
+    {
+        std::lock_guard<std::mutex> lock(g_embedder_mutex);
+        EmbeddingEngine* embedder = current_embedder();
+        if (embedder == nullptr) {
+            LOGE("No embedding model loaded, cannot embed batch.");
+            return nullptr;
+        }
+        if (!embedder->embed_batch(inputs, embeddings)) {
+            return nullptr;
+        }
+    }
+
+    jfloatArray result = env->NewFloatArray((jsize) embeddings.size());
     if (result == nullptr) {
         LOGE("Failed to create new float array.");
-    } else {
-        env->SetFloatArrayRegion(result, 0, n_embd, embedding);
+        return nullptr;
     }
-
-    llama_batch_free(batch);
-    env->ReleaseStringUTFChars(prompt, prompt_cstr);
-    LOGI("✅ Embedding generated successfully.");
+    env->SetFloatArrayRegion(result, 0, (jsize) embeddings.size(), embeddings.data());
+    LOGI("✅ Embedded %d texts", n_texts);
     return result;
 }
 
+/**
+ * Dimension of the vectors returned by nativeEmbedBatch (0 if no embedding model is available)
+ */
+JNIEXPORT jint JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeGetEmbeddingDim(JNIEnv* env, jobject thiz) {
+    std::lock_guard<std::mutex> lock(g_embedder_mutex);
+    EmbeddingEngine* embedder = g_using_fallback ? nullptr : current_embedder();
+    return embedder != nullptr ? embedder->dim() : 0;
+}
+
+/**
+ * Signature of the vectors returned by nativeEmbedBatch / nativeGenerateEmbedding
+ * (model, pooling and method version); stored vectors with another signature
+ * must be re-embedded before they can be compared. Empty if no embedding
+ * model is available.
+ */
+JNIEXPORT jstring JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeGetEmbeddingSignature(JNIEnv* env, jobject thiz) {
+    std::lock_guard<std::mutex> lock(g_embedder_mutex);
+    EmbeddingEngine* embedder = g_using_fallback ? nullptr : current_embedder();
+    return env->NewStringUTF(embedder != nullptr ? embedder->signature().c_str() : "");
+}
+
+/**
+ * Free the dedicated embedding model (the chat model is used again afterwards)
+ */
+JNIEXPORT void JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeFreeEmbeddingModel(JNIEnv* env, jobject thiz) {
+    std::lock_guard<std::mutex> lock(g_embedder_mutex);
+    g_embedder.reset();
+    LOGI("✅ Embedding model freed");
+}
+
 /**
  * Free model resources
  */
@@ -327,15 +1305,8 @@ JNIEXPORT void JNICALL
 Java_com_ailive_ai_llm_LLMBridge_nativeFreeModel(JNIEnv* env, jobject thiz) {
     LOGI("Freeing model resources...");
 
-    if (g_ctx != nullptr) {
-        llama_free(g_ctx);
-        g_ctx = nullptr;
-    }
-
-    if (g_model != nullptr) {
-        llama_model_free(g_model);
-        g_model = nullptr;
-    }
+    finish_async_load();
+    free_engine();
 
     // Use fallback implementation if in fallback mode
     if (g_using_fallback) {
@@ -345,7 +1316,7 @@ Java_com_ailive_ai_llm_LLMBridge_nativeFreeModel(JNIEnv* env, jobject thiz) {
         return;
     }
 
-    llama_backend_free();
+    // The backend stays initialized (ensure_backend) for the next load
     g_using_fallback = false;
     LOGI("✅ Resources freed");
 }
@@ -359,285 +1330,198 @@ Java_com_ailive_ai_llm_LLMBridge_nativeIsLoaded(JNIEnv* env, jobject thiz) {
     if (g_using_fallback) {
         return Java_com_ailive_ai_llm_LLMBridge_fallbackIsLoaded(env, thiz);
     }
-    
-    return (g_model != nullptr && g_ctx != nullptr) ? JNI_TRUE : JNI_FALSE;
-}
-
-} // extern "C"
 
+    return current_engine() != nullptr ? JNI_TRUE : JNI_FALSE;
+}
 
 /**
- * Main generation function using the corrected llama.cpp workflow.
- * 
- * ===== CORE LLM RESPONSE GENERATION ENGINE =====
- * This function is the heart of AI response generation in AILive.
- * It processes user prompts and generates coherent text responses using llama.cpp.
- * 
- * RESPONSE GENERATION PIPELINE:
- * 1. Tokenizes user prompt into model-compatible tokens
- * 2. Decodes prompt through neural network for context understanding
- * 3. Generates response tokens one by one using sampling
- * 4. Converts tokens back to human-readable text
- * 5. Returns complete response to user via JNI bridge
- * 
- * USER EXPERIENCE IMPACT:
- * - Quality of generated responses depends on this function
- * - Response time directly affected by generation efficiency
- * - Coherence and relevance determined by sampling parameters
- * - Error messages returned if generation fails
- * 
- * TECHNICAL IMPLEMENTATION:
- * - Uses llama.cpp state-of-the-art sampling techniques
- * - Handles edge-of-sequence detection for complete responses
- * - Manages memory and GPU resources efficiently
- * - Optimized for mobile device constraints
- */
-static std::string llama_decode_and_generate(const std::string& prompt_str, int max_tokens) {
-    LOGI("🔍 Generating response for: %.80s...", prompt_str.c_str());
-
-    // Note: KV cache clearing function varies by llama.cpp version
-    // Skipping cache clear - will naturally overwrite with new tokens
-
-    // Tokenize the prompt
-    std::vector<llama_token> prompt_tokens;
-    prompt_tokens.resize(prompt_str.length() + 1); // Actually allocate memory
-    const llama_vocab* vocab = llama_model_get_vocab(g_model);
-    int n_prompt_tokens = llama_tokenize(vocab, prompt_str.c_str(), prompt_str.length(), prompt_tokens.data(), prompt_tokens.size(), true, false);
-    if (n_prompt_tokens < 0) {
-        LOGE("Failed to tokenize prompt (buffer too small). Required size: %d", -n_prompt_tokens);
-        // Resize and try again
-        prompt_tokens.resize(-n_prompt_tokens);
-        n_prompt_tokens = llama_tokenize(vocab, prompt_str.c_str(), prompt_str.length(), prompt_tokens.data(), prompt_tokens.size(), true, false);
-    } else {
-        prompt_tokens.resize(n_prompt_tokens);
+ * Get prompt prefix cache statistics (summed over all sessions)
+ *
+ * @return long[4]: { hits, misses, reused tokens, prefilled tokens }
+ */
+JNIEXPORT jlongArray JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeGetPrefixCacheStats(JNIEnv* env, jobject thiz) {
+    PrefixCacheStats cache_stats;
+    if (std::shared_ptr<LlmEngine> engine = current_engine()) {
+        cache_stats = engine->prefix_cache_stats();
     }
-
-    if (n_prompt_tokens <= 0) {
-        LOGE("Tokenization resulted in 0 or negative tokens.");
-        return "[ERROR: Tokenization failed]";
-    }
-    LOGI("Tokenized prompt into %d tokens.", n_prompt_tokens);
-
-    // --- Process Prompt ---
-    llama_batch batch = llama_batch_init(n_prompt_tokens, 0, 1);
-    batch.n_tokens = n_prompt_tokens;
-    for (int i = 0; i < n_prompt_tokens; ++i) {
-        batch.token[i] = prompt_tokens[i];
-        batch.pos[i] = i;
-        batch.n_seq_id[i] = 1;
-        batch.seq_id[i][0] = 0;
-        batch.logits[i] = (i == n_prompt_tokens - 1) ? 1 : 0; // Request logit only for last token
+    jlong stats[4] = {
+        cache_stats.hits,
+        cache_stats.misses,
+        cache_stats.reused_tokens,
+        cache_stats.prefilled_tokens
+    };
+    jlongArray result = env->NewLongArray(4);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, 4, stats);
     }
+    return result;
+}
 
-    if (llama_decode(g_ctx, batch) != 0) {
-        LOGE("Failed to decode prompt.");
-        llama_batch_free(batch);
-        return "[ERROR: Prompt decoding failed]";
+/**
+ * Get context window statistics (summed over all sessions)
+ *
+ * @return long[3]: { window shifts, evicted tokens, generations stopped at a full window }
+ */
+JNIEXPORT jlongArray JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeGetContextStats(JNIEnv* env, jobject thiz) {
+    ContextWindowStats window_stats;
+    if (std::shared_ptr<LlmEngine> engine = current_engine()) {
+        window_stats = engine->context_stats();
     }
-    LOGI("Prompt decoded successfully.");
-
-    // --- Generate Response ---
-    std::string result_str;
-    int n_current = n_prompt_tokens;
-
-    while (n_current < max_tokens) {
-        // Sample the next token using the new sampler API
-        auto* logits = llama_get_logits_ith(g_ctx, batch.n_tokens - 1);
-
-        const llama_vocab* vocab = llama_model_get_vocab(g_model);
-        const int n_vocab = llama_vocab_n_tokens(vocab);
-
-        llama_token_data_array candidates;
-        candidates.data = new llama_token_data[n_vocab];
-        candidates.size = n_vocab;
-        for (int token_id = 0; token_id < candidates.size; ++token_id) {
-            candidates.data[token_id].id = token_id;
-            candidates.data[token_id].logit = logits[token_id];
-            candidates.data[token_id].p = 0.0f;
-        }
-
-        llama_token_data_array cur_p = { candidates.data, candidates.size, -1 };
-
-        // Create a sampler chain for this token
-        llama_sampler_chain_params chain_params = llama_sampler_chain_default_params();
-        llama_sampler* sampler_chain = llama_sampler_chain_init(chain_params);
-
-        // Add samplers to the chain
-        llama_sampler_chain_add(sampler_chain, llama_sampler_init_penalties(64, 1.1f, 0.0f, 0.0f)); // repetition penalty
-        llama_sampler_chain_add(sampler_chain, llama_sampler_init_top_k(40));
-        llama_sampler_chain_add(sampler_chain, llama_sampler_init_min_p(0.05f, 1));
-        llama_sampler_chain_add(sampler_chain, llama_sampler_init_top_p(0.95f, 1));
-        llama_sampler_chain_add(sampler_chain, llama_sampler_init_temp(0.8f));
-        llama_sampler_chain_add(sampler_chain, llama_sampler_init_dist(0)); // greedy sampling
-
-        // Apply the sampler chain
-        llama_sampler_apply(sampler_chain, &cur_p);
-
-        llama_token new_token_id = cur_p.data[cur_p.selected].id;
-
-        llama_sampler_free(sampler_chain);
-        delete[] candidates.data;
-
-        // Check for End-of-Sequence
-        if (new_token_id == llama_vocab_eos(vocab)) {
-            LOGI("End of generation (EOS token).");
-            break;
-        }
-
-        // Append token to result string
-        char piece_buf[256];
-        int piece_len = llama_token_to_piece(vocab, new_token_id, piece_buf, sizeof(piece_buf), 0, false);
-        if (piece_len > 0) {
-            result_str.append(piece_buf, std::min(piece_len, (int)sizeof(piece_buf)));
-        }
-
-        // Prepare for next iteration
-        llama_batch_free(batch);
-        batch = llama_batch_init(1, 0, 1);
-        batch.n_tokens = 1;
-        batch.token[0] = new_token_id;
-        batch.pos[0] = n_current;
-        batch.n_seq_id[0] = 1;
-        batch.seq_id[0][0] = 0;
-        batch.logits[0] = 1;
-        
-        if (llama_decode(g_ctx, batch) != 0) {
-            LOGE("Failed to decode token %d", new_token_id);
-            break;
-        }
-
-        n_current++;
+    jlong stats[3] = {
+        window_stats.shifts,
+        window_stats.evicted_tokens,
+        window_stats.overflows
+    };
+    jlongArray result = env->NewLongArray(3);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, 3, stats);
     }
-
-    llama_batch_free(batch);
-    LOGI("✨ Generated %zu tokens: %.80s...", result_str.length(), result_str.c_str());
-    return result_str;
+    return result;
 }
 
-#if 0 // TODO: Vision features disabled - llama_image API not available in current llama.cpp
 /**
- * Main generation function using the corrected llama.cpp workflow for multimodal input.
+ * Get speculative decoding statistics
+ *
+ * Sampled tokens and decode time are the scheduler's, so effective tokens/sec
+ * can be computed with drafting time included.
+ *
+ * @return long[9]: { draft model: verify steps, drafted tokens, accepted tokens;
+ *                    draft time us (both modes), sampled tokens, decode time us;
+ *                    prompt lookup: verify steps, drafted tokens, accepted tokens }
  */
-static std::string llama_decode_and_generate_multimodal(const std::string& prompt_str, const std::vector<uint8_t>& image_bytes, int max_tokens) {
-    LOGI("🖼️ Generating response for multimodal input (prompt: %.80s..., image size: %zu bytes)...", prompt_str.c_str(), image_bytes.size());
-
-    // Clear the KV cache from previous runs
-    llama_kv_cache_clear(g_ctx);
-
-    // 1. Create image embed
-    llama_image_embed* image_embed = llama_image_embed_make_with_bytes(g_ctx, g_model, image_bytes.data(), image_bytes.size());
-    if (image_embed == nullptr) {
-        LOGE("Failed to create image embed from bytes.");
-        return "[ERROR: Image embedding failed]";
+JNIEXPORT jlongArray JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeGetSpeculativeStats(JNIEnv* env, jobject thiz) {
+    SpeculativeStats speculative_stats;
+    SchedulerStats scheduler_stats;
+    if (std::shared_ptr<LlmEngine> engine = current_engine()) {
+        speculative_stats = engine->speculative_stats();
+        scheduler_stats = engine->scheduler_stats();
     }
-    LOGI("Image embed created. N_image_tokens: %d", llama_image_embed_n_tokens(image_embed));
-
-    // 2. Tokenize prompt with image embed
-    std::vector<llama_token> prompt_tokens;
-    prompt_tokens.reserve(prompt_str.length() + llama_image_embed_n_tokens(image_embed) + 1); // Reserve space
-
-    // Add BOS token
-    prompt_tokens.push_back(llama_token_bos(g_model));
-
-    // Add image tokens
-    llama_image_embed_tokenize_to_vector(g_model, image_embed, prompt_tokens);
-
-    // Add text tokens
-    int n_text_tokens = llama_tokenize(g_model, prompt_str.c_str(), prompt_str.length(), nullptr, 0, false, false);
-    if (n_text_tokens < 0) {
-        LOGE("Failed to tokenize text prompt for multimodal (buffer too small). Required size: %d", -n_text_tokens);
-        // Resize and try again
-        std::vector<llama_token> text_tokens_temp;
-        text_tokens_temp.resize(-n_text_tokens);
-        n_text_tokens = llama_tokenize(g_model, prompt_str.c_str(), prompt_str.length(), text_tokens_temp.data(), text_tokens_temp.size(), false, false);
-        prompt_tokens.insert(prompt_tokens.end(), text_tokens_temp.begin(), text_tokens_temp.end());
-    } else {
-        std::vector<llama_token> text_tokens_temp;
-        text_tokens_temp.resize(n_text_tokens);
-        llama_tokenize(g_model, prompt_str.c_str(), prompt_str.length(), text_tokens_temp.data(), text_tokens_temp.size(), false, false);
-        prompt_tokens.insert(prompt_tokens.end(), text_tokens_temp.begin(), text_tokens_temp.end());
+    jlong stats[9] = {
+        speculative_stats.steps,
+        speculative_stats.drafted_tokens,
+        speculative_stats.accepted_tokens,
+        speculative_stats.draft_time_us,
+        scheduler_stats.sampled_tokens,
+        scheduler_stats.decode_time_us,
+        speculative_stats.lookup_steps,
+        speculative_stats.lookup_drafted_tokens,
+        speculative_stats.lookup_accepted_tokens
+    };
+    jlongArray result = env->NewLongArray(9);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, 9, stats);
     }
+    return result;
+}
 
-    // Add EOS token if not already present
-    if (prompt_tokens.empty() || prompt_tokens.back() != llama_token_eos(g_model)) {
-        prompt_tokens.push_back(llama_token_eos(g_model));
+/**
+ * Get continuous batching scheduler statistics
+ *
+ * @return long[5]: { decode calls, decoded tokens, sampled tokens, max sequences per batch, decode time us }
+ */
+JNIEXPORT jlongArray JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeGetSchedulerStats(JNIEnv* env, jobject thiz) {
+    SchedulerStats scheduler_stats;
+    if (std::shared_ptr<LlmEngine> engine = current_engine()) {
+        scheduler_stats = engine->scheduler_stats();
     }
-
-    llama_image_embed_free(image_embed); // Free image embed after tokenization
-
-    if (prompt_tokens.empty()) {
-        LOGE("Multimodal tokenization resulted in 0 tokens.");
-        return "[ERROR: Multimodal tokenization failed]";
+    jlong stats[5] = {
+        scheduler_stats.decode_calls,
+        scheduler_stats.decoded_tokens,
+        scheduler_stats.sampled_tokens,
+        scheduler_stats.max_batch_sequences,
+        scheduler_stats.decode_time_us
+    };
+    jlongArray result = env->NewLongArray(5);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, 5, stats);
     }
-    LOGI("Tokenized multimodal prompt into %zu tokens.", prompt_tokens.size());
+    return result;
+}
 
-    // --- Process Prompt ---
-    llama_batch batch = llama_batch_init(prompt_tokens.size(), 0, 1);
-    for (size_t i = 0; i < prompt_tokens.size(); ++i) {
-        llama_batch_add(batch, prompt_tokens[i], i, {0}, true);
+/**
+ * Set sampling parameters (from Kotlin ModelSettings)
+ *
+ * Each session rebuilds its sampler chain before its next generation starts.
+ */
+JNIEXPORT void JNICALL
+Java_com_ailive_ai_llm_LLMBridge_nativeSetSamplingParams(
+        JNIEnv* env,
+        jobject thiz,
+        jfloat temperature,
+        jfloat top_p,
+        jint top_k,
+        jfloat repeat_penalty,
+        jfloat presence_penalty,
+        jfloat frequency_penalty,
+        jint mirostat,
+        jfloat mirostat_tau,
+        jfloat mirostat_eta) {
+
+    std::lock_guard<std::mutex> lock(g_sampling_mutex);
+    g_sampling_params.temperature = temperature;
+    g_sampling_params.top_p = top_p;
+    g_sampling_params.top_k = top_k;
+    g_sampling_params.repeat_penalty = repeat_penalty;
+    g_sampling_params.presence_penalty = presence_penalty;
+    g_sampling_params.frequency_penalty = frequency_penalty;
+    g_sampling_params.mirostat = mirostat;
+    g_sampling_params.mirostat_tau = mirostat_tau;
+    g_sampling_params.mirostat_eta = mirostat_eta;
+    if (std::shared_ptr<LlmEngine> engine = current_engine()) {
+        engine->set_sampling_params(g_sampling_params);
     }
-    batch.logits[batch.n_tokens - 1] = 1; // Request logit for the last token
 
-    if (llama_decode(g_ctx, batch) != 0) {
-        LOGE("Failed to decode multimodal prompt.");
-        llama_batch_free(batch);
-        return "[ERROR: Multimodal prompt decoding failed]";
-    }
-    LOGI("Multimodal prompt decoded successfully.");
+    LOGI("Sampling params: temp=%.2f top_p=%.2f top_k=%d repeat=%.2f presence=%.2f frequency=%.2f mirostat=%d",
+         temperature, top_p, top_k, repeat_penalty, presence_penalty, frequency_penalty, mirostat);
+}
 
-    // --- Generate Response ---
-    std::string result_str;
-    int n_current = prompt_tokens.size();
+} // extern "C"
 
-    while (n_current < max_tokens) {
-        // Sample the next token
-        auto* logits = llama_get_logits_ith(g_ctx, batch.n_tokens - 1);
-        
-        llama_token_data_array candidates;
-        candidates.data = new llama_token_data[llama_n_vocab(g_model)];
-        candidates.size = llama_n_vocab(g_model);
-        for (int token_id = 0; token_id < candidates.size; ++token_id) {
-            candidates.data[token_id].id = token_id;
-            candidates.data[token_id].logit = logits[token_id];
-            candidates.data[token_id].p = 0.0f;
-        }
 
-        llama_token_data_array cur_p = { candidates.data, candidates.size, false };
-
-        // Apply penalties
-        llama_sample_repetition_penalties(g_ctx, &cur_p, prompt_tokens.data(), prompt_tokens.size(), 1.1f, 64, 1.0f);
-        llama_sample_top_k(g_ctx, &cur_p, 40, 1);
-        llama_sample_min_p(g_ctx, &cur_p, 0.05f, 1);
-        llama_sample_top_p(g_ctx, &cur_p, 0.95f, 1);
-        llama_sample_temp(g_ctx, &cur_p, 0.8f);
-        
-        llama_token new_token_id = llama_sample_token(g_ctx, &cur_p);
-        delete[] candidates.data;
-
-        // Check for End-of-Sequence
-        if (new_token_id == llama_token_eos(g_model)) {
-            LOGI("End of generation (EOS token).");
-            break;
+/**
+ * Convert UTF-8 to a Java string.
+ *
+ * NewStringUTF expects modified UTF-8 and rejects 4-byte sequences (emoji),
+ * so decode to UTF-16 here. Invalid bytes become U+FFFD.
+ */
+static jstring utf8_to_jstring(JNIEnv* env, const std::string& text) {
+    std::u16string utf16;
+    utf16.reserve(text.size());
+    const unsigned char* p = (const unsigned char*) text.data();
+    const unsigned char* end = p + text.size();
+    while (p < end) {
+        uint32_t cp;
+        size_t n;
+        if (p[0] < 0x80)                { cp = p[0];        n = 1; }
+        else if ((p[0] & 0xE0) == 0xC0) { cp = p[0] & 0x1F; n = 2; }
+        else if ((p[0] & 0xF0) == 0xE0) { cp = p[0] & 0x0F; n = 3; }
+        else if ((p[0] & 0xF8) == 0xF0) { cp = p[0] & 0x07; n = 4; }
+        else                            { cp = 0xFFFD;      n = 1; }
+
+        if (n > 1) {
+            if (p + n > end) {
+                cp = 0xFFFD;
+                n = end - p;
+            } else {
+                for (size_t i = 1; i < n; ++i) {
+                    if ((p[i] & 0xC0) != 0x80) { cp = 0xFFFD; n = i; break; }
+                    cp = (cp << 6) | (p[i] & 0x3F);
+                }
+            }
         }
 
-        // Append token to result string
-        result_str += llama_token_to_piece(g_ctx, new_token_id);
-
-        // Prepare for next iteration
-        llama_batch_free(batch);
-        batch = llama_batch_init(1, 0, 1);
-        llama_batch_add(batch, new_token_id, n_current, {0}, true);
-        
-        if (llama_decode(g_ctx, batch) != 0) {
-            LOGE("Failed to decode token %d", new_token_id);
-            break;
+        if (cp >= 0x10000 && cp <= 0x10FFFF) {
+            cp -= 0x10000;
+            utf16.push_back((char16_t) (0xD800 + (cp >> 10)));
+            utf16.push_back((char16_t) (0xDC00 + (cp & 0x3FF)));
+        } else {
+            utf16.push_back((char16_t) cp);
         }
-
-        n_current++;
+        p += n;
     }
-
-    llama_batch_free(batch);
-    LOGI("✨ Generated %zu tokens: %.80s...", result_str.length(), result_str.c_str());
-    return result_str;
+    return env->NewString((const jchar*) utf16.data(), (jsize) utf16.size());
 }
-#endif // Vision features disabled
@@ -0,0 +1,368 @@
+/**
+ * ailive_vector.cpp - JNI Bridge for the native vector store in AILive
+ *
+ * Backs com.ailive.memory.storage.NativeVectorIndex, holding an exact
+ * VectorStore, an approximate HnswIndex, a QuantizedStore or a file-backed
+ * PersistentIndex. Vectors, keys and results cross the boundary as direct
+ * ByteBuffers in native byte order, so nothing is copied or pinned per call.
+ */
+
+#include <jni.h>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <android/log.h>
+#include "vector_store.h"
+#include "hnsw_index.h"
+#include "quantized_store.h"
+#include "persistent_index.h"
+#include "vector_kernels.h"
+
+#define LOG_TAG_VEC "AILive-Vector"
+#define LOGI_VEC(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG_VEC, __VA_ARGS__)
+#define LOGE_VEC(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG_VEC, __VA_ARGS__)
+
+static inline VectorIndex* to_store(jlong handle) {
+    return reinterpret_cast<VectorIndex*>(handle);
+}
+
+static std::string to_string(JNIEnv* env, jstring str) {
+    std::string out;
+    if (str != nullptr) {
+        const char* chars = env->GetStringUTFChars(str, nullptr);
+        out = chars;
+        env->ReleaseStringUTFChars(str, chars);
+    }
+    return out;
+}
+
+/**
+ * Address of a direct buffer holding at least `min_bytes`, or nullptr.
+ */
+static void* direct_buffer(JNIEnv* env, jobject buffer, size_t min_bytes) {
+    if (buffer == nullptr) {
+        return nullptr;
+    }
+    void* address = env->GetDirectBufferAddress(buffer);
+    if (address == nullptr || env->GetDirectBufferCapacity(buffer) < (jlong) min_bytes) {
+        LOGE_VEC("❌ Buffer is not direct or too small (need %zu bytes)", min_bytes);
+        return nullptr;
+    }
+    return address;
+}
+
+extern "C" {
+
+JNIEXPORT jlong JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeCreate(
+        JNIEnv* env, jobject thiz, jint dim, jint capacity) {
+    if (dim <= 0) {
+        LOGE_VEC("❌ Invalid dimension: %d", dim);
+        return 0;
+    }
+    auto* store = new (std::nothrow) VectorStore(dim, capacity > 0 ? (size_t) capacity : 0);
+    if (store == nullptr) {
+        LOGE_VEC("❌ Failed to allocate vector store");
+        return 0;
+    }
+    LOGI_VEC("✅ Vector store created: dim=%d, capacity=%d, kernel=%s", dim, capacity, vec::kernel_name());
+    return reinterpret_cast<jlong>(static_cast<VectorIndex*>(store));
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeCreateHnsw(
+        JNIEnv* env, jobject thiz, jint dim, jint capacity, jint m, jint ef_construction, jint ef_search) {
+    if (dim <= 0) {
+        LOGE_VEC("❌ Invalid dimension: %d", dim);
+        return 0;
+    }
+    HnswParams params;
+    if (m > 0) params.M = m;
+    if (ef_construction > 0) params.ef_construction = ef_construction;
+    if (ef_search > 0) params.ef_search = ef_search;
+
+    auto* index = new (std::nothrow) HnswIndex(dim, capacity > 0 ? (size_t) capacity : 0, params);
+    if (index == nullptr) {
+        LOGE_VEC("❌ Failed to allocate HNSW index");
+        return 0;
+    }
+    LOGI_VEC("✅ HNSW index created: dim=%d, M=%d, efConstruction=%d, efSearch=%d, kernel=%s",
+             dim, params.M, params.ef_construction, params.ef_search, vec::kernel_name());
+    return reinterpret_cast<jlong>(static_cast<VectorIndex*>(index));
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeCreateQuantized(
+        JNIEnv* env, jobject thiz, jint dim, jint capacity, jboolean int8, jboolean binary,
+        jint binary_candidates, jint rescore_candidates, jstring rescore_path) {
+    if (dim <= 0 || (!int8 && !binary)) {
+        LOGE_VEC("❌ Invalid quantized index: dim=%d, int8=%d, binary=%d", dim, int8, binary);
+        return 0;
+    }
+    QuantizedParams params;
+    params.int8 = int8;
+    params.binary = binary;
+    if (binary_candidates > 0) params.binary_candidates = binary_candidates;
+    if (rescore_candidates > 0) params.rescore_candidates = rescore_candidates;
+
+    const std::string path = to_string(env, rescore_path);
+    auto* index = new (std::nothrow) QuantizedStore(dim, capacity > 0 ? (size_t) capacity : 0, params, path);
+    if (index == nullptr) {
+        LOGE_VEC("❌ Failed to allocate quantized index");
+        return 0;
+    }
+    LOGI_VEC("✅ Quantized index created: dim=%d, int8=%d, binary=%d, fp32 %s, kernel=%s",
+             dim, int8, binary, index->is_file_backed() ? "mmap" : "heap", vec::kernel_name());
+    return reinterpret_cast<jlong>(static_cast<VectorIndex*>(index));
+}
+
+/**
+ * Open (or create) a file-backed index. m > 0 also keeps an HNSW graph.
+ */
+JNIEXPORT jlong JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeOpenPersistent(
+        JNIEnv* env, jobject thiz, jstring path, jint dim, jint capacity, jint m, jint ef_construction,
+        jint ef_search) {
+    if (dim <= 0 || path == nullptr) {
+        LOGE_VEC("❌ Invalid persistent index: dim=%d", dim);
+        return 0;
+    }
+    HnswParams params;
+    if (m > 0) params.M = m;
+    if (ef_construction > 0) params.ef_construction = ef_construction;
+    if (ef_search > 0) params.ef_search = ef_search;
+
+    std::unique_ptr<PersistentIndex> index = PersistentIndex::open(
+            to_string(env, path), dim, capacity > 0 ? (size_t) capacity : 0, m > 0 ? &params : nullptr);
+    if (index == nullptr) {
+        LOGE_VEC("❌ Failed to open persistent index");
+        return 0;
+    }
+    LOGI_VEC("✅ Persistent index opened: dim=%d, %zu entries, graph=%d, kernel=%s",
+             dim, index->size(), index->has_graph(), vec::kernel_name());
+    return reinterpret_cast<jlong>(static_cast<VectorIndex*>(index.release()));
+}
+
+JNIEXPORT void JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeDestroy(JNIEnv* env, jobject thiz, jlong handle) {
+    delete to_store(handle);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeInsert(
+        JNIEnv* env, jobject thiz, jlong handle, jlong key, jobject vector) {
+    VectorIndex* store = to_store(handle);
+    if (store == nullptr) return JNI_FALSE;
+
+    auto* data = static_cast<const float*>(direct_buffer(env, vector, sizeof(float) * store->dim()));
+    if (data == nullptr) return JNI_FALSE;
+
+    store->insert(key, data);
+    return JNI_TRUE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeInsertWithMetadata(
+        JNIEnv* env, jobject thiz, jlong handle, jlong key, jobject vector, jbyteArray metadata) {
+    VectorIndex* store = to_store(handle);
+    if (store == nullptr) return JNI_FALSE;
+
+    auto* data = static_cast<const float*>(direct_buffer(env, vector, sizeof(float) * store->dim()));
+    if (data == nullptr) return JNI_FALSE;
+
+    std::vector<uint8_t> meta(metadata != nullptr ? env->GetArrayLength(metadata) : 0);
+    if (!meta.empty()) {
+        env->GetByteArrayRegion(metadata, 0, (jsize) meta.size(), reinterpret_cast<jbyte*>(meta.data()));
+    }
+    return store->insert_with_metadata(key, data, meta.data(), meta.size()) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeInsertBatch(
+        JNIEnv* env, jobject thiz, jlong handle, jobject keys, jobject vectors, jint count) {
+    VectorIndex* store = to_store(handle);
+    if (store == nullptr || count <= 0) return 0;
+
+    auto* key_data = static_cast<const int64_t*>(direct_buffer(env, keys, sizeof(int64_t) * count));
+    auto* vec_data = static_cast<const float*>(
+            direct_buffer(env, vectors, sizeof(float) * (size_t) count * store->dim()));
+    if (key_data == nullptr || vec_data == nullptr) return 0;
+
+    for (jint i = 0; i < count; ++i) {
+        store->insert(key_data[i], vec_data + (size_t) i * store->dim());
+    }
+    return count;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeDelete(
+        JNIEnv* env, jobject thiz, jlong handle, jlong key) {
+    VectorIndex* store = to_store(handle);
+    if (store == nullptr) return JNI_FALSE;
+    return store->remove(key) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeSearch(
+        JNIEnv* env, jobject thiz, jlong handle, jobject query, jint k, jfloat min_similarity,
+        jobject out_keys, jobject out_scores) {
+    VectorIndex* store = to_store(handle);
+    if (store == nullptr || k <= 0) return 0;
+
+    auto* query_data = static_cast<const float*>(direct_buffer(env, query, sizeof(float) * store->dim()));
+    auto* keys = static_cast<int64_t*>(direct_buffer(env, out_keys, sizeof(int64_t) * k));
+    auto* scores = static_cast<float*>(direct_buffer(env, out_scores, sizeof(float) * k));
+    if (query_data == nullptr || keys == nullptr || scores == nullptr) return 0;
+
+    return store->search(query_data, k, min_similarity, keys, scores);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeSearchBatch(
+        JNIEnv* env, jobject thiz, jlong handle, jobject queries, jint n_queries, jint k,
+        jfloat min_similarity, jobject out_keys, jobject out_scores, jobject out_counts) {
+    VectorIndex* store = to_store(handle);
+    if (store == nullptr || n_queries <= 0 || k <= 0) return JNI_FALSE;
+
+    const size_t n_results = (size_t) n_queries * k;
+    auto* query_data = static_cast<const float*>(
+            direct_buffer(env, queries, sizeof(float) * (size_t) n_queries * store->dim()));
+    auto* keys = static_cast<int64_t*>(direct_buffer(env, out_keys, sizeof(int64_t) * n_results));
+    auto* scores = static_cast<float*>(direct_buffer(env, out_scores, sizeof(float) * n_results));
+    auto* counts = static_cast<int*>(direct_buffer(env, out_counts, sizeof(int) * n_queries));
+    if (query_data == nullptr || keys == nullptr || scores == nullptr || counts == nullptr) {
+        return JNI_FALSE;
+    }
+
+    store->search_batch(query_data, n_queries, k, min_similarity, keys, scores, counts);
+    return JNI_TRUE;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeSize(JNIEnv* env, jobject thiz, jlong handle) {
+    VectorIndex* store = to_store(handle);
+    return store != nullptr ? (jint) store->size() : 0;
+}
+
+JNIEXPORT void JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeClear(JNIEnv* env, jobject thiz, jlong handle) {
+    VectorIndex* store = to_store(handle);
+    if (store != nullptr) store->clear();
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeMemoryBytes(JNIEnv* env, jobject thiz, jlong handle) {
+    VectorIndex* store = to_store(handle);
+    return store != nullptr ? (jlong) store->memory_bytes() : 0;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeGetVector(
+        JNIEnv* env, jobject thiz, jlong handle, jlong key, jobject out_vector) {
+    VectorIndex* store = to_store(handle);
+    if (store == nullptr) return JNI_FALSE;
+
+    auto* out = static_cast<float*>(direct_buffer(env, out_vector, sizeof(float) * store->dim()));
+    if (out == nullptr) return JNI_FALSE;
+    return store->get_vector(key, out) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeSetEfSearch(
+        JNIEnv* env, jobject thiz, jlong handle, jint ef_search) {
+    VectorIndex* store = to_store(handle);
+    if (store != nullptr) store->set_ef_search(ef_search);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeDeletedCount(JNIEnv* env, jobject thiz, jlong handle) {
+    VectorIndex* store = to_store(handle);
+    return store != nullptr ? (jint) store->deleted_count() : 0;
+}
+
+/**
+ * Rebuild without tombstones. Blocking; called from a background coroutine.
+ */
+JNIEXPORT jint JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeCompact(JNIEnv* env, jobject thiz, jlong handle) {
+    VectorIndex* store = to_store(handle);
+    if (store == nullptr) return 0;
+    const size_t reclaimed = store->compact();
+    if (reclaimed > 0) {
+        LOGI_VEC("🧹 Compacted index: reclaimed %zu deleted entries, %zu live", reclaimed, store->size());
+    }
+    return (jint) reclaimed;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeSetMetadata(
+        JNIEnv* env, jobject thiz, jlong handle, jlong key, jbyteArray metadata) {
+    VectorIndex* store = to_store(handle);
+    if (store == nullptr || metadata == nullptr) return JNI_FALSE;
+
+    std::vector<uint8_t> meta(env->GetArrayLength(metadata));
+    env->GetByteArrayRegion(metadata, 0, (jsize) meta.size(), reinterpret_cast<jbyte*>(meta.data()));
+    return store->set_metadata(key, meta.data(), meta.size()) ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * Every live key with its metadata, packed as [key int64][length int32][bytes]
+ * in native byte order, so a restore costs one JNI call.
+ */
+JNIEXPORT jbyteArray JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeDumpMetadata(JNIEnv* env, jobject thiz, jlong handle) {
+    VectorIndex* store = to_store(handle);
+    if (store == nullptr) return nullptr;
+
+    std::vector<int64_t> keys;
+    store->keys(&keys);
+    std::vector<uint8_t> packed;
+    std::string meta;
+    for (int64_t key : keys) {
+        if (!store->get_metadata(key, &meta)) {
+            continue;
+        }
+        const int32_t length = (int32_t) meta.size();
+        const size_t pos = packed.size();
+        packed.resize(pos + sizeof(key) + sizeof(length) + meta.size());
+        std::memcpy(packed.data() + pos, &key, sizeof(key));
+        std::memcpy(packed.data() + pos + sizeof(key), &length, sizeof(length));
+        std::memcpy(packed.data() + pos + sizeof(key) + sizeof(length), meta.data(), meta.size());
+    }
+
+    jbyteArray result = env->NewByteArray((jsize) packed.size());
+    if (result != nullptr && !packed.empty()) {
+        env->SetByteArrayRegion(result, 0, (jsize) packed.size(), reinterpret_cast<const jbyte*>(packed.data()));
+    }
+    return result;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeLogBytes(JNIEnv* env, jobject thiz, jlong handle) {
+    VectorIndex* store = to_store(handle);
+    return store != nullptr ? (jlong) store->log_bytes() : 0;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeSync(JNIEnv* env, jobject thiz, jlong handle) {
+    VectorIndex* store = to_store(handle);
+    return store != nullptr && store->sync() ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * Checksum the stored data. Reads it all; called from a background coroutine.
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeVerify(JNIEnv* env, jobject thiz, jlong handle) {
+    VectorIndex* store = to_store(handle);
+    return store != nullptr && store->verify() ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jstring JNICALL
+Java_com_ailive_memory_storage_NativeVectorIndex_nativeKernelName(JNIEnv* env, jobject thiz) {
+    return env->NewStringUTF(vec::kernel_name());
+}
+
+} // extern "C"
@@ -0,0 +1,142 @@
+/**
+ * ailive_vision.cpp - JNI Bridge for native image preprocessing in AILive
+ *
+ * Backs com.ailive.ai.vision.ImagePreprocessor. Bitmap pixels are read in
+ * place through AndroidBitmap_lockPixels (or from a direct ByteBuffer), and
+ * the output tensor is handed to Kotlin once as a direct ByteBuffer over the
+ * preprocessor's own aligned memory, so no pixel or float data is copied
+ * across the boundary.
+ */
+
+#include <jni.h>
+#include <cstdint>
+#include <new>
+#include <android/bitmap.h>
+#include <android/log.h>
+#include "image_preprocess.h"
+
+#define LOG_TAG_VISION "AILive-Vision"
+#define LOGI_VISION(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG_VISION, __VA_ARGS__)
+#define LOGE_VISION(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG_VISION, __VA_ARGS__)
+
+static inline img::ImagePreprocessor* to_preprocessor(jlong handle) {
+    return reinterpret_cast<img::ImagePreprocessor*>(handle);
+}
+
+extern "C" {
+
+/**
+ * @param mean, std Three values each (R, G, B), applied to pixel / 255
+ * @param pad_rgb Letterbox colour as 0xRRGGBB
+ * @return handle, or 0 on failure
+ */
+JNIEXPORT jlong JNICALL
+Java_com_ailive_ai_vision_ImagePreprocessor_nativeCreate(
+        JNIEnv* env, jobject thiz, jint width, jint height, jboolean nhwc, jboolean letterbox,
+        jfloatArray mean, jfloatArray std, jint pad_rgb) {
+    if (width <= 0 || height <= 0) {
+        LOGE_VISION("❌ Invalid output size: %dx%d", width, height);
+        return 0;
+    }
+    img::PreprocessParams params;
+    params.width = width;
+    params.height = height;
+    params.layout = nhwc ? img::Layout::NHWC : img::Layout::NCHW;
+    params.letterbox = letterbox;
+    if (mean != nullptr && env->GetArrayLength(mean) >= 3) {
+        env->GetFloatArrayRegion(mean, 0, 3, params.mean);
+    }
+    if (std != nullptr && env->GetArrayLength(std) >= 3) {
+        env->GetFloatArrayRegion(std, 0, 3, params.std);
+    }
+    params.pad[0] = (uint8_t) (pad_rgb >> 16);
+    params.pad[1] = (uint8_t) (pad_rgb >> 8);
+    params.pad[2] = (uint8_t) pad_rgb;
+
+    auto* preprocessor = new (std::nothrow) img::ImagePreprocessor(params);
+    if (preprocessor == nullptr || preprocessor->output() == nullptr) {
+        LOGE_VISION("❌ Failed to allocate %dx%d preprocessor", width, height);
+        delete preprocessor;
+        return 0;
+    }
+    LOGI_VISION("✅ Image preprocessor created: %dx%d %s%s, kernel=%s", width, height,
+                nhwc ? "NHWC" : "NCHW", letterbox ? " letterbox" : "", img::kernel_name());
+    return reinterpret_cast<jlong>(preprocessor);
+}
+
+JNIEXPORT void JNICALL
+Java_com_ailive_ai_vision_ImagePreprocessor_nativeDestroy(
+        JNIEnv* env, jobject thiz, jlong handle) {
+    delete to_preprocessor(handle);
+}
+
+/**
+ * Direct ByteBuffer over the output tensor (native byte order floats),
+ * valid until nativeDestroy. Contents change with every process call.
+ */
+JNIEXPORT jobject JNICALL
+Java_com_ailive_ai_vision_ImagePreprocessor_nativeOutput(
+        JNIEnv* env, jobject thiz, jlong handle) {
+    img::ImagePreprocessor* preprocessor = to_preprocessor(handle);
+    return env->NewDirectByteBuffer(const_cast<float*>(preprocessor->output()),
+                                    (jlong) (preprocessor->output_size() * sizeof(float)));
+}
+
+/**
+ * Preprocess an ARGB_8888 bitmap, read in place.
+ * @return false for other bitmap configs (convert first) or lock failures
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_ai_vision_ImagePreprocessor_nativeProcessBitmap(
+        JNIEnv* env, jobject thiz, jlong handle, jobject bitmap) {
+    AndroidBitmapInfo info;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) != ANDROID_BITMAP_RESULT_SUCCESS) {
+        LOGE_VISION("❌ Failed to read bitmap info");
+        return JNI_FALSE;
+    }
+    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        LOGE_VISION("❌ Unsupported bitmap format %d (need RGBA_8888)", info.format);
+        return JNI_FALSE;
+    }
+    void* pixels = nullptr;
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) != ANDROID_BITMAP_RESULT_SUCCESS || pixels == nullptr) {
+        LOGE_VISION("❌ Failed to lock bitmap pixels");
+        return JNI_FALSE;
+    }
+    bool ok = to_preprocessor(handle)->run(static_cast<const uint8_t*>(pixels),
+                                           (int) info.width, (int) info.height, info.stride);
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * Preprocess RGBA_8888 pixels (bytes R, G, B, A) from a direct buffer,
+ * e.g. an ImageReader plane or Bitmap.copyPixelsToBuffer output.
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_ailive_ai_vision_ImagePreprocessor_nativeProcessBuffer(
+        JNIEnv* env, jobject thiz, jlong handle, jobject buffer, jint width, jint height, jint row_stride) {
+    void* address = buffer != nullptr ? env->GetDirectBufferAddress(buffer) : nullptr;
+    if (address == nullptr || width <= 0 || height <= 0 || row_stride < width * 4 ||
+        env->GetDirectBufferCapacity(buffer) < (jlong) row_stride * (height - 1) + width * 4) {
+        LOGE_VISION("❌ Buffer is not direct or too small for %dx%d (stride %d)", width, height, row_stride);
+        return JNI_FALSE;
+    }
+    return to_preprocessor(handle)->run(static_cast<const uint8_t*>(address), width, height, (size_t) row_stride)
+           ? JNI_TRUE : JNI_FALSE;
+}
+
+/**
+ * Image content in the output after the last call: [x, y, width, height].
+ */
+JNIEXPORT jintArray JNICALL
+Java_com_ailive_ai_vision_ImagePreprocessor_nativePlacement(
+        JNIEnv* env, jobject thiz, jlong handle) {
+    const img::Placement& p = to_preprocessor(handle)->placement();
+    const jint values[4] = {p.x, p.y, p.width, p.height};
+    jintArray result = env->NewIntArray(4);
+    env->SetIntArrayRegion(result, 0, 4, values);
+    return result;
+}
+
+} // extern "C"
@@ -0,0 +1,156 @@
+/**
+ * audio_dsp.cpp - PCM conversion and sample-rate conversion for the audio path
+ *
+ * See audio_dsp.h.
+ */
+
+#include "audio_dsp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "vector_kernels.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+namespace dsp {
+
+// Filter half-length in zero crossings of the lowpass sinc; sets the
+// transition band width (about 10% of the output band at 48 -> 16 kHz)
+static constexpr int kZeroCrossings = 16;
+
+// Cutoff as a fraction of the lower Nyquist frequency
+static constexpr double kRolloff = 0.9;
+
+static constexpr float kPcmScale = 1.0f / 32768.0f;
+
+// ===== int16 -> float =====
+
+void pcm16_to_float(const int16_t* in, size_t n, float* out) {
+    size_t i = 0;
+#if defined(__aarch64__)
+    for (; i + 16 <= n; i += 16) {
+        int16x8_t a = vld1q_s16(in + i);
+        int16x8_t b = vld1q_s16(in + i + 8);
+        // Fixed-point convert with 15 fraction bits divides by 32768 for free
+        vst1q_f32(out + i,      vcvtq_n_f32_s32(vmovl_s16(vget_low_s16(a)), 15));
+        vst1q_f32(out + i + 4,  vcvtq_n_f32_s32(vmovl_high_s16(a), 15));
+        vst1q_f32(out + i + 8,  vcvtq_n_f32_s32(vmovl_s16(vget_low_s16(b)), 15));
+        vst1q_f32(out + i + 12, vcvtq_n_f32_s32(vmovl_high_s16(b), 15));
+    }
+#elif defined(__x86_64__)
+    const __m128 scale = _mm_set1_ps(kPcmScale);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (in + i));
+        // Sign-extend by placing each sample in the high half and shifting back
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#endif
+    for (; i < n; ++i) {
+        out[i] = in[i] * kPcmScale;
+    }
+}
+
+const char* kernel_name() {
+#if defined(__aarch64__)
+    return "neon";
+#elif defined(__x86_64__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+// ===== Resampler =====
+
+Resampler::Resampler(int in_rate, int out_rate)
+        : in_rate_(in_rate), out_rate_(out_rate) {
+    const int g = std::gcd(in_rate, out_rate);
+    up_ = out_rate / g;
+    down_ = in_rate / g;
+    if (passthrough()) {
+        taps_ = 1;
+        return;
+    }
+
+    // Prototype lowpass at in_rate * up_, cut below the lower of the two
+    // Nyquist frequencies, Blackman-windowed
+    const double stretch = std::max(1.0, (double) down_ / up_);
+    taps_ = (int) std::ceil(2 * kZeroCrossings * stretch);
+    const int length = up_ * taps_;
+    const double cutoff = kRolloff * 0.5 / up_ / stretch;   // cycles per prototype sample
+    const double center = (length - 1) / 2.0;
+
+    filters_.resize((size_t) length);
+    for (int i = 0; i < length; ++i) {
+        const double x = i - center;
+        const double sinc = x == 0.0 ? 1.0 : std::sin(2.0 * M_PI * cutoff * x) / (M_PI * x) / (2.0 * cutoff);
+        const double w = 0.42 - 0.5 * std::cos(2.0 * M_PI * i / (length - 1))
+                         + 0.08 * std::cos(4.0 * M_PI * i / (length - 1));
+        // up_ compensates for the zeros implied by upsampling
+        const float h = (float) (2.0 * cutoff * sinc * w * up_);
+
+        // Tap j of phase p is h[p + j * up_]; stored reversed so an output
+        // is a forward dot product over the last taps_ inputs
+        const int phase = i % up_;
+        const int tap = i / up_;
+        filters_[(size_t) phase * taps_ + (taps_ - 1 - tap)] = h;
+    }
+    reset();
+}
+
+void Resampler::reset() {
+    buffer_.assign((size_t) taps_ - 1, 0.0f);
+    next_ = (size_t) taps_ - 1;
+    phase_ = 0;
+}
+
+void Resampler::process(const float* in, size_t n, std::vector<float>* out) {
+    if (passthrough()) {
+        out->insert(out->end(), in, in + n);
+        return;
+    }
+
+    buffer_.insert(buffer_.end(), in, in + n);
+    while (next_ < buffer_.size()) {
+        const float* x = buffer_.data() + next_ + 1 - taps_;
+        out->push_back(vec::dot(x, filters_.data() + (size_t) phase_ * taps_, taps_));
+        phase_ += down_;
+        next_ += (size_t) (phase_ / up_);
+        phase_ %= up_;
+    }
+
+    // Keep the history the next output needs
+    const size_t consumed = std::min(next_ + 1 - (size_t) taps_, buffer_.size());
+    buffer_.erase(buffer_.begin(), buffer_.begin() + consumed);
+    next_ -= consumed;
+}
+
+std::vector<float> Resampler::convert(const float* in, size_t n, int in_rate, int out_rate) {
+    Resampler resampler(in_rate, out_rate);
+    if (resampler.passthrough()) {
+        return std::vector<float>(in, in + n);
+    }
+
+    std::vector<float> out;
+    resampler.process(in, n, &out);
+    const std::vector<float> tail((size_t) resampler.taps_, 0.0f);
+    resampler.process(tail.data(), tail.size(), &out);
+
+    // Drop the filter delay from the front and the flushed excess from the end
+    const double delay = (resampler.up_ * resampler.taps_ - 1) / 2.0 / resampler.down_;
+    const size_t skip = std::min(out.size(), (size_t) std::lround(delay));
+    const size_t length = (size_t) ((double) n * resampler.up_ / resampler.down_);
+    out.erase(out.begin(), out.begin() + skip);
+    out.resize(std::min(out.size(), length));
+    return out;
+}
+
+} // namespace dsp
@@ -0,0 +1,69 @@
+/**
+ * audio_dsp.h - PCM conversion and sample-rate conversion for the audio path
+ *
+ * Microphone audio arrives as 16-bit PCM at the device's native rate
+ * (usually 48 kHz); Whisper, the VAD and the keyword spotter all want float
+ * samples at 16 kHz. Conversion uses NEON on arm64 and SSE2 on x86_64
+ * (emulators); resampling is a polyphase windowed-sinc filter whose inner
+ * product runs on the vector_kernels dot product.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dsp {
+
+/**
+ * out[i] = in[i] / 32768 for n samples. `in` needs no particular alignment.
+ */
+void pcm16_to_float(const int16_t* in, size_t n, float* out);
+
+/**
+ * Name of the selected conversion kernel ("neon", "sse2", "scalar"), for logging.
+ */
+const char* kernel_name();
+
+/**
+ * Streaming rational resampler. Output is delayed by half the filter
+ * length (well under a millisecond); state carries across process() calls,
+ * so hops of any size can be fed.
+ */
+class Resampler {
+public:
+    Resampler(int in_rate, int out_rate);
+
+    int in_rate() const { return in_rate_; }
+    int out_rate() const { return out_rate_; }
+
+    /** Rates are equal: process() only copies */
+    bool passthrough() const { return up_ == down_; }
+
+    /** Resample n input samples, appending the output to `out`. */
+    void process(const float* in, size_t n, std::vector<float>* out);
+
+    /** Forget buffered input (start of a new recording). */
+    void reset();
+
+    /**
+     * Resample a complete clip. The tail is flushed, so the output holds
+     * about n * out_rate / in_rate samples.
+     */
+    static std::vector<float> convert(const float* in, size_t n, int in_rate, int out_rate);
+
+private:
+    int in_rate_;
+    int out_rate_;
+    int up_;                       // out_rate / gcd
+    int down_;                     // in_rate / gcd
+    int taps_;                     // filter taps per phase (input samples per output)
+    std::vector<float> filters_;   // up_ phases * taps_, reversed for a forward dot product
+
+    std::vector<float> buffer_;    // taps_ - 1 samples of history, then unconsumed input
+    size_t next_ = 0;              // index in buffer_ of the newest input for the next output
+    int phase_ = 0;
+};
+
+} // namespace dsp
@@ -0,0 +1,181 @@
+/**
+ * context_plan.cpp - Fit an LLM context into a memory budget
+ *
+ * See context_plan.h.
+ */
+
+#include "context_plan.h"
+
+#include <algorithm>
+#include <sys/stat.h>
+#include <android/log.h>
+
+#define LOG_TAG "AILive-LLM"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+static constexpr int kDefaultBatch = 512;
+static constexpr int kMinContext = 512;
+static constexpr int kContextStep = 256;
+
+/**
+ * Configurations tried in order under a budget, most accurate first.
+ * q8_0 KV is close to lossless; K suffers more from 4 bits than V does.
+ */
+struct Candidate {
+    ggml_type type_k;
+    ggml_type type_v;
+    int n_ubatch;
+};
+
+static const Candidate kCandidates[] = {
+    { GGML_TYPE_F16,  GGML_TYPE_F16,  512 },
+    { GGML_TYPE_Q8_0, GGML_TYPE_Q8_0, 512 },
+    { GGML_TYPE_Q8_0, GGML_TYPE_Q8_0, 256 },
+    { GGML_TYPE_Q8_0, GGML_TYPE_Q4_0, 256 },
+    { GGML_TYPE_Q4_0, GGML_TYPE_Q4_0, 256 },
+    { GGML_TYPE_Q4_0, GGML_TYPE_Q4_0, 128 },
+};
+
+struct ModelShape {
+    int64_t n_layer;
+    int64_t n_head;
+    int64_t n_embd;
+    int64_t n_embd_kv;     // KV heads x head size
+    int64_t n_vocab;
+};
+
+static ModelShape model_shape(const llama_model* model) {
+    ModelShape m;
+    m.n_layer = llama_model_n_layer(model);
+    m.n_head = std::max(1, llama_model_n_head(model));
+    m.n_embd = llama_model_n_embd(model);
+    m.n_embd_kv = m.n_embd / m.n_head * std::max(1, llama_model_n_head_kv(model));
+    m.n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(model));
+    return m;
+}
+
+// Bytes of n elements of a cache type; q8_0 and q4_0 store 32 values per block
+static int64_t type_bytes(ggml_type type, int64_t n) {
+    switch (type) {
+        case GGML_TYPE_Q8_0: return n / 32 * 34;
+        case GGML_TYPE_Q4_0: return n / 32 * 18;
+        default:             return n * 2;
+    }
+}
+
+static int64_t kv_bytes(const ModelShape& m, int64_t n_ctx, ggml_type type_k, ggml_type type_v) {
+    const int64_t n = n_ctx * m.n_layer * m.n_embd_kv;
+    return type_bytes(type_k, n) + type_bytes(type_v, n);
+}
+
+/**
+ * Largest compute buffer of one micro-batch: logits and the hidden and
+ * feed-forward activations (FFN taken as 4 x n_embd), plus the attention
+ * scores over the whole cache unless flash attention tiles them.
+ */
+static int64_t compute_bytes(const ModelShape& m, int64_t n_ctx, int64_t n_ubatch, bool flash_attn) {
+    int64_t bytes = n_ubatch * (m.n_vocab + 16 * m.n_embd) * (int64_t) sizeof(float);
+    if (!flash_attn) {
+        bytes += n_ubatch * n_ctx * m.n_head * (int64_t) sizeof(float);
+    }
+    return bytes;
+}
+
+static void fill(ContextPlan& plan, const ModelShape& m, int n_ctx, const Candidate& c) {
+    plan.n_ctx = n_ctx;
+    plan.n_ubatch = c.n_ubatch;
+    plan.n_batch = c.n_ubatch;
+    plan.type_k = c.type_k;
+    plan.type_v = c.type_v;
+    plan.flash_attn = c.type_v != GGML_TYPE_F16;
+    plan.kv_bytes = kv_bytes(m, n_ctx, c.type_k, c.type_v);
+    plan.compute_bytes = compute_bytes(m, n_ctx, c.n_ubatch, plan.flash_attn);
+}
+
+static void log_plan(const ContextPlan& plan) {
+    LOGI("📐 Context plan: n_ctx %d, batch %d/%d, KV %s/%s, flash attention %s",
+         plan.n_ctx, plan.n_batch, plan.n_ubatch, kv_type_name(plan.type_k), kv_type_name(plan.type_v),
+         plan.flash_attn ? "on" : "auto");
+    LOGI("   weights %lld MB + KV %lld MB + compute %lld MB = %lld MB (budget %lld MB)",
+         (long long) (plan.weights_bytes >> 20), (long long) (plan.kv_bytes >> 20),
+         (long long) (plan.compute_bytes >> 20), (long long) (plan.total_bytes() >> 20),
+         (long long) (plan.budget_bytes >> 20));
+}
+
+bool plan_context(const llama_model* model, int64_t weights_bytes, int n_ctx, int64_t budget_bytes,
+                  ContextPlan& plan) {
+    const ModelShape m = model_shape(model);
+    n_ctx = n_ctx > 0 ? n_ctx : 2048;
+    plan = ContextPlan();
+    plan.weights_bytes = weights_bytes;
+    plan.budget_bytes = std::max<int64_t>(budget_bytes, 0);
+
+    if (budget_bytes <= 0) {
+        fill(plan, m, n_ctx, { GGML_TYPE_F16, GGML_TYPE_F16, kDefaultBatch });
+        log_plan(plan);
+        return true;
+    }
+
+    for (const Candidate& c : kCandidates) {
+        fill(plan, m, n_ctx, c);
+        if (plan.total_bytes() <= budget_bytes) {
+            log_plan(plan);
+            return true;
+        }
+    }
+
+    // Even the most compact configuration is too big: shorten the context
+    const Candidate& smallest = kCandidates[sizeof(kCandidates) / sizeof(kCandidates[0]) - 1];
+    fill(plan, m, 0, smallest);
+    const int64_t per_token = std::max<int64_t>(kv_bytes(m, kContextStep, smallest.type_k, smallest.type_v), 1);
+    const int64_t room = budget_bytes - weights_bytes - plan.compute_bytes;
+    const int fit = room > 0 ? (int) std::min<int64_t>(room / per_token * kContextStep, n_ctx) : 0;
+    if (fit < kMinContext) {
+        LOGE("❌ No context of %d+ tokens fits: weights %lld MB, budget %lld MB", kMinContext,
+             (long long) (weights_bytes >> 20), (long long) (budget_bytes >> 20));
+        return false;
+    }
+    fill(plan, m, fit, smallest);
+    LOGI("Context shortened from %d to %d tokens to fit the memory budget", n_ctx, fit);
+    log_plan(plan);
+    return true;
+}
+
+bool plan_context_for_file(const char* path, int n_ctx, int64_t budget_bytes, ContextPlan& plan) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        LOGE("Cannot stat %s", path);
+        return false;
+    }
+    llama_model_params params = llama_model_default_params();
+    params.vocab_only = true;   // hyperparameters and vocabulary, no tensors
+    llama_model* model = llama_model_load_from_file(path, params);
+    if (model == nullptr) {
+        LOGE("Failed to read model metadata from %s", path);
+        return false;
+    }
+    const bool ok = plan_context(model, (int64_t) st.st_size, n_ctx, budget_bytes, plan);
+    llama_model_free(model);
+    return ok;
+}
+
+void apply_context_plan(const ContextPlan& plan, llama_context_params& params) {
+    params.n_ctx = plan.n_ctx;
+    params.n_batch = plan.n_batch;
+    params.n_ubatch = plan.n_ubatch;
+    params.type_k = plan.type_k;
+    params.type_v = plan.type_v;
+    if (plan.flash_attn) {
+        params.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_ENABLED;
+    }
+}
+
+const char* kv_type_name(ggml_type type) {
+    switch (type) {
+        case GGML_TYPE_F16:  return "f16";
+        case GGML_TYPE_Q8_0: return "q8_0";
+        case GGML_TYPE_Q4_0: return "q4_0";
+        default:             return "?";
+    }
+}
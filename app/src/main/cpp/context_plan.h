@@ -0,0 +1,56 @@
+/**
+ * context_plan.h - Fit an LLM context into a memory budget
+ *
+ * Besides the weights, a context costs its KV cache (n_ctx x layers x KV
+ * heads x head size, at the cache type's bytes per element) and its compute
+ * buffers, which grow with n_ubatch and, without flash attention, with the
+ * attention scores of n_ubatch x n_ctx x heads.
+ *
+ * Given a budget for weights plus context, the planner walks from the most
+ * accurate configuration to the most compact one (f16 KV, q8_0, q8_0 K with
+ * q4_0 V, q4_0, smaller micro-batches) and only then shortens the context,
+ * so a phone gets the longest context that fits rather than whatever was
+ * asked for. Plans are made before the context is created; a model that
+ * cannot fit fails to load without allocating its KV cache.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "llama.h"
+
+struct ContextPlan {
+    int n_ctx = 0;
+    int n_batch = 0;                  // = n_ubatch: one scheduler step is one micro-batch
+    int n_ubatch = 0;
+    ggml_type type_k = GGML_TYPE_F16;
+    ggml_type type_v = GGML_TYPE_F16;
+    bool flash_attn = false;          // forced on (quantized V needs it); else llama.cpp decides
+    int64_t budget_bytes = 0;         // 0 = no budget, defaults planned for reporting only
+    int64_t weights_bytes = 0;
+    int64_t kv_bytes = 0;             // estimated KV cache
+    int64_t compute_bytes = 0;        // estimated compute buffers
+
+    int64_t total_bytes() const { return weights_bytes + kv_bytes + compute_bytes; }
+};
+
+/**
+ * Plan a context of at most n_ctx tokens for `model`, whose weights take
+ * weights_bytes. Without a budget (budget_bytes <= 0) this is the default
+ * configuration (f16 KV, 512-token batches, n_ctx as asked). Returns false
+ * if not even the smallest context fits.
+ */
+bool plan_context(const llama_model* model, int64_t weights_bytes, int n_ctx, int64_t budget_bytes,
+                  ContextPlan& plan);
+
+/**
+ * Same, reading only the model's hyperparameters and vocabulary (the
+ * weights are not loaded; their size is the file size).
+ */
+bool plan_context_for_file(const char* path, int n_ctx, int64_t budget_bytes, ContextPlan& plan);
+
+/** Set n_ctx, batch sizes, KV cache types and flash attention from `plan` */
+void apply_context_plan(const ContextPlan& plan, llama_context_params& params);
+
+/** "f16", "q8_0", "q4_0" */
+const char* kv_type_name(ggml_type type);
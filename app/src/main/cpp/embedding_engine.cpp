@@ -0,0 +1,207 @@
+/**
+ * embedding_engine.cpp - Batched sentence embeddings for AILive
+ *
+ * See embedding_engine.h.
+ */
+
+#include "embedding_engine.h"
+#include "session_state.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <android/log.h>
+
+#define LOG_TAG "AILive-Embed"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// Tokens decoded per batch. Non-causal (encoder) models need the whole batch
+// in one micro-batch, so n_ctx = n_batch = n_ubatch.
+static constexpr int kBatchTokens = 2048;
+
+std::unique_ptr<EmbeddingEngine> EmbeddingEngine::load(const char* path, int pooling) {
+    std::unique_ptr<EmbeddingEngine> engine(new EmbeddingEngine());
+
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = 99;
+
+    engine->model_ = llama_model_load_from_file(path, model_params);
+    if (engine->model_ == nullptr) {
+        LOGE("Failed to load embedding model from %s", path);
+        return nullptr;
+    }
+    engine->owns_model_ = true;
+    engine->model_key_ = model_fingerprint(path, engine->model_);
+
+    if (!engine->init_context(pooling)) {
+        return nullptr;
+    }
+    return engine;
+}
+
+std::unique_ptr<EmbeddingEngine> EmbeddingEngine::create(llama_model* model, uint64_t model_key, int pooling) {
+    std::unique_ptr<EmbeddingEngine> engine(new EmbeddingEngine());
+    engine->model_ = model;
+    engine->owns_model_ = false;
+    engine->model_key_ = model_key;
+
+    if (!engine->init_context(pooling)) {
+        return nullptr;
+    }
+    return engine;
+}
+
+bool EmbeddingEngine::init_context(int pooling) {
+    encoder_only_ = llama_model_has_encoder(model_) && !llama_model_has_decoder(model_);
+
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = kBatchTokens;
+    ctx_params.n_batch = kBatchTokens;
+    ctx_params.n_ubatch = kBatchTokens;
+    ctx_params.n_seq_max = kMaxSequences;
+    ctx_params.n_threads = 4;
+    ctx_params.embeddings = true;
+    ctx_params.pooling_type = (enum llama_pooling_type) pooling;
+    ctx_params.kv_unified = true;
+
+    ctx_ = llama_init_from_model(model_, ctx_params);
+    if (ctx_ == nullptr) {
+        LOGE("Failed to create embedding context");
+        return false;
+    }
+
+    if (llama_pooling_type(ctx_) == LLAMA_POOLING_TYPE_NONE) {
+        LOGE("Embedding context has no pooling; a per-sequence embedding is required");
+        return false;
+    }
+
+    n_embd_ = llama_model_n_embd(model_);
+    batch_capacity_ = kBatchTokens;
+    batch_ = llama_batch_init(batch_capacity_, 0, 1);
+
+    // BERT-style models cannot attend past their training context
+    max_text_tokens_ = batch_capacity_;
+    const int n_ctx_train = llama_model_n_ctx_train(model_);
+    if (n_ctx_train > 0) {
+        max_text_tokens_ = std::min(max_text_tokens_, n_ctx_train);
+    }
+
+    LOGI("✅ Embedding context ready: dim=%d, pooling=%d, %s, %d sequences x %d tokens per batch",
+         n_embd_, (int) llama_pooling_type(ctx_), encoder_only_ ? "encoder" : "decoder",
+         kMaxSequences, batch_capacity_);
+    return true;
+}
+
+std::string EmbeddingEngine::signature() const {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%016" PRIx64 "-p%d-v%d",
+             model_key_, (int) llama_pooling_type(ctx_), kMethodVersion);
+    return buf;
+}
+
+EmbeddingEngine::~EmbeddingEngine() {
+    if (batch_capacity_ > 0) {
+        llama_batch_free(batch_);
+    }
+    if (ctx_ != nullptr) {
+        llama_free(ctx_);
+    }
+    if (owns_model_ && model_ != nullptr) {
+        llama_model_free(model_);
+    }
+}
+
+/**
+ * Decode the sequences packed into batch_ and write their pooled, normalized
+ * embeddings to the rows of `out` listed in seq_rows_.
+ */
+bool EmbeddingEngine::decode_batch(std::vector<float>& out) {
+    const int n_seqs = (int) seq_rows_.size();
+    llama_memory_t memory = llama_get_memory(ctx_);
+    if (memory != nullptr) {
+        llama_memory_clear(memory, true);
+    }
+
+    const int ret = encoder_only_ ? llama_encode(ctx_, batch_) : llama_decode(ctx_, batch_);
+    if (ret != 0) {
+        LOGE("Embedding batch failed (%d tokens, %d sequences), ret=%d", batch_.n_tokens, n_seqs, ret);
+        return false;
+    }
+
+    for (int seq = 0; seq < n_seqs; ++seq) {
+        const float* embedding = llama_get_embeddings_seq(ctx_, seq);
+        if (embedding == nullptr) {
+            LOGE("Failed to get pooled embedding for sequence %d", seq);
+            return false;
+        }
+
+        // L2 normalize so cosine similarity is a dot product
+        float norm = 0.0f;
+        for (int i = 0; i < n_embd_; ++i) {
+            norm += embedding[i] * embedding[i];
+        }
+        norm = std::sqrt(norm);
+        const float scale = norm > 0.0f ? 1.0f / norm : 0.0f;
+
+        float* row = out.data() + seq_rows_[seq] * n_embd_;
+        for (int i = 0; i < n_embd_; ++i) {
+            row[i] = embedding[i] * scale;
+        }
+    }
+
+    seq_rows_.clear();
+    batch_.n_tokens = 0;
+    return true;
+}
+
+bool EmbeddingEngine::embed_batch(const std::vector<std::string>& texts, std::vector<float>& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out.assign(texts.size() * n_embd_, 0.0f);
+
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    seq_rows_.clear();
+    batch_.n_tokens = 0;
+
+    for (size_t t = 0; t < texts.size(); ++t) {
+        const std::string& text = texts[t];
+
+        tokens_.resize(text.length() + 2);
+        int n_tokens = llama_tokenize(vocab, text.c_str(), text.length(), tokens_.data(), tokens_.size(), true, false);
+        if (n_tokens < 0) {
+            tokens_.resize(-n_tokens);
+            n_tokens = llama_tokenize(vocab, text.c_str(), text.length(), tokens_.data(), tokens_.size(), true, false);
+        }
+        if (n_tokens <= 0) {
+            // Leave a zero vector rather than failing the whole batch
+            LOGI("Text %zu produced no tokens, returning zero vector", t);
+            continue;
+        }
+        n_tokens = std::min(n_tokens, max_text_tokens_);
+
+        // Flush when this text does not fit
+        const int n_seqs = (int) seq_rows_.size();
+        if (n_seqs == kMaxSequences || (n_seqs > 0 && batch_.n_tokens + n_tokens > batch_capacity_)) {
+            if (!decode_batch(out)) {
+                return false;
+            }
+        }
+
+        const llama_seq_id seq_id = (llama_seq_id) seq_rows_.size();
+        for (int i = 0; i < n_tokens; ++i) {
+            const int idx = batch_.n_tokens++;
+            batch_.token[idx] = tokens_[i];
+            batch_.pos[idx] = i;
+            batch_.n_seq_id[idx] = 1;
+            batch_.seq_id[idx][0] = seq_id;
+            batch_.logits[idx] = 1; // pooling reads every token's output
+        }
+        seq_rows_.push_back(t);
+    }
+
+    if (!seq_rows_.empty() && !decode_batch(out)) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+/**
+ * embedding_engine.h - Batched sentence embeddings for AILive
+ *
+ * A dedicated llama_context with embeddings enabled and sequence pooling
+ * (mean or CLS). Many texts are packed into one llama_batch, one sequence ID
+ * per text, so re-indexing memory costs a handful of decode calls instead of
+ * one per string. The model is either a small embedding GGUF (e.g. bge-small)
+ * owned by the engine, or the chat model borrowed from LlmEngine.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include "llama.h"
+
+class EmbeddingEngine {
+public:
+    // Upper bound on texts decoded together in one batch
+    static constexpr int kMaxSequences = 32;
+
+    // Bumped when the same model and pooling would produce different vectors
+    // (1: last token of the chat context, 2: sequence pooling)
+    static constexpr int kMethodVersion = 2;
+
+    /**
+     * Load a dedicated embedding model (owned by the engine).
+     *
+     * @param pooling LLAMA_POOLING_TYPE_MEAN / _CLS, or _UNSPECIFIED for the model default
+     */
+    static std::unique_ptr<EmbeddingEngine> load(const char* path, int pooling);
+
+    /**
+     * Create an embedding context on an already loaded model. The model is not
+     * owned and must outlive the engine.
+     *
+     * @param model_key Fingerprint of the model (see model_fingerprint)
+     */
+    static std::unique_ptr<EmbeddingEngine> create(llama_model* model, uint64_t model_key, int pooling);
+
+    ~EmbeddingEngine();
+
+    EmbeddingEngine(const EmbeddingEngine&) = delete;
+    EmbeddingEngine& operator=(const EmbeddingEngine&) = delete;
+
+    /**
+     * Embed `texts` into `out` (texts.size() * dim() floats, row-major,
+     * L2-normalized). Texts longer than the batch are truncated.
+     */
+    bool embed_batch(const std::vector<std::string>& texts, std::vector<float>& out);
+
+    int dim() const { return n_embd_; }
+    bool owns_model() const { return owns_model_; }
+
+    /**
+     * Identifies the vector space: model fingerprint, pooling and
+     * kMethodVersion. Vectors are only comparable under the same signature.
+     */
+    std::string signature() const;
+
+private:
+    EmbeddingEngine() = default;
+
+    bool init_context(int pooling);
+    bool decode_batch(std::vector<float>& out);
+
+    llama_model* model_ = nullptr;
+    llama_context* ctx_ = nullptr;
+    bool owns_model_ = false;
+    uint64_t model_key_ = 0;
+    bool encoder_only_ = false;   // BERT-style models run through llama_encode
+    int n_embd_ = 0;
+    int max_text_tokens_ = 0;
+
+    std::mutex mutex_;
+    llama_batch batch_ = {};
+    int batch_capacity_ = 0;
+    std::vector<llama_token> tokens_;
+    std::vector<size_t> seq_rows_;   // output row of each sequence in batch_
+};
@@ -0,0 +1,593 @@
+/**
+ * hnsw_index.cpp - Approximate nearest-neighbour index (HNSW) for AILive memory
+ *
+ * See hnsw_index.h.
+ */
+
+#include "hnsw_index.h"
+#include "vector_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+struct Closer {   // max-heap: most similar on top
+    bool operator()(const std::pair<float, int32_t>& a, const std::pair<float, int32_t>& b) const {
+        return a.first < b.first;
+    }
+};
+
+struct Farther {  // min-heap: least similar on top
+    bool operator()(const std::pair<float, int32_t>& a, const std::pair<float, int32_t>& b) const {
+        return a.first > b.first;
+    }
+};
+
+/**
+ * Per-thread visited set. A generation counter makes reset O(1).
+ */
+class VisitedList {
+public:
+    void reset(size_t n_nodes) {
+        if (tags_.size() < n_nodes) {
+            tags_.resize(n_nodes, 0);
+        }
+        if (++generation_ == 0) {
+            std::fill(tags_.begin(), tags_.end(), 0);
+            generation_ = 1;
+        }
+    }
+
+    // True the first time `node` is seen since reset()
+    inline bool visit(int32_t node) {
+        if (tags_[node] == generation_) {
+            return false;
+        }
+        tags_[node] = generation_;
+        return true;
+    }
+
+private:
+    std::vector<uint32_t> tags_;
+    uint32_t generation_ = 0;
+};
+
+VisitedList& visited_list() {
+    thread_local VisitedList visited;
+    return visited;
+}
+
+} // namespace
+
+HnswIndex::HnswIndex(int dim, size_t initial_capacity, const HnswParams& params)
+    : dim_(dim),
+      M_(std::max(2, params.M)),
+      M0_(2 * std::max(2, params.M)),
+      ef_construction_(std::max(params.ef_construction, std::max(2, params.M))),
+      level_mult_(1.0 / std::log((double) std::max(2, params.M))),
+      ef_search_(std::max(1, params.ef_search)) {
+    reserve(graph_, initial_capacity);
+}
+
+// ===== Public API =====
+
+void HnswIndex::insert(int64_t key, const float* vector) {
+    std::vector<float> normalized(vector, vector + dim_);
+    vec::normalize(normalized.data(), dim_);
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    tombstone(graph_, key);
+    insert_node(graph_, key, normalized.data());
+    if (compacting_) {
+        pending_.push_back({ PendingOp::INSERT, key, std::move(normalized) });
+    }
+}
+
+bool HnswIndex::remove(int64_t key) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (compacting_) {
+        pending_.push_back({ PendingOp::REMOVE, key, {} });
+    }
+    return tombstone(graph_, key);
+}
+
+void HnswIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    graph_ = Graph();
+    if (compacting_) {
+        pending_.clear();
+        pending_.push_back({ PendingOp::CLEAR, 0, {} });
+    }
+}
+
+int HnswIndex::search(const float* query, int k, float min_similarity,
+                      int64_t* out_keys, float* out_scores) const {
+    if (k <= 0) {
+        return 0;
+    }
+
+    std::vector<float> q(query, query + dim_);
+    vec::normalize(q.data(), dim_);
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const Graph& g = graph_;
+    if (g.entry < 0 || g.nodes.empty()) {
+        return 0;
+    }
+
+    int32_t entry = g.entry;
+    for (int level = g.max_level; level > 0; --level) {
+        entry = greedy_search(g, q.data(), entry, level);
+    }
+
+    const int ef = std::max(ef_search_.load(std::memory_order_relaxed), k);
+    std::vector<Candidate> found = search_layer(g, q.data(), entry, ef, 0, true);
+    std::sort(found.begin(), found.end(), Farther());
+
+    int n = 0;
+    for (const Candidate& c : found) {
+        if (n >= k || c.first < min_similarity) {
+            break;
+        }
+        out_keys[n] = g.keys[c.second];
+        out_scores[n] = c.first;
+        ++n;
+    }
+    return n;
+}
+
+size_t HnswIndex::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return graph_.nodes.size();
+}
+
+size_t HnswIndex::memory_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const Graph& g = graph_;
+    size_t bytes = g.vectors.capacity() * sizeof(float)
+                   + g.keys.capacity() * sizeof(int64_t)
+                   + g.deleted.capacity()
+                   + g.links0.capacity() * sizeof(int32_t)
+                   + g.upper.capacity() * sizeof(std::vector<int32_t>)
+                   + g.nodes.size() * (sizeof(int64_t) + sizeof(int32_t) + 2 * sizeof(void*));
+    for (const auto& layers : g.upper) {
+        bytes += layers.capacity() * sizeof(int32_t);
+    }
+    return bytes;
+}
+
+bool HnswIndex::get_vector(int64_t key, float* out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = graph_.nodes.find(key);
+    if (it == graph_.nodes.end()) {
+        return false;
+    }
+    std::memcpy(out, graph_.vectors.data() + (size_t) it->second * dim_, sizeof(float) * dim_);
+    return true;
+}
+
+void HnswIndex::set_ef_search(int ef) {
+    ef_search_.store(std::max(1, ef), std::memory_order_relaxed);
+}
+
+size_t HnswIndex::deleted_count() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return graph_.n_deleted;
+}
+
+size_t HnswIndex::compact() {
+    std::lock_guard<std::mutex> compact_lock(compact_mutex_);
+
+    // 1. Snapshot live nodes
+    std::vector<int64_t> keys;
+    std::vector<float> vectors;
+    size_t reclaimed;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        const Graph& g = graph_;
+        reclaimed = g.n_deleted;
+        if (reclaimed == 0) {
+            return 0;
+        }
+        keys.reserve(g.nodes.size());
+        vectors.reserve(g.nodes.size() * dim_);
+        for (size_t node = 0; node < g.keys.size(); ++node) {
+            if (!g.deleted[node]) {
+                keys.push_back(g.keys[node]);
+                vectors.insert(vectors.end(), g.vectors.begin() + node * dim_,
+                               g.vectors.begin() + (node + 1) * dim_);
+            }
+        }
+        compacting_ = true;
+        pending_.clear();
+    }
+
+    // 2. Build the replacement graph while searches and writes continue on the old one
+    Graph rebuilt;
+    reserve(rebuilt, keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        insert_node(rebuilt, keys[i], vectors.data() + i * dim_);
+    }
+
+    // 3. Replay writes made during the rebuild and swap
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (const PendingOp& op : pending_) {
+        switch (op.type) {
+            case PendingOp::INSERT:
+                tombstone(rebuilt, op.key);
+                insert_node(rebuilt, op.key, op.vector.data());
+                break;
+            case PendingOp::REMOVE:
+                tombstone(rebuilt, op.key);
+                break;
+            case PendingOp::CLEAR:
+                rebuilt = Graph();
+                break;
+        }
+    }
+    graph_ = std::move(rebuilt);
+    compacting_ = false;
+    pending_.clear();
+    pending_.shrink_to_fit();
+    return reclaimed;
+}
+
+// ===== Persistence =====
+
+namespace {
+
+struct GraphHeader {
+    uint32_t M;
+    uint32_t count;
+    int32_t entry;
+    int32_t max_level;
+};
+
+} // namespace
+
+void HnswIndex::export_graph(const std::vector<int64_t>& keys, std::vector<uint8_t>* out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const Graph& g = graph_;
+    const size_t n = keys.size();
+
+    std::vector<int32_t> node_of(n, -1);
+    std::vector<int32_t> row_of(g.keys.size(), -1);
+    for (size_t row = 0; row < n; ++row) {
+        auto it = g.nodes.find(keys[row]);
+        if (it != g.nodes.end()) {
+            node_of[row] = it->second;
+            row_of[it->second] = (int32_t) row;
+        }
+    }
+
+    // Layout: header, levels (padded to 4 bytes), layer-0 links, upper-layer links in row order
+    std::vector<uint8_t> levels(n, 0);
+    size_t upper_ints = 0;
+    GraphHeader h { (uint32_t) M_, (uint32_t) n, -1, -1 };
+    for (size_t row = 0; row < n; ++row) {
+        if (node_of[row] < 0) {
+            continue;
+        }
+        const int level = (int) (g.upper[node_of[row]].size() / (1 + M_));
+        levels[row] = (uint8_t) level;
+        upper_ints += g.upper[node_of[row]].size();
+        if (level > h.max_level) {
+            h.max_level = level;
+            h.entry = (int32_t) row;
+        }
+    }
+    if (g.entry >= 0 && row_of[g.entry] >= 0) {
+        h.entry = row_of[g.entry];
+        h.max_level = g.max_level;
+    }
+
+    const size_t levels_bytes = (n + 3) & ~(size_t) 3;
+    out->assign(sizeof(h) + levels_bytes + (n * (1 + M0_) + upper_ints) * sizeof(int32_t), 0);
+    uint8_t* p = out->data();
+    std::memcpy(p, &h, sizeof(h));
+    p += sizeof(h);
+    std::memcpy(p, levels.data(), n);
+    p += levels_bytes;
+
+    auto copy_links = [&](const int32_t* from, int max_links, int32_t* to) {
+        int32_t count = 0;
+        for (int32_t i = 1; i <= from[0] && i <= max_links; ++i) {
+            const int32_t row = row_of[from[i]];
+            if (row >= 0) {
+                to[1 + count++] = row;
+            }
+        }
+        to[0] = count;
+    };
+
+    auto* links0_out = reinterpret_cast<int32_t*>(p);
+    for (size_t row = 0; row < n; ++row) {
+        if (node_of[row] >= 0) {
+            copy_links(links(g, node_of[row], 0), M0_, links0_out + row * (1 + M0_));
+        }
+    }
+    auto* upper_out = links0_out + n * (1 + M0_);
+    for (size_t row = 0; row < n; ++row) {
+        for (int level = 1; level <= levels[row]; ++level) {
+            copy_links(links(g, node_of[row], level), M_, upper_out);
+            upper_out += 1 + M_;
+        }
+    }
+}
+
+bool HnswIndex::import_graph(const int64_t* keys, const float* vectors, size_t n,
+                             const uint8_t* data, size_t bytes) {
+    GraphHeader h;
+    if (data == nullptr || bytes < sizeof(h)) {
+        return false;
+    }
+    std::memcpy(&h, data, sizeof(h));
+    const size_t levels_bytes = (n + 3) & ~(size_t) 3;
+    if (h.M != (uint32_t) M_ || h.count != n || bytes < sizeof(h) + levels_bytes
+            || (n > 0 && (h.entry < 0 || (size_t) h.entry >= n))) {
+        return false;
+    }
+    const uint8_t* levels = data + sizeof(h);
+    size_t upper_ints = 0;
+    for (size_t row = 0; row < n; ++row) {
+        upper_ints += (size_t) levels[row] * (1 + M_);
+    }
+    if (bytes != sizeof(h) + levels_bytes + (n * (1 + M0_) + upper_ints) * sizeof(int32_t)) {
+        return false;
+    }
+
+    Graph g;
+    g.vectors.assign(vectors, vectors + n * dim_);
+    g.keys.assign(keys, keys + n);
+    g.deleted.assign(n, 0);
+    g.links0.resize(n * (1 + M0_));
+    std::memcpy(g.links0.data(), levels + levels_bytes, g.links0.size() * sizeof(int32_t));
+    const auto* upper_in = reinterpret_cast<const int32_t*>(levels + levels_bytes) + g.links0.size();
+    g.upper.resize(n);
+    g.nodes.reserve(n);
+    for (size_t row = 0; row < n; ++row) {
+        const size_t ints = (size_t) levels[row] * (1 + M_);
+        g.upper[row].assign(upper_in, upper_in + ints);
+        upper_in += ints;
+        g.nodes[keys[row]] = (int32_t) row;
+    }
+    g.entry = n > 0 ? h.entry : -1;
+    g.max_level = n > 0 ? h.max_level : -1;
+
+    // A corrupt link would send searches out of bounds
+    auto valid = [n](const int32_t* l, int max_links) {
+        if (l[0] < 0 || l[0] > max_links) return false;
+        for (int32_t i = 1; i <= l[0]; ++i) {
+            if (l[i] < 0 || (size_t) l[i] >= n) return false;
+        }
+        return true;
+    };
+    for (size_t row = 0; row < n; ++row) {
+        if (!valid(links(g, (int32_t) row, 0), M0_)) return false;
+        for (int level = 1; level <= levels[row]; ++level) {
+            if (!valid(links(g, (int32_t) row, level), M_)) return false;
+        }
+    }
+    if (n > 0 && (int) levels[h.entry] != h.max_level) {
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    graph_ = std::move(g);
+    return true;
+}
+
+// ===== Graph construction =====
+
+void HnswIndex::reserve(Graph& g, size_t capacity) const {
+    g.vectors.reserve(capacity * dim_);
+    g.keys.reserve(capacity);
+    g.deleted.reserve(capacity);
+    g.links0.reserve(capacity * (1 + M0_));
+    g.upper.reserve(capacity);
+    g.nodes.reserve(capacity);
+}
+
+void HnswIndex::insert_node(Graph& g, int64_t key, const float* normalized) const {
+    const int32_t node = (int32_t) g.keys.size();
+    const int level = random_level(g);
+
+    g.vectors.insert(g.vectors.end(), normalized, normalized + dim_);
+    g.keys.push_back(key);
+    g.deleted.push_back(0);
+    g.links0.resize(g.links0.size() + 1 + M0_, 0);
+    g.upper.emplace_back((size_t) level * (1 + M_), 0);
+    g.nodes[key] = node;
+
+    if (g.entry < 0) {
+        g.entry = node;
+        g.max_level = level;
+        return;
+    }
+
+    const float* v = g.vectors.data() + (size_t) node * dim_;
+    int32_t entry = g.entry;
+    for (int l = g.max_level; l > level; --l) {
+        entry = greedy_search(g, v, entry, l);
+    }
+
+    for (int l = std::min(level, g.max_level); l >= 0; --l) {
+        std::vector<Candidate> candidates = search_layer(g, v, entry, ef_construction_, l, false);
+        std::sort(candidates.begin(), candidates.end(), Farther());
+        entry = candidates.front().second;
+
+        std::vector<int32_t> neighbors = select_neighbors(g, candidates, M_);
+        int32_t* own = links(g, node, l);
+        own[0] = (int32_t) neighbors.size();
+        std::copy(neighbors.begin(), neighbors.end(), own + 1);
+        for (int32_t neighbor : neighbors) {
+            add_link(g, neighbor, node, l);
+        }
+    }
+
+    if (level > g.max_level) {
+        g.entry = node;
+        g.max_level = level;
+    }
+}
+
+bool HnswIndex::tombstone(Graph& g, int64_t key) const {
+    auto it = g.nodes.find(key);
+    if (it == g.nodes.end()) {
+        return false;
+    }
+    g.deleted[it->second] = 1;
+    g.nodes.erase(it);
+    g.n_deleted++;
+    return true;
+}
+
+int HnswIndex::random_level(Graph& g) const {
+    std::uniform_real_distribution<double> uniform(std::numeric_limits<double>::min(), 1.0);
+    return (int) (-std::log(uniform(g.rng)) * level_mult_);
+}
+
+int32_t* HnswIndex::links(Graph& g, int32_t node, int level) const {
+    if (level == 0) {
+        return g.links0.data() + (size_t) node * (1 + M0_);
+    }
+    return g.upper[node].data() + (size_t) (level - 1) * (1 + M_);
+}
+
+const int32_t* HnswIndex::links(const Graph& g, int32_t node, int level) const {
+    return links(const_cast<Graph&>(g), node, level);
+}
+
+float HnswIndex::similarity(const Graph& g, const float* query, int32_t node) const {
+    return vec::dot(query, g.vectors.data() + (size_t) node * dim_, dim_);
+}
+
+// ===== Graph search =====
+
+int32_t HnswIndex::greedy_search(const Graph& g, const float* query, int32_t entry, int level) const {
+    float best = similarity(g, query, entry);
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        const int32_t* l = links(g, entry, level);
+        for (int32_t i = 1; i <= l[0]; ++i) {
+            const float s = similarity(g, query, l[i]);
+            if (s > best) {
+                best = s;
+                entry = l[i];
+                improved = true;
+            }
+        }
+    }
+    return entry;
+}
+
+std::vector<HnswIndex::Candidate> HnswIndex::search_layer(const Graph& g, const float* query,
+                                                          int32_t entry, int ef, int level,
+                                                          bool skip_deleted) const {
+    VisitedList& visited = visited_list();
+    visited.reset(g.keys.size());
+
+    std::vector<Candidate> candidates;  // to expand, best on top
+    std::vector<Candidate> results;     // best ef so far, worst on top
+    candidates.reserve(ef * 2);
+    results.reserve(ef + 1);
+
+    const float s = similarity(g, query, entry);
+    visited.visit(entry);
+    candidates.emplace_back(s, entry);
+    if (!skip_deleted || !g.deleted[entry]) {
+        results.emplace_back(s, entry);
+    }
+    float worst = results.empty() ? -std::numeric_limits<float>::infinity() : s;
+
+    while (!candidates.empty()) {
+        const Candidate current = candidates.front();
+        if (current.first < worst && (int) results.size() >= ef) {
+            break;
+        }
+        std::pop_heap(candidates.begin(), candidates.end(), Closer());
+        candidates.pop_back();
+
+        const int32_t* l = links(g, current.second, level);
+        const int32_t n_links = l[0];
+        for (int32_t i = 1; i <= n_links; ++i) {
+            if (i < n_links) {
+                __builtin_prefetch(g.vectors.data() + (size_t) l[i + 1] * dim_);
+            }
+            const int32_t neighbor = l[i];
+            if (!visited.visit(neighbor)) {
+                continue;
+            }
+            const float sn = similarity(g, query, neighbor);
+            if ((int) results.size() < ef || sn > worst) {
+                candidates.emplace_back(sn, neighbor);
+                std::push_heap(candidates.begin(), candidates.end(), Closer());
+
+                if (!skip_deleted || !g.deleted[neighbor]) {
+                    results.emplace_back(sn, neighbor);
+                    std::push_heap(results.begin(), results.end(), Farther());
+                    if ((int) results.size() > ef) {
+                        std::pop_heap(results.begin(), results.end(), Farther());
+                        results.pop_back();
+                    }
+                    worst = results.front().first;
+                }
+            }
+        }
+    }
+    return results;
+}
+
+std::vector<int32_t> HnswIndex::select_neighbors(const Graph& g, std::vector<Candidate>& candidates,
+                                                 int max_links) const {
+    // Heuristic from the HNSW paper: keep a candidate only if it is closer to
+    // the base node than to every neighbour already kept, which spreads links
+    // across directions instead of clustering them
+    std::sort(candidates.begin(), candidates.end(), Farther());
+
+    std::vector<int32_t> selected;
+    selected.reserve(max_links);
+    for (const Candidate& c : candidates) {
+        if ((int) selected.size() >= max_links) {
+            break;
+        }
+        const float* cv = g.vectors.data() + (size_t) c.second * dim_;
+        bool keep = true;
+        for (int32_t s : selected) {
+            if (similarity(g, cv, s) > c.first) {
+                keep = false;
+                break;
+            }
+        }
+        if (keep) {
+            selected.push_back(c.second);
+        }
+    }
+    return selected;
+}
+
+void HnswIndex::add_link(Graph& g, int32_t from, int32_t to, int level) const {
+    const int max_links = level == 0 ? M0_ : M_;
+    int32_t* l = links(g, from, level);
+    if (l[0] < max_links) {
+        l[1 + l[0]] = to;
+        l[0]++;
+        return;
+    }
+
+    // Full: re-select among the existing links plus the new one
+    const float* fv = g.vectors.data() + (size_t) from * dim_;
+    std::vector<Candidate> candidates;
+    candidates.reserve(max_links + 1);
+    candidates.emplace_back(similarity(g, fv, to), to);
+    for (int32_t i = 1; i <= l[0]; ++i) {
+        candidates.emplace_back(similarity(g, fv, l[i]), l[i]);
+    }
+    std::vector<int32_t> kept = select_neighbors(g, candidates, max_links);
+    l[0] = (int32_t) kept.size();
+    std::copy(kept.begin(), kept.end(), l + 1);
+}
@@ -0,0 +1,133 @@
+/**
+ * hnsw_index.h - Approximate nearest-neighbour index (HNSW) for AILive memory
+ *
+ * Hierarchical Navigable Small World graph (Malkov & Yashunin): each vector
+ * is a node linked to its nearest neighbours on layer 0 and, with
+ * exponentially decreasing probability, on sparser upper layers. A query
+ * descends greedily from the top layer and runs a best-first beam search of
+ * width ef_search on layer 0, so cost grows roughly with log(n) instead of n.
+ *
+ * Deletes only set a tombstone: the node keeps routing queries but is never
+ * returned. compact() rebuilds the graph from live nodes off the lock, so
+ * searches and writes continue while it runs.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+#include "vector_index.h"
+
+struct HnswParams {
+    int M = 16;                 // links per node on upper layers (2*M on layer 0)
+    int ef_construction = 200;  // beam width while inserting
+    int ef_search = 64;         // beam width while searching (raised to k if smaller)
+};
+
+class HnswIndex : public VectorIndex {
+public:
+    HnswIndex(int dim, size_t initial_capacity, const HnswParams& params);
+
+    /**
+     * Insert `key`. Replacing an existing key tombstones its old node.
+     */
+    void insert(int64_t key, const float* vector) override;
+
+    /**
+     * Tombstone `key`. Space is reclaimed by compact().
+     */
+    bool remove(int64_t key) override;
+
+    void clear() override;
+
+    int search(const float* query, int k, float min_similarity,
+               int64_t* out_keys, float* out_scores) const override;
+
+    size_t size() const override;
+    int dim() const override { return dim_; }
+    size_t memory_bytes() const override;
+    bool get_vector(int64_t key, float* out) const override;
+
+    void set_ef_search(int ef) override;
+    size_t deleted_count() const override;
+
+    /**
+     * Rebuild the graph without tombstoned nodes. The live vectors are
+     * snapshotted, the new graph is built without holding the index lock,
+     * writes made meanwhile are replayed, and the graphs are swapped.
+     */
+    size_t compact() override;
+
+    /**
+     * Serialize the graph links with nodes renumbered to their position in
+     * `keys` (live keys, e.g. the row order of a persisted index). Links to
+     * nodes outside `keys` are dropped.
+     */
+    void export_graph(const std::vector<int64_t>& keys, std::vector<uint8_t>* out) const;
+
+    /**
+     * Replace the graph with one written by export_graph() over the `n`
+     * normalized `vectors` / `keys` in the same order, without rebuilding it.
+     * @return false if `data` does not match this index's parameters
+     */
+    bool import_graph(const int64_t* keys, const float* vectors, size_t n,
+                      const uint8_t* data, size_t bytes);
+
+private:
+    struct Graph {
+        std::vector<float> vectors;                 // node -> normalized vector (dim_ floats)
+        std::vector<int64_t> keys;                  // node -> key
+        std::vector<uint8_t> deleted;               // node -> tombstone flag
+        std::vector<int32_t> links0;                // node -> [count, 2*M neighbours] on layer 0
+        std::vector<std::vector<int32_t>> upper;    // node -> [count, M neighbours] per layer >= 1
+        std::unordered_map<int64_t, int32_t> nodes; // live key -> node
+        int32_t entry = -1;
+        int max_level = -1;
+        size_t n_deleted = 0;
+        std::mt19937 rng{ 42 };
+    };
+
+    // Write made while a compaction is building its graph
+    struct PendingOp {
+        enum Type { INSERT, REMOVE, CLEAR } type;
+        int64_t key;
+        std::vector<float> vector;
+    };
+
+    using Candidate = std::pair<float, int32_t>;  // (similarity, node)
+
+    void reserve(Graph& g, size_t capacity) const;
+    void insert_node(Graph& g, int64_t key, const float* normalized) const;
+    bool tombstone(Graph& g, int64_t key) const;
+
+    int random_level(Graph& g) const;
+    int32_t* links(Graph& g, int32_t node, int level) const;
+    const int32_t* links(const Graph& g, int32_t node, int level) const;
+    float similarity(const Graph& g, const float* query, int32_t node) const;
+
+    int32_t greedy_search(const Graph& g, const float* query, int32_t entry, int level) const;
+    std::vector<Candidate> search_layer(const Graph& g, const float* query, int32_t entry,
+                                        int ef, int level, bool skip_deleted) const;
+    std::vector<int32_t> select_neighbors(const Graph& g, std::vector<Candidate>& candidates,
+                                          int max_links) const;
+    void add_link(Graph& g, int32_t from, int32_t to, int level) const;
+
+    const int dim_;
+    const int M_;
+    const int M0_;
+    const int ef_construction_;
+    const double level_mult_;
+    std::atomic<int> ef_search_;
+
+    mutable std::shared_mutex mutex_;
+    Graph graph_;
+
+    std::mutex compact_mutex_;      // one compaction at a time
+    bool compacting_ = false;       // guarded by mutex_
+    std::vector<PendingOp> pending_;
+};
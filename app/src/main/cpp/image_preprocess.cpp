@@ -0,0 +1,237 @@
+/**
+ * image_preprocess.cpp - Fused resize + normalize for vision model inputs
+ *
+ * See image_preprocess.h.
+ */
+
+#include "image_preprocess.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+namespace img {
+
+// Output tensor alignment: a cache line, and enough for any SIMD load
+static constexpr size_t kAlignment = 64;
+
+ImagePreprocessor::ImagePreprocessor(const PreprocessParams& params) : params_(params) {
+    params_.width = std::max(params_.width, 1);
+    params_.height = std::max(params_.height, 1);
+    for (int c = 0; c < 3; ++c) {
+        const float std_dev = params_.std[c] != 0.0f ? params_.std[c] : 1.0f;
+        scale_[c] = 1.0f / (255.0f * std_dev);
+        bias_[c] = -params_.mean[c] / std_dev;
+    }
+    void* memory = nullptr;
+    if (posix_memalign(&memory, kAlignment, output_size() * sizeof(float)) == 0) {
+        output_ = static_cast<float*>(memory);
+    }
+    row_index_[0] = row_index_[1] = -1;
+}
+
+ImagePreprocessor::~ImagePreprocessor() {
+    free(output_);
+}
+
+bool ImagePreprocessor::run(const uint8_t* rgba, int width, int height, size_t stride) {
+    if (output_ == nullptr || rgba == nullptr || width <= 0 || height <= 0) {
+        return false;
+    }
+    const int out_w = params_.width;
+    const int out_h = params_.height;
+
+    Placement placement;
+    if (params_.letterbox) {
+        const float s = std::min((float) out_w / width, (float) out_h / height);
+        placement.width = std::clamp((int) lroundf(width * s), 1, out_w);
+        placement.height = std::clamp((int) lroundf(height * s), 1, out_h);
+        placement.x = (out_w - placement.width) / 2;
+        placement.y = (out_h - placement.height) / 2;
+    } else {
+        placement.width = out_w;
+        placement.height = out_h;
+    }
+    placement.scale = (float) placement.width / width;
+
+    const bool layout_changed = placement.width != placement_.width || width != src_width_;
+    placement_ = placement;
+    if (layout_changed) {
+        // Source x for each content column, pixel centres aligned
+        const float step = (float) width / placement.width;
+        x0_.resize(placement.width);
+        wx_.resize(placement.width);
+        for (int x = 0; x < placement.width; ++x) {
+            const float sx = std::clamp((x + 0.5f) * step - 0.5f, 0.0f, (float) (width - 1));
+            const int x0 = std::min((int) sx, std::max(width - 2, 0));
+            x0_[x] = x0;
+            wx_[x] = width > 1 ? sx - x0 : 0.0f;
+        }
+        src_width_ = width;
+        rows_[0].resize((size_t) placement.width * 3);
+        rows_[1].resize((size_t) placement.width * 3);
+    }
+    row_index_[0] = row_index_[1] = -1;
+
+    if (params_.letterbox) {
+        fill_padding();
+    }
+
+    const float step = (float) height / placement.height;
+    const int dy = height > 1 ? 1 : 0;
+    for (int y = 0; y < placement.height; ++y) {
+        const float sy = std::clamp((y + 0.5f) * step - 0.5f, 0.0f, (float) (height - 1));
+        const int y0 = std::min((int) sy, std::max(height - 2, 0));
+        const int needed[2] = {y0, y0 + dy};
+        const float* rows[2];
+        for (int k = 0; k < 2; ++k) {
+            int slot = row_index_[0] == needed[k] ? 0 : row_index_[1] == needed[k] ? 1 : -1;
+            if (slot < 0) {
+                // Evict the slot the other needed row is not in; rows only move down
+                slot = row_index_[0] == needed[1 - k] ? 1 : 0;
+                filter_row(rgba + (size_t) needed[k] * stride, rows_[slot].data());
+                row_index_[slot] = needed[k];
+            }
+            rows[k] = rows_[slot].data();
+        }
+        emit_row(rows[0], rows[1], height > 1 ? sy - y0 : 0.0f, placement.y + y);
+    }
+    return true;
+}
+
+void ImagePreprocessor::filter_row(const uint8_t* src_row, float* dst) const {
+    const int n = placement_.width;
+    const int dx = src_width_ > 1 ? 4 : 0;
+    float* r = dst;
+    float* g = dst + n;
+    float* b = dst + 2 * n;
+    for (int x = 0; x < n; ++x) {
+        const uint8_t* p = src_row + (size_t) x0_[x] * 4;
+        const float w = wx_[x];
+        r[x] = p[0] + w * (float) (p[dx + 0] - p[0]);
+        g[x] = p[1] + w * (float) (p[dx + 1] - p[1]);
+        b[x] = p[2] + w * (float) (p[dx + 2] - p[2]);
+    }
+}
+
+void ImagePreprocessor::emit_row(const float* top, const float* bottom, float wy, int out_y) {
+    const int n = placement_.width;
+    const size_t plane = (size_t) params_.width * params_.height;
+    // out = (top + wy * (bottom - top)) * scale + bias, as two multiply-adds
+    float wt[3], wb[3];
+    for (int c = 0; c < 3; ++c) {
+        wt[c] = (1.0f - wy) * scale_[c];
+        wb[c] = wy * scale_[c];
+    }
+
+    if (params_.layout == Layout::NCHW) {
+        for (int c = 0; c < 3; ++c) {
+            const float* t = top + (size_t) c * n;
+            const float* b = bottom + (size_t) c * n;
+            float* out = output_ + c * plane + (size_t) out_y * params_.width + placement_.x;
+            int x = 0;
+#if defined(__aarch64__)
+            const float32x4_t vt = vdupq_n_f32(wt[c]);
+            const float32x4_t vb = vdupq_n_f32(wb[c]);
+            const float32x4_t bias = vdupq_n_f32(bias_[c]);
+            for (; x + 8 <= n; x += 8) {
+                float32x4_t a0 = vfmaq_f32(vfmaq_f32(bias, vld1q_f32(t + x), vt), vld1q_f32(b + x), vb);
+                float32x4_t a1 = vfmaq_f32(vfmaq_f32(bias, vld1q_f32(t + x + 4), vt), vld1q_f32(b + x + 4), vb);
+                vst1q_f32(out + x, a0);
+                vst1q_f32(out + x + 4, a1);
+            }
+#elif defined(__x86_64__)
+            const __m128 vt = _mm_set1_ps(wt[c]);
+            const __m128 vb = _mm_set1_ps(wb[c]);
+            const __m128 bias = _mm_set1_ps(bias_[c]);
+            for (; x + 4 <= n; x += 4) {
+                __m128 a = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(t + x), vt), _mm_mul_ps(_mm_loadu_ps(b + x), vb));
+                _mm_storeu_ps(out + x, _mm_add_ps(a, bias));
+            }
+#endif
+            for (; x < n; ++x) {
+                out[x] = t[x] * wt[c] + b[x] * wb[c] + bias_[c];
+            }
+        }
+        return;
+    }
+
+    float* out = output_ + ((size_t) out_y * params_.width + placement_.x) * 3;
+    int x = 0;
+#if defined(__aarch64__)
+    float32x4_t vt[3], vb[3], bias[3];
+    for (int c = 0; c < 3; ++c) {
+        vt[c] = vdupq_n_f32(wt[c]);
+        vb[c] = vdupq_n_f32(wb[c]);
+        bias[c] = vdupq_n_f32(bias_[c]);
+    }
+    for (; x + 4 <= n; x += 4) {
+        float32x4x3_t rgb;
+        for (int c = 0; c < 3; ++c) {
+            const float* t = top + (size_t) c * n + x;
+            const float* b = bottom + (size_t) c * n + x;
+            rgb.val[c] = vfmaq_f32(vfmaq_f32(bias[c], vld1q_f32(t), vt[c]), vld1q_f32(b), vb[c]);
+        }
+        vst3q_f32(out + (size_t) x * 3, rgb);   // interleaving store
+    }
+#endif
+    for (; x < n; ++x) {
+        for (int c = 0; c < 3; ++c) {
+            out[(size_t) x * 3 + c] = top[(size_t) c * n + x] * wt[c] + bottom[(size_t) c * n + x] * wb[c] + bias_[c];
+        }
+    }
+}
+
+void ImagePreprocessor::fill_padding() {
+    const int out_w = params_.width;
+    const int out_h = params_.height;
+    const size_t plane = (size_t) out_w * out_h;
+    float value[3];
+    for (int c = 0; c < 3; ++c) {
+        value[c] = params_.pad[c] * scale_[c] + bias_[c];
+    }
+
+    // Output pixels [begin, end) of row y
+    auto fill = [&](int y, int begin, int end) {
+        if (begin >= end) return;
+        if (params_.layout == Layout::NCHW) {
+            for (int c = 0; c < 3; ++c) {
+                float* row = output_ + c * plane + (size_t) y * out_w;
+                std::fill(row + begin, row + end, value[c]);
+            }
+        } else {
+            float* row = output_ + (size_t) y * out_w * 3;
+            for (int x = begin; x < end; ++x) {
+                std::copy(value, value + 3, row + (size_t) x * 3);
+            }
+        }
+    };
+
+    const Placement& p = placement_;
+    for (int y = 0; y < out_h; ++y) {
+        if (y < p.y || y >= p.y + p.height) {
+            fill(y, 0, out_w);
+        } else {
+            fill(y, 0, p.x);
+            fill(y, p.x + p.width, out_w);
+        }
+    }
+}
+
+const char* kernel_name() {
+#if defined(__aarch64__)
+    return "neon";
+#elif defined(__x86_64__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace img
@@ -0,0 +1,102 @@
+/**
+ * image_preprocess.h - Fused resize + normalize for vision model inputs
+ *
+ * Camera frames and gallery images arrive as RGBA_8888 bitmaps of any size;
+ * vision encoders want a fixed-size float tensor, planar (NCHW, ONNX) or
+ * interleaved (NHWC, TFLite), normalized per channel. Resizing, channel
+ * extraction and normalization happen in one pass over the output: each
+ * source row is filtered horizontally once into a small row cache, and the
+ * vertical blend, scale and bias run on NEON (arm64) or SSE2 (x86_64)
+ * straight into the output tensor. No intermediate bitmap or image-sized
+ * buffer is allocated.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace img {
+
+enum class Layout {
+    NCHW,   // all R, then all G, then all B
+    NHWC,   // RGBRGB...
+};
+
+struct PreprocessParams {
+    int width = 224;
+    int height = 224;
+    Layout layout = Layout::NCHW;
+    /** Keep the aspect ratio and pad the borders instead of stretching */
+    bool letterbox = false;
+    /** Applied to value / 255, per R, G, B: (v / 255 - mean) / std */
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    float std[3] = {1.0f, 1.0f, 1.0f};
+    /** Border colour for letterboxing, 0-255 per channel */
+    uint8_t pad[3] = {0, 0, 0};
+};
+
+/** Where the image ended up in the output, to map results back */
+struct Placement {
+    int x = 0;          // left edge of the image content
+    int y = 0;          // top edge
+    int width = 0;      // content size; equals the output size unless letterboxed
+    int height = 0;
+    float scale = 1.0f; // output pixels per source pixel (horizontal)
+};
+
+/**
+ * Reusable preprocessor for one output shape. The output tensor is a
+ * 64-byte aligned buffer owned by the preprocessor and overwritten by
+ * every run(). Not thread-safe.
+ */
+class ImagePreprocessor {
+public:
+    explicit ImagePreprocessor(const PreprocessParams& params);
+    ~ImagePreprocessor();
+
+    ImagePreprocessor(const ImagePreprocessor&) = delete;
+    ImagePreprocessor& operator=(const ImagePreprocessor&) = delete;
+
+    /**
+     * Convert an RGBA_8888 image (bytes R, G, B, A; alpha ignored) with
+     * `stride` bytes per row.
+     * @return false if the source is empty
+     */
+    bool run(const uint8_t* rgba, int width, int height, size_t stride);
+
+    const float* output() const { return output_; }
+    /** width * height * 3 floats */
+    size_t output_size() const { return (size_t) params_.width * params_.height * 3; }
+    const Placement& placement() const { return placement_; }
+    const PreprocessParams& params() const { return params_; }
+
+private:
+    void fill_padding();
+    void filter_row(const uint8_t* src_row, float* dst) const;
+    void emit_row(const float* top, const float* bottom, float wy, int out_y);
+
+    PreprocessParams params_;
+    float scale_[3];           // 1 / (255 * std)
+    float bias_[3];            // -mean / std
+    float* output_ = nullptr;  // aligned, output_size() floats
+    Placement placement_;
+
+    // Per content column: left source pixel and the weight of the right one
+    std::vector<int> x0_;
+    std::vector<float> wx_;
+    int src_width_ = 0;        // x tables are valid for this source width
+
+    // Two horizontally filtered source rows, planar R/G/B of content width
+    std::vector<float> rows_[2];
+    int row_index_[2];
+};
+
+/**
+ * Name of the selected kernel ("neon", "sse2", "scalar"), for logging.
+ */
+const char* kernel_name();
+
+} // namespace img
@@ -0,0 +1,454 @@
+/**
+ * index_file.cpp - On-disk format of the persistent vector index
+ *
+ * See index_file.h.
+ */
+
+#include "index_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <android/log.h>
+
+#define LOG_TAG "AILive-Vector"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+static constexpr char kMagic[8] = { 'A', 'I', 'L', 'V', 'I', 'D', 'X', '\0' };
+static constexpr size_t kHeaderBytes = 4096;         // one page, so the vectors start page-aligned
+static constexpr size_t kInitialLogBytes = 64 * 1024;
+static constexpr size_t kMinGrowBytes = 1024 * 1024;
+
+struct IndexFile::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t flags;                 // reserved, 0
+    uint32_t reserved;
+    uint64_t sealed_count;
+    uint64_t vectors_offset;        // sealed_count * dim floats
+    uint64_t keys_offset;           // sealed_count int64
+    uint64_t meta_index_offset;     // sealed_count + 1 uint64, relative to meta_offset
+    uint64_t meta_offset;
+    uint64_t graph_offset;
+    uint64_t graph_bytes;
+    uint64_t log_offset;            // end of the sealed part, start of the log
+    uint32_t sealed_crc;            // CRC-32C of [vectors_offset, log_offset)
+    uint32_t header_crc;            // CRC-32C of the fields above
+};
+
+// Fixed part of a log record; followed by `floats` floats, `meta_bytes`
+// bytes of metadata and zero padding to a multiple of 8 bytes
+struct LogRecord {
+    uint32_t type;
+    uint32_t meta_bytes;
+    int64_t key;
+    uint32_t crc;                   // CRC-32C of the record with crc = 0
+    uint32_t floats;                // dim for INSERT, 0 otherwise
+};
+
+static_assert(sizeof(LogRecord) == 24, "log record header must stay 24 bytes");
+
+static inline uint64_t align8(uint64_t n) {
+    return (n + 7) & ~(uint64_t) 7;
+}
+
+static inline size_t record_bytes(uint32_t floats, uint32_t meta_bytes) {
+    return align8(sizeof(LogRecord) + (uint64_t) floats * sizeof(float) + meta_bytes);
+}
+
+// ===== CRC-32C =====
+
+namespace {
+
+// Slicing-by-8 tables: eight bytes per step
+struct Crc32cTable {
+    uint32_t entries[8][256];
+
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+            }
+            entries[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int t = 1; t < 8; ++t) {
+                entries[t][i] = (entries[t - 1][i] >> 8) ^ entries[0][entries[t - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+} // namespace
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t bytes) {
+    static const Crc32cTable table;
+    const auto& t = table.entries;
+    const auto* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (; bytes >= 8; bytes -= 8, p += 8) {
+        uint32_t lo;
+        uint32_t hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+              ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    for (; bytes > 0; --bytes, ++p) {
+        crc = t[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// ===== Open / write =====
+
+IndexFile::IndexFile(const std::string& path, int dim, int fd)
+    : path_(path), dim_(dim), fd_(fd) {
+}
+
+IndexFile::~IndexFile() {
+    if (base_ != nullptr) {
+        munmap(base_, mapped_bytes_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+std::unique_ptr<IndexFile> IndexFile::open(const std::string& path, int dim) {
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        const int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd >= 0) {
+            std::unique_ptr<IndexFile> file(new IndexFile(path, dim, fd));
+            struct stat st {};
+            if (fstat(fd, &st) == 0 && (size_t) st.st_size >= kHeaderBytes
+                    && file->map((size_t) st.st_size) && file->read_header((size_t) st.st_size)) {
+                file->log_begin_ = file->header().log_offset;
+                file->log_end_ = file->log_begin_;
+                return file;
+            }
+            LOGE("⚠️ Index file %s is invalid or for another version/dimension, recreating", path.c_str());
+        }
+        if (attempt == 0 && !write(path, dim, {}, {})) {
+            break;
+        }
+    }
+    LOGE("❌ Cannot open index file %s", path.c_str());
+    return nullptr;
+}
+
+bool IndexFile::write(const std::string& path, int dim, const std::vector<Row>& rows,
+                      const std::vector<uint8_t>& graph) {
+    const uint64_t n = rows.size();
+    uint64_t meta_total = 0;
+    for (const Row& row : rows) {
+        meta_total += row.meta_bytes;
+    }
+
+    Header h {};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.dim = (uint32_t) dim;
+    h.sealed_count = n;
+    h.vectors_offset = kHeaderBytes;
+    h.keys_offset = align8(h.vectors_offset + n * dim * sizeof(float));
+    h.meta_index_offset = h.keys_offset + n * sizeof(int64_t);
+    h.meta_offset = h.meta_index_offset + (n + 1) * sizeof(uint64_t);
+    h.graph_offset = align8(h.meta_offset + meta_total);
+    h.graph_bytes = graph.size();
+    h.log_offset = align8(h.graph_offset + h.graph_bytes);
+    const size_t file_bytes = h.log_offset + kInitialLogBytes;
+
+    const std::string tmp_path = path + ".tmp";
+    const int fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOGE("❌ Cannot create %s: %s", tmp_path.c_str(), strerror(errno));
+        return false;
+    }
+    void* mapping = MAP_FAILED;
+    if (ftruncate(fd, (off_t) file_bytes) == 0) {
+        mapping = mmap(nullptr, file_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (mapping == MAP_FAILED) {
+        LOGE("❌ Cannot size %s to %zu bytes: %s", tmp_path.c_str(), file_bytes, strerror(errno));
+        close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    auto* base = static_cast<uint8_t*>(mapping);
+    auto* vectors = reinterpret_cast<float*>(base + h.vectors_offset);
+    auto* keys = reinterpret_cast<int64_t*>(base + h.keys_offset);
+    auto* meta_index = reinterpret_cast<uint64_t*>(base + h.meta_index_offset);
+    uint64_t meta_pos = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        const Row& row = rows[i];
+        std::memcpy(vectors + i * dim, row.vector, sizeof(float) * dim);
+        keys[i] = row.key;
+        meta_index[i] = meta_pos;
+        if (row.meta_bytes > 0) {
+            std::memcpy(base + h.meta_offset + meta_pos, row.meta, row.meta_bytes);
+        }
+        meta_pos += row.meta_bytes;
+    }
+    meta_index[n] = meta_pos;
+    if (!graph.empty()) {
+        std::memcpy(base + h.graph_offset, graph.data(), graph.size());
+    }
+
+    h.sealed_crc = crc32c(0, base + h.vectors_offset, h.log_offset - h.vectors_offset);
+    h.header_crc = crc32c(0, &h, offsetof(Header, header_crc));
+    std::memcpy(base, &h, sizeof(h));
+
+    const bool flushed = msync(mapping, file_bytes, MS_SYNC) == 0;
+    munmap(mapping, file_bytes);
+    const bool synced = flushed && fsync(fd) == 0;
+    close(fd);
+    if (!synced || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        LOGE("❌ Cannot replace %s: %s", path.c_str(), strerror(errno));
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    // Make the rename itself durable
+    const std::string dir = path.substr(0, path.find_last_of('/') + 1);
+    const int dir_fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    return true;
+}
+
+bool IndexFile::read_header(size_t file_bytes) const {
+    const Header& h = header();
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion
+            || h.dim != (uint32_t) dim_ || h.header_crc != crc32c(0, &h, offsetof(Header, header_crc))) {
+        return false;
+    }
+    // Bound the counts first so the offset arithmetic below cannot overflow
+    const uint64_t n = h.sealed_count;
+    if (n > file_bytes / (dim_ * sizeof(float)) || h.graph_bytes > file_bytes) {
+        return false;
+    }
+    const bool layout_ok = h.vectors_offset == kHeaderBytes
+           && h.keys_offset >= h.vectors_offset + n * dim_ * sizeof(float)
+           && h.meta_index_offset >= h.keys_offset + n * sizeof(int64_t)
+           && h.meta_offset >= h.meta_index_offset + (n + 1) * sizeof(uint64_t)
+           && h.graph_offset >= h.meta_offset
+           && h.log_offset >= h.graph_offset + h.graph_bytes
+           && h.log_offset <= file_bytes
+           && h.keys_offset % 8 == 0 && h.meta_index_offset % 8 == 0
+           && h.log_offset % 8 == 0;
+    if (!layout_ok) {
+        return false;
+    }
+
+    // Metadata is served before verify() has checked the sealed part, so
+    // every row's slice must lie inside the blob
+    const auto* meta_index = reinterpret_cast<const uint64_t*>(base_ + h.meta_index_offset);
+    if (meta_index[0] != 0) {
+        return false;
+    }
+    for (uint64_t i = 0; i < n; ++i) {
+        if (meta_index[i + 1] < meta_index[i] || meta_index[i + 1] - meta_index[i] > UINT32_MAX) {
+            return false;
+        }
+    }
+    return meta_index[n] <= h.graph_offset - h.meta_offset;
+}
+
+// ===== Sealed part =====
+
+size_t IndexFile::sealed_count() const {
+    return header().sealed_count;
+}
+
+const float* IndexFile::sealed_vectors() const {
+    return vector_at(header().vectors_offset);
+}
+
+const int64_t* IndexFile::sealed_keys() const {
+    return reinterpret_cast<const int64_t*>(base_ + header().keys_offset);
+}
+
+uint64_t IndexFile::sealed_vector_offset(size_t row) const {
+    return header().vectors_offset + (uint64_t) row * dim_ * sizeof(float);
+}
+
+void IndexFile::sealed_metadata(size_t row, uint64_t* offset, uint32_t* bytes) const {
+    const Header& h = header();
+    const auto* index = reinterpret_cast<const uint64_t*>(base_ + h.meta_index_offset);
+    *offset = h.meta_offset + index[row];
+    *bytes = (uint32_t) (index[row + 1] - index[row]);
+}
+
+const uint8_t* IndexFile::graph(size_t* bytes) const {
+    const Header& h = header();
+    *bytes = h.graph_bytes;
+    return h.graph_bytes > 0 ? base_ + h.graph_offset : nullptr;
+}
+
+// ===== Append log =====
+
+void IndexFile::replay(const std::function<void(const Record&)>& visit) {
+    uint64_t pos = log_begin_;
+    bool torn = false;
+    while (pos + sizeof(LogRecord) <= mapped_bytes_) {
+        LogRecord rec;
+        std::memcpy(&rec, base_ + pos, sizeof(rec));
+        if (rec.type == RECORD_END) {
+            break;
+        }
+        const size_t bytes = record_bytes(rec.floats, rec.meta_bytes);
+        if (rec.type > RECORD_CLEAR || (rec.floats != 0 && rec.floats != (uint32_t) dim_)
+                || (rec.type == RECORD_INSERT) != (rec.floats != 0)
+                || pos + bytes > mapped_bytes_) {
+            torn = true;
+            break;
+        }
+        const uint32_t stored_crc = rec.crc;
+        rec.crc = 0;
+        uint32_t crc = crc32c(0, &rec, sizeof(rec));
+        crc = crc32c(crc, base_ + pos + sizeof(rec), bytes - sizeof(rec));
+        if (crc != stored_crc) {
+            torn = true;
+            break;
+        }
+
+        Record record {};
+        record.type = (RecordType) rec.type;
+        record.key = rec.key;
+        record.vector_offset = rec.floats > 0 ? pos + sizeof(rec) : 0;
+        record.meta_offset = pos + sizeof(rec) + (uint64_t) rec.floats * sizeof(float);
+        record.meta_bytes = rec.meta_bytes;
+        visit(record);
+        pos += bytes;
+    }
+
+    log_end_ = pos;
+    if (torn) {
+        // Drop the damaged tail so later appends cannot revive stale records behind it
+        LOGE("⚠️ Index file %s: damaged log record at offset %llu, dropping the tail",
+             path_.c_str(), (unsigned long long) pos);
+        std::memset(base_ + pos, 0, mapped_bytes_ - pos);
+    }
+}
+
+bool IndexFile::append_insert(int64_t key, const float* normalized, const uint8_t* meta, uint32_t meta_bytes,
+                              uint64_t* vector_offset, uint64_t* meta_offset) {
+    return append(RECORD_INSERT, key, normalized, meta, meta_bytes, vector_offset, meta_offset);
+}
+
+bool IndexFile::append_remove(int64_t key) {
+    return append(RECORD_REMOVE, key, nullptr, nullptr, 0, nullptr, nullptr);
+}
+
+bool IndexFile::append_metadata(int64_t key, const uint8_t* meta, uint32_t meta_bytes, uint64_t* meta_offset) {
+    return append(RECORD_METADATA, key, nullptr, meta, meta_bytes, nullptr, meta_offset);
+}
+
+bool IndexFile::append_clear() {
+    return append(RECORD_CLEAR, 0, nullptr, nullptr, 0, nullptr, nullptr);
+}
+
+size_t IndexFile::log_bytes() const {
+    return log_end_ - log_begin_;
+}
+
+bool IndexFile::append(RecordType type, int64_t key, const float* vector, const uint8_t* meta,
+                       uint32_t meta_bytes, uint64_t* vector_offset, uint64_t* meta_offset) {
+    const uint32_t floats = vector != nullptr ? (uint32_t) dim_ : 0;
+    const size_t bytes = record_bytes(floats, meta_bytes);
+    if (!reserve(log_end_ + bytes)) {
+        return false;
+    }
+
+    uint8_t* p = base_ + log_end_;
+    uint8_t* payload = p + sizeof(LogRecord);
+    if (floats > 0) {
+        std::memcpy(payload, vector, sizeof(float) * floats);
+    }
+    if (meta_bytes > 0) {
+        std::memcpy(payload + sizeof(float) * floats, meta, meta_bytes);
+    }
+
+    LogRecord rec { type, meta_bytes, key, 0, floats };
+    uint32_t crc = crc32c(0, &rec, sizeof(rec));
+    rec.crc = crc32c(crc, payload, bytes - sizeof(rec));
+    std::memcpy(p, &rec, sizeof(rec));
+
+    if (vector_offset != nullptr) {
+        *vector_offset = log_end_ + sizeof(LogRecord);
+    }
+    if (meta_offset != nullptr) {
+        *meta_offset = log_end_ + sizeof(LogRecord) + sizeof(float) * floats;
+    }
+    log_end_ += bytes;
+    return true;
+}
+
+// ===== Mapping =====
+
+bool IndexFile::reserve(size_t bytes) {
+    // Keep at least one zeroed record header past the end so replay stops there
+    const size_t needed = bytes + sizeof(LogRecord);
+    if (needed <= mapped_bytes_) {
+        return true;
+    }
+    const size_t grown = needed + std::max(kMinGrowBytes, (size_t) log_bytes());
+    if (ftruncate(fd_, (off_t) grown) != 0 || !map(grown)) {
+        LOGE("❌ Index file %s could not grow to %zu bytes: %s", path_.c_str(), grown, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool IndexFile::map(size_t bytes) {
+    void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    if (base_ != nullptr) {
+        munmap(base_, mapped_bytes_);
+    }
+    base_ = static_cast<uint8_t*>(mapping);
+    mapped_bytes_ = bytes;
+    return true;
+}
+
+bool IndexFile::sync() {
+    return base_ == nullptr || msync(base_, mapped_bytes_, MS_SYNC) == 0;
+}
+
+bool IndexFile::verify() const {
+    // Reads through its own mapping of the immutable sealed part, so it can
+    // run while appends grow and remap the file
+    Header h;
+    if (pread(fd_, &h, sizeof(h), 0) != (ssize_t) sizeof(h)) {
+        return false;
+    }
+    void* mapping = mmap(nullptr, h.log_offset, PROT_READ, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    madvise(mapping, h.log_offset, MADV_SEQUENTIAL);
+    const auto* base = static_cast<const uint8_t*>(mapping);
+    const uint32_t crc = crc32c(0, base + h.vectors_offset, h.log_offset - h.vectors_offset);
+    munmap(mapping, h.log_offset);
+
+    if (crc != h.sealed_crc) {
+        LOGE("❌ Index file %s: sealed checksum mismatch", path_.c_str());
+        return false;
+    }
+    return true;
+}
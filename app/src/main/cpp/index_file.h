@@ -0,0 +1,163 @@
+/**
+ * index_file.h - On-disk format of the persistent vector index
+ *
+ * One file per index, mapped with mmap and read in place (no parsing):
+ *
+ *   [header page]   magic, version, dim, section offsets, CRC-32C checksums
+ *   [sealed part]   written by compaction, immutable afterwards:
+ *                     vectors       sealed_count * dim normalized floats
+ *                     keys          sealed_count int64
+ *                     meta offsets  sealed_count + 1 uint64 into the blob
+ *                     meta blob     opaque per-key metadata
+ *                     graph         serialized HNSW graph (optional)
+ *   [append log]    records written since the last compaction:
+ *                     INSERT (key, vector, metadata), REMOVE, METADATA, CLEAR
+ *
+ * Every log record carries its own checksum. On open the log is replayed
+ * up to the first bad or empty record, so a torn write at the tail loses
+ * only that record. The sealed part has one checksum, checked by verify()
+ * rather than on open so a large file is queryable before it is read; its
+ * section offsets and per-row metadata bounds are checked on open, so a
+ * damaged file is never read out of bounds meanwhile.
+ *
+ * Compaction writes a new file next to the old one and renames it over it.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class IndexFile {
+public:
+    static constexpr uint32_t kVersion = 1;
+
+    enum RecordType : uint32_t {
+        RECORD_END = 0,       // zero-filled space after the last record
+        RECORD_INSERT = 1,
+        RECORD_REMOVE = 2,
+        RECORD_METADATA = 3,
+        RECORD_CLEAR = 4,
+    };
+
+    /**
+     * A log record as seen by replay(). Offsets are file offsets, valid for
+     * vector_at() / bytes_at() until the file is replaced by compaction.
+     */
+    struct Record {
+        RecordType type;
+        int64_t key;
+        uint64_t vector_offset;   // INSERT only
+        uint64_t meta_offset;     // INSERT / METADATA
+        uint32_t meta_bytes;
+    };
+
+    /**
+     * A row to write into the sealed part of a new file.
+     */
+    struct Row {
+        int64_t key;
+        const float* vector;      // normalized, dim floats
+        const uint8_t* meta;
+        uint32_t meta_bytes;
+    };
+
+    ~IndexFile();
+
+    IndexFile(const IndexFile&) = delete;
+    IndexFile& operator=(const IndexFile&) = delete;
+
+    /**
+     * Open `path`, creating an empty index when it is missing, unreadable,
+     * from another version or for another dimension.
+     * @return nullptr only if the file cannot be created or mapped
+     */
+    static std::unique_ptr<IndexFile> open(const std::string& path, int dim);
+
+    /**
+     * Write a new file holding `rows` (and `graph`, if not empty) in its
+     * sealed part and an empty log, then atomically rename it to `path`.
+     */
+    static bool write(const std::string& path, int dim, const std::vector<Row>& rows,
+                      const std::vector<uint8_t>& graph);
+
+    // ===== Sealed part =====
+
+    size_t sealed_count() const;
+    const float* sealed_vectors() const;
+    const int64_t* sealed_keys() const;
+    uint64_t sealed_vector_offset(size_t row) const;
+    void sealed_metadata(size_t row, uint64_t* offset, uint32_t* bytes) const;
+    const uint8_t* graph(size_t* bytes) const;
+
+    // ===== Append log =====
+
+    /**
+     * Call `visit` for each valid log record in order. Called once after
+     * open(); a torn tail is cut off and zeroed.
+     */
+    void replay(const std::function<void(const Record&)>& visit);
+
+    /**
+     * Append an INSERT record.
+     * @return the file offsets of the stored vector and metadata, or false
+     *         if the file could not grow
+     */
+    bool append_insert(int64_t key, const float* normalized, const uint8_t* meta, uint32_t meta_bytes,
+                       uint64_t* vector_offset, uint64_t* meta_offset);
+    bool append_remove(int64_t key);
+    bool append_metadata(int64_t key, const uint8_t* meta, uint32_t meta_bytes, uint64_t* meta_offset);
+    bool append_clear();
+
+    /** Bytes of log records written since the last compaction */
+    size_t log_bytes() const;
+
+    // ===== Access =====
+
+    const float* vector_at(uint64_t offset) const {
+        return reinterpret_cast<const float*>(base_ + offset);
+    }
+    const uint8_t* bytes_at(uint64_t offset) const { return base_ + offset; }
+
+    /** Flush written pages to storage (msync). */
+    bool sync();
+
+    /**
+     * Check the sealed part against its checksum. Reads the whole part;
+     * safe to call while another thread appends.
+     */
+    bool verify() const;
+
+    int dim() const { return dim_; }
+    const std::string& path() const { return path_; }
+
+private:
+    struct Header;
+
+    IndexFile(const std::string& path, int dim, int fd);
+
+    const Header& header() const { return *reinterpret_cast<const Header*>(base_); }
+
+    bool map(size_t bytes);
+    bool reserve(size_t bytes);
+    bool append(RecordType type, int64_t key, const float* vector, const uint8_t* meta,
+                uint32_t meta_bytes, uint64_t* vector_offset, uint64_t* meta_offset);
+    bool read_header(size_t file_bytes) const;
+
+    const std::string path_;
+    const int dim_;
+    int fd_ = -1;
+    uint8_t* base_ = nullptr;
+    size_t mapped_bytes_ = 0;
+    uint64_t log_begin_ = 0;
+    uint64_t log_end_ = 0;
+};
+
+/**
+ * CRC-32C (Castagnoli) of `bytes` bytes, continuing from `crc`.
+ */
+uint32_t crc32c(uint32_t crc, const void* data, size_t bytes);
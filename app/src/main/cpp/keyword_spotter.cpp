@@ -0,0 +1,340 @@
+/**
+ * keyword_spotter.cpp - Template-matching wake word spotter
+ *
+ * See keyword_spotter.h.
+ */
+
+#include "keyword_spotter.h"
+#include "audio_dsp.h"
+#include "voice_activity.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <complex>
+
+static constexpr int kFrameSamples = 400;    // 25 ms
+static constexpr int kHopSamples = 160;      // 10 ms
+static constexpr int kFftSize = 512;
+static constexpr int kBins = kFftSize / 2 + 1;
+static constexpr int kMelBands = 26;
+static constexpr float kMelLowHz = 20.0f;
+static constexpr float kMelHighHz = 7600.0f;
+static constexpr float kPreEmphasis = 0.97f;
+
+// Running cepstral mean: about one second of memory
+static constexpr float kCmnRate = 0.01f;
+
+// Distance accepted with a single template (no calibration possible)
+static constexpr float kDefaultThreshold = 4.5f;
+
+// Calibrated threshold: the largest template-to-template distance plus margin
+static constexpr float kCalibrationMargin = 1.2f;
+
+// A match may be spoken at half to double the template's speed
+static constexpr float kMinStretch = 0.5f;
+static constexpr float kMaxStretch = 2.0f;
+
+// Frames ignored after a detection (1 s)
+static constexpr int kRefractoryFrames = 100;
+
+// Padding kept around enrolled speech
+static constexpr int kTemplatePaddingMs = 50;
+
+static float hz_to_mel(float hz) { return 2595.0f * log10f(1.0f + hz / 700.0f); }
+static float mel_to_hz(float mel) { return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f); }
+
+/** In-place radix-2 FFT; size must be a power of two. */
+static void fft(std::complex<float>* x, int n) {
+    for (int i = 1, j = 0; i < n; ++i) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(x[i], x[j]);
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        const float angle = -2.0f * (float) M_PI / len;
+        const std::complex<float> step(cosf(angle), sinf(angle));
+        for (int i = 0; i < n; i += len) {
+            std::complex<float> w(1.0f, 0.0f);
+            for (int k = 0; k < len / 2; ++k) {
+                std::complex<float> u = x[i + k];
+                std::complex<float> v = x[i + k + len / 2] * w;
+                x[i + k] = u + v;
+                x[i + k + len / 2] = u - v;
+                w *= step;
+            }
+        }
+    }
+}
+
+KeywordSpotter::KeywordSpotter() {
+    window_.resize(kFrameSamples);
+    for (int i = 0; i < kFrameSamples; ++i) {
+        window_[i] = 0.54f - 0.46f * cosf(2.0f * (float) M_PI * i / (kFrameSamples - 1));
+    }
+
+    // Triangular mel filters over the power spectrum
+    mel_weights_.assign((size_t) kMelBands * kBins, 0.0f);
+    const float mel_low = hz_to_mel(kMelLowHz);
+    const float mel_high = hz_to_mel(kMelHighHz);
+    float edges[kMelBands + 2];
+    for (int b = 0; b < kMelBands + 2; ++b) {
+        edges[b] = mel_to_hz(mel_low + (mel_high - mel_low) * b / (kMelBands + 1)) * kFftSize / kSampleRate;
+    }
+    for (int b = 0; b < kMelBands; ++b) {
+        for (int k = 0; k < kBins; ++k) {
+            float w = 0.0f;
+            if (k > edges[b] && k <= edges[b + 1]) {
+                w = (k - edges[b]) / (edges[b + 1] - edges[b]);
+            } else if (k > edges[b + 1] && k < edges[b + 2]) {
+                w = (edges[b + 2] - k) / (edges[b + 2] - edges[b + 1]);
+            }
+            mel_weights_[(size_t) b * kBins + k] = w;
+        }
+    }
+
+    // Orthonormal DCT-II
+    dct_.resize((size_t) kNumCoeffs * kMelBands);
+    for (int c = 0; c < kNumCoeffs; ++c) {
+        const float scale = sqrtf((c == 0 ? 1.0f : 2.0f) / kMelBands);
+        for (int b = 0; b < kMelBands; ++b) {
+            dct_[(size_t) c * kMelBands + b] = scale * cosf((float) M_PI * c * (b + 0.5f) / kMelBands);
+        }
+    }
+
+    reset();
+}
+
+void KeywordSpotter::compute_frame(const float* samples, float* out) {
+    std::complex<float> spectrum[kFftSize];
+    for (int i = 0; i < kFrameSamples; ++i) {
+        float prev = i > 0 ? samples[i - 1] : samples[0];
+        spectrum[i] = (samples[i] - kPreEmphasis * prev) * window_[i];
+    }
+    for (int i = kFrameSamples; i < kFftSize; ++i) {
+        spectrum[i] = 0.0f;
+    }
+    fft(spectrum, kFftSize);
+
+    float power[kBins];
+    for (int k = 0; k < kBins; ++k) {
+        power[k] = std::norm(spectrum[k]);
+    }
+
+    float log_mel[kMelBands];
+    for (int b = 0; b < kMelBands; ++b) {
+        const float* w = mel_weights_.data() + (size_t) b * kBins;
+        float energy = 0.0f;
+        for (int k = 0; k < kBins; ++k) {
+            energy += w[k] * power[k];
+        }
+        log_mel[b] = logf(energy + 1e-10f);
+    }
+
+    for (int c = 0; c < kNumCoeffs; ++c) {
+        const float* d = dct_.data() + (size_t) c * kMelBands;
+        float sum = 0.0f;
+        for (int b = 0; b < kMelBands; ++b) {
+            sum += d[b] * log_mel[b];
+        }
+        out[c] = sum;
+    }
+
+    // Running mean normalization, shared by enrollment and detection so both
+    // see the same channel compensation
+    if (!cmn_ready_) {
+        std::copy(out, out + kNumCoeffs, cmn_mean_);
+        cmn_ready_ = true;
+    }
+    for (int c = 0; c < kNumCoeffs; ++c) {
+        cmn_mean_[c] += kCmnRate * (out[c] - cmn_mean_[c]);
+        out[c] -= cmn_mean_[c];
+    }
+}
+
+float KeywordSpotter::distance(const float* a, const float* b) {
+    float sum = 0.0f;
+    for (int c = 0; c < kNumCoeffs; ++c) {
+        float d = a[c] - b[c];
+        sum += d * d;
+    }
+    return sqrtf(sum);
+}
+
+bool KeywordSpotter::add_template(const int16_t* pcm, size_t n, int sample_rate) {
+    if (n == 0 || sample_rate <= 0) return false;
+    std::vector<float> pcm_float(n);
+    dsp::pcm16_to_float(pcm, n, pcm_float.data());
+    std::vector<float> audio = dsp::Resampler::convert(pcm_float.data(), n, sample_rate, kSampleRate);
+
+    VadParams vad;
+    vad.padding_ms = kTemplatePaddingMs;
+    std::vector<VadSegment> speech = VoiceActivityDetector::detect(audio.data(), audio.size(), vad);
+    if (speech.empty()) {
+        return false;
+    }
+    const int64_t first = (int64_t) speech.front().start / kHopSamples;
+    const int64_t last = (int64_t) speech.back().end / kHopSamples;
+
+    // Run the whole clip through the front end (leading silence included,
+    // as in live audio) and keep the frames covering speech
+    Template t;
+    cmn_ready_ = false;
+    float frame[kNumCoeffs];
+    for (size_t pos = 0, index = 0; pos + kFrameSamples <= audio.size(); pos += kHopSamples, ++index) {
+        compute_frame(audio.data() + pos, frame);
+        if ((int64_t) index >= first && (int64_t) index < last) {
+            t.features.insert(t.features.end(), frame, frame + kNumCoeffs);
+        }
+    }
+    cmn_ready_ = false;
+
+    t.frames = (int) (t.features.size() / kNumCoeffs);
+    if (t.frames < 10) {
+        return false;
+    }
+    t.cost.assign(t.frames, FLT_MAX);
+    t.weight.assign(t.frames, 1.0f);
+    t.start.assign(t.frames, 0);
+    templates_.push_back(std::move(t));
+    threshold_ = 0.0f;   // recalibrated on next use
+    return true;
+}
+
+float KeywordSpotter::align(const Template& a, const Template& b) {
+    // Full DTW (both ends anchored), symmetric step weights
+    const int n = a.frames, m = b.frames;
+    std::vector<float> prev(m, FLT_MAX), cur(m, FLT_MAX);
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < m; ++j) {
+            float d = distance(a.features.data() + (size_t) i * kNumCoeffs, b.features.data() + (size_t) j * kNumCoeffs);
+            float best;
+            if (i == 0 && j == 0) {
+                best = d;
+            } else {
+                best = FLT_MAX;
+                if (i > 0 && j > 0 && prev[j - 1] < FLT_MAX) best = std::min(best, prev[j - 1] + 2.0f * d);
+                if (i > 0 && prev[j] < FLT_MAX) best = std::min(best, prev[j] + d);
+                if (j > 0 && cur[j - 1] < FLT_MAX) best = std::min(best, cur[j - 1] + d);
+            }
+            cur[j] = best;
+        }
+        std::swap(prev, cur);
+    }
+    return prev[m - 1] / (n + m);
+}
+
+float KeywordSpotter::calibrate() {
+    if (templates_.size() < 2) {
+        threshold_ = kDefaultThreshold;
+        return threshold_;
+    }
+    float worst = 0.0f;
+    for (size_t i = 0; i < templates_.size(); ++i) {
+        for (size_t j = i + 1; j < templates_.size(); ++j) {
+            worst = std::max(worst, align(templates_[i], templates_[j]));
+        }
+    }
+    threshold_ = worst * kCalibrationMargin;
+    return threshold_;
+}
+
+bool KeywordSpotter::process(const int16_t* pcm, size_t n) {
+    if (templates_.empty()) return false;
+    if (threshold_ <= 0.0f) calibrate();
+
+    const size_t old_size = pending_.size();
+    pending_.resize(old_size + n);
+    dsp::pcm16_to_float(pcm, n, pending_.data() + old_size);
+
+    bool detected = false;
+    float frame[kNumCoeffs];
+    size_t pos = 0;
+    for (; pos + kFrameSamples <= pending_.size(); pos += kHopSamples) {
+        compute_frame(pending_.data() + pos, frame);
+        match_frame(frame);
+        ++frame_index_;
+
+        if (frame_index_ >= refractory_until_) {
+            const float limit = threshold_ * sensitivity_;
+            for (const Template& t : templates_) {
+                const float cost = t.cost[t.frames - 1];
+                if (cost == FLT_MAX) continue;
+                const float score = cost / t.weight[t.frames - 1];
+                const int64_t span = frame_index_ - t.start[t.frames - 1];
+                if (span < t.frames * kMinStretch || span > t.frames * kMaxStretch) continue;
+                best_score_ = std::min(best_score_, score);
+                if (score < limit) {
+                    detected = true;
+                }
+            }
+            if (detected) {
+                refractory_until_ = frame_index_ + kRefractoryFrames;
+                clear_matches();
+            }
+        }
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + pos);
+    return detected;
+}
+
+void KeywordSpotter::match_frame(const float* feature) {
+    // Subsequence DTW: a path may start at any input frame (row 0) and each
+    // row picks the predecessor with the lowest average cost
+    for (Template& t : templates_) {
+        float diag_cost = FLT_MAX, diag_weight = 1.0f;
+        int64_t diag_start = 0;
+        for (int i = 0; i < t.frames; ++i) {
+            const float d = distance(t.features.data() + (size_t) i * kNumCoeffs, feature);
+            const float old_cost = t.cost[i], old_weight = t.weight[i];
+            const int64_t old_start = t.start[i];
+
+            float cost = d, weight = 1.0f;
+            int64_t start = frame_index_;
+            if (i > 0) {
+                cost = FLT_MAX;
+                auto consider = [&](float c, float w, int64_t s, float step) {
+                    if (c == FLT_MAX) return;
+                    float nc = c + step * d, nw = w + step;
+                    if (cost == FLT_MAX || nc / nw < cost / weight) {
+                        cost = nc;
+                        weight = nw;
+                        start = s;
+                    }
+                };
+                consider(diag_cost, diag_weight, diag_start, 2.0f);
+                consider(t.cost[i - 1], t.weight[i - 1], t.start[i - 1], 1.0f);   // already this frame
+                consider(old_cost, old_weight, old_start, 1.0f);
+            }
+
+            diag_cost = old_cost;
+            diag_weight = old_weight;
+            diag_start = old_start;
+            t.cost[i] = cost;
+            t.weight[i] = weight;
+            t.start[i] = start;
+        }
+    }
+}
+
+void KeywordSpotter::clear_matches() {
+    for (Template& t : templates_) {
+        std::fill(t.cost.begin(), t.cost.end(), FLT_MAX);
+    }
+}
+
+float KeywordSpotter::take_best_score() {
+    float score = best_score_;
+    best_score_ = FLT_MAX;
+    return score;
+}
+
+void KeywordSpotter::reset() {
+    pending_.clear();
+    cmn_ready_ = false;
+    frame_index_ = 0;
+    refractory_until_ = 0;
+    best_score_ = FLT_MAX;
+    clear_matches();
+}
@@ -0,0 +1,90 @@
+/**
+ * keyword_spotter.h - Template-matching wake word spotter
+ *
+ * MFCC front end (25 ms windows every 10 ms, 26 mel bands, 13 cepstra with
+ * running mean normalization) and subsequence DTW against enrolled
+ * recordings of the wake phrase. Every 10 ms frame extends one DTW column
+ * per template, so the spotter costs a small FFT plus a few thousand
+ * multiply-adds per frame: cheap enough to run continuously, with Whisper
+ * started only after a detection.
+ *
+ * The detection threshold is calibrated from the distances between the
+ * templates themselves and can be scaled with set_sensitivity().
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class KeywordSpotter {
+public:
+    static constexpr int kSampleRate = 16000;
+    static constexpr int kNumCoeffs = 13;
+
+    KeywordSpotter();
+
+    /**
+     * Enroll one spoken example of the keyword (mono PCM at any rate,
+     * resampled to 16 kHz). Leading and trailing silence are trimmed.
+     * @return false if the clip holds no usable speech
+     */
+    bool add_template(const int16_t* pcm, size_t n, int sample_rate);
+
+    size_t template_count() const { return templates_.size(); }
+
+    /**
+     * Derive the detection threshold from the templates (or a default for a
+     * single template). Call after the last add_template().
+     * @return the threshold
+     */
+    float calibrate();
+
+    /** Scale the calibrated threshold: > 1 detects more readily, < 1 less. */
+    void set_sensitivity(float scale) { sensitivity_ = scale; }
+
+    /**
+     * Feed 16 kHz mono PCM.
+     * @return true if the keyword ended within this chunk
+     */
+    bool process(const int16_t* pcm, size_t n);
+
+    /** Best normalized DTW distance since the last call (lower is closer) */
+    float take_best_score();
+
+    /** Drop buffered audio and partial matches. */
+    void reset();
+
+private:
+    struct Template {
+        std::vector<float> features;   // frames * kNumCoeffs
+        int frames;
+        // DTW column for the most recent input frame: accumulated cost,
+        // path weight and start frame of the best path ending at each row
+        std::vector<float> cost;
+        std::vector<float> weight;
+        std::vector<int64_t> start;
+    };
+
+    void compute_frame(const float* samples, float* out);
+    void match_frame(const float* feature);
+    void clear_matches();
+    static float distance(const float* a, const float* b);
+    static float align(const Template& a, const Template& b);
+
+    std::vector<float> window_;        // Hamming
+    std::vector<float> mel_weights_;   // bands * (fft/2+1)
+    std::vector<float> dct_;           // kNumCoeffs * bands
+
+    std::vector<Template> templates_;
+    float threshold_ = 0.0f;
+    float sensitivity_ = 1.0f;
+
+    std::vector<float> pending_;       // samples not yet framed
+    float cmn_mean_[kNumCoeffs];
+    bool cmn_ready_ = false;
+    int64_t frame_index_ = 0;
+    int64_t refractory_until_ = 0;
+    float best_score_;
+};
@@ -0,0 +1,1331 @@
+/**
+ * llm_engine.cpp - Multi-session llama.cpp inference engine for AILive
+ *
+ * See llm_engine.h. Generation requests are queued for the scheduler thread,
+ * which owns all decoding: one llama_decode per step covers the next token of
+ * every running generation plus prompt chunks, instead of one call per token
+ * per session.
+ */
+
+#include "llm_engine.h"
+#include "session_state.h"
+#include "speculative.h"
+#include "utf8_util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <android/log.h>
+
+#define LOG_TAG "AILive-LLM"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// Handles of created sessions are (epoch << kHandleSlotBits) | slot, so a handle
+// kept by Kotlin across a model reload is rejected instead of hitting a new session.
+static constexpr int kHandleSlotBits = 4;
+static constexpr int kHandleSlotMask = (1 << kHandleSlotBits) - 1;
+static_assert(LlmEngine::kMaxSessions <= kHandleSlotMask, "session slots must fit the handle");
+
+static std::atomic<int> s_next_epoch{1};
+
+// Cached tokens after the pinned prefix that must match a new prompt for it
+// to count as continuing a session's shifted window
+static constexpr size_t kWindowMatchTokens = 8;
+
+/**
+ * A generation in flight, shared by the requesting thread and the scheduler.
+ * All fields are guarded by LlmEngine::mutex_.
+ */
+struct GenerationRequest {
+    InferenceSession* session = nullptr;
+    std::vector<llama_token> prompt;
+    int max_tokens = 0;
+
+    // Embeddings occupying prompt[embedding_offset, embedding_offset + n_pos)
+    std::shared_ptr<const PromptEmbedding> embedding;
+    size_t embedding_offset = 0;
+    bool embedding_done = false;
+
+    bool admitted = false;              // prefix reuse and sampler reset done
+    size_t n_prompt_done = 0;           // prompt tokens resident in the KV cache
+    llama_token pending = -1;           // sampled but not yet decoded
+    Speculation speculation = Speculation::Auto;
+    std::vector<DraftToken> drafts;     // drafted continuation of pending, decoded after it
+    int n_sampled = 0;
+
+    std::vector<llama_token> output;    // sampled tokens not yet taken by the requester
+    bool cancelled = false;
+    bool done = false;
+    bool prefill_failed = false;
+
+    // Position of this request in the batch being decoded
+    int batch_start = 0;
+    int batch_count = 0;
+};
+
+static llama_sampler* build_sampler_chain(const llama_model* model, const SamplingParams& params) {
+    llama_sampler_chain_params chain_params = llama_sampler_chain_default_params();
+    chain_params.no_perf = true;
+    llama_sampler* sampler = llama_sampler_chain_init(chain_params);
+
+    llama_sampler_chain_add(sampler, llama_sampler_init_penalties(
+            params.penalty_last_n, params.repeat_penalty, params.frequency_penalty, params.presence_penalty));
+
+    if (params.mirostat == 1) {
+        const llama_vocab* vocab = llama_model_get_vocab(model);
+        llama_sampler_chain_add(sampler, llama_sampler_init_temp(params.temperature));
+        llama_sampler_chain_add(sampler, llama_sampler_init_mirostat(
+                llama_vocab_n_tokens(vocab), params.seed, params.mirostat_tau, params.mirostat_eta, 100));
+    } else if (params.mirostat == 2) {
+        llama_sampler_chain_add(sampler, llama_sampler_init_temp(params.temperature));
+        llama_sampler_chain_add(sampler, llama_sampler_init_mirostat_v2(
+                params.seed, params.mirostat_tau, params.mirostat_eta));
+    } else {
+        llama_sampler_chain_add(sampler, llama_sampler_init_top_k(params.top_k));
+        llama_sampler_chain_add(sampler, llama_sampler_init_min_p(params.min_p, 1));
+        llama_sampler_chain_add(sampler, llama_sampler_init_top_p(params.top_p, 1));
+        llama_sampler_chain_add(sampler, llama_sampler_init_temp(params.temperature));
+        llama_sampler_chain_add(sampler, llama_sampler_init_dist(params.seed));
+    }
+    return sampler;
+}
+
+static int64_t elapsed_us(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+static bool load_progress(float progress, void* user_data) {
+    const auto* on_progress = static_cast<const std::function<bool(float)>*>(user_data);
+    return (*on_progress)(progress);
+}
+
+std::unique_ptr<LlmEngine> LlmEngine::load(const char* path, int n_ctx) {
+    LoadOptions options;
+    options.n_ctx = n_ctx;
+    return load(path, options);
+}
+
+std::unique_ptr<LlmEngine> LlmEngine::load(const char* path, const LoadOptions& options, LoadTimings* timings) {
+    std::unique_ptr<LlmEngine> engine(new LlmEngine());
+    LoadTimings local_timings;
+    LoadTimings& t = timings != nullptr ? *timings : local_timings;
+    t = LoadTimings();
+    const auto t_start = std::chrono::steady_clock::now();
+
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = 99; // Offload as much as possible
+    model_params.use_mlock = options.use_mlock;
+    if (options.on_progress) {
+        model_params.progress_callback = load_progress;
+        model_params.progress_callback_user_data = const_cast<std::function<bool(float)>*>(&options.on_progress);
+    }
+
+    engine->model_ = llama_model_load_from_file(path, model_params);
+    if (engine->model_ == nullptr) {
+        LOGE("Failed to load model from %s", path);
+        return nullptr;
+    }
+    engine->model_key_ = model_fingerprint(path, engine->model_);
+    t.model_us = elapsed_us(t_start);
+
+    // Size the context before allocating it
+    const auto t_context = std::chrono::steady_clock::now();
+    if (!plan_context(engine->model_, (int64_t) llama_model_size(engine->model_), options.n_ctx,
+                      options.memory_budget, engine->plan_)) {
+        return nullptr;
+    }
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_threads = 4;
+    ctx_params.n_seq_max = kMaxSessions;
+    ctx_params.kv_unified = true;             // sessions share the whole KV pool instead of n_ctx / n_seq_max each
+    apply_context_plan(engine->plan_, ctx_params);
+
+    engine->ctx_ = llama_init_from_model(engine->model_, ctx_params);
+    if (engine->ctx_ == nullptr) {
+        LOGE("Failed to create context (n_ctx %d, KV %s/%s)", engine->plan_.n_ctx,
+             kv_type_name(engine->plan_.type_k), kv_type_name(engine->plan_.type_v));
+        return nullptr;
+    }
+
+    // Shifting rewrites each cached key's single RoPE position; M-RoPE keeps several
+    const llama_rope_type rope_type = llama_model_rope_type(engine->model_);
+    engine->can_shift_ = llama_memory_can_shift(llama_get_memory(engine->ctx_))
+            && (rope_type == LLAMA_ROPE_TYPE_NORM || rope_type == LLAMA_ROPE_TYPE_NEOX);
+
+    engine->epoch_ = s_next_epoch.fetch_add(1) & 0x03FFFFFF;
+    if (engine->epoch_ == 0) {
+        engine->epoch_ = s_next_epoch.fetch_add(1) & 0x03FFFFFF;
+    }
+
+    const llama_vocab* vocab = llama_model_get_vocab(engine->model_);
+    engine->candidates_.resize(llama_vocab_n_tokens(vocab));
+    engine->batch_capacity_ = (int) llama_n_batch(engine->ctx_);
+    engine->batch_ = llama_batch_init(engine->batch_capacity_, 0, 1);
+
+    for (int i = 0; i < kMaxSessions; ++i) {
+        engine->sessions_[i].seq_id = i;
+    }
+    engine->sessions_[0].active = true;
+    t.context_us = elapsed_us(t_context);
+
+    if (options.warmup) {
+        const auto t_warmup = std::chrono::steady_clock::now();
+        if (!engine->warmup()) {
+            LOGE("Warm-up decode failed");  // not fatal: the first prompt pays instead
+        }
+        t.warmup_us = elapsed_us(t_warmup);
+    }
+
+    engine->scheduler_ = std::thread(&LlmEngine::scheduler_loop, engine.get());
+
+    t.total_us = elapsed_us(t_start);
+    LOGI("⏱️ Model load %.0f ms, context %.0f ms, warm-up %.0f ms%s",
+         t.model_us / 1000.0, t.context_us / 1000.0, t.warmup_us / 1000.0, options.use_mlock ? " (mlock)" : "");
+    return engine;
+}
+
+/**
+ * Decode one token and discard it, before the scheduler starts. With mmap
+ * the weights are paged in on first touch and the first graph is built
+ * lazily; doing both here keeps them out of the first user prompt.
+ */
+bool LlmEngine::warmup() {
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    llama_token token = llama_vocab_bos(vocab);
+    if (token == LLAMA_TOKEN_NULL) {
+        token = llama_vocab_eos(vocab);
+    }
+    if (token == LLAMA_TOKEN_NULL) {
+        token = 0;
+    }
+    batch_.token[0] = token;
+    batch_.pos[0] = 0;
+    batch_.n_seq_id[0] = 1;
+    batch_.seq_id[0][0] = sessions_[0].seq_id;
+    batch_.logits[0] = 1;
+    batch_.n_tokens = 1;
+
+    const int ret = llama_decode(ctx_, batch_);
+    llama_synchronize(ctx_);
+    llama_memory_clear(llama_get_memory(ctx_), true);
+    return ret == 0;
+}
+
+LlmEngine::~LlmEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    if (scheduler_.joinable()) {
+        scheduler_.join();
+    }
+
+    for (auto& session : sessions_) {
+        if (session.sampler != nullptr) {
+            llama_sampler_free(session.sampler);
+            session.sampler = nullptr;
+        }
+    }
+    if (batch_capacity_ > 0) {
+        llama_batch_free(batch_);
+    }
+    if (ctx_ != nullptr) {
+        llama_free(ctx_);
+    }
+    if (model_ != nullptr) {
+        llama_model_free(model_);
+    }
+}
+
+InferenceSession* LlmEngine::session_for_handle(int handle) {
+    if (handle == kDefaultSession) {
+        return &sessions_[0];
+    }
+    if (handle < 0 || (handle >> kHandleSlotBits) != epoch_) {
+        return nullptr;
+    }
+    const int slot = handle & kHandleSlotMask;
+    if (slot < 1 || slot >= kMaxSessions || !sessions_[slot].active) {
+        return nullptr;
+    }
+    return &sessions_[slot];
+}
+
+int LlmEngine::create_session() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int slot = 1; slot < kMaxSessions; ++slot) {
+        InferenceSession& session = sessions_[slot];
+        if (!session.active) {
+            session.active = true;
+            session.busy = false;
+            session.cached_tokens.clear();
+            session.pinned.clear();
+            session.n_discarded = 0;
+            session.last_used = ++use_counter_;
+            const int handle = (epoch_ << kHandleSlotBits) | slot;
+            LOGI("Created session %d (seq %d)", handle, session.seq_id);
+            return handle;
+        }
+    }
+    LOGE("Cannot create session: all %d slots in use", kMaxSessions - 1);
+    return -1;
+}
+
+bool LlmEngine::destroy_session(int handle) {
+    std::lock_guard<std::mutex> ctx_lock(ctx_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (handle == kDefaultSession) {
+        LOGE("The default session cannot be destroyed");
+        return false;
+    }
+    InferenceSession* session = session_for_handle(handle);
+    if (session == nullptr) {
+        return false;
+    }
+    if (session->busy) {
+        LOGE("Cannot destroy session %d while it is generating", handle);
+        return false;
+    }
+    reset_session_cache(*session);
+    if (draft_ != nullptr) {
+        draft_->forget(session->seq_id);
+    }
+    if (session->sampler != nullptr) {
+        llama_sampler_free(session->sampler);
+        session->sampler = nullptr;
+    }
+    session->sampler_version = 0;
+    session->pinned.clear();
+    session->active = false;
+    LOGI("Destroyed session %d (seq %d)", handle, session->seq_id);
+    return true;
+}
+
+bool LlmEngine::is_session_active(int handle) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return session_for_handle(handle) != nullptr;
+}
+
+bool LlmEngine::snapshot_session(int handle, SessionSnapshot& snapshot) {
+    // The KV cache and cached_tokens only change in the scheduler, under ctx_mutex_
+    std::lock_guard<std::mutex> ctx_lock(ctx_mutex_);
+    llama_seq_id seq_id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        InferenceSession* session = session_for_handle(handle);
+        if (session == nullptr || session->busy || session->cached_tokens.empty()) {
+            return false;
+        }
+        snapshot.tokens = session->cached_tokens;
+        snapshot.n_discarded = session->n_discarded;
+        seq_id = session->seq_id;
+    }
+
+    const size_t size = llama_state_seq_get_size(ctx_, seq_id);
+    snapshot.state.resize(size);
+    if (llama_state_seq_get_data(ctx_, snapshot.state.data(), size, seq_id) != size) {
+        LOGE("Failed to copy KV state of session %d", handle);
+        return false;
+    }
+    snapshot.model_key = model_key_;
+    snapshot.n_ctx = llama_n_ctx(ctx_);
+    snapshot.type_k = plan_.type_k;
+    snapshot.type_v = plan_.type_v;
+    return true;
+}
+
+int LlmEngine::restore_session(int handle, const SessionSnapshot& snapshot) {
+    std::lock_guard<std::mutex> ctx_lock(ctx_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    InferenceSession* session = session_for_handle(handle);
+    if (session == nullptr || session->busy) {
+        LOGE("Cannot restore session %d: invalid or generating", handle);
+        return -1;
+    }
+    if (snapshot.model_key != model_key_ || snapshot.n_ctx != llama_n_ctx(ctx_)
+        || snapshot.type_k != plan_.type_k || snapshot.type_v != plan_.type_v) {
+        LOGE("Snapshot belongs to another model, context size or KV cache type");
+        return -1;
+    }
+
+    reset_session_cache(*session);
+    if (llama_state_seq_set_data(ctx_, snapshot.state.data(), snapshot.state.size(), session->seq_id) == 0) {
+        // Typically no room left in the shared KV pool
+        LOGE("Failed to restore KV state of session %d", handle);
+        reset_session_cache(*session);
+        return -1;
+    }
+    session->cached_tokens = snapshot.tokens;
+    session->n_discarded = (size_t) snapshot.n_discarded;
+    session->last_used = ++use_counter_;
+    LOGI("Restored session %d: %zu tokens, %zu KB of KV state", handle, snapshot.tokens.size(),
+         snapshot.state.size() / 1024);
+    return (int) snapshot.tokens.size();
+}
+
+bool LlmEngine::set_pinned_prefix(int handle, const std::string& prefix) {
+    std::vector<llama_token> tokens;
+    if (!prefix.empty() && !tokenize(prefix, tokens)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    InferenceSession* session = session_for_handle(handle);
+    if (session == nullptr) {
+        return false;
+    }
+    if (session->pinned != tokens) {
+        LOGI("Pinned %zu prompt tokens (seq %d)", tokens.size(), session->seq_id);
+        session->pinned.swap(tokens);
+    }
+    return true;
+}
+
+void LlmEngine::set_sampling_params(const SamplingParams& params) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sampling_params_ = params;
+    sampling_version_++;
+}
+
+PrefixCacheStats LlmEngine::prefix_cache_stats() const {
+    PrefixCacheStats stats;
+    stats.hits = prefix_hits_.load();
+    stats.misses = prefix_misses_.load();
+    stats.reused_tokens = prefix_reused_tokens_.load();
+    stats.prefilled_tokens = prefix_prefilled_tokens_.load();
+    return stats;
+}
+
+SchedulerStats LlmEngine::scheduler_stats() const {
+    SchedulerStats stats;
+    stats.decode_calls = decode_calls_.load();
+    stats.decoded_tokens = decoded_tokens_.load();
+    stats.sampled_tokens = sampled_tokens_.load();
+    stats.max_batch_sequences = max_batch_sequences_.load();
+    stats.decode_time_us = decode_time_us_.load();
+    return stats;
+}
+
+ContextWindowStats LlmEngine::context_stats() const {
+    ContextWindowStats stats;
+    stats.shifts = window_shifts_.load();
+    stats.evicted_tokens = evicted_tokens_.load();
+    stats.overflows = window_overflows_.load();
+    return stats;
+}
+
+SpeculativeStats LlmEngine::speculative_stats() const {
+    SpeculativeStats stats;
+    stats.steps = speculative_steps_.load();
+    stats.drafted_tokens = drafted_tokens_.load();
+    stats.accepted_tokens = accepted_tokens_.load();
+    stats.draft_time_us = draft_time_us_.load();
+    stats.lookup_steps = lookup_steps_.load();
+    stats.lookup_drafted_tokens = lookup_drafted_tokens_.load();
+    stats.lookup_accepted_tokens = lookup_accepted_tokens_.load();
+    return stats;
+}
+
+bool LlmEngine::load_draft(const char* path, int n_draft) {
+    if (n_draft <= 0) {
+        free_draft();
+        return true;
+    }
+    if (llama_model_is_recurrent(model_)) {
+        LOGE("Speculative decoding needs a KV cache that can drop rejected drafts");
+        return false;
+    }
+    // Loaded without the context lock; the scheduler keeps running meanwhile
+    std::unique_ptr<DraftModel> draft = DraftModel::load(path, model_, (int) llama_n_ctx(ctx_), kMaxSessions);
+    if (draft == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> ctx_lock(ctx_mutex_);
+    draft_.swap(draft);
+    n_draft_ = std::min(n_draft, kMaxDraftTokens);
+    LOGI("Speculative decoding on: up to %d drafted tokens per step", n_draft_);
+    return true;
+}
+
+void LlmEngine::free_draft() {
+    std::unique_ptr<DraftModel> draft;
+    {
+        std::lock_guard<std::mutex> ctx_lock(ctx_mutex_);
+        draft.swap(draft_);
+        n_draft_ = 0;
+    }
+    if (draft != nullptr) {
+        LOGI("Speculative decoding off, draft model freed");
+    }
+}
+
+bool LlmEngine::tokenize(const std::string& text, std::vector<llama_token>& out,
+                         bool add_special, bool parse_special) const {
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    out.resize(text.length() + 2);
+    int n_tokens = llama_tokenize(vocab, text.c_str(), text.length(), out.data(), out.size(), add_special, parse_special);
+    if (n_tokens < 0) {
+        out.resize(-n_tokens);
+        n_tokens = llama_tokenize(vocab, text.c_str(), text.length(), out.data(), out.size(), add_special, parse_special);
+    }
+    if (n_tokens <= 0) {
+        out.clear();
+        return false;
+    }
+    out.resize(n_tokens);
+    return true;
+}
+
+/**
+ * Drop the session's sequence from the KV cache and forget its cached tokens.
+ */
+void LlmEngine::reset_session_cache(InferenceSession& session) {
+    llama_memory_seq_rm(llama_get_memory(ctx_), session.seq_id, -1, -1);
+    session.cached_tokens.clear();
+    session.n_discarded = 0;
+}
+
+/**
+ * Number of leading prompt tokens the session keeps in its window.
+ */
+size_t LlmEngine::pinned_length(const InferenceSession& session, const std::vector<llama_token>& prompt) const {
+    if (session.pinned.empty()) {
+        const llama_vocab* vocab = llama_model_get_vocab(model_);
+        return !prompt.empty() && llama_vocab_get_add_bos(vocab) && prompt[0] == llama_vocab_bos(vocab) ? 1 : 0;
+    }
+    // The pinned text alone may tokenize differently where the prompt goes on
+    const size_t n_max = std::min(session.pinned.size(), prompt.size());
+    size_t n = 0;
+    while (n < n_max && session.pinned[n] == prompt[n]) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Drop cached tokens [n_keep, n_keep + n_discard) of the session from the KV
+ * cache and shift the later ones down, so positions stay equal to indices in
+ * cached_tokens (caller holds both locks). Returns false if positions could
+ * not be shifted; everything after the pinned prefix is dropped instead.
+ */
+bool LlmEngine::evict(InferenceSession& session, size_t n_keep, size_t n_discard) {
+    llama_memory_t mem = llama_get_memory(ctx_);
+    std::vector<llama_token>& cached = session.cached_tokens;
+    const llama_pos p0 = (llama_pos) n_keep;
+    const llama_pos p1 = (llama_pos) (n_keep + n_discard);
+    if (can_shift_ && llama_memory_seq_rm(mem, session.seq_id, p0, p1)) {
+        llama_memory_seq_add(mem, session.seq_id, p1, -1, -(llama_pos) n_discard);
+        cached.erase(cached.begin() + n_keep, cached.begin() + n_keep + n_discard);
+        return true;
+    }
+    if (llama_memory_seq_rm(mem, session.seq_id, p0, -1)) {
+        cached.resize(n_keep);
+    } else {
+        reset_session_cache(session);
+    }
+    return false;
+}
+
+/**
+ * Fit the request's prompt into the context window with room left for the
+ * start of the reply (caller holds both locks).
+ *
+ * Once a conversation has outgrown the window, the session caches
+ * [pinned prefix][recent history] with n_discarded tokens evicted between
+ * them. A prompt that continues it gets the same span cut out, so it lines
+ * up with the cache and only its new turn is prefilled. If that is still too
+ * long, a further chunk of the oldest history is evicted, from the KV cache
+ * as well. Returns false if the prompt cannot fit at all.
+ */
+bool LlmEngine::fit_prompt(GenerationRequest& request) {
+    InferenceSession& session = *request.session;
+    std::vector<llama_token>& prompt = request.prompt;
+    const std::vector<llama_token>& cached = session.cached_tokens;
+    const size_t n_ctx = llama_n_ctx(ctx_);
+    const size_t n_reserve = std::min((size_t) std::max(request.max_tokens, 1), n_ctx / 4);
+    const size_t n_window = n_ctx - n_reserve;
+
+    // A pinned prefix filling most of the window would leave nothing to evict
+    const size_t n_keep = std::min(pinned_length(session, prompt), n_window / 2);
+    session.n_keep = n_keep;
+    if (prompt.size() <= n_window) {
+        session.n_discarded = 0;
+        return true;
+    }
+
+    // Does the prompt continue the cached window after the span evicted before?
+    size_t n_gap = 0;
+    bool continues = false;
+    const size_t n_tail = cached.size() > n_keep ? cached.size() - n_keep : 0;
+    if (n_tail > 0 && prompt.size() > n_keep + session.n_discarded
+            && std::equal(cached.begin(), cached.begin() + n_keep, prompt.begin())) {
+        const size_t n_check = std::min({n_tail, prompt.size() - n_keep - session.n_discarded, kWindowMatchTokens});
+        continues = std::equal(cached.begin() + n_keep, cached.begin() + n_keep + n_check,
+                               prompt.begin() + n_keep + session.n_discarded);
+        n_gap = continues ? session.n_discarded : 0;
+    }
+
+    // Evict in chunks of a quarter of the window, so only every few turns pay for it
+    size_t cut = n_keep + n_gap;
+    if (prompt.size() - n_gap > n_window) {
+        cut += std::max(prompt.size() - n_gap - n_window, (n_window - n_keep) / 4);
+        // Embeddings go whole or not at all
+        while (cut < prompt.size() && prompt[cut] < 0 && prompt[cut] == prompt[cut - 1]) {
+            cut++;
+        }
+    }
+    if (cut >= prompt.size() || (request.embedding != nullptr && cut > request.embedding_offset)) {
+        LOGE("Prompt of %zu tokens does not fit the %zu-token context window", prompt.size(), n_ctx);
+        return false;
+    }
+
+    const size_t n_evict = cut - n_keep - n_gap;
+    if (continues && n_evict > 0) {
+        evict(session, n_keep, std::min(n_evict, n_tail));
+    }
+    prompt.erase(prompt.begin() + n_keep, prompt.begin() + cut);
+    if (request.embedding != nullptr) {
+        request.embedding_offset -= cut - n_keep;
+    }
+    session.n_discarded = cut - n_keep;
+    if (n_evict > 0) {
+        window_shifts_++;
+        evicted_tokens_ += (int64_t) n_evict;
+        LOGI("🪟 Context window full (seq %d): evicted %zu oldest tokens after %zu pinned (%zu in total)",
+             session.seq_id, n_evict, n_keep, session.n_discarded);
+    }
+    return true;
+}
+
+/**
+ * Make room for the next token of a session whose window is full by evicting
+ * the older half of the conversation after the pinned prefix (caller holds
+ * both locks). False if the KV positions cannot be shifted.
+ */
+bool LlmEngine::shift_window(InferenceSession& session) {
+    const std::vector<llama_token>& cached = session.cached_tokens;
+    if (!can_shift_) {
+        return false;
+    }
+    const size_t n_keep = std::min(session.n_keep, cached.size() / 2);
+    size_t cut = n_keep + (cached.size() - n_keep) / 2;
+    while (cut < cached.size() && cached[cut] < 0 && cached[cut] == cached[cut - 1]) {
+        cut++;
+    }
+    const size_t n_discard = cut - n_keep;
+    if (cut >= cached.size() || !evict(session, n_keep, n_discard)) {
+        return false;
+    }
+    session.n_discarded += n_discard;
+    window_shifts_++;
+    evicted_tokens_ += (int64_t) n_discard;
+    LOGI("🪟 Context window full while generating (seq %d): evicted %zu tokens after %zu pinned",
+         session.seq_id, n_discard, n_keep);
+    return true;
+}
+
+/**
+ * Reuse the longest common prefix between the session's cached tokens and the new prompt.
+ *
+ * Removes the divergent tail from the KV cache and returns the number of prompt
+ * tokens that are already resident (and must not be decoded again). At least one
+ * prompt token is always left to decode so that fresh logits are produced.
+ */
+size_t LlmEngine::reuse_prefix(InferenceSession& session, const std::vector<llama_token>& prompt_tokens) {
+    std::vector<llama_token>& cached = session.cached_tokens;
+
+    size_t n_past = 0;
+    const size_t n_max = std::min(cached.size(), prompt_tokens.size());
+    while (n_past < n_max && cached[n_past] == prompt_tokens[n_past]) {
+        n_past++;
+    }
+    if (n_past == prompt_tokens.size()) {
+        n_past--;
+    }
+
+    if (n_past < cached.size()) {
+        if (!llama_memory_seq_rm(llama_get_memory(ctx_), session.seq_id, (llama_pos) n_past, -1)) {
+            // Partial removal is not supported by every memory type (e.g. recurrent)
+            LOGI("Partial KV removal not supported, clearing sequence %d", session.seq_id);
+            reset_session_cache(session);
+            n_past = 0;
+        }
+        cached.resize(n_past);
+    }
+
+    if (n_past > 0) {
+        prefix_hits_++;
+    } else {
+        prefix_misses_++;
+    }
+    prefix_reused_tokens_ += (int64_t) n_past;
+    prefix_prefilled_tokens_ += (int64_t) (prompt_tokens.size() - n_past);
+    return n_past;
+}
+
+/**
+ * Bring the session's sampler chain up to date with the current sampling
+ * parameters, reset it, and seed the repetition penalty window with the end
+ * of the prompt.
+ */
+void LlmEngine::prepare_sampler(InferenceSession& session, const std::vector<llama_token>& prompt_tokens) {
+    if (session.sampler == nullptr || session.sampler_version != sampling_version_) {
+        if (session.sampler != nullptr) {
+            llama_sampler_free(session.sampler);
+        }
+        session.sampler = build_sampler_chain(model_, sampling_params_);
+        session.sampler_version = sampling_version_;
+    }
+
+    llama_sampler_reset(session.sampler);
+    const size_t n_history = std::min(prompt_tokens.size(), (size_t) sampling_params_.penalty_last_n);
+    for (size_t i = prompt_tokens.size() - n_history; i < prompt_tokens.size(); ++i) {
+        if (prompt_tokens[i] >= 0) {   // skip embedding placeholders
+            llama_sampler_accept(session.sampler, prompt_tokens[i]);
+        }
+    }
+}
+
+/**
+ * Decode batch_ (caller holds ctx_mutex_). When the shared KV cache is full,
+ * evict the least recently used idle session (the default chat session last)
+ * and retry.
+ */
+int LlmEngine::decode() {
+    while (true) {
+        const auto t_start = std::chrono::steady_clock::now();
+        const int ret = llama_decode(ctx_, batch_);
+        decode_time_us_ += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - t_start).count();
+        if (ret != 1) {
+            return ret;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        InferenceSession* victim = nullptr;
+        for (auto& session : sessions_) {
+            if (!session.active || session.busy || session.cached_tokens.empty()) {
+                continue;
+            }
+            if (victim == nullptr) {
+                victim = &session;
+                continue;
+            }
+            const bool is_default = &session == &sessions_[0];
+            const bool victim_is_default = victim == &sessions_[0];
+            if (is_default != victim_is_default) {
+                if (victim_is_default) victim = &session;
+            } else if (session.last_used < victim->last_used) {
+                victim = &session;
+            }
+        }
+        if (victim == nullptr) {
+            LOGE("KV cache full and no idle session to evict");
+            return ret;
+        }
+        LOGI("KV cache full, evicting seq %d (%zu tokens)", victim->seq_id, victim->cached_tokens.size());
+        reset_session_cache(*victim);
+    }
+}
+
+/**
+ * Run the session's sampler chain over the logits of batch index `idx`.
+ * The returned candidates live in candidates_ until the next call.
+ */
+llama_token_data_array LlmEngine::apply_sampler(InferenceSession& session, int idx) {
+    const float* logits = llama_get_logits_ith(ctx_, idx);
+    const int n_vocab = (int) candidates_.size();
+    for (int token_id = 0; token_id < n_vocab; ++token_id) {
+        candidates_[token_id].id = token_id;
+        candidates_[token_id].logit = logits[token_id];
+        candidates_[token_id].p = 0.0f;
+    }
+
+    llama_token_data_array cur_p = { candidates_.data(), candidates_.size(), -1, false };
+    llama_sampler_apply(session.sampler, &cur_p);
+    return cur_p;
+}
+
+/**
+ * Sample a token from the logits of batch index `idx` and record it in the
+ * session's sampler history (repetition penalties, mirostat state).
+ */
+llama_token LlmEngine::sample(InferenceSession& session, int idx) {
+    const llama_token_data_array cur_p = apply_sampler(session, idx);
+    const llama_token token = cur_p.data[cur_p.selected].id;
+    llama_sampler_accept(session.sampler, token);
+    return token;
+}
+
+/**
+ * Main generation function using the corrected llama.cpp workflow.
+ *
+ * ===== CORE LLM RESPONSE GENERATION ENGINE =====
+ * This function is the heart of AI response generation in AILive.
+ * It processes user prompts and generates coherent text responses using llama.cpp.
+ *
+ * RESPONSE GENERATION PIPELINE:
+ * 1. Tokenizes user prompt into model-compatible tokens
+ * 2. Queues the request; the scheduler reuses the session's cached prefix
+ *    and prefills the rest in chunks alongside other sessions' decoding
+ * 3. Receives sampled tokens from the scheduler as they are produced
+ * 4. Converts tokens back to human-readable text (streamed via on_token)
+ * 5. Returns complete response to user via JNI bridge
+ */
+std::string LlmEngine::generate(int handle, const std::string& prompt_str, int max_tokens,
+                                const TokenCallback& on_token, Speculation speculation) {
+    LOGI("🔍 Generating response for: %.80s...", prompt_str.c_str());
+
+    auto request = std::make_shared<GenerationRequest>();
+    if (!tokenize(prompt_str, request->prompt)) {
+        LOGE("Tokenization resulted in 0 or negative tokens.");
+        return "[ERROR: Tokenization failed]";
+    }
+    LOGI("Tokenized prompt into %zu tokens.", request->prompt.size());
+    request->max_tokens = max_tokens;
+    request->speculation = speculation;
+    return run(handle, request, on_token);
+}
+
+std::string LlmEngine::generate_with_embedding(int handle, const std::vector<llama_token>& before,
+                                               std::shared_ptr<const PromptEmbedding> embedding,
+                                               const std::vector<llama_token>& after, int max_tokens,
+                                               const TokenCallback& on_token, Speculation speculation) {
+    if (embedding == nullptr || embedding->n_pos <= 0 || after.empty()) {
+        LOGE("Embedding prompt needs embeddings and text after them.");
+        return "[ERROR: Invalid multimodal prompt]";
+    }
+
+    auto request = std::make_shared<GenerationRequest>();
+    request->prompt.reserve(before.size() + embedding->n_pos + after.size());
+    request->prompt = before;
+    request->prompt.insert(request->prompt.end(), (size_t) embedding->n_pos, placeholder_token(embedding->id));
+    request->prompt.insert(request->prompt.end(), after.begin(), after.end());
+    request->embedding_offset = before.size();
+    request->embedding = std::move(embedding);
+    request->max_tokens = max_tokens;
+    request->speculation = speculation;
+    LOGI("Multimodal prompt: %zu + %d embedded + %zu tokens.", before.size(), request->embedding->n_pos, after.size());
+    return run(handle, request, on_token);
+}
+
+/**
+ * Queue `request` on the session and collect its tokens until it finishes.
+ */
+std::string LlmEngine::run(int handle, std::shared_ptr<GenerationRequest> request, const TokenCallback& on_token) {
+    // The scheduler checks the limit after sampling, so it would emit one token
+    if (request->max_tokens <= 0) {
+        LOGE("max_tokens must be positive (got %d)", request->max_tokens);
+        return "";
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    InferenceSession* session = session_for_handle(handle);
+    if (session == nullptr) {
+        LOGE("Invalid session handle %d", handle);
+        return "";
+    }
+    if (session->busy) {
+        LOGE("Session %d is already generating", handle);
+        return "[ERROR: Session busy]";
+    }
+    session->busy = true;
+    session->last_used = ++use_counter_;
+    request->session = session;
+    requests_.push_back(request);
+    work_cv_.notify_one();
+    const auto t_submit = std::chrono::steady_clock::now();
+
+    // --- Collect tokens from the scheduler ---
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    std::vector<llama_token> tokens;
+    std::string result_str;
+    size_t n_streamed = 0; // bytes of result_str already delivered to on_token
+    bool cancelled = false;
+
+    while (true) {
+        result_cv_.wait(lock, [&request] { return !request->output.empty() || request->done; });
+        tokens.swap(request->output);
+        const bool done = request->done;
+        lock.unlock();
+
+        if (!tokens.empty() && first_token_us_.load() < 0) {
+            int64_t unset = -1;
+            if (first_token_us_.compare_exchange_strong(unset, elapsed_us(t_submit))) {
+                LOGI("⏱️ First token after load: %.0f ms", first_token_us_.load() / 1000.0);
+            }
+        }
+
+        for (llama_token token : tokens) {
+            // Append token to result string
+            char piece_buf[256];
+            int piece_len = llama_token_to_piece(vocab, token, piece_buf, sizeof(piece_buf), 0, false);
+            if (piece_len > 0) {
+                result_str.append(piece_buf, std::min(piece_len, (int)sizeof(piece_buf)));
+            }
+
+            // Stream whatever is complete UTF-8 so far
+            if (on_token && !cancelled) {
+                const size_t n_complete = utf8_complete_prefix(result_str);
+                if (n_complete > n_streamed) {
+                    const bool keep_going = on_token(result_str.substr(n_streamed, n_complete - n_streamed));
+                    n_streamed = n_complete;
+                    if (!keep_going) {
+                        LOGI("Generation cancelled by caller.");
+                        cancelled = true;
+                    }
+                }
+            }
+        }
+        tokens.clear();
+
+        lock.lock();
+        if (done) {
+            break;
+        }
+        if (cancelled && !request->cancelled) {
+            // The scheduler retires the request at its next step; wait for that
+            // so the session is free again when we return.
+            request->cancelled = true;
+            work_cv_.notify_one();
+        }
+    }
+    const bool prefill_failed = request->prefill_failed;
+    const int n_generated = request->n_sampled;
+    lock.unlock();
+
+    if (prefill_failed) {
+        return "[ERROR: Prompt decoding failed]";
+    }
+
+    // Flush a trailing incomplete character so the streamed text matches the result
+    if (on_token && !cancelled && n_streamed < result_str.size()) {
+        on_token(result_str.substr(n_streamed));
+    }
+
+    LOGI("✨ Generated %d tokens: %.80s...", n_generated, result_str.c_str());
+    return result_str;
+}
+
+/**
+ * Fit the prompt into the context window, reuse the session's cached prefix
+ * and reset its sampler for `request` (caller holds both locks). The
+ * embeddings are either fully reused or decoded again; the KV cache never
+ * keeps part of them. A prompt that cannot fit fails the request, which the
+ * next scheduler step retires.
+ */
+bool LlmEngine::admit(GenerationRequest& request) {
+    InferenceSession& session = *request.session;
+    if (!fit_prompt(request)) {
+        request.prefill_failed = true;
+        request.cancelled = true;
+        return false;
+    }
+    request.n_prompt_done = reuse_prefix(session, request.prompt);
+    if (request.embedding != nullptr) {
+        const size_t begin = request.embedding_offset;
+        const size_t end = begin + request.embedding->n_pos;
+        if (request.n_prompt_done > begin && request.n_prompt_done < end) {
+            if (!llama_memory_seq_rm(llama_get_memory(ctx_), session.seq_id, (llama_pos) begin, -1)) {
+                reset_session_cache(session);
+            }
+            session.cached_tokens.resize(std::min(session.cached_tokens.size(), begin));
+            request.n_prompt_done = session.cached_tokens.size();
+        }
+        request.embedding_done = request.n_prompt_done >= end;
+        if (request.embedding_done) {
+            LOGI("Embeddings reused from the KV cache (seq %d).", session.seq_id);
+        }
+    }
+    LOGI("Prefix cache (seq %d): reusing %zu tokens, prefilling %zu.",
+         session.seq_id, request.n_prompt_done, request.prompt.size() - request.n_prompt_done);
+    prepare_sampler(session, request.prompt);
+    request.admitted = true;
+    return true;
+}
+
+/**
+ * Decode the embeddings of requests whose prefill has reached them. They
+ * go through their own decode call rather than the shared batch. Caller
+ * holds ctx_mutex_.
+ */
+void LlmEngine::decode_embeddings() {
+    std::vector<std::shared_ptr<GenerationRequest>> due;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& request : requests_) {
+            if (request->embedding == nullptr || request->embedding_done || request->cancelled) {
+                continue;
+            }
+            if (!request->admitted && !admit(*request)) {
+                continue;
+            }
+            if (!request->embedding_done && request->n_prompt_done == request->embedding_offset) {
+                due.push_back(request);
+            }
+        }
+    }
+
+    for (auto& request : due) {
+        const InferenceSession& session = *request->session;
+        const auto t_start = std::chrono::steady_clock::now();
+        const bool ok = request->embedding->decode(ctx_, session.seq_id, (llama_pos) request->n_prompt_done);
+        const int64_t elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - t_start).count();
+        decode_time_us_ += elapsed_us;
+        decode_calls_++;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        InferenceSession& owner = *request->session;
+        if (!ok) {
+            LOGE("Failed to decode %d embedded positions (seq %d)", request->embedding->n_pos, owner.seq_id);
+            reset_session_cache(owner);
+            request->prefill_failed = true;
+            owner.busy = false;
+            request->done = true;
+            requests_.erase(std::find(requests_.begin(), requests_.end(), request));
+            continue;
+        }
+        const int n_pos = request->embedding->n_pos;
+        owner.cached_tokens.insert(owner.cached_tokens.end(), (size_t) n_pos, placeholder_token(request->embedding->id));
+        request->n_prompt_done += n_pos;
+        request->embedding_done = true;
+        decoded_tokens_ += n_pos;
+        LOGI("Embeddings decoded: %d positions in %.1f ms (seq %d).", n_pos, elapsed_us / 1000.0, owner.seq_id);
+    }
+    if (!due.empty()) {
+        result_cv_.notify_all();
+    }
+}
+
+/**
+ * Draft tokens after the pending token of every decoding request that
+ * speculates, with the draft model or by prompt lookup, within the batch
+ * capacity left once each has its one token, the room left in its window
+ * and the tokens it still wants. Caller holds ctx_mutex_.
+ */
+void LlmEngine::draft_tokens() {
+    struct DraftJob {
+        std::shared_ptr<GenerationRequest> request;
+        int n_draft;
+    };
+    std::vector<DraftJob> jobs;
+    SamplingParams params;
+    uint64_t params_version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (sampling_params_.mirostat != 0) {
+            return;   // mirostat adapts to every sampled token; its p cannot be evaluated ahead
+        }
+        params = sampling_params_;
+        params_version = sampling_version_;
+        const int n_decoding = (int) std::count_if(requests_.begin(), requests_.end(),
+                [](const std::shared_ptr<GenerationRequest>& r) { return r->pending >= 0; });
+        int n_spare = batch_capacity_ - n_decoding;
+        const size_t n_ctx = llama_n_ctx(ctx_);
+        for (auto& request : requests_) {
+            request->drafts.clear();
+            const size_t n_cached = request->session->cached_tokens.size();
+            const bool lookup = request->speculation == Speculation::PromptLookup;
+            const bool with_model = request->speculation == Speculation::Auto && draft_ != nullptr;
+            if (request->pending < 0 || request->cancelled || n_cached + 1 >= n_ctx || (!lookup && !with_model)) {
+                continue;
+            }
+            const int n_draft = std::min({ lookup ? kMaxDraftTokens : n_draft_, n_spare, (int) (n_ctx - n_cached - 1),
+                                           request->max_tokens - request->n_sampled - 1 });
+            if (n_draft > 0) {
+                jobs.push_back({ request, n_draft });
+                n_spare -= n_draft;
+            }
+        }
+    }
+
+    if (jobs.empty()) {
+        return;
+    }
+    const auto t_start = std::chrono::steady_clock::now();
+    std::vector<DraftToken> drafts;
+    for (DraftJob& job : jobs) {
+        // cached_tokens and speculation only change on this thread
+        const InferenceSession& session = *job.request->session;
+        if (job.request->speculation == Speculation::PromptLookup) {
+            lookup_draft(session.cached_tokens, job.request->pending, job.n_draft, drafts);
+        } else {
+            draft_->draft(session.seq_id, session.cached_tokens, job.request->pending, job.n_draft,
+                          params, params_version, drafts);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        job.request->drafts.swap(drafts);
+    }
+    draft_time_us_ += elapsed_us(t_start);
+}
+
+/**
+ * Verify the drafted tokens of a decoding request against the logits the
+ * main model produced at their positions. Accepted tokens are handed back
+ * as if sampled one by one; the first rejected one is replaced by a draw
+ * from the residual distribution, and if all are accepted the next token is
+ * sampled after the last. Returns that token, the request's next pending
+ * one, unless generation ended within the accepted run (request.done).
+ * Rejected positions leave the KV cache. Caller holds both locks.
+ */
+llama_token LlmEngine::accept_drafts(GenerationRequest& request) {
+    InferenceSession& session = *request.session;
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    const size_t n_drafted = request.drafts.size();
+    const bool lookup = request.speculation == Speculation::PromptLookup;
+    llama_token next = LLAMA_TOKEN_NULL;
+
+    // A fixed seed makes speculative output reproducible like plain sampling
+    if (verify_rng_version_ != sampling_version_) {
+        verify_rng_version_ = sampling_version_;
+        if (sampling_params_.seed != LLAMA_DEFAULT_SEED) {
+            verify_rng_.seed(sampling_params_.seed);
+        }
+    }
+
+    size_t i = 0;
+    for (; i < n_drafted; ++i) {
+        llama_token_data_array cur_p = apply_sampler(session, request.batch_start + (int) i);
+        normalize_candidates(cur_p);
+        bool accepted = false;
+        const llama_token token = verify_draft(cur_p, request.drafts[i], verify_rng_, accepted);
+        llama_sampler_accept(session.sampler, token);
+        if (!accepted) {
+            next = token;
+            break;
+        }
+        (lookup ? lookup_accepted_tokens_ : accepted_tokens_)++;
+        if (llama_vocab_is_eog(vocab, token)) {
+            LOGI("End of generation (EOS token, seq %d).", session.seq_id);
+            request.done = true;
+            break;
+        }
+        session.cached_tokens.push_back(token);
+        request.output.push_back(token);
+        request.n_sampled++;
+        sampled_tokens_++;
+        if (request.n_sampled >= request.max_tokens) {
+            request.done = true;
+            break;
+        }
+    }
+    if (i == n_drafted) {
+        next = sample(session, request.batch_start + (int) n_drafted);
+    }
+
+    (lookup ? lookup_steps_ : speculative_steps_)++;
+    (lookup ? lookup_drafted_tokens_ : drafted_tokens_) += (int64_t) n_drafted;
+    llama_memory_seq_rm(llama_get_memory(ctx_), session.seq_id, (llama_pos) session.cached_tokens.size(), -1);
+    request.drafts.clear();
+    return next;
+}
+
+void LlmEngine::scheduler_loop() {
+    LOGI("Scheduler thread started (batch capacity %d)", batch_capacity_);
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait(lock, [this] { return stop_ || !requests_.empty(); });
+            if (stop_) {
+                // Release anyone still waiting; their partial output is kept
+                for (auto& request : requests_) {
+                    request->session->busy = false;
+                    request->done = true;
+                }
+                requests_.clear();
+                result_cv_.notify_all();
+                break;
+            }
+        }
+        std::lock_guard<std::mutex> ctx_lock(ctx_mutex_);
+        scheduler_step();
+    }
+    LOGI("Scheduler thread stopped");
+}
+
+/**
+ * One continuous-batching step.
+ *
+ * Packs the pending token of every decoding request first (one logit each,
+ * plus its drafted tokens with speculative decoding), then fills the
+ * remaining n_batch capacity with prompt chunks in arrival order, so a long
+ * prefill is spread over several steps instead of stalling interactive
+ * decoding. Caller holds ctx_mutex_.
+ */
+void LlmEngine::scheduler_step() {
+    decode_embeddings();
+
+    std::vector<std::shared_ptr<GenerationRequest>> active;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // Retire cancelled requests; make room in full windows or stop there
+        const size_t n_ctx = llama_n_ctx(ctx_);
+        bool retired = false;
+        for (auto it = requests_.begin(); it != requests_.end();) {
+            GenerationRequest& request = **it;
+            if (!request.cancelled && request.pending >= 0 && request.session->cached_tokens.size() >= n_ctx
+                    && !shift_window(*request.session)) {
+                LOGE("Context window full and cannot be shifted (seq %d), stopping generation",
+                     request.session->seq_id);
+                window_overflows_++;
+                request.cancelled = true;
+            }
+            if (request.cancelled) {
+                request.session->busy = false;
+                request.done = true;
+                it = requests_.erase(it);
+                retired = true;
+            } else {
+                ++it;
+            }
+        }
+        if (retired) {
+            result_cv_.notify_all();
+        }
+    }
+
+    draft_tokens();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int n_tokens = 0;
+        auto add_token = [this, &n_tokens](llama_token token, llama_pos pos, llama_seq_id seq_id, bool logits) {
+            batch_.token[n_tokens] = token;
+            batch_.pos[n_tokens] = pos;
+            batch_.n_seq_id[n_tokens] = 1;
+            batch_.seq_id[n_tokens][0] = seq_id;
+            batch_.logits[n_tokens] = logits ? 1 : 0;
+            n_tokens++;
+        };
+
+        // --- Next token of every decoding request ---
+        for (auto& request : requests_) {
+            request->batch_count = 0;
+            if (request->pending < 0) {
+                continue;
+            }
+            InferenceSession& session = *request->session;
+            const llama_pos pos = (llama_pos) session.cached_tokens.size();
+            request->batch_start = n_tokens;
+            add_token(request->pending, pos, session.seq_id, true);
+            // Drafted tokens, each verified from the logits before it
+            for (size_t i = 0; i < request->drafts.size(); ++i) {
+                add_token(request->drafts[i].id, pos + 1 + (llama_pos) i, session.seq_id, true);
+            }
+            request->batch_count = n_tokens - request->batch_start;
+            active.push_back(request);
+        }
+
+        // --- Prompt chunks in the remaining capacity ---
+        for (auto& request : requests_) {
+            if (n_tokens >= batch_capacity_) {
+                break;
+            }
+            if (request->pending >= 0 || request->cancelled) {
+                continue;
+            }
+            InferenceSession& session = *request->session;
+            // --- Fit the window, reuse cached prefix, reset sampler ---
+            if (!request->admitted && !admit(*request)) {
+                continue;   // retired at the next step
+            }
+
+            const size_t n_prompt = request->prompt.size();
+            // Text stops where embeddings still to be decoded begin
+            const size_t n_limit = request->embedding != nullptr && !request->embedding_done
+                    ? request->embedding_offset : n_prompt;
+            if (request->n_prompt_done >= n_limit) {
+                continue;   // embeddings are decoded at the start of the next step
+            }
+            const int n_chunk = (int) std::min((size_t) (batch_capacity_ - n_tokens), n_limit - request->n_prompt_done);
+            request->batch_start = n_tokens;
+            request->batch_count = n_chunk;
+            for (int i = 0; i < n_chunk; ++i) {
+                const size_t idx = request->n_prompt_done + i;
+                // Request logit only for the last prompt token
+                add_token(request->prompt[idx], (llama_pos) idx, session.seq_id, idx == n_prompt - 1);
+            }
+            active.push_back(request);
+        }
+
+        batch_.n_tokens = n_tokens;
+    }
+
+    if (active.empty()) {
+        return;
+    }
+
+    const int ret = decode();
+    decode_calls_++;
+    if (ret != 0) {
+        LOGE("Failed to decode batch of %d tokens (%zu sequences), ret=%d", batch_.n_tokens, active.size(), ret);
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& request : active) {
+            reset_session_cache(*request->session);
+            request->prefill_failed = request->pending < 0;
+            request->session->busy = false;
+            request->done = true;
+            requests_.erase(std::find(requests_.begin(), requests_.end(), request));
+        }
+        result_cv_.notify_all();
+        return;
+    }
+    decoded_tokens_ += batch_.n_tokens;
+    if ((int64_t) active.size() > max_batch_sequences_.load()) {
+        max_batch_sequences_ = (int64_t) active.size();
+    }
+
+    // --- Sample and hand tokens back ---
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& request : active) {
+        InferenceSession& session = *request->session;
+        const int logits_idx = request->batch_start + request->batch_count - 1;
+
+        if (request->pending >= 0) {
+            session.cached_tokens.push_back(request->pending);
+            request->pending = -1;
+        } else {
+            session.cached_tokens.insert(session.cached_tokens.end(),
+                                         request->prompt.begin() + request->n_prompt_done,
+                                         request->prompt.begin() + request->n_prompt_done + request->batch_count);
+            request->n_prompt_done += request->batch_count;
+            if (request->n_prompt_done < request->prompt.size()) {
+                continue; // more prompt to prefill next step
+            }
+            LOGI("Prompt decoded successfully (seq %d).", session.seq_id);
+        }
+
+        if (request->cancelled) {
+            if (!request->drafts.empty()) {
+                llama_memory_seq_rm(llama_get_memory(ctx_), session.seq_id, (llama_pos) session.cached_tokens.size(), -1);
+                request->drafts.clear();
+            }
+            continue;
+        }
+
+        const llama_token token = request->drafts.empty() ? sample(session, logits_idx) : accept_drafts(*request);
+        if (request->done) {
+            // Ended within the accepted drafts
+        } else if (llama_vocab_is_eog(vocab, token)) {
+            LOGI("End of generation (EOS token, seq %d).", session.seq_id);
+            request->done = true;
+        } else {
+            request->output.push_back(token);
+            request->n_sampled++;
+            sampled_tokens_++;
+            if (request->n_sampled >= request->max_tokens) {
+                request->done = true;
+            } else {
+                request->pending = token;
+            }
+        }
+
+        if (request->done) {
+            session.busy = false;
+            requests_.erase(std::find(requests_.begin(), requests_.end(), request));
+        }
+    }
+    result_cv_.notify_all();
+}
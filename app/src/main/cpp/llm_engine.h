@@ -0,0 +1,352 @@
+/**
+ * llm_engine.h - Multi-session llama.cpp inference engine for AILive
+ *
+ * One model and one llama_context are shared by several inference sessions.
+ * Each session owns a llama sequence ID in the unified KV cache together with
+ * the tokens currently cached for it, so the chat, fact extraction and tool
+ * reasoning keep their own prompt prefixes warm instead of overwriting
+ * sequence 0 for each other.
+ *
+ * Generation is driven by a scheduler thread (continuous batching): every
+ * step it packs the next token of each decoding session plus chunks of
+ * pending prompt prefills into one llama_batch, decodes them together and
+ * hands the sampled tokens back to the requesting threads.
+ *
+ * A prompt may carry precomputed embeddings (an encoded image) between its
+ * text tokens; the scheduler decodes them into the session's sequence when
+ * the prefill reaches them.
+ *
+ * A session never runs past the context window: its pinned prefix (the
+ * system prompt) stays, and the oldest conversation tokens after it are
+ * evicted from the KV cache with the rest shifted down, so a long chat keeps
+ * prefilling only its newest turn.
+ *
+ * With a draft model attached (see speculative.h) each decoding session's
+ * pending token is followed in the batch by a few drafted tokens, and every
+ * drafted token the main model accepts saves a decode step. Requests that
+ * quote their prompt can instead draft by prompt lookup, without a model.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <random>
+#include "llama.h"
+#include "context_plan.h"
+
+/**
+ * Sampling parameters, mirrored from Kotlin ModelSettings via nativeSetSamplingParams.
+ */
+struct SamplingParams {
+    float temperature = 0.7f;
+    float top_p = 0.9f;
+    int top_k = 40;
+    float min_p = 0.05f;
+    float repeat_penalty = 1.18f;
+    float presence_penalty = 0.6f;
+    float frequency_penalty = 0.3f;
+    int penalty_last_n = 64;
+    int mirostat = 0;            // 0 = disabled, 1 = v1, 2 = v2
+    float mirostat_tau = 5.0f;
+    float mirostat_eta = 0.1f;
+    uint32_t seed = LLAMA_DEFAULT_SEED;
+};
+
+/**
+ * How a generation drafts tokens for speculative decoding; values match
+ * LLMBridge.SPECULATION_*.
+ */
+enum class Speculation {
+    Off = 0,             // one token per step
+    Auto = 1,            // the draft model if one is attached, else off
+    PromptLookup = 2,    // n-gram matches in the prompt and output (no model)
+};
+
+// Receives each complete UTF-8 piece as it is sampled; return false to stop generation
+using TokenCallback = std::function<bool(const std::string&)>;
+
+struct PrefixCacheStats {
+    int64_t hits = 0;
+    int64_t misses = 0;
+    int64_t reused_tokens = 0;
+    int64_t prefilled_tokens = 0;
+};
+
+struct ContextWindowStats {
+    int64_t shifts = 0;                // evictions from a session's window
+    int64_t evicted_tokens = 0;        // conversation tokens evicted by them
+    int64_t overflows = 0;             // generations stopped at a full window that could not shift
+};
+
+struct SchedulerStats {
+    int64_t decode_calls = 0;          // llama_decode calls made by the scheduler
+    int64_t decoded_tokens = 0;        // prompt + generated tokens decoded
+    int64_t sampled_tokens = 0;        // tokens handed back to requesters
+    int64_t max_batch_sequences = 0;   // most sequences decoded together in one step
+    int64_t decode_time_us = 0;        // wall time spent in llama_decode
+};
+
+struct SpeculativeStats {
+    int64_t steps = 0;                 // decodes that verified a session's draft-model tokens
+    int64_t drafted_tokens = 0;
+    int64_t accepted_tokens = 0;
+    int64_t draft_time_us = 0;         // wall time spent drafting (both modes)
+    int64_t lookup_steps = 0;          // the same for Speculation::PromptLookup
+    int64_t lookup_drafted_tokens = 0;
+    int64_t lookup_accepted_tokens = 0;
+};
+
+/**
+ * Embeddings spliced into a prompt, e.g. an image encoded by the vision
+ * projector. In the session's cached tokens its positions hold
+ * placeholder_token(id), so a later prompt with the same embeddings at the
+ * same place reuses them from the KV cache like text.
+ */
+struct PromptEmbedding {
+    uint64_t id = 0;     // content hash; equal ids must mean equal embeddings
+    int n_pos = 0;       // KV positions occupied
+    // Writes the embeddings into seq_id from position pos; runs on the
+    // scheduler thread with the context locked
+    std::function<bool(llama_context* ctx, llama_seq_id seq_id, llama_pos pos)> decode;
+};
+
+/**
+ * How LlmEngine::load brings a model up.
+ */
+struct LoadOptions {
+    int n_ctx = 2048;
+    bool use_mlock = false;   // pin the weights in RAM so memory pressure cannot evict them
+    bool warmup = true;       // one decode before returning: faults the weights in, first graph build
+    // Bytes the weights and context may take together; the KV cache type,
+    // batch sizes and if need be n_ctx are chosen to fit (see context_plan.h).
+    // 0 = f16 KV cache, 512-token batches and n_ctx as given
+    int64_t memory_budget = 0;
+    // Fraction of tensors loaded (0..1), on the loading thread; return false to cancel
+    std::function<bool(float progress)> on_progress;
+};
+
+/**
+ * Wall time of each phase of LlmEngine::load.
+ */
+struct LoadTimings {
+    int64_t model_us = 0;      // GGUF mapped and tensors loaded
+    int64_t context_us = 0;    // context, KV cache and compute buffers
+    int64_t warmup_us = 0;     // warm-up decode (0 if skipped)
+    int64_t total_us = 0;
+};
+
+struct GenerationRequest;
+struct SessionSnapshot;
+class DraftModel;
+
+/**
+ * One conversation slot: a KV sequence plus the bookkeeping needed to reuse it.
+ */
+struct InferenceSession {
+    bool active = false;
+    bool busy = false;                      // a generation is running on this session
+    llama_seq_id seq_id = -1;
+    std::vector<llama_token> cached_tokens; // tokens resident in the KV cache for seq_id
+    std::vector<llama_token> pinned;        // prompt prefix never evicted (set_pinned_prefix)
+    size_t n_keep = 0;                      // tokens of the current window's pinned prefix
+    size_t n_discarded = 0;                 // conversation tokens evicted right after the pinned prefix
+    llama_sampler* sampler = nullptr;       // own chain, so penalty history is per session
+    uint64_t sampler_version = 0;
+    uint64_t last_used = 0;
+};
+
+class LlmEngine {
+public:
+    // Generation sessions map to sequences 0..kMaxSessions-1
+    static constexpr int kMaxSessions = 4;
+    // Handle of the session created with the engine (used by the legacy API)
+    static constexpr int kDefaultSession = 0;
+
+    /**
+     * Load a GGUF model and create a context with kMaxSessions sequences,
+     * planned to fit options.memory_budget. Returns nullptr on failure,
+     * cancellation, or if no context fits the budget. Blocks; callers wanting
+     * a responsive UI run it on a worker thread.
+     */
+    static std::unique_ptr<LlmEngine> load(const char* path, const LoadOptions& options,
+                                           LoadTimings* timings = nullptr);
+    static std::unique_ptr<LlmEngine> load(const char* path, int n_ctx);
+    ~LlmEngine();
+
+    LlmEngine(const LlmEngine&) = delete;
+    LlmEngine& operator=(const LlmEngine&) = delete;
+
+    /**
+     * Create a new session. Returns its handle, or -1 if all slots are in use.
+     */
+    int create_session();
+    bool destroy_session(int handle);
+    bool is_session_active(int handle);
+
+    /**
+     * Generate a completion for `prompt` in the given session. The KV cache of
+     * the session is reused for the longest common prefix with its previous
+     * prompt. Blocks until done; on_token runs on the calling thread. Requests
+     * on other sessions are decoded in the same batches.
+     */
+    std::string generate(int handle, const std::string& prompt, int max_tokens,
+                         const TokenCallback& on_token = nullptr, Speculation speculation = Speculation::Auto);
+
+    /**
+     * Like generate() for the prompt `before` + embedding + `after`. `after`
+     * must not be empty (the logits come from its last token).
+     */
+    std::string generate_with_embedding(int handle, const std::vector<llama_token>& before,
+                                        std::shared_ptr<const PromptEmbedding> embedding,
+                                        const std::vector<llama_token>& after, int max_tokens,
+                                        const TokenCallback& on_token = nullptr,
+                                        Speculation speculation = Speculation::Auto);
+
+    /**
+     * Copy a session's cached tokens and KV sequence into `snapshot` (see
+     * session_state.h). False if the session is empty or generating; the
+     * KV copy is a memcpy, so this only briefly holds up the scheduler.
+     */
+    bool snapshot_session(int handle, SessionSnapshot& snapshot);
+
+    /**
+     * Replace a session's KV sequence and cached tokens with a snapshot of
+     * this model, so its next prompt reuses the restored prefix. Returns the
+     * number of tokens restored, or -1 (the session is then empty).
+     */
+    int restore_session(int handle, const SessionSnapshot& snapshot);
+
+    /**
+     * Pin the start of the session's prompts, typically the system prompt.
+     * When a conversation outgrows the context window the oldest tokens
+     * after it are evicted instead; without a pinned prefix only BOS is kept.
+     * An empty prefix unpins.
+     */
+    bool set_pinned_prefix(int handle, const std::string& prefix);
+
+    /**
+     * Attach a draft model for speculative decoding: it proposes up to
+     * n_draft tokens per session and step for this model to verify. It must
+     * share this model's vocabulary. Loads on the calling thread and replaces
+     * any previous draft model; false leaves that one attached.
+     */
+    bool load_draft(const char* path, int n_draft);
+    void free_draft();
+
+    /** Context configuration chosen at load and its estimated memory */
+    const ContextPlan& context_plan() const { return plan_; }
+
+    /** Fingerprint of the loaded GGUF (model_fingerprint) */
+    uint64_t model_key() const { return model_key_; }
+
+    /** Tokenize with the model's vocabulary; false if no tokens result */
+    bool tokenize(const std::string& text, std::vector<llama_token>& out,
+                  bool add_special = true, bool parse_special = false) const;
+
+    /** Cached-token value of every position of a PromptEmbedding; never a real token */
+    static llama_token placeholder_token(uint64_t id) {
+        return -2 - (llama_token) (id & 0x3FFFFFFF);
+    }
+
+    void set_sampling_params(const SamplingParams& params);
+    PrefixCacheStats prefix_cache_stats() const;
+    SchedulerStats scheduler_stats() const;
+    ContextWindowStats context_stats() const;
+    SpeculativeStats speculative_stats() const;
+    /** Submit-to-first-token time of the first generation, -1 until one produced a token */
+    int64_t first_token_us() const { return first_token_us_.load(); }
+
+    llama_model* model() const { return model_; }
+    llama_context* context() const { return ctx_; }
+
+private:
+    LlmEngine() = default;
+
+    bool warmup();
+    InferenceSession* session_for_handle(int handle);
+    std::string run(int handle, std::shared_ptr<GenerationRequest> request, const TokenCallback& on_token);
+    bool admit(GenerationRequest& request);
+    bool fit_prompt(GenerationRequest& request);
+    size_t pinned_length(const InferenceSession& session, const std::vector<llama_token>& prompt) const;
+    bool evict(InferenceSession& session, size_t n_keep, size_t n_discard);
+    bool shift_window(InferenceSession& session);
+    void decode_embeddings();
+    size_t reuse_prefix(InferenceSession& session, const std::vector<llama_token>& prompt_tokens);
+    void reset_session_cache(InferenceSession& session);
+    void prepare_sampler(InferenceSession& session, const std::vector<llama_token>& prompt_tokens);
+    int decode();
+    llama_token_data_array apply_sampler(InferenceSession& session, int idx);
+    llama_token sample(InferenceSession& session, int idx);
+    void draft_tokens();
+    llama_token accept_drafts(GenerationRequest& request);
+
+    void scheduler_loop();
+    void scheduler_step();
+
+    llama_model* model_ = nullptr;
+    llama_context* ctx_ = nullptr;
+    int epoch_ = 0;                         // distinguishes handles of different engines
+    uint64_t model_key_ = 0;
+    ContextPlan plan_;
+    bool can_shift_ = false;                // KV positions can be shifted (not with M-RoPE)
+
+    // Lock order: ctx_mutex_ before mutex_.
+    // ctx_mutex_ guards the context (decode, logits, KV memory) and the buffers below.
+    std::mutex ctx_mutex_;
+    // mutex_ guards sessions_, requests_ and sampling_params_.
+    std::mutex mutex_;
+    InferenceSession sessions_[kMaxSessions];
+    uint64_t use_counter_ = 0;
+
+    // Scheduler thread and the generations it is running
+    std::thread scheduler_;
+    std::condition_variable work_cv_;       // new request, cancellation or shutdown
+    std::condition_variable result_cv_;     // tokens sampled or a request finished
+    std::vector<std::shared_ptr<GenerationRequest>> requests_;
+    bool stop_ = false;
+
+    // Per-context buffers, allocated once and reused by every decode step
+    std::vector<llama_token_data> candidates_;
+    llama_batch batch_ = {};
+    int batch_capacity_ = 0;
+
+    SamplingParams sampling_params_;
+    uint64_t sampling_version_ = 1;
+
+    // Speculative decoding, guarded by ctx_mutex_
+    std::unique_ptr<DraftModel> draft_;
+    int n_draft_ = 0;
+    std::mt19937 verify_rng_{std::random_device{}()};
+    uint64_t verify_rng_version_ = 0;   // sampling_version_ verify_rng_ was last seeded for
+
+    std::atomic<int64_t> prefix_hits_{0};
+    std::atomic<int64_t> prefix_misses_{0};
+    std::atomic<int64_t> prefix_reused_tokens_{0};
+    std::atomic<int64_t> prefix_prefilled_tokens_{0};
+
+    std::atomic<int64_t> decode_calls_{0};
+    std::atomic<int64_t> decoded_tokens_{0};
+    std::atomic<int64_t> sampled_tokens_{0};
+    std::atomic<int64_t> max_batch_sequences_{0};
+    std::atomic<int64_t> decode_time_us_{0};
+    std::atomic<int64_t> first_token_us_{-1};
+
+    std::atomic<int64_t> window_shifts_{0};
+    std::atomic<int64_t> evicted_tokens_{0};
+    std::atomic<int64_t> window_overflows_{0};
+
+    std::atomic<int64_t> speculative_steps_{0};
+    std::atomic<int64_t> drafted_tokens_{0};
+    std::atomic<int64_t> accepted_tokens_{0};
+    std::atomic<int64_t> draft_time_us_{0};
+    std::atomic<int64_t> lookup_steps_{0};
+    std::atomic<int64_t> lookup_drafted_tokens_{0};
+    std::atomic<int64_t> lookup_accepted_tokens_{0};
+};
@@ -0,0 +1,263 @@
+/**
+ * multimodal_engine.cpp - Vision projector (llama.cpp mtmd) with an image-embedding cache
+ *
+ * See multimodal_engine.h.
+ */
+
+#include "multimodal_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <android/log.h>
+#include "mtmd.h"
+#include "mtmd-helper.h"
+
+#define LOG_TAG "AILive-MTMD"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+ImageEmbedding::~ImageEmbedding() {
+    if (chunk != nullptr) {
+        mtmd_input_chunk_free(chunk);
+    }
+}
+
+static int64_t elapsed_us(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+/**
+ * 64-bit hash of the image file bytes, one multiply per 8 bytes. Equal
+ * frames compress to equal bytes, which is all the cache needs.
+ */
+static uint64_t content_hash(const uint8_t* data, size_t len, uint64_t seed) {
+    constexpr uint64_t kMul = 0x9E3779B97F4A7C15ull;
+    uint64_t h = seed ^ (len * kMul);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ word) * kMul;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, len - i);
+    h = (h ^ tail) * kMul;
+    return h ^ (h >> 32);
+}
+
+/**
+ * Box-filter an RGB image down so its longer side is `max_side`.
+ */
+static std::vector<uint8_t> downscale_rgb(const uint8_t* src, int nx, int ny, int max_side, int* out_nx, int* out_ny) {
+    const float s = (float) max_side / std::max(nx, ny);
+    const int tx = std::max(1, (int) (nx * s + 0.5f));
+    const int ty = std::max(1, (int) (ny * s + 0.5f));
+    std::vector<uint8_t> out((size_t) tx * ty * 3);
+    for (int oy = 0; oy < ty; ++oy) {
+        const int y0 = (int) ((int64_t) oy * ny / ty);
+        const int y1 = std::max(y0 + 1, (int) ((int64_t) (oy + 1) * ny / ty));
+        for (int ox = 0; ox < tx; ++ox) {
+            const int x0 = (int) ((int64_t) ox * nx / tx);
+            const int x1 = std::max(x0 + 1, (int) ((int64_t) (ox + 1) * nx / tx));
+            uint32_t sum[3] = {0, 0, 0};
+            for (int y = y0; y < y1; ++y) {
+                const uint8_t* p = src + ((size_t) y * nx + x0) * 3;
+                for (int x = x0; x < x1; ++x, p += 3) {
+                    sum[0] += p[0];
+                    sum[1] += p[1];
+                    sum[2] += p[2];
+                }
+            }
+            const uint32_t n = (uint32_t) ((y1 - y0) * (x1 - x0));
+            uint8_t* q = out.data() + ((size_t) oy * tx + ox) * 3;
+            for (int c = 0; c < 3; ++c) {
+                q[c] = (uint8_t) ((sum[c] + n / 2) / n);
+            }
+        }
+    }
+    *out_nx = tx;
+    *out_ny = ty;
+    return out;
+}
+
+std::unique_ptr<MultimodalEngine> MultimodalEngine::load(const char* mmproj_path, const llama_model* model,
+                                                         int n_threads, int max_image_side) {
+    mtmd_context_params params = mtmd_context_params_default();
+    params.use_gpu = false;          // the projector runs on the CPU threads
+    params.n_threads = n_threads > 0 ? n_threads : 4;
+    params.print_timings = false;
+
+    mtmd_context* ctx = mtmd_init_from_file(mmproj_path, model, params);
+    if (ctx == nullptr) {
+        LOGE("Failed to load vision projector from %s", mmproj_path);
+        return nullptr;
+    }
+    if (!mtmd_support_vision(ctx)) {
+        LOGE("Projector %s has no vision encoder", mmproj_path);
+        mtmd_free(ctx);
+        return nullptr;
+    }
+
+    std::unique_ptr<MultimodalEngine> engine(new MultimodalEngine());
+    engine->ctx_ = std::shared_ptr<mtmd_context>(ctx, mtmd_free);
+    engine->model_ = model;
+    engine->max_image_side_ = max_image_side > 0 ? max_image_side : kDefaultMaxImageSide;
+    LOGI("✅ Vision projector loaded: %d threads, images up to %d px", params.n_threads, engine->max_image_side_);
+    return engine;
+}
+
+MultimodalEngine::~MultimodalEngine() = default;
+
+const char* MultimodalEngine::marker() {
+    return mtmd_default_marker();
+}
+
+std::shared_ptr<const ImageEmbedding> MultimodalEngine::embed(const uint8_t* data, size_t len, ImageEncodeStats* stats) {
+    ImageEncodeStats local;
+    ImageEncodeStats& st = stats != nullptr ? *stats : local;
+    st = ImageEncodeStats();
+    const uint64_t key = content_hash(data, len, (uint64_t) max_image_side_);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = cache_.begin(); it != cache_.end(); ++it) {
+        if ((*it)->key == key) {
+            std::shared_ptr<const ImageEmbedding> image = *it;
+            cache_.splice(cache_.begin(), cache_, it);
+            hits_++;
+            st.cache_hit = true;
+            st.n_tokens = image->n_tokens;
+            LOGI("🖼️ Image embedding cache hit: %d tokens, encoder skipped", image->n_tokens);
+            return image;
+        }
+    }
+
+    misses_++;
+    std::shared_ptr<ImageEmbedding> image = encode(data, len, key, &st);
+    if (image == nullptr) {
+        return nullptr;
+    }
+    cache_.push_front(image);
+    cache_bytes_ += image->bytes();
+    // Evict least recently used images, always keeping the newest
+    while (cache_bytes_ > kCacheBytes && cache_.size() > 1) {
+        cache_bytes_ -= cache_.back()->bytes();
+        cache_.pop_back();
+    }
+    LOGI("🖼️ Image encoded: %d tokens, decode %.1f ms, encoder %.1f ms (cache %zu images, %zu KB)",
+         image->n_tokens, st.decode_us / 1000.0, st.encode_us / 1000.0, cache_.size(), cache_bytes_ / 1024);
+    return image;
+}
+
+std::shared_ptr<ImageEmbedding> MultimodalEngine::encode(const uint8_t* data, size_t len, uint64_t key,
+                                                         ImageEncodeStats* stats) {
+    mtmd_context* ctx = ctx_.get();
+    auto t_start = std::chrono::steady_clock::now();
+
+    mtmd_bitmap* bitmap = mtmd_helper_bitmap_init_from_buf(ctx, data, len);
+    if (bitmap == nullptr) {
+        LOGE("Failed to decode image (%zu bytes)", len);
+        return nullptr;
+    }
+    const int nx = (int) mtmd_bitmap_get_nx(bitmap);
+    const int ny = (int) mtmd_bitmap_get_ny(bitmap);
+    if (std::max(nx, ny) > max_image_side_) {
+        int tx = 0, ty = 0;
+        std::vector<uint8_t> rgb = downscale_rgb(mtmd_bitmap_get_data(bitmap), nx, ny, max_image_side_, &tx, &ty);
+        mtmd_bitmap_free(bitmap);
+        bitmap = mtmd_bitmap_init((uint32_t) tx, (uint32_t) ty, rgb.data());
+        if (bitmap == nullptr) {
+            LOGE("Failed to allocate %dx%d bitmap", tx, ty);
+            return nullptr;
+        }
+        LOGI("Image downscaled %dx%d -> %dx%d", nx, ny, tx, ty);
+    }
+    stats->decode_us = elapsed_us(t_start);
+
+    std::unique_ptr<mtmd_input_chunks, void (*)(mtmd_input_chunks*)> chunks(mtmd_input_chunks_init(), mtmd_input_chunks_free);
+    mtmd_input_text text;
+    text.text = mtmd_default_marker();
+    text.add_special = false;
+    text.parse_special = true;
+    const mtmd_bitmap* bitmaps[1] = {bitmap};
+    const int32_t ret = mtmd_tokenize(ctx, chunks.get(), &text, bitmaps, 1);
+    mtmd_bitmap_free(bitmap);
+    if (ret != 0) {
+        LOGE("Failed to tokenize image, ret=%d", ret);
+        return nullptr;
+    }
+
+    auto image = std::make_shared<ImageEmbedding>();
+    image->key = key;
+    const mtmd_input_chunk* image_chunk = nullptr;
+    for (size_t i = 0; i < mtmd_input_chunks_size(chunks.get()); ++i) {
+        const mtmd_input_chunk* chunk = mtmd_input_chunks_get(chunks.get(), i);
+        if (mtmd_input_chunk_get_type(chunk) == MTMD_INPUT_CHUNK_TYPE_TEXT) {
+            size_t n = 0;
+            const llama_token* tokens = mtmd_input_chunk_get_tokens_text(chunk, &n);
+            std::vector<llama_token>& side = image_chunk == nullptr ? image->before : image->after;
+            side.insert(side.end(), tokens, tokens + n);
+        } else if (mtmd_input_chunk_get_type(chunk) == MTMD_INPUT_CHUNK_TYPE_IMAGE && image_chunk == nullptr) {
+            image_chunk = chunk;
+        } else {
+            LOGE("Unexpected chunk in image tokenization");
+            return nullptr;
+        }
+    }
+    if (image_chunk == nullptr) {
+        LOGE("Image tokenization produced no image chunk");
+        return nullptr;
+    }
+    image->n_tokens = (int) mtmd_input_chunk_get_n_tokens(image_chunk);
+    image->n_pos = (int) mtmd_input_chunk_get_n_pos(image_chunk);
+
+    t_start = std::chrono::steady_clock::now();
+    if (mtmd_encode_chunk(ctx, image_chunk) != 0) {
+        LOGE("Vision encoder failed");
+        return nullptr;
+    }
+    const size_t n_embd = (size_t) llama_model_n_embd(model_);
+    const float* embd = mtmd_get_output_embd(ctx);
+    image->embd.assign(embd, embd + (size_t) image->n_tokens * n_embd);
+    image->chunk = mtmd_input_chunk_copy(image_chunk);
+    stats->encode_us = elapsed_us(t_start);
+    stats->n_tokens = image->n_tokens;
+    return image;
+}
+
+std::shared_ptr<const PromptEmbedding> MultimodalEngine::prompt_embedding(std::shared_ptr<const ImageEmbedding> image) const {
+    auto embedding = std::make_shared<PromptEmbedding>();
+    embedding->id = image->key;
+    embedding->n_pos = image->n_pos;
+    std::shared_ptr<mtmd_context> ctx = ctx_;
+    embedding->decode = [ctx, image](llama_context* lctx, llama_seq_id seq_id, llama_pos pos) {
+        llama_pos n_past = pos;
+        // Handles M-RoPE positions and non-causal projectors
+        const int32_t ret = mtmd_helper_decode_image_chunk(ctx.get(), lctx, image->chunk,
+                                                           const_cast<float*>(image->embd.data()), pos, seq_id,
+                                                           (int32_t) llama_n_batch(lctx), &n_past);
+        if (ret != 0 || n_past != pos + image->n_pos) {
+            LOGE("Failed to decode image embeddings, ret=%d", ret);
+            return false;
+        }
+        return true;
+    };
+    return embedding;
+}
+
+MultimodalCacheStats MultimodalEngine::cache_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    MultimodalCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.entries = (int64_t) cache_.size();
+    stats.bytes = (int64_t) cache_bytes_;
+    return stats;
+}
+
+void MultimodalEngine::clear_cache() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_.clear();
+    cache_bytes_ = 0;
+}
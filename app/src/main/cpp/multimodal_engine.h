@@ -0,0 +1,109 @@
+/**
+ * multimodal_engine.h - Vision projector (llama.cpp mtmd) with an image-embedding cache
+ *
+ * Images are decoded, optionally downscaled (fewer image tokens, which is
+ * what bounds encoder time on the CPU), encoded by the projector into
+ * embeddings for the text model, and cached by content hash. Asking another
+ * question about the same camera frame reuses the embeddings and skips the
+ * vision encoder entirely; LlmEngine can then also reuse them from the KV
+ * cache (see PromptEmbedding).
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "llama.h"
+#include "llm_engine.h"
+
+struct mtmd_context;
+struct mtmd_input_chunk;
+
+/**
+ * An encoded image plus the text tokens the projector wraps it in (e.g.
+ * <|vision_start|> ... <|vision_end|>). Immutable once cached.
+ */
+struct ImageEmbedding {
+    uint64_t key = 0;                  // content hash (includes the downscale limit)
+    std::vector<llama_token> before;   // tokens to put before the embeddings
+    std::vector<llama_token> after;    // and after them
+    mtmd_input_chunk* chunk = nullptr; // owned; positions layout for decoding
+    std::vector<float> embd;           // n_tokens * n_embd
+    int n_tokens = 0;                  // embedding vectors
+    int n_pos = 0;                     // KV positions (differs from n_tokens with M-RoPE)
+
+    ~ImageEmbedding();
+    size_t bytes() const { return embd.size() * sizeof(float); }
+};
+
+struct ImageEncodeStats {
+    bool cache_hit = false;
+    int n_tokens = 0;          // image tokens fed to the text model
+    int64_t decode_us = 0;     // image file decode + downscale (0 on a hit)
+    int64_t encode_us = 0;     // vision encoder (0 on a hit)
+};
+
+struct MultimodalCacheStats {
+    int64_t hits = 0;
+    int64_t misses = 0;
+    int64_t entries = 0;
+    int64_t bytes = 0;
+};
+
+class MultimodalEngine {
+public:
+    // Longest image side fed to the projector by default
+    static constexpr int kDefaultMaxImageSide = 512;
+    // Embedding memory kept for recent images
+    static constexpr size_t kCacheBytes = 64u << 20;
+
+    /**
+     * Load a projector (mmproj GGUF) for `model`, which must outlive the
+     * engine. Runs on the CPU. Returns nullptr on failure.
+     */
+    static std::unique_ptr<MultimodalEngine> load(const char* mmproj_path, const llama_model* model,
+                                                  int n_threads, int max_image_side);
+    ~MultimodalEngine();
+
+    MultimodalEngine(const MultimodalEngine&) = delete;
+    MultimodalEngine& operator=(const MultimodalEngine&) = delete;
+
+    /**
+     * Embeddings of an encoded image (JPEG, PNG, BMP, ...), from the cache or
+     * the encoder. Returns nullptr if the image cannot be decoded or encoded.
+     */
+    std::shared_ptr<const ImageEmbedding> embed(const uint8_t* data, size_t len, ImageEncodeStats* stats);
+
+    /**
+     * PromptEmbedding that decodes `image` into a sequence. Keeps the image
+     * and this engine's context referenced until it is dropped.
+     */
+    std::shared_ptr<const PromptEmbedding> prompt_embedding(std::shared_ptr<const ImageEmbedding> image) const;
+
+    MultimodalCacheStats cache_stats() const;
+    void clear_cache();
+
+    /** Marker the image goes at in a prompt ("<__media__>") */
+    static const char* marker();
+
+private:
+    MultimodalEngine() = default;
+
+    std::shared_ptr<ImageEmbedding> encode(const uint8_t* data, size_t len, uint64_t key, ImageEncodeStats* stats);
+
+    // Shared with the PromptEmbedding callbacks, which may outlive a reload
+    std::shared_ptr<mtmd_context> ctx_;
+    const llama_model* model_ = nullptr;
+    int max_image_side_ = kDefaultMaxImageSide;
+
+    // mutex_ guards the encoder (mtmd is not thread-safe) and the cache
+    mutable std::mutex mutex_;
+    std::list<std::shared_ptr<const ImageEmbedding>> cache_;   // most recent first
+    size_t cache_bytes_ = 0;
+    int64_t hits_ = 0;
+    int64_t misses_ = 0;
+};
@@ -0,0 +1,409 @@
+/**
+ * persistent_index.cpp - Vector index stored in an mmap'ed IndexFile
+ *
+ * See persistent_index.h.
+ */
+
+#include "persistent_index.h"
+#include "vector_kernels.h"
+#include "vector_topk.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <android/log.h>
+
+#define LOG_TAG "AILive-Vector"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// Sealed rows scored per dot_rows call
+static constexpr size_t kBlockRows = 1024;
+
+PersistentIndex::PersistentIndex(int dim, const HnswParams* graph, size_t initial_capacity)
+    : dim_(dim), graph_params_(graph != nullptr ? *graph : HnswParams()) {
+    entries_.reserve(initial_capacity);
+    if (graph != nullptr) {
+        graph_.reset(new HnswIndex(dim, initial_capacity, *graph));
+    }
+}
+
+std::unique_ptr<PersistentIndex> PersistentIndex::open(const std::string& path, int dim,
+                                                       size_t initial_capacity, const HnswParams* graph) {
+    const auto start = std::chrono::steady_clock::now();
+
+    std::shared_ptr<IndexFile> file = IndexFile::open(path, dim);
+    if (file == nullptr) {
+        return nullptr;
+    }
+    std::unique_ptr<PersistentIndex> index(new PersistentIndex(dim, graph, initial_capacity));
+    index->load(std::move(file));
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOGI("📂 Opened %s: %zu vectors (%zu sealed, %zu log bytes) in %.1f ms",
+         path.c_str(), index->entries_.size(), index->file_->sealed_count(), index->file_->log_bytes(), ms);
+    return index;
+}
+
+// ===== Loading =====
+
+void PersistentIndex::load(std::shared_ptr<IndexFile> file) {
+    file_ = std::move(file);
+    const size_t n_sealed = file_->sealed_count();
+    const int64_t* sealed_keys = file_->sealed_keys();
+
+    sealed_live_.assign(n_sealed, 1);
+    for (size_t row = 0; row < n_sealed; ++row) {
+        Entry entry {};
+        entry.vector = file_->sealed_vector_offset(row);
+        file_->sealed_metadata(row, &entry.meta, &entry.meta_bytes);
+        entry.sealed_row = (int64_t) row;
+        entries_[sealed_keys[row]] = entry;
+    }
+
+    file_->replay([this](const IndexFile::Record& record) {
+        switch (record.type) {
+            case IndexFile::RECORD_INSERT:
+                drop(record.key);
+                add_log_row(record.key, record.vector_offset, record.meta_offset, record.meta_bytes);
+                break;
+            case IndexFile::RECORD_REMOVE:
+                drop(record.key);
+                break;
+            case IndexFile::RECORD_METADATA: {
+                auto it = entries_.find(record.key);
+                if (it != entries_.end()) {
+                    it->second.meta = record.meta_offset;
+                    it->second.meta_bytes = record.meta_bytes;
+                }
+                break;
+            }
+            case IndexFile::RECORD_CLEAR:
+                drop_all();
+                break;
+            default:
+                break;
+        }
+    });
+
+    if (graph_ == nullptr) {
+        return;
+    }
+
+    // Restore the saved graph over the sealed rows, then apply the log to it
+    size_t graph_bytes = 0;
+    const uint8_t* graph = file_->graph(&graph_bytes);
+    if (!graph_->import_graph(sealed_keys, file_->sealed_vectors(), n_sealed, graph, graph_bytes)) {
+        if (n_sealed > 0) {
+            LOGI("⚠️ No usable graph in %s, rebuilding it over %zu vectors", file_->path().c_str(), n_sealed);
+        }
+        graph_->clear();
+        for (size_t row = 0; row < n_sealed; ++row) {
+            graph_->insert(sealed_keys[row], file_->vector_at(file_->sealed_vector_offset(row)));
+        }
+    }
+    for (size_t row = 0; row < n_sealed; ++row) {
+        if (!sealed_live_[row]) {
+            graph_->remove(sealed_keys[row]);
+        }
+    }
+    for (size_t slot = 0; slot < log_keys_.size(); ++slot) {
+        graph_->insert(log_keys_[slot], file_->vector_at(log_vectors_[slot]));
+    }
+}
+
+void PersistentIndex::add_log_row(int64_t key, uint64_t vector, uint64_t meta, uint32_t meta_bytes) {
+    Entry entry { vector, meta, meta_bytes, -1, log_keys_.size() };
+    entries_[key] = entry;
+    log_keys_.push_back(key);
+    log_vectors_.push_back(vector);
+}
+
+bool PersistentIndex::drop(int64_t key) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        return false;
+    }
+    const Entry& entry = it->second;
+    if (entry.sealed_row >= 0) {
+        sealed_live_[entry.sealed_row] = 0;
+    } else {
+        // Swap-remove from the log rows
+        const size_t slot = entry.log_slot;
+        const size_t last = log_keys_.size() - 1;
+        if (slot != last) {
+            log_keys_[slot] = log_keys_[last];
+            log_vectors_[slot] = log_vectors_[last];
+            entries_[log_keys_[slot]].log_slot = slot;
+        }
+        log_keys_.pop_back();
+        log_vectors_.pop_back();
+    }
+    entries_.erase(it);
+    n_dead_++;
+    return true;
+}
+
+void PersistentIndex::drop_all() {
+    n_dead_ += entries_.size();
+    entries_.clear();
+    std::fill(sealed_live_.begin(), sealed_live_.end(), 0);
+    log_keys_.clear();
+    log_vectors_.clear();
+}
+
+// ===== Writes =====
+
+void PersistentIndex::insert(int64_t key, const float* vector) {
+    insert_with_metadata(key, vector, nullptr, 0);
+}
+
+bool PersistentIndex::insert_with_metadata(int64_t key, const float* vector,
+                                           const uint8_t* meta, size_t meta_bytes) {
+    std::vector<float> normalized(vector, vector + dim_);
+    vec::normalize(normalized.data(), dim_);
+
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        uint64_t vector_offset = 0;
+        uint64_t meta_offset = 0;
+        if (!file_->append_insert(key, normalized.data(), meta, (uint32_t) meta_bytes,
+                                  &vector_offset, &meta_offset)) {
+            return false;
+        }
+        drop(key);
+        add_log_row(key, vector_offset, meta_offset, (uint32_t) meta_bytes);
+    }
+    if (graph_ != nullptr) {
+        graph_->insert(key, normalized.data());
+    }
+    return true;
+}
+
+bool PersistentIndex::remove(int64_t key) {
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (entries_.find(key) == entries_.end() || !file_->append_remove(key)) {
+            return false;
+        }
+        drop(key);
+    }
+    if (graph_ != nullptr) {
+        graph_->remove(key);
+    }
+    return true;
+}
+
+void PersistentIndex::clear() {
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (!file_->append_clear()) {
+            return;
+        }
+        drop_all();
+    }
+    if (graph_ != nullptr) {
+        graph_->clear();
+    }
+}
+
+bool PersistentIndex::set_metadata(int64_t key, const uint8_t* meta, size_t meta_bytes) {
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    uint64_t meta_offset = 0;
+    if (it == entries_.end() || !file_->append_metadata(key, meta, (uint32_t) meta_bytes, &meta_offset)) {
+        return false;
+    }
+    it->second.meta = meta_offset;
+    it->second.meta_bytes = (uint32_t) meta_bytes;
+    return true;
+}
+
+// ===== Reads =====
+
+int PersistentIndex::search(const float* query, int k, float min_similarity,
+                            int64_t* out_keys, float* out_scores) const {
+    if (k <= 0) {
+        return 0;
+    }
+    if (graph_ != nullptr) {
+        return graph_->search(query, k, min_similarity, out_keys, out_scores);
+    }
+
+    std::vector<float> q(query, query + dim_);
+    vec::normalize(q.data(), dim_);
+
+    thread_local std::vector<float> scores;
+    scores.resize(kBlockRows);
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    TopK top(k, min_similarity);
+
+    // Sealed rows: contiguous in the file
+    const size_t n_sealed = sealed_live_.size();
+    const float* base = file_->sealed_vectors();
+    const int64_t* keys = file_->sealed_keys();
+    for (size_t start = 0; start < n_sealed; start += kBlockRows) {
+        const size_t n_block = std::min(kBlockRows, n_sealed - start);
+        vec::dot_rows(q.data(), base + start * dim_, n_block, dim_, scores.data());
+        for (size_t i = 0; i < n_block; ++i) {
+            if (sealed_live_[start + i]) {
+                top.offer(scores[i], keys[start + i]);
+            }
+        }
+    }
+
+    // Rows appended since the last compaction
+    for (size_t slot = 0; slot < log_keys_.size(); ++slot) {
+        top.offer(vec::dot(q.data(), file_->vector_at(log_vectors_[slot]), dim_), log_keys_[slot]);
+    }
+    return top.finish(out_keys, out_scores);
+}
+
+size_t PersistentIndex::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t PersistentIndex::memory_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t bytes = entries_.size() * (sizeof(int64_t) + sizeof(Entry) + 2 * sizeof(void*))
+                   + sealed_live_.capacity()
+                   + log_keys_.capacity() * sizeof(int64_t)
+                   + log_vectors_.capacity() * sizeof(uint64_t);
+    if (graph_ != nullptr) {
+        bytes += graph_->memory_bytes();
+    }
+    return bytes;
+}
+
+bool PersistentIndex::get_vector(int64_t key, float* out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        return false;
+    }
+    std::memcpy(out, file_->vector_at(it->second.vector), sizeof(float) * dim_);
+    return true;
+}
+
+bool PersistentIndex::get_metadata(int64_t key, std::string* out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        return false;
+    }
+    out->assign(reinterpret_cast<const char*>(file_->bytes_at(it->second.meta)), it->second.meta_bytes);
+    return true;
+}
+
+void PersistentIndex::keys(std::vector<int64_t>* out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    out->clear();
+    out->reserve(entries_.size());
+    for (const auto& entry : entries_) {
+        out->push_back(entry.first);
+    }
+}
+
+void PersistentIndex::set_ef_search(int ef) {
+    if (graph_ != nullptr) {
+        graph_->set_ef_search(ef);
+    }
+}
+
+size_t PersistentIndex::deleted_count() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return n_dead_;
+}
+
+size_t PersistentIndex::log_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return file_->log_bytes();
+}
+
+// ===== Durability =====
+
+bool PersistentIndex::sync() {
+    // Appends (which may remap the file) are held off; searches are not
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    return file_->sync();
+}
+
+bool PersistentIndex::verify() const {
+    std::shared_ptr<IndexFile> file;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        file = file_;
+    }
+    return file->verify();
+}
+
+size_t PersistentIndex::compact() {
+    // Writers wait; the file and in-memory state are stable until the swap
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    const size_t reclaimed = n_dead_;
+    if (reclaimed == 0 && file_->log_bytes() == 0) {
+        return 0;
+    }
+    const auto start = std::chrono::steady_clock::now();
+
+    // Live entries: surviving sealed rows in their order, then the log rows
+    std::vector<IndexFile::Row> rows;
+    std::vector<int64_t> keys;
+    rows.reserve(entries_.size());
+    keys.reserve(entries_.size());
+    auto add_row = [&](int64_t key) {
+        const Entry& entry = entries_.at(key);
+        rows.push_back({ key, file_->vector_at(entry.vector), file_->bytes_at(entry.meta), entry.meta_bytes });
+        keys.push_back(key);
+    };
+    const int64_t* sealed_keys = file_->sealed_keys();
+    for (size_t row = 0; row < sealed_live_.size(); ++row) {
+        if (sealed_live_[row]) {
+            add_row(sealed_keys[row]);
+        }
+    }
+    for (int64_t key : log_keys_) {
+        add_row(key);
+    }
+
+    std::vector<uint8_t> graph;
+    if (graph_ != nullptr) {
+        graph_->compact();
+        graph_->export_graph(keys, &graph);
+    }
+
+    if (!IndexFile::write(file_->path(), dim_, rows, graph)) {
+        return 0;
+    }
+    std::shared_ptr<IndexFile> next = IndexFile::open(file_->path(), dim_);
+    if (next == nullptr) {
+        return 0;
+    }
+    next->replay([](const IndexFile::Record&) {});
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    file_ = std::move(next);
+    entries_.clear();
+    sealed_live_.assign(rows.size(), 1);
+    log_keys_.clear();
+    log_vectors_.clear();
+    for (size_t row = 0; row < rows.size(); ++row) {
+        Entry entry {};
+        entry.vector = file_->sealed_vector_offset(row);
+        file_->sealed_metadata(row, &entry.meta, &entry.meta_bytes);
+        entry.sealed_row = (int64_t) row;
+        entries_[keys[row]] = entry;
+    }
+    n_dead_ = 0;
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOGI("🧹 Compacted %s: %zu live vectors, %zu records dropped in %.1f ms",
+         file_->path().c_str(), rows.size(), reclaimed, ms);
+    return reclaimed;
+}
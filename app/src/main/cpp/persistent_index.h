@@ -0,0 +1,110 @@
+/**
+ * persistent_index.h - Vector index stored in an mmap'ed IndexFile
+ *
+ * Vectors and metadata are read in place from the mapped file, so opening
+ * takes milliseconds and the data lives in the page cache rather than on a
+ * heap. Writes are appended to the file's log; compact() folds the log into
+ * a new sealed part.
+ *
+ * Exact mode scans the sealed vectors with SIMD dot products and the log
+ * vectors one by one. With HnswParams the index also keeps an HNSW graph:
+ * it is saved in the sealed part by compact() and restored on open without
+ * a rebuild (the graph copies the vectors it routes over).
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "hnsw_index.h"
+#include "index_file.h"
+#include "vector_index.h"
+
+class PersistentIndex : public VectorIndex {
+public:
+    /**
+     * Open or create the index file at `path`.
+     * @param graph HNSW parameters to keep an ANN graph, or nullptr for exact search
+     * @return nullptr if the file cannot be created or mapped
+     */
+    static std::unique_ptr<PersistentIndex> open(const std::string& path, int dim, size_t initial_capacity,
+                                                 const HnswParams* graph);
+
+    void insert(int64_t key, const float* vector) override;
+    bool insert_with_metadata(int64_t key, const float* vector,
+                              const uint8_t* meta, size_t meta_bytes) override;
+    bool remove(int64_t key) override;
+
+    /** Drops every entry; the space is reclaimed by compact(). */
+    void clear() override;
+
+    int search(const float* query, int k, float min_similarity,
+               int64_t* out_keys, float* out_scores) const override;
+
+    size_t size() const override;
+    int dim() const override { return dim_; }
+
+    /** Key tables and graph; the mapped file is not counted. */
+    size_t memory_bytes() const override;
+
+    bool get_vector(int64_t key, float* out) const override;
+
+    void set_ef_search(int ef) override;
+
+    /** Superseded or removed records still in the file */
+    size_t deleted_count() const override;
+
+    /**
+     * Rewrite the file with only live entries (and a fresh graph) in its
+     * sealed part. Writes wait until it finishes; searches do not.
+     */
+    size_t compact() override;
+
+    bool set_metadata(int64_t key, const uint8_t* meta, size_t meta_bytes) override;
+    bool get_metadata(int64_t key, std::string* out) const override;
+    void keys(std::vector<int64_t>* out) const override;
+    size_t log_bytes() const override;
+    bool sync() override;
+    bool verify() const override;
+
+    bool has_graph() const { return graph_ != nullptr; }
+
+private:
+    struct Entry {
+        uint64_t vector;        // file offset of the normalized vector
+        uint64_t meta;          // file offset of the metadata
+        uint32_t meta_bytes;
+        int64_t sealed_row;     // row in the sealed part, or -1
+        size_t log_slot;        // index into log_keys_ / log_vectors_ when not sealed
+    };
+
+    PersistentIndex(int dim, const HnswParams* graph, size_t initial_capacity);
+
+    void load(std::shared_ptr<IndexFile> file);
+    void add_log_row(int64_t key, uint64_t vector, uint64_t meta, uint32_t meta_bytes);
+    bool drop(int64_t key);
+    void drop_all();
+
+    const int dim_;
+    const HnswParams graph_params_;
+
+    // Readers take mutex_ shared. Writers hold write_mutex_ for the whole
+    // operation and mutex_ exclusively only while the in-memory state
+    // changes, so compaction (write_mutex_ only) does not block searches.
+    mutable std::shared_mutex mutex_;
+    mutable std::mutex write_mutex_;
+
+    std::shared_ptr<IndexFile> file_;
+    std::unordered_map<int64_t, Entry> entries_;
+    std::vector<uint8_t> sealed_live_;      // sealed row -> still current
+    std::vector<int64_t> log_keys_;         // live entries stored in the log
+    std::vector<uint64_t> log_vectors_;
+    size_t n_dead_ = 0;
+
+    std::unique_ptr<HnswIndex> graph_;
+};
@@ -0,0 +1,302 @@
+/**
+ * quantized_store.cpp - Quantized vector index with fp32 rescoring
+ *
+ * See quantized_store.h.
+ */
+
+#include "quantized_store.h"
+#include "vector_kernels.h"
+#include "vector_topk.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <android/log.h>
+
+#define LOG_TAG "AILive-Vector"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// Smallest fp32 file growth step, in rows
+static constexpr size_t kMinFileRows = 1024;
+
+QuantizedStore::QuantizedStore(int dim, size_t initial_capacity, const QuantizedParams& params,
+                               const std::string& rescore_path)
+    : dim_(dim), words_((dim + 63) / 64), params_(params), path_(rescore_path) {
+    if (params_.int8) {
+        codes_.reserve(initial_capacity * dim_);
+        scales_.reserve(initial_capacity);
+    }
+    if (params_.binary) {
+        bits_.reserve(initial_capacity * words_);
+    }
+    keys_.reserve(initial_capacity);
+    rows_.reserve(initial_capacity);
+
+    if (!path_.empty()) {
+        fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd_ < 0) {
+            LOGE("⚠️ Cannot open rescore file %s, keeping fp32 vectors on the heap", path_.c_str());
+        } else {
+            ensure_fp32_capacity(std::max(initial_capacity, kMinFileRows));
+        }
+    }
+}
+
+QuantizedStore::~QuantizedStore() {
+    unmap_file();
+}
+
+// ===== Public API =====
+
+void QuantizedStore::insert(int64_t key, const float* vector) {
+    std::vector<float> normalized(vector, vector + dim_);
+    vec::normalize(normalized.data(), dim_);
+
+    std::vector<int8_t> codes;
+    float scale = 0.0f;
+    if (params_.int8) {
+        codes.resize(dim_);
+        scale = vec::quantize_i8(normalized.data(), dim_, codes.data());
+    }
+    std::vector<uint64_t> bits;
+    if (params_.binary) {
+        bits.resize(words_);
+        vec::pack_signs(normalized.data(), dim_, bits.data());
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    size_t row;
+    auto it = rows_.find(key);
+    if (it != rows_.end()) {
+        row = it->second;
+    } else {
+        row = keys_.size();
+        ensure_fp32_capacity(row + 1);
+        keys_.push_back(key);
+        if (params_.int8) {
+            codes_.resize(codes_.size() + dim_);
+            scales_.push_back(0.0f);
+        }
+        if (params_.binary) {
+            bits_.resize(bits_.size() + words_);
+        }
+        rows_.emplace(key, row);
+    }
+
+    if (params_.int8) {
+        std::memcpy(codes_.data() + row * dim_, codes.data(), dim_);
+        scales_[row] = scale;
+    }
+    if (params_.binary) {
+        std::memcpy(bits_.data() + row * words_, bits.data(), sizeof(uint64_t) * words_);
+    }
+    std::memcpy(fp32_row(row), normalized.data(), sizeof(float) * dim_);
+}
+
+bool QuantizedStore::remove(int64_t key) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    auto it = rows_.find(key);
+    if (it == rows_.end()) {
+        return false;
+    }
+    const size_t row = it->second;
+    const size_t last = keys_.size() - 1;
+    rows_.erase(it);
+
+    if (row != last) {
+        if (params_.int8) {
+            std::memcpy(codes_.data() + row * dim_, codes_.data() + last * dim_, dim_);
+            scales_[row] = scales_[last];
+        }
+        if (params_.binary) {
+            std::memcpy(bits_.data() + row * words_, bits_.data() + last * words_, sizeof(uint64_t) * words_);
+        }
+        std::memcpy(fp32_row(row), fp32_row(last), sizeof(float) * dim_);
+        keys_[row] = keys_[last];
+        rows_[keys_[row]] = row;
+    }
+
+    keys_.pop_back();
+    if (params_.int8) {
+        codes_.resize(keys_.size() * dim_);
+        scales_.pop_back();
+    }
+    if (params_.binary) {
+        bits_.resize(keys_.size() * words_);
+    }
+    if (mapped_ == nullptr) {
+        heap_fp32_.resize(keys_.size() * dim_);
+    }
+    return true;
+}
+
+void QuantizedStore::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    codes_.clear();
+    scales_.clear();
+    bits_.clear();
+    keys_.clear();
+    rows_.clear();
+    heap_fp32_.clear();
+}
+
+int QuantizedStore::search(const float* query, int k, float min_similarity,
+                           int64_t* out_keys, float* out_scores) const {
+    if (k <= 0) {
+        return 0;
+    }
+
+    std::vector<float> q(query, query + dim_);
+    vec::normalize(q.data(), dim_);
+
+    std::vector<int8_t> q_codes;
+    float q_scale = 0.0f;
+    if (params_.int8) {
+        q_codes.resize(dim_);
+        q_scale = vec::quantize_i8(q.data(), dim_, q_codes.data());
+    }
+    std::vector<uint64_t> q_bits;
+    if (params_.binary) {
+        q_bits.resize(words_);
+        vec::pack_signs(q.data(), dim_, q_bits.data());
+    }
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const size_t n_rows = keys_.size();
+    if (n_rows == 0) {
+        return 0;
+    }
+
+    // 1. Hamming prefilter on sign bits
+    thread_local std::vector<int64_t> candidates;
+    const size_t n_prefilter = (size_t) k * std::max(1, params_.binary_candidates);
+    if (params_.binary && n_rows > n_prefilter) {
+        thread_local std::vector<std::pair<int, uint32_t>> distances;
+        distances.resize(n_rows);
+        for (size_t row = 0; row < n_rows; ++row) {
+            distances[row] = { vec::hamming(q_bits.data(), bits_.data() + row * words_, words_), (uint32_t) row };
+        }
+        std::nth_element(distances.begin(), distances.begin() + n_prefilter, distances.end());
+        candidates.resize(n_prefilter);
+        for (size_t i = 0; i < n_prefilter; ++i) {
+            candidates[i] = distances[i].second;
+        }
+    } else {
+        candidates.resize(n_rows);
+        std::iota(candidates.begin(), candidates.end(), 0);
+    }
+
+    // 2. int8 scoring keeps the best few per requested result
+    const int n_rescore = k * std::max(1, params_.rescore_candidates);
+    if (params_.int8 && candidates.size() > (size_t) n_rescore) {
+        TopK top(n_rescore, -std::numeric_limits<float>::infinity());
+        for (int64_t row : candidates) {
+            const int32_t dot = vec::dot_i8(q_codes.data(), codes_.data() + row * dim_, dim_);
+            top.offer(q_scale * scales_[row] * (float) dot, row);
+        }
+        thread_local std::vector<float> approx_scores;
+        approx_scores.resize(n_rescore);
+        candidates.resize(n_rescore);
+        candidates.resize(top.finish(candidates.data(), approx_scores.data()));
+    }
+
+    // 3. Exact rescoring against the fp32 vectors
+    TopK top(k, min_similarity);
+    for (int64_t row : candidates) {
+        top.offer(vec::dot(q.data(), fp32_row(row), dim_), keys_[row]);
+    }
+    return top.finish(out_keys, out_scores);
+}
+
+size_t QuantizedStore::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return keys_.size();
+}
+
+size_t QuantizedStore::memory_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return codes_.capacity()
+           + scales_.capacity() * sizeof(float)
+           + bits_.capacity() * sizeof(uint64_t)
+           + keys_.capacity() * sizeof(int64_t)
+           + rows_.size() * (sizeof(int64_t) + sizeof(size_t) + 2 * sizeof(void*))
+           + heap_fp32_.capacity() * sizeof(float);
+}
+
+bool QuantizedStore::get_vector(int64_t key, float* out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = rows_.find(key);
+    if (it == rows_.end()) {
+        return false;
+    }
+    std::memcpy(out, fp32_row(it->second), sizeof(float) * dim_);
+    return true;
+}
+
+// ===== fp32 backing =====
+
+float* QuantizedStore::fp32_row(size_t row) const {
+    float* base = mapped_ != nullptr ? mapped_ : const_cast<float*>(heap_fp32_.data());
+    return base + row * dim_;
+}
+
+void QuantizedStore::ensure_fp32_capacity(size_t rows) {
+    if (fd_ < 0) {
+        if (heap_fp32_.size() < rows * dim_) {
+            heap_fp32_.resize(rows * dim_);
+        }
+        return;
+    }
+    if (rows <= mapped_rows_) {
+        return;
+    }
+
+    const size_t new_rows = std::max({ rows, mapped_rows_ * 2, kMinFileRows });
+    if (ftruncate(fd_, (off_t) (new_rows * dim_ * sizeof(float))) == 0 && map_file(new_rows)) {
+        LOGI("📁 Rescore file %s mapped: %zu rows", path_.c_str(), new_rows);
+        return;
+    }
+
+    // Disk full or mapping failed: move what we have to the heap and carry on
+    LOGE("⚠️ Rescore file could not grow to %zu rows, falling back to heap", new_rows);
+    heap_fp32_.assign(mapped_ != nullptr ? mapped_ : nullptr,
+                      mapped_ != nullptr ? mapped_ + keys_.size() * dim_ : nullptr);
+    unmap_file();
+    heap_fp32_.resize(rows * dim_);
+}
+
+bool QuantizedStore::map_file(size_t rows) {
+    void* mapping = mmap(nullptr, rows * dim_ * sizeof(float), PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    // Rescoring touches a few scattered rows per query
+    madvise(mapping, rows * dim_ * sizeof(float), MADV_RANDOM);
+
+    if (mapped_ != nullptr) {
+        munmap(mapped_, mapped_rows_ * dim_ * sizeof(float));
+    }
+    mapped_ = static_cast<float*>(mapping);
+    mapped_rows_ = rows;
+    return true;
+}
+
+void QuantizedStore::unmap_file() {
+    if (mapped_ != nullptr) {
+        munmap(mapped_, mapped_rows_ * dim_ * sizeof(float));
+        mapped_ = nullptr;
+        mapped_rows_ = 0;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+}
@@ -0,0 +1,94 @@
+/**
+ * quantized_store.h - Quantized vector index with fp32 rescoring
+ *
+ * Keeps compact codes in RAM and the full-precision vectors in a file mapped
+ * with mmap, so they live in the page cache rather than the app heap:
+ *
+ *   - int8 tier: one signed byte per dimension plus a per-vector scale
+ *     (about 4x smaller than fp32), scored with SIMD integer dot products
+ *   - binary tier (optional): one sign bit per dimension (32x smaller),
+ *     used as a Hamming-distance prefilter
+ *
+ * A search narrows the candidates tier by tier (Hamming -> int8) and
+ * rescores the survivors against the fp32 vectors, so results match exact
+ * search as long as the true neighbours survive the quantized stages.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vector_index.h"
+
+struct QuantizedParams {
+    bool int8 = true;             // keep int8 codes
+    bool binary = false;          // keep sign bits for a Hamming prefilter
+    int binary_candidates = 64;   // rows kept by the prefilter, per requested result
+    int rescore_candidates = 4;   // rows rescored in fp32, per requested result
+};
+
+class QuantizedStore : public VectorIndex {
+public:
+    /**
+     * @param rescore_path file for the fp32 vectors (created or truncated);
+     *        when empty or unusable they are kept on the heap instead
+     */
+    QuantizedStore(int dim, size_t initial_capacity, const QuantizedParams& params,
+                   const std::string& rescore_path);
+    ~QuantizedStore() override;
+
+    QuantizedStore(const QuantizedStore&) = delete;
+    QuantizedStore& operator=(const QuantizedStore&) = delete;
+
+    void insert(int64_t key, const float* vector) override;
+
+    /**
+     * Remove `key`. The last row is moved into its slot, keeping storage dense.
+     */
+    bool remove(int64_t key) override;
+
+    void clear() override;
+
+    int search(const float* query, int k, float min_similarity,
+               int64_t* out_keys, float* out_scores) const override;
+
+    size_t size() const override;
+    int dim() const override { return dim_; }
+
+    /**
+     * Resident bytes: codes, scales, sign bits and key tables. The mmap'ed
+     * fp32 file is not counted; the kernel can drop those pages at will.
+     */
+    size_t memory_bytes() const override;
+
+    bool get_vector(int64_t key, float* out) const override;
+
+    bool is_file_backed() const { return mapped_ != nullptr; }
+
+private:
+    float* fp32_row(size_t row) const;
+    void ensure_fp32_capacity(size_t rows);
+    bool map_file(size_t rows);
+    void unmap_file();
+
+    const int dim_;
+    const int words_;   // uint64 words of sign bits per row
+    const QuantizedParams params_;
+
+    mutable std::shared_mutex mutex_;
+    std::vector<int8_t> codes_;                  // size() * dim_ int8 codes
+    std::vector<float> scales_;                  // per-row dequantization scale
+    std::vector<uint64_t> bits_;                 // size() * words_ sign bits
+    std::vector<int64_t> keys_;                  // key of each row
+    std::unordered_map<int64_t, size_t> rows_;   // key -> row
+
+    // fp32 rows for rescoring: shared mapping of `path_`, or the heap fallback
+    std::string path_;
+    int fd_ = -1;
+    float* mapped_ = nullptr;
+    size_t mapped_rows_ = 0;
+    std::vector<float> heap_fp32_;
+};
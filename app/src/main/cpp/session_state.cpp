@@ -0,0 +1,183 @@
+/**
+ * session_state.cpp - On-disk snapshots of an inference session's KV cache
+ *
+ * See session_state.h.
+ */
+
+#include "session_state.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <android/log.h>
+#include "index_file.h"   // crc32c
+
+#define LOG_TAG "AILive-LLM"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+static constexpr char kMagic[8] = { 'A', 'I', 'L', 'V', 'K', 'V', 'S', '\0' };
+static constexpr uint32_t kVersion = 3;   // 2: evicted token count, 3: KV cache types
+// GGUF header, metadata and tensor infos of the models we ship fit well within this
+static constexpr size_t kFingerprintBytes = 4 << 20;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_ctx;
+    uint32_t type_k;                // ggml_type of the K and V caches
+    uint32_t type_v;
+    uint64_t model_key;
+    uint64_t n_tokens;
+    uint64_t n_discarded;
+    uint64_t state_bytes;
+    uint32_t payload_crc;           // CRC-32C of tokens then state
+    uint32_t header_crc;            // CRC-32C of the fields above
+};
+
+static uint64_t fnv1a(uint64_t h, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        h = (h ^ data[i]) * 0x100000001B3ull;
+    }
+    return h;
+}
+
+uint64_t model_fingerprint(const char* path, const llama_model* model) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    const uint64_t n_params = llama_model_n_params(model);
+    h = fnv1a(h, reinterpret_cast<const uint8_t*>(&n_params), sizeof(n_params));
+
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGE("Cannot open %s for fingerprinting: %s", path, strerror(errno));
+        return h;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        const uint64_t size = (uint64_t) st.st_size;
+        h = fnv1a(h, reinterpret_cast<const uint8_t*>(&size), sizeof(size));
+    }
+    std::vector<uint8_t> buf(64 * 1024);
+    size_t total = 0;
+    while (total < kFingerprintBytes) {
+        const ssize_t n = ::read(fd, buf.data(), std::min(buf.size(), kFingerprintBytes - total));
+        if (n <= 0) {
+            break;
+        }
+        h = fnv1a(h, buf.data(), (size_t) n);
+        total += (size_t) n;
+    }
+    close(fd);
+    return h;
+}
+
+static bool write_all(int fd, const void* data, size_t bytes) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    while (bytes > 0) {
+        const ssize_t n = ::write(fd, p, bytes);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        bytes -= (size_t) n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void* data, size_t bytes) {
+    auto* p = static_cast<uint8_t*>(data);
+    while (bytes > 0) {
+        const ssize_t n = ::read(fd, p, bytes);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        bytes -= (size_t) n;
+    }
+    return true;
+}
+
+bool write_session_snapshot(const std::string& path, const SessionSnapshot& snapshot) {
+    SnapshotHeader h {};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.n_ctx = snapshot.n_ctx;
+    h.type_k = (uint32_t) snapshot.type_k;
+    h.type_v = (uint32_t) snapshot.type_v;
+    h.model_key = snapshot.model_key;
+    h.n_tokens = snapshot.tokens.size();
+    h.n_discarded = snapshot.n_discarded;
+    h.state_bytes = snapshot.state.size();
+    const size_t token_bytes = snapshot.tokens.size() * sizeof(llama_token);
+    h.payload_crc = crc32c(crc32c(0, snapshot.tokens.data(), token_bytes),
+                           snapshot.state.data(), snapshot.state.size());
+    h.header_crc = crc32c(0, &h, offsetof(SnapshotHeader, header_crc));
+
+    const std::string tmp_path = path + ".tmp";
+    const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOGE("❌ Cannot create %s: %s", tmp_path.c_str(), strerror(errno));
+        return false;
+    }
+    const bool written = write_all(fd, &h, sizeof(h))
+                         && write_all(fd, snapshot.tokens.data(), token_bytes)
+                         && write_all(fd, snapshot.state.data(), snapshot.state.size())
+                         && fsync(fd) == 0;
+    close(fd);
+    if (!written || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        LOGE("❌ Cannot write session snapshot %s: %s", path.c_str(), strerror(errno));
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool read_session_snapshot(const std::string& path, uint64_t model_key, uint32_t n_ctx,
+                           ggml_type type_k, ggml_type type_v, SessionSnapshot& snapshot) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;   // no snapshot yet
+    }
+    struct stat st;
+    SnapshotHeader h {};
+    bool ok = fstat(fd, &st) == 0 && read_all(fd, &h, sizeof(h))
+              && std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 && h.version == kVersion
+              && h.header_crc == crc32c(0, &h, offsetof(SnapshotHeader, header_crc));
+    if (ok && (h.model_key != model_key || h.n_ctx != n_ctx
+               || h.type_k != (uint32_t) type_k || h.type_v != (uint32_t) type_v)) {
+        LOGI("Session snapshot %s is for another model, context size or KV cache type, ignoring", path.c_str());
+        ok = false;
+    }
+    // The sizes must account for the file exactly before anything is allocated
+    ok = ok && h.n_tokens <= n_ctx
+         && sizeof(h) + h.n_tokens * sizeof(llama_token) + h.state_bytes == (uint64_t) st.st_size;
+    if (ok) {
+        snapshot.model_key = h.model_key;
+        snapshot.n_ctx = h.n_ctx;
+        snapshot.type_k = (ggml_type) h.type_k;
+        snapshot.type_v = (ggml_type) h.type_v;
+        snapshot.n_discarded = h.n_discarded;
+        snapshot.tokens.resize(h.n_tokens);
+        snapshot.state.resize(h.state_bytes);
+        ok = read_all(fd, snapshot.tokens.data(), h.n_tokens * sizeof(llama_token))
+             && read_all(fd, snapshot.state.data(), h.state_bytes)
+             && h.payload_crc == crc32c(crc32c(0, snapshot.tokens.data(), h.n_tokens * sizeof(llama_token)),
+                                        snapshot.state.data(), snapshot.state.size());
+        if (!ok) {
+            LOGE("❌ Session snapshot %s is corrupt", path.c_str());
+        }
+    }
+    close(fd);
+    return ok;
+}
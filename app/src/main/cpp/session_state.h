@@ -0,0 +1,55 @@
+/**
+ * session_state.h - On-disk snapshots of an inference session's KV cache
+ *
+ * A snapshot is the session's cached token list plus its KV sequence as
+ * serialized by llama_state_seq_get_data, so a conversation can resume
+ * after the model was freed or the app was killed without prefilling the
+ * history again:
+ *
+ *   [header]   magic, version, model key, context size, KV cache types,
+ *              token count, evicted token count, state size, CRC-32C of
+ *              everything after the header
+ *   [tokens]   n_tokens int32 (image placeholders included)
+ *   [state]    state_bytes of llama sequence state
+ *
+ * The model key fingerprints the GGUF file, so a snapshot is never applied
+ * to a different model or quantization; the context size and KV cache
+ * types (chosen by the memory planner, see context_plan.h) must match too.
+ * Files are written to a temporary name and renamed into place.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "llama.h"
+
+struct SessionSnapshot {
+    uint64_t model_key = 0;
+    uint32_t n_ctx = 0;
+    ggml_type type_k = GGML_TYPE_F16;
+    ggml_type type_v = GGML_TYPE_F16;
+    std::vector<llama_token> tokens;
+    uint64_t n_discarded = 0;   // tokens evicted after the pinned prefix (InferenceSession)
+    std::vector<uint8_t> state;
+};
+
+/**
+ * Fingerprint of a loaded model: file size, parameter count and a hash of
+ * the GGUF header and metadata (which include every tensor's name, type
+ * and shape). Cheap enough to compute on every load.
+ */
+uint64_t model_fingerprint(const char* path, const llama_model* model);
+
+/** Write atomically; false on I/O errors */
+bool write_session_snapshot(const std::string& path, const SessionSnapshot& snapshot);
+
+/**
+ * Read and verify a snapshot written for `model_key`, `n_ctx` and KV cache
+ * types `type_k`/`type_v`. Returns false if the file is missing, torn or
+ * belongs to another model/context.
+ */
+bool read_session_snapshot(const std::string& path, uint64_t model_key, uint32_t n_ctx,
+                           ggml_type type_k, ggml_type type_v, SessionSnapshot& snapshot);
@@ -0,0 +1,385 @@
+/**
+ * speculative.cpp - Draft model for speculative decoding
+ *
+ * See speculative.h.
+ */
+
+#include "speculative.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <android/log.h>
+
+#define LOG_TAG "AILive-LLM"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+static constexpr int kDraftBatch = 256;
+// Candidates kept by the draft sampler; q may be any distribution, a
+// narrow one keeps verification cheap
+static constexpr int kDraftTopK = 64;
+// Drafting stops when the draft's most likely token is less likely than this
+static constexpr float kMinDraftConfidence = 0.3f;
+// Token counts may differ by a few added special tokens at the end
+static constexpr int kMaxVocabDifference = 128;
+// N-gram lengths looked up, longest first; a single token matches too often
+static constexpr int kLookupMaxNgram = 4;
+static constexpr int kLookupMinNgram = 2;
+
+/**
+ * Same tokenizer: same type, special tokens and text for every token id
+ * both vocabularies have.
+ */
+static bool vocabs_compatible(const llama_vocab* target, const llama_vocab* draft) {
+    if (llama_vocab_type(target) != llama_vocab_type(draft)
+            || llama_vocab_get_add_bos(target) != llama_vocab_get_add_bos(draft)
+            || llama_vocab_bos(target) != llama_vocab_bos(draft)
+            || llama_vocab_eos(target) != llama_vocab_eos(draft)) {
+        return false;
+    }
+    const int n_target = llama_vocab_n_tokens(target);
+    const int n_draft = llama_vocab_n_tokens(draft);
+    if (std::abs(n_target - n_draft) > kMaxVocabDifference) {
+        return false;
+    }
+    for (int i = 0; i < std::min(n_target, n_draft); ++i) {
+        if (std::strcmp(llama_vocab_get_text(target, i), llama_vocab_get_text(draft, i)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * The main chain without repetition penalties or mirostat, and with top-k
+ * capped: any q keeps the output exact, one close to p is accepted more often.
+ */
+static llama_sampler* build_draft_chain(const SamplingParams& params) {
+    llama_sampler_chain_params chain_params = llama_sampler_chain_default_params();
+    chain_params.no_perf = true;
+    llama_sampler* sampler = llama_sampler_chain_init(chain_params);
+    const int top_k = params.top_k > 0 ? std::min(params.top_k, kDraftTopK) : kDraftTopK;
+    llama_sampler_chain_add(sampler, llama_sampler_init_top_k(top_k));
+    llama_sampler_chain_add(sampler, llama_sampler_init_min_p(params.min_p, 1));
+    llama_sampler_chain_add(sampler, llama_sampler_init_top_p(params.top_p, 1));
+    llama_sampler_chain_add(sampler, llama_sampler_init_temp(params.temperature));
+    return sampler;
+}
+
+// Index drawn with probability weights[i] / total
+static size_t sample_index(const std::vector<float>& weights, float total, std::mt19937& rng) {
+    std::uniform_real_distribution<float> uniform(0.0f, total);
+    float r = uniform(rng);
+    for (size_t i = 0; i < weights.size(); ++i) {
+        r -= weights[i];
+        if (r <= 0.0f) {
+            return i;
+        }
+    }
+    return weights.size() - 1;
+}
+
+// Candidate drawn from normalized candidates
+static size_t sample_candidate(const llama_token_data_array& cur_p, std::mt19937& rng) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    float r = uniform(rng);
+    for (size_t i = 0; i < cur_p.size; ++i) {
+        r -= cur_p.data[i].p;
+        if (r <= 0.0f) {
+            return i;
+        }
+    }
+    return cur_p.size - 1;
+}
+
+void normalize_candidates(llama_token_data_array& cur_p) {
+    float max_logit = -INFINITY;
+    for (size_t i = 0; i < cur_p.size; ++i) {
+        max_logit = std::max(max_logit, cur_p.data[i].logit);
+    }
+    float sum = 0.0f;
+    for (size_t i = 0; i < cur_p.size; ++i) {
+        cur_p.data[i].p = std::isfinite(cur_p.data[i].logit) ? std::exp(cur_p.data[i].logit - max_logit) : 0.0f;
+        sum += cur_p.data[i].p;
+    }
+    for (size_t i = 0; i < cur_p.size; ++i) {
+        cur_p.data[i].p = sum > 0.0f ? cur_p.data[i].p / sum : 1.0f / (float) cur_p.size;
+    }
+}
+
+static float probability_of(const llama_token_data* data, size_t n, llama_token id) {
+    for (size_t i = 0; i < n; ++i) {
+        if (data[i].id == id) {
+            return data[i].p;
+        }
+    }
+    return 0.0f;
+}
+
+llama_token verify_draft(const llama_token_data_array& target, const DraftToken& draft, std::mt19937& rng,
+                         bool& accepted) {
+    // u < p/q, with q > 0 since the draft sampled the token
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    const float p = probability_of(target.data, target.size, draft.id);
+    accepted = uniform(rng) * draft.p < p;
+    if (accepted) {
+        return draft.id;
+    }
+
+    std::vector<float> residual(target.size);
+    float total = 0.0f;
+    for (size_t i = 0; i < target.size; ++i) {
+        const float q = probability_of(draft.dist.data(), draft.dist.size(), target.data[i].id);
+        residual[i] = std::max(0.0f, target.data[i].p - q);
+        total += residual[i];
+    }
+    if (total <= 0.0f) {
+        // p == q up to rounding: the residual is empty, p itself is exact
+        return target.data[sample_candidate(target, rng)].id;
+    }
+    return target.data[sample_index(residual, total, rng)].id;
+}
+
+int lookup_draft(const std::vector<llama_token>& cached, llama_token last, int n_draft,
+                 std::vector<DraftToken>& out) {
+    out.clear();
+    const size_t n = cached.size() + 1;
+    auto token_at = [&cached, last](size_t i) { return i < cached.size() ? cached[i] : last; };
+
+    for (size_t ngram = kLookupMaxNgram; ngram >= (size_t) kLookupMinNgram; --ngram) {
+        if (ngram >= n) {
+            continue;
+        }
+        const size_t key = n - ngram;
+        for (size_t i = key; i-- > 0;) {
+            size_t j = 0;
+            while (j < ngram && token_at(i + j) == token_at(key + j)) {
+                j++;
+            }
+            if (j < ngram) {
+                continue;
+            }
+            for (size_t k = i + ngram; k < n && (int) out.size() < n_draft; ++k) {
+                const llama_token token = token_at(k);
+                if (token < 0) {
+                    break;   // embedding placeholders
+                }
+                DraftToken draft;
+                draft.id = token;
+                draft.p = 1.0f;
+                draft.dist.push_back({ token, 0.0f, 1.0f });
+                out.push_back(std::move(draft));
+            }
+            if (!out.empty()) {
+                return (int) out.size();
+            }
+        }
+    }
+    return 0;
+}
+
+std::unique_ptr<DraftModel> DraftModel::load(const char* path, const llama_model* target, int n_ctx, int n_seq) {
+    // Tokenizer first: rejecting e.g. an embedding model must not cost a full weight load
+    llama_model_params vocab_params = llama_model_default_params();
+    vocab_params.vocab_only = true;
+    llama_model* vocab_model = llama_model_load_from_file(path, vocab_params);
+    if (vocab_model == nullptr) {
+        LOGE("Failed to read the vocabulary of draft model %s", path);
+        return nullptr;
+    }
+    const bool compatible = vocabs_compatible(llama_model_get_vocab(target), llama_model_get_vocab(vocab_model));
+    llama_model_free(vocab_model);
+    if (!compatible) {
+        LOGE("❌ Draft model %s does not share the main model's vocabulary", path);
+        return nullptr;
+    }
+
+    std::unique_ptr<DraftModel> draft(new DraftModel());
+
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = 99;
+    draft->model_ = llama_model_load_from_file(path, model_params);
+    if (draft->model_ == nullptr) {
+        LOGE("Failed to load draft model from %s", path);
+        return nullptr;
+    }
+    if (llama_model_is_recurrent(draft->model_)) {
+        LOGE("❌ Draft model %s is recurrent; rejected drafts cannot be removed from its state", path);
+        return nullptr;
+    }
+
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = n_ctx;
+    ctx_params.n_batch = kDraftBatch;
+    ctx_params.n_ubatch = kDraftBatch;
+    ctx_params.n_threads = 4;
+    ctx_params.n_seq_max = n_seq;
+    ctx_params.kv_unified = true;
+    draft->ctx_ = llama_init_from_model(draft->model_, ctx_params);
+    if (draft->ctx_ == nullptr) {
+        LOGE("Failed to create draft context (n_ctx %d)", n_ctx);
+        return nullptr;
+    }
+
+    // Only ids both models have are drafted
+    draft->n_vocab_ = std::min(llama_vocab_n_tokens(llama_model_get_vocab(draft->model_)),
+                               llama_vocab_n_tokens(llama_model_get_vocab(target)));
+    draft->candidates_.resize(draft->n_vocab_);
+    draft->batch_capacity_ = kDraftBatch;
+    draft->batch_ = llama_batch_init(kDraftBatch, 0, 1);
+    draft->cached_.resize(n_seq);
+    draft->rng_.seed(std::random_device{}());
+    LOGI("🏎️ Draft model loaded: %s (%.0fM parameters)", path, llama_model_n_params(draft->model_) / 1e6);
+    return draft;
+}
+
+DraftModel::~DraftModel() {
+    if (sampler_ != nullptr) {
+        llama_sampler_free(sampler_);
+    }
+    if (batch_capacity_ > 0) {
+        llama_batch_free(batch_);
+    }
+    if (ctx_ != nullptr) {
+        llama_free(ctx_);
+    }
+    if (model_ != nullptr) {
+        llama_model_free(model_);
+    }
+}
+
+void DraftModel::forget(llama_seq_id seq_id) {
+    if (seq_id >= 0 && seq_id < (llama_seq_id) cached_.size()) {
+        llama_memory_seq_rm(llama_get_memory(ctx_), seq_id, -1, -1);
+        cached_[seq_id].clear();
+    }
+}
+
+/**
+ * Decode batch_. A full draft KV cache is cleared for every sequence; they
+ * catch up again on later steps.
+ */
+bool DraftModel::decode_batch() {
+    const int ret = llama_decode(ctx_, batch_);
+    if (ret == 1) {
+        LOGI("Draft KV cache full, clearing it");
+        llama_memory_clear(llama_get_memory(ctx_), true);
+        for (auto& cached : cached_) {
+            cached.clear();
+        }
+    } else if (ret != 0) {
+        LOGE("Draft decode failed, ret=%d", ret);
+    }
+    return ret == 0;
+}
+
+int DraftModel::draft(llama_seq_id seq_id, const std::vector<llama_token>& cached, llama_token last, int n_draft,
+                      const SamplingParams& params, uint64_t params_version, std::vector<DraftToken>& out) {
+    out.clear();
+    if (seq_id < 0 || seq_id >= (llama_seq_id) cached_.size() || n_draft <= 0) {
+        return 0;
+    }
+    if (sampler_ == nullptr || sampler_version_ != params_version) {
+        if (sampler_ != nullptr) {
+            llama_sampler_free(sampler_);
+        }
+        sampler_ = build_draft_chain(params);
+        sampler_version_ = params_version;
+        if (params.seed != LLAMA_DEFAULT_SEED) {
+            rng_.seed(params.seed);
+        }
+    }
+
+    // --- Catch up with the session: cached + last ---
+    std::vector<llama_token>& draft_cached = cached_[seq_id];
+    const size_t n_context = cached.size() + 1;
+    auto token_at = [&cached, last](size_t i) { return i < cached.size() ? cached[i] : last; };
+
+    size_t n_past = 0;
+    const size_t n_max = std::min(draft_cached.size(), n_context);
+    while (n_past < n_max && draft_cached[n_past] == token_at(n_past)) {
+        n_past++;
+    }
+    if (n_past == n_context) {
+        n_past--;   // the logits after the last token are needed
+    }
+    if (n_past < draft_cached.size()) {
+        if (!llama_memory_seq_rm(llama_get_memory(ctx_), seq_id, (llama_pos) n_past, -1)) {
+            forget(seq_id);
+            n_past = 0;
+        }
+        draft_cached.resize(n_past);
+    }
+
+    const size_t n_chunk = std::min(n_context - n_past, (size_t) batch_capacity_);
+    const bool caught_up = n_past + n_chunk == n_context;
+    batch_.n_tokens = 0;
+    for (size_t i = n_past; i < n_past + n_chunk; ++i) {
+        const llama_token token = token_at(i);
+        if (token < 0 || token >= n_vocab_) {
+            break;   // embeddings, or a token only the main model has: nothing to draft from
+        }
+        const int n = batch_.n_tokens++;
+        batch_.token[n] = token;
+        batch_.pos[n] = (llama_pos) i;
+        batch_.n_seq_id[n] = 1;
+        batch_.seq_id[n][0] = seq_id;
+        batch_.logits[n] = i == n_context - 1 ? 1 : 0;
+    }
+    if (batch_.n_tokens == 0 || !decode_batch()) {
+        return 0;
+    }
+    draft_cached.insert(draft_cached.end(), batch_.token, batch_.token + batch_.n_tokens);
+    if (!caught_up || batch_.n_tokens < (int) n_chunk) {
+        return 0;
+    }
+
+    // --- Draft ---
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    int idx = batch_.n_tokens - 1;
+    while ((int) out.size() < n_draft) {
+        const float* logits = llama_get_logits_ith(ctx_, idx);
+        for (int token_id = 0; token_id < n_vocab_; ++token_id) {
+            candidates_[token_id].id = token_id;
+            candidates_[token_id].logit = logits[token_id];
+            candidates_[token_id].p = 0.0f;
+        }
+        llama_token_data_array cur_p = { candidates_.data(), candidates_.size(), -1, false };
+        llama_sampler_apply(sampler_, &cur_p);
+        normalize_candidates(cur_p);
+
+        // Decided before sampling, so q stays the distribution drafts are drawn from
+        float confidence = 0.0f;
+        for (size_t i = 0; i < cur_p.size; ++i) {
+            confidence = std::max(confidence, cur_p.data[i].p);
+        }
+        if (confidence < kMinDraftConfidence) {
+            break;
+        }
+
+        DraftToken token;
+        const size_t selected = sample_candidate(cur_p, rng_);
+        token.id = cur_p.data[selected].id;
+        token.p = cur_p.data[selected].p;
+        token.dist.assign(cur_p.data, cur_p.data + cur_p.size);
+        out.push_back(std::move(token));
+        if ((int) out.size() == n_draft || llama_vocab_is_eog(vocab, out.back().id)) {
+            break;
+        }
+
+        batch_.token[0] = out.back().id;
+        batch_.pos[0] = (llama_pos) draft_cached.size();
+        batch_.n_seq_id[0] = 1;
+        batch_.seq_id[0][0] = seq_id;
+        batch_.logits[0] = 1;
+        batch_.n_tokens = 1;
+        if (!decode_batch()) {
+            break;
+        }
+        draft_cached.push_back(out.back().id);
+        idx = 0;
+    }
+    return (int) out.size();
+}
@@ -0,0 +1,111 @@
+/**
+ * speculative.h - Draft model for speculative decoding
+ *
+ * A small model sharing the main model's vocabulary proposes the next few
+ * tokens of a generating session. The scheduler decodes them behind the
+ * session's pending token in the same batch, so one main-model decode can
+ * yield several tokens.
+ *
+ * Drafted tokens are verified by rejection sampling: token x, drawn from the
+ * draft distribution q, is kept with probability min(1, p(x) / q(x)) where p
+ * is the main model's sampling distribution at that position; the first
+ * rejected token is replaced by a draw from max(0, p - q), renormalized.
+ * The output therefore follows p exactly; the draft only decides how many
+ * tokens a step produces.
+ *
+ * The draft model keeps its own KV cache, one sequence per session, and
+ * catches up with the session's cached tokens by longest common prefix
+ * before drafting.
+ *
+ * Prompt lookup drafts without a model: answers that quote their prompt
+ * (memory facts, search snippets, tool output) repeat runs of it, so the
+ * tokens that followed an earlier occurrence of the latest n-gram are a
+ * good guess. Such a draft is certain (q is one-hot), and verification
+ * accepts it with probability p(x).
+ */
+
+#pragma once
+
+#include <memory>
+#include <random>
+#include <vector>
+#include "llama.h"
+#include "llm_engine.h"
+
+// Most tokens drafted for one session per step
+static constexpr int kMaxDraftTokens = 8;
+
+/**
+ * A drafted token and the draft distribution it was sampled from.
+ */
+struct DraftToken {
+    llama_token id = LLAMA_TOKEN_NULL;
+    float p = 0.0f;                          // q(id)
+    std::vector<llama_token_data> dist;      // candidates of q, p normalized
+};
+
+class DraftModel {
+public:
+    /**
+     * Load a draft model for `target` with a context of n_ctx tokens and
+     * n_seq sequences. Returns nullptr if it fails to load or its
+     * vocabulary differs from the target's; the vocabulary is compared
+     * from a vocab-only load, before any weights are read.
+     */
+    static std::unique_ptr<DraftModel> load(const char* path, const llama_model* target, int n_ctx, int n_seq);
+    ~DraftModel();
+
+    DraftModel(const DraftModel&) = delete;
+    DraftModel& operator=(const DraftModel&) = delete;
+
+    /**
+     * Draft up to n_draft tokens continuing `cached` + `last` in sequence
+     * seq_id. Drafting stops early when the draft is unsure of the next
+     * token. A sequence far behind its session catches up one batch per
+     * call and drafts nothing meanwhile. Returns the number of tokens in
+     * `out`.
+     */
+    int draft(llama_seq_id seq_id, const std::vector<llama_token>& cached, llama_token last, int n_draft,
+              const SamplingParams& params, uint64_t params_version, std::vector<DraftToken>& out);
+
+    /** Drop a sequence, e.g. when its session is destroyed */
+    void forget(llama_seq_id seq_id);
+
+private:
+    DraftModel() = default;
+
+    bool decode_batch();
+
+    llama_model* model_ = nullptr;
+    llama_context* ctx_ = nullptr;
+    int n_vocab_ = 0;
+    std::vector<std::vector<llama_token>> cached_;   // tokens in the draft KV cache, per sequence
+
+    llama_sampler* sampler_ = nullptr;
+    uint64_t sampler_version_ = 0;
+    std::mt19937 rng_;
+
+    std::vector<llama_token_data> candidates_;
+    llama_batch batch_ = {};
+    int batch_capacity_ = 0;
+};
+
+/**
+ * Prompt lookup: propose up to n_draft tokens that followed the most recent
+ * earlier occurrence of the last n-gram (4 down to 2 tokens) of `cached` +
+ * `last`, i.e. of the prompt and output so far. Returns the number of
+ * tokens in `out`.
+ */
+int lookup_draft(const std::vector<llama_token>& cached, llama_token last, int n_draft,
+                 std::vector<DraftToken>& out);
+
+/** Set the p of each candidate to the softmax of the candidates' logits */
+void normalize_candidates(llama_token_data_array& cur_p);
+
+/**
+ * Verify `draft` against the main model's normalized candidates `target`.
+ * Returns draft.id with accepted set, or a token drawn from the residual
+ * distribution max(0, p - q).
+ */
+llama_token verify_draft(const llama_token_data_array& target, const DraftToken& draft, std::mt19937& rng,
+                         bool& accepted);
@@ -0,0 +1,32 @@
+/**
+ * utf8_util.h - UTF-8 helpers shared by the LLM and Whisper text paths
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+/**
+ * Length of the longest prefix of `text` that ends on a UTF-8 character boundary.
+ *
+ * Token pieces can end partway through a multi-byte character (byte-level
+ * BPE splits emoji and CJK across tokens); the incomplete tail must wait for
+ * the next piece before it can be shown.
+ */
+inline size_t utf8_complete_prefix(const std::string& text) {
+    const size_t len = text.size();
+    for (size_t back = 1; back <= std::min<size_t>(4, len); ++back) {
+        const unsigned char c = (unsigned char) text[len - back];
+        if ((c & 0xC0) == 0x80) {
+            continue; // continuation byte, keep looking for the lead byte
+        }
+        size_t needed = 1;
+        if ((c & 0xE0) == 0xC0) needed = 2;
+        else if ((c & 0xF0) == 0xE0) needed = 3;
+        else if ((c & 0xF8) == 0xF0) needed = 4;
+        return needed > back ? len - back : len;
+    }
+    return len;
+}
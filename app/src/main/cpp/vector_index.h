@@ -0,0 +1,103 @@
+/**
+ * vector_index.h - Common interface of the native vector indexes
+ *
+ * VectorStore (exact, brute-force SIMD scan), HnswIndex (approximate,
+ * graph search), QuantizedStore and PersistentIndex (file-backed) share it
+ * so the JNI layer can hold any of them behind one handle.
+ * Similarity is cosine: vectors are normalized on insert and on query.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class VectorIndex {
+public:
+    virtual ~VectorIndex() = default;
+
+    /**
+     * Insert or replace the vector stored under `key`. The vector is copied
+     * and normalized.
+     */
+    virtual void insert(int64_t key, const float* vector) = 0;
+
+    virtual bool remove(int64_t key) = 0;
+
+    virtual void clear() = 0;
+
+    /**
+     * Top-k most similar rows to `query` (cosine similarity), best first.
+     * Rows below `min_similarity` are skipped.
+     *
+     * @return number of results written to out_keys / out_scores (<= k)
+     */
+    virtual int search(const float* query, int k, float min_similarity,
+                       int64_t* out_keys, float* out_scores) const = 0;
+
+    /**
+     * search() for `n_queries` contiguous queries. Results for query q start
+     * at out_keys + q * k; out_counts[q] holds the number of results for it.
+     */
+    virtual void search_batch(const float* queries, int n_queries, int k, float min_similarity,
+                              int64_t* out_keys, float* out_scores, int* out_counts) const {
+        for (int q = 0; q < n_queries; ++q) {
+            out_counts[q] = search(queries + (size_t) q * dim(), k, min_similarity,
+                                   out_keys + (size_t) q * k, out_scores + (size_t) q * k);
+        }
+    }
+
+    /** Number of live (searchable) vectors */
+    virtual size_t size() const = 0;
+    virtual int dim() const = 0;
+    virtual size_t memory_bytes() const = 0;
+
+    /**
+     * Copy the stored (normalized) vector of `key` into `out`.
+     * @return false if the key is unknown or vectors are not retained
+     */
+    virtual bool get_vector(int64_t key, float* out) const { return false; }
+
+    // ===== Approximate-index tuning (no-ops for exact indexes) =====
+
+    virtual void set_ef_search(int ef) {}
+
+    /** Deleted entries still occupying space (tombstones) */
+    virtual size_t deleted_count() const { return 0; }
+
+    /**
+     * Drop deleted entries and rebuild internal structures.
+     * @return number of entries reclaimed
+     */
+    virtual size_t compact() { return 0; }
+
+    // ===== Persistence (file-backed indexes; in-memory ones keep no metadata) =====
+
+    /**
+     * insert() that also stores opaque `meta` bytes with the vector.
+     * @return false if the entry could not be stored
+     */
+    virtual bool insert_with_metadata(int64_t key, const float* vector,
+                                      const uint8_t* meta, size_t meta_bytes) {
+        insert(key, vector);
+        return true;
+    }
+
+    /** Replace the metadata of an existing key */
+    virtual bool set_metadata(int64_t key, const uint8_t* meta, size_t meta_bytes) { return false; }
+    virtual bool get_metadata(int64_t key, std::string* out) const { return false; }
+
+    /** Keys of all live entries, for rebuilding key mappings after open */
+    virtual void keys(std::vector<int64_t>* out) const {}
+
+    /** Bytes appended since the last compaction */
+    virtual size_t log_bytes() const { return 0; }
+
+    /** Flush writes to storage */
+    virtual bool sync() { return true; }
+
+    /** Check stored data against its checksums */
+    virtual bool verify() const { return true; }
+};
@@ -0,0 +1,257 @@
+/**
+ * vector_kernels.cpp - SIMD dot-product kernels for the native vector store
+ *
+ * See vector_kernels.h.
+ */
+
+#include "vector_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace vec {
+
+// ===== Scalar =====
+
+static float dot_scalar(const float* a, const float* b, int dim) {
+    float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+    int i = 0;
+    for (; i + 4 <= dim; i += 4) {
+        sum0 += a[i] * b[i];
+        sum1 += a[i + 1] * b[i + 1];
+        sum2 += a[i + 2] * b[i + 2];
+        sum3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < dim; ++i) {
+        sum0 += a[i] * b[i];
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+static int32_t dot_i8_scalar(const int8_t* a, const int8_t* b, int dim) {
+    int32_t sum = 0;
+    for (int i = 0; i < dim; ++i) {
+        sum += (int32_t) a[i] * (int32_t) b[i];
+    }
+    return sum;
+}
+
+static int hamming_scalar(const uint64_t* a, const uint64_t* b, int words) {
+    int distance = 0;
+    for (int i = 0; i < words; ++i) {
+        distance += __builtin_popcountll(a[i] ^ b[i]);
+    }
+    return distance;
+}
+
+// ===== NEON (arm64) =====
+
+#if defined(__aarch64__)
+static float dot_neon(const float* a, const float* b, int dim) {
+    // Four independent accumulators hide the FMA latency
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    float32x4_t acc2 = vdupq_n_f32(0.0f);
+    float32x4_t acc3 = vdupq_n_f32(0.0f);
+    int i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        acc2 = vfmaq_f32(acc2, vld1q_f32(a + i + 8), vld1q_f32(b + i + 8));
+        acc3 = vfmaq_f32(acc3, vld1q_f32(a + i + 12), vld1q_f32(b + i + 12));
+    }
+    for (; i + 4 <= dim; i += 4) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    float sum = vaddvq_f32(vaddq_f32(vaddq_f32(acc0, acc1), vaddq_f32(acc2, acc3)));
+    for (; i < dim; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static int32_t dot_i8_neon(const int8_t* a, const int8_t* b, int dim) {
+    int32x4_t acc = vdupq_n_s32(0);
+    int i = 0;
+#if defined(__ARM_FEATURE_DOTPROD)
+    // SDOT: 16 int8 products summed into 4 int32 lanes per instruction
+    for (; i + 16 <= dim; i += 16) {
+        acc = vdotq_s32(acc, vld1q_s8(a + i), vld1q_s8(b + i));
+    }
+#else
+    for (; i + 16 <= dim; i += 16) {
+        const int8x16_t va = vld1q_s8(a + i);
+        const int8x16_t vb = vld1q_s8(b + i);
+        acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+        acc = vpadalq_s16(acc, vmull_high_s8(va, vb));
+    }
+#endif
+    int32_t sum = vaddvq_s32(acc);
+    for (; i < dim; ++i) {
+        sum += (int32_t) a[i] * (int32_t) b[i];
+    }
+    return sum;
+}
+#endif
+
+// ===== AVX2 + FMA (x86_64, runtime-detected) =====
+
+#if defined(__x86_64__)
+__attribute__((target("avx2,fma")))
+static float dot_avx2(const float* a, const float* b, int dim) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    __m256 acc3 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 32 <= dim; i += 32) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+    }
+    for (; i + 8 <= dim; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    const __m256 acc = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+    __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+    sum4 = _mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, 0x55));
+    float sum = _mm_cvtss_f32(sum4);
+    for (; i < dim; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2")))
+static int32_t dot_i8_avx2(const int8_t* a, const int8_t* b, int dim) {
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        const __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (a + i)));
+        const __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (b + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+    }
+    __m128i sum4 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, 0x4E));
+    sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, 0xB1));
+    int32_t sum = _mm_cvtsi128_si32(sum4);
+    for (; i < dim; ++i) {
+        sum += (int32_t) a[i] * (int32_t) b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("popcnt")))
+static int hamming_popcnt(const uint64_t* a, const uint64_t* b, int words) {
+    int distance = 0;
+    for (int i = 0; i < words; ++i) {
+        distance += (int) _mm_popcnt_u64(a[i] ^ b[i]);
+    }
+    return distance;
+}
+#endif
+
+// ===== Dispatch =====
+
+using DotFn = float (*)(const float*, const float*, int);
+using DotI8Fn = int32_t (*)(const int8_t*, const int8_t*, int);
+using HammingFn = int (*)(const uint64_t*, const uint64_t*, int);
+
+struct Kernel {
+    DotFn dot;
+    DotI8Fn dot_i8;
+    HammingFn hamming;
+    const char* name;
+};
+
+static Kernel select_kernel() {
+#if defined(__aarch64__)
+    // Advanced SIMD is mandatory on arm64; popcount lowers to CNT
+    return { dot_neon, dot_i8_neon, hamming_scalar, "neon" };
+#elif defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("popcnt")) {
+        return { dot_avx2, dot_i8_avx2, hamming_popcnt, "avx2" };
+    }
+    return { dot_scalar, dot_i8_scalar, hamming_scalar, "scalar" };
+#else
+    return { dot_scalar, dot_i8_scalar, hamming_scalar, "scalar" };
+#endif
+}
+
+static const Kernel& kernel() {
+    static const Kernel selected = select_kernel();
+    return selected;
+}
+
+float dot(const float* a, const float* b, int dim) {
+    return kernel().dot(a, b, dim);
+}
+
+void dot_rows(const float* query, const float* base, size_t n_rows, int dim, float* out) {
+    const DotFn fn = kernel().dot;
+    for (size_t row = 0; row < n_rows; ++row) {
+        out[row] = fn(query, base + row * dim, dim);
+    }
+}
+
+float normalize(float* v, int dim) {
+    const float norm = std::sqrt(dot(v, v, dim));
+    if (norm > 0.0f) {
+        const float scale = 1.0f / norm;
+        for (int i = 0; i < dim; ++i) {
+            v[i] *= scale;
+        }
+    }
+    return norm;
+}
+
+int32_t dot_i8(const int8_t* a, const int8_t* b, int dim) {
+    return kernel().dot_i8(a, b, dim);
+}
+
+float quantize_i8(const float* v, int dim, int8_t* out) {
+    float max_abs = 0.0f;
+    for (int i = 0; i < dim; ++i) {
+        max_abs = std::max(max_abs, std::fabs(v[i]));
+    }
+    if (max_abs == 0.0f) {
+        std::memset(out, 0, dim);
+        return 0.0f;
+    }
+    const float scale = max_abs / 127.0f;
+    const float inv = 1.0f / scale;
+    for (int i = 0; i < dim; ++i) {
+        out[i] = (int8_t) std::lrintf(v[i] * inv);
+    }
+    return scale;
+}
+
+void pack_signs(const float* v, int dim, uint64_t* out) {
+    const int words = (dim + 63) / 64;
+    std::memset(out, 0, sizeof(uint64_t) * words);
+    for (int i = 0; i < dim; ++i) {
+        if (v[i] > 0.0f) {
+            out[i >> 6] |= 1ULL << (i & 63);
+        }
+    }
+}
+
+int hamming(const uint64_t* a, const uint64_t* b, int words) {
+    return kernel().hamming(a, b, words);
+}
+
+const char* kernel_name() {
+    return kernel().name;
+}
+
+} // namespace vec
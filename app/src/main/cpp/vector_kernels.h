@@ -0,0 +1,59 @@
+/**
+ * vector_kernels.h - SIMD dot-product kernels for the native vector store
+ *
+ * The implementation is picked once at runtime: NEON on arm64, AVX2+FMA on
+ * x86_64 CPUs that support it (emulators), portable scalar code otherwise.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vec {
+
+/**
+ * Dot product of two float vectors of length `dim`.
+ */
+float dot(const float* a, const float* b, int dim);
+
+/**
+ * Scores of `query` against `n_rows` contiguous rows of `base` (row-major,
+ * `dim` floats per row), written to `out`.
+ */
+void dot_rows(const float* query, const float* base, size_t n_rows, int dim, float* out);
+
+/**
+ * Scale `v` to unit L2 norm in place. Zero vectors are left unchanged.
+ * @return the original norm
+ */
+float normalize(float* v, int dim);
+
+/**
+ * Dot product of two int8 code vectors, accumulated in int32.
+ */
+int32_t dot_i8(const int8_t* a, const int8_t* b, int dim);
+
+/**
+ * Symmetric int8 quantization: out[i] = round(v[i] / scale), with scale
+ * chosen so max|v| maps to 127.
+ * @return the scale (v[i] ~= out[i] * scale)
+ */
+float quantize_i8(const float* v, int dim, int8_t* out);
+
+/**
+ * One bit per dimension (set when v[i] > 0), packed into (dim + 63) / 64 words.
+ */
+void pack_signs(const float* v, int dim, uint64_t* out);
+
+/**
+ * Number of differing bits between two packed sign vectors.
+ */
+int hamming(const uint64_t* a, const uint64_t* b, int words);
+
+/**
+ * Name of the selected kernel ("neon", "avx2", "scalar"), for logging.
+ */
+const char* kernel_name();
+
+} // namespace vec
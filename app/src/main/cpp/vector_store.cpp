@@ -0,0 +1,159 @@
+/**
+ * vector_store.cpp - Native in-memory vector index for AILive memory search
+ *
+ * See vector_store.h.
+ */
+
+#include "vector_store.h"
+#include "vector_kernels.h"
+#include "vector_topk.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+// Rows scored per block; 1024 x 384 floats = 1.5 MB, about one L2 slice
+static constexpr size_t kBlockRows = 1024;
+
+VectorStore::VectorStore(int dim, size_t initial_capacity) : dim_(dim) {
+    vectors_.reserve(initial_capacity * dim);
+    keys_.reserve(initial_capacity);
+    rows_.reserve(initial_capacity);
+}
+
+void VectorStore::insert(int64_t key, const float* vector) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    size_t row;
+    auto it = rows_.find(key);
+    if (it != rows_.end()) {
+        row = it->second;
+    } else {
+        row = keys_.size();
+        keys_.push_back(key);
+        vectors_.resize(vectors_.size() + dim_);
+        rows_.emplace(key, row);
+    }
+
+    float* dst = vectors_.data() + row * dim_;
+    std::memcpy(dst, vector, sizeof(float) * dim_);
+    vec::normalize(dst, dim_);
+}
+
+bool VectorStore::remove(int64_t key) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    auto it = rows_.find(key);
+    if (it == rows_.end()) {
+        return false;
+    }
+    const size_t row = it->second;
+    const size_t last = keys_.size() - 1;
+    rows_.erase(it);
+
+    if (row != last) {
+        std::memcpy(vectors_.data() + row * dim_, vectors_.data() + last * dim_, sizeof(float) * dim_);
+        keys_[row] = keys_[last];
+        rows_[keys_[row]] = row;
+    }
+    keys_.pop_back();
+    vectors_.resize(keys_.size() * dim_);
+    return true;
+}
+
+void VectorStore::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    vectors_.clear();
+    keys_.clear();
+    rows_.clear();
+}
+
+int VectorStore::search(const float* query, int k, float min_similarity,
+                        int64_t* out_keys, float* out_scores) const {
+    if (k <= 0) {
+        return 0;
+    }
+
+    std::vector<float> q(query, query + dim_);
+    vec::normalize(q.data(), dim_);
+
+    thread_local std::vector<float> scores;
+    scores.resize(kBlockRows);
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const size_t n_rows = keys_.size();
+    TopK top(k, min_similarity);
+
+    for (size_t start = 0; start < n_rows; start += kBlockRows) {
+        const size_t n_block = std::min(kBlockRows, n_rows - start);
+        vec::dot_rows(q.data(), vectors_.data() + start * dim_, n_block, dim_, scores.data());
+        for (size_t i = 0; i < n_block; ++i) {
+            top.offer(scores[i], keys_[start + i]);
+        }
+    }
+    return top.finish(out_keys, out_scores);
+}
+
+void VectorStore::search_batch(const float* queries, int n_queries, int k, float min_similarity,
+                               int64_t* out_keys, float* out_scores, int* out_counts) const {
+    if (n_queries <= 0) {
+        return;
+    }
+    if (k <= 0) {
+        std::fill(out_counts, out_counts + n_queries, 0);
+        return;
+    }
+
+    std::vector<float> q(queries, queries + (size_t) n_queries * dim_);
+    for (int i = 0; i < n_queries; ++i) {
+        vec::normalize(q.data() + (size_t) i * dim_, dim_);
+    }
+
+    std::vector<TopK> tops;
+    tops.reserve(n_queries);
+    for (int i = 0; i < n_queries; ++i) {
+        tops.emplace_back(k, min_similarity);
+    }
+
+    thread_local std::vector<float> scores;
+    scores.resize(kBlockRows);
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const size_t n_rows = keys_.size();
+
+    for (size_t start = 0; start < n_rows; start += kBlockRows) {
+        const size_t n_block = std::min(kBlockRows, n_rows - start);
+        const float* block = vectors_.data() + start * dim_;
+        for (int qi = 0; qi < n_queries; ++qi) {
+            vec::dot_rows(q.data() + (size_t) qi * dim_, block, n_block, dim_, scores.data());
+            for (size_t i = 0; i < n_block; ++i) {
+                tops[qi].offer(scores[i], keys_[start + i]);
+            }
+        }
+    }
+
+    for (int qi = 0; qi < n_queries; ++qi) {
+        out_counts[qi] = tops[qi].finish(out_keys + (size_t) qi * k, out_scores + (size_t) qi * k);
+    }
+}
+
+size_t VectorStore::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return keys_.size();
+}
+
+size_t VectorStore::memory_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return vectors_.capacity() * sizeof(float) + keys_.capacity() * sizeof(int64_t)
+           + rows_.size() * (sizeof(int64_t) + sizeof(size_t) + 2 * sizeof(void*));
+}
+
+bool VectorStore::get_vector(int64_t key, float* out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = rows_.find(key);
+    if (it == rows_.end()) {
+        return false;
+    }
+    std::memcpy(out, vectors_.data() + it->second * dim_, sizeof(float) * dim_);
+    return true;
+}
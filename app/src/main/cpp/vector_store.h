@@ -0,0 +1,53 @@
+/**
+ * vector_store.h - Native in-memory vector index for AILive memory search
+ *
+ * Embeddings are L2-normalized once on insert and kept in one contiguous
+ * row-major float buffer, with the keys in a parallel array, so cosine
+ * similarity is a single SIMD dot product per row and a search is a linear
+ * scan over cache-friendly memory followed by a partial top-k selection.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+#include "vector_index.h"
+
+class VectorStore : public VectorIndex {
+public:
+    VectorStore(int dim, size_t initial_capacity);
+
+    void insert(int64_t key, const float* vector) override;
+
+    /**
+     * Remove `key`. The last row is moved into its slot, keeping storage dense.
+     */
+    bool remove(int64_t key) override;
+
+    void clear() override;
+
+    int search(const float* query, int k, float min_similarity,
+               int64_t* out_keys, float* out_scores) const override;
+
+    /**
+     * Rows are scanned in blocks shared by all queries, so each block is
+     * loaded into cache once.
+     */
+    void search_batch(const float* queries, int n_queries, int k, float min_similarity,
+                      int64_t* out_keys, float* out_scores, int* out_counts) const override;
+
+    size_t size() const override;
+    int dim() const override { return dim_; }
+    size_t memory_bytes() const override;
+    bool get_vector(int64_t key, float* out) const override;
+
+private:
+    const int dim_;
+
+    mutable std::shared_mutex mutex_;
+    std::vector<float> vectors_;                 // size() * dim_ normalized floats
+    std::vector<int64_t> keys_;                  // key of each row
+    std::unordered_map<int64_t, size_t> rows_;   // key -> row
+};
@@ -0,0 +1,63 @@
+/**
+ * vector_topk.h - Bounded top-k selection shared by the native vector indexes
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Bounded min-heap keeping the k best (score, key) pairs seen so far.
+ */
+class TopK {
+public:
+    TopK(int k, float min_score) : k_(k), threshold_(min_score) {
+        heap_.reserve(k);
+    }
+
+    inline void offer(float score, int64_t key) {
+        if (score < threshold_) {
+            return;
+        }
+        if ((int) heap_.size() < k_) {
+            heap_.emplace_back(score, key);
+            std::push_heap(heap_.begin(), heap_.end(), Worse());
+            if ((int) heap_.size() == k_) {
+                threshold_ = std::max(threshold_, heap_.front().first);
+            }
+        } else if (score > heap_.front().first) {
+            std::pop_heap(heap_.begin(), heap_.end(), Worse());
+            heap_.back() = { score, key };
+            std::push_heap(heap_.begin(), heap_.end(), Worse());
+            threshold_ = heap_.front().first;
+        }
+    }
+
+    /**
+     * Write results best first. Returns the count.
+     */
+    int finish(int64_t* out_keys, float* out_scores) {
+        std::sort_heap(heap_.begin(), heap_.end(), Worse());
+        const int n = (int) heap_.size();
+        for (int i = 0; i < n; ++i) {
+            out_scores[i] = heap_[i].first;
+            out_keys[i] = heap_[i].second;
+        }
+        return n;
+    }
+
+private:
+    // Heap ordering that keeps the worst result on top
+    struct Worse {
+        bool operator()(const std::pair<float, int64_t>& a, const std::pair<float, int64_t>& b) const {
+            return a.first > b.first;
+        }
+    };
+
+    const int k_;
+    float threshold_;
+    std::vector<std::pair<float, int64_t>> heap_;
+};
@@ -0,0 +1,148 @@
+/**
+ * voice_activity.cpp - Energy / zero-crossing voice activity detection
+ *
+ * See voice_activity.h.
+ */
+
+#include "voice_activity.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Noise floor tracking: falls fast, rises slowly. It also creeps up during
+// speech so a sudden steady noise (a fan) cannot hold speech open forever.
+static constexpr float kNoiseRise = 0.02f;
+static constexpr float kNoiseRiseInSpeech = 0.002f;
+static constexpr float kNoiseFall = 0.3f;
+
+// Speech energy swings by syllable; a "speech" run this long whose energy
+// stays within this range is steady noise (or the floor starting too low)
+static constexpr int kSteadyCheckMs = 600;
+static constexpr float kSteadyRangeDb = 6.0f;
+
+// Zero-crossing rate of fricatives ("s", "f"); such frames keep speech going
+// at half the energy threshold but never start it
+static constexpr float kFricativeZcr = 0.3f;
+
+VoiceActivityDetector::VoiceActivityDetector(const VadParams& params) : params_(params) {
+    reset(0);
+}
+
+void VoiceActivityDetector::process(const float* samples, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        size_t take = std::min(n - i, (size_t) (kFrameSamples - frame_fill_));
+        std::copy(samples + i, samples + i + take, frame_ + frame_fill_);
+        frame_fill_ += (int) take;
+        i += take;
+        if (frame_fill_ == kFrameSamples) {
+            process_frame(frame_);
+            frame_fill_ = 0;
+        }
+    }
+}
+
+void VoiceActivityDetector::process_frame(const float* frame) {
+    float energy = 0.0f;
+    int crossings = 0;
+    for (int i = 0; i < kFrameSamples; ++i) {
+        energy += frame[i] * frame[i];
+    }
+    for (int i = 1; i < kFrameSamples; ++i) {
+        crossings += (frame[i - 1] < 0.0f) != (frame[i] < 0.0f);
+    }
+    const float db = 10.0f * log10f(energy / kFrameSamples + 1e-10f);
+    const float zcr = (float) crossings / (kFrameSamples - 1);
+
+    const uint64_t frame_start = position_;
+    position_ += kFrameSamples;
+
+    const float above = db - noise_db_;
+    bool speech = db > params_.min_energy_db && above > params_.threshold_db;
+    if (!speech && in_speech_ && db > params_.min_energy_db &&
+        above > params_.threshold_db * 0.5f && zcr > kFricativeZcr) {
+        speech = true;
+    }
+
+    if (speech) {
+        if (!in_speech_ && last_speech_ != frame_start) {
+            onset_ = frame_start;   // a new run of speech frames
+            run_min_db_ = db;
+            run_max_db_ = db;
+        }
+        last_speech_ = position_;
+        run_min_db_ = std::min(run_min_db_, db);
+        run_max_db_ = std::max(run_max_db_, db);
+        noise_db_ += kNoiseRiseInSpeech * (db - noise_db_);
+
+        if (last_speech_ - onset_ >= samples(kSteadyCheckMs) && run_max_db_ - run_min_db_ < kSteadyRangeDb) {
+            // Steady: take it as the new noise floor and drop the segment
+            noise_db_ = run_max_db_;
+            in_speech_ = false;
+            last_speech_ = onset_;
+            return;
+        }
+        if (!in_speech_ && last_speech_ - onset_ >= samples(params_.min_speech_ms)) {
+            in_speech_ = true;
+        }
+    } else {
+        noise_db_ += (db < noise_db_ ? kNoiseFall : kNoiseRise) * (db - noise_db_);
+        if (in_speech_ && position_ - last_speech_ >= samples(params_.hangover_ms)) {
+            close_segment(last_speech_);
+        }
+    }
+}
+
+void VoiceActivityDetector::close_segment(uint64_t end) {
+    VadSegment segment;
+    segment.start = speech_start();
+    segment.end = end + samples(params_.padding_ms);
+    segments_.push_back(segment);
+    last_end_ = segment.end;
+    in_speech_ = false;
+}
+
+uint64_t VoiceActivityDetector::speech_start() const {
+    // Padding never reaches back into the previous segment
+    uint64_t pad = samples(params_.padding_ms);
+    uint64_t start = onset_ > pad ? onset_ - pad : 0;
+    return std::max(start, last_end_);
+}
+
+std::vector<VadSegment> VoiceActivityDetector::take_segments() {
+    std::vector<VadSegment> out;
+    out.swap(segments_);
+    return out;
+}
+
+void VoiceActivityDetector::reset(uint64_t origin) {
+    frame_fill_ = 0;
+    position_ = origin;
+    noise_db_ = params_.min_energy_db;   // adapts within a second or two of audio
+    in_speech_ = false;
+    onset_ = origin;
+    last_speech_ = origin;
+    run_min_db_ = FLT_MAX;
+    run_max_db_ = -FLT_MAX;
+    last_end_ = 0;
+    segments_.clear();
+}
+
+void VoiceActivityDetector::finish() {
+    if (in_speech_) {
+        close_segment(last_speech_);
+    }
+}
+
+std::vector<VadSegment> VoiceActivityDetector::detect(const float* samples, size_t n, const VadParams& params) {
+    VoiceActivityDetector vad(params);
+    vad.process(samples, n);
+    vad.finish();
+
+    std::vector<VadSegment> segments = vad.take_segments();
+    for (VadSegment& segment : segments) {
+        segment.end = std::min<uint64_t>(segment.end, n);
+    }
+    return segments;
+}
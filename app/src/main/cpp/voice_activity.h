@@ -0,0 +1,91 @@
+/**
+ * voice_activity.h - Energy / zero-crossing voice activity detection
+ *
+ * Classifies 20 ms frames of 16 kHz PCM as speech when their energy rises
+ * far enough above an adaptive noise floor (unvoiced, high zero-crossing
+ * frames only extend speech that already started). Runs whose energy stays
+ * flat are re-labelled as noise and raise the floor. Onsets shorter than
+ * min_speech_ms are ignored as clicks; speech ends after hangover_ms without
+ * a speech frame. Segments are padded on both sides so word edges survive.
+ *
+ * Costs a few multiply-adds per sample, so it gates Whisper: silence and
+ * background noise never reach the encoder.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct VadParams {
+    float threshold_db = 12.0f;      // frame energy above the noise floor that counts as speech
+    float min_energy_db = -55.0f;    // frames quieter than this (dBFS) are never speech
+    int hangover_ms = 300;           // speech continues this long after the last speech frame
+    int min_speech_ms = 100;         // shorter bursts are discarded
+    int padding_ms = 200;            // added before and after each segment
+};
+
+/** Padded speech span in samples, [start, end) */
+struct VadSegment {
+    uint64_t start;
+    uint64_t end;
+};
+
+class VoiceActivityDetector {
+public:
+    static constexpr int kSampleRate = 16000;
+    static constexpr int kFrameSamples = kSampleRate / 50;   // 20 ms
+
+    explicit VoiceActivityDetector(const VadParams& params);
+
+    /**
+     * Feed samples; positions continue from the previous call. Finished
+     * segments are collected until take_segments().
+     */
+    void process(const float* samples, size_t n);
+
+    /** A segment is open (speech onset seen, hangover not yet expired) */
+    bool in_speech() const { return in_speech_; }
+
+    /** Padded start of the open segment; only meaningful while in_speech() */
+    uint64_t speech_start() const;
+
+    /** Padded end of the most recently finished segment, 0 if none */
+    uint64_t last_speech_end() const { return last_end_; }
+
+    /** Samples processed so far (plus the origin passed to reset()) */
+    uint64_t position() const { return position_; }
+
+    /** End of input: close the open segment at the last speech frame. */
+    void finish();
+
+    std::vector<VadSegment> take_segments();
+
+    /** Forget all state; the next sample is at `origin`. */
+    void reset(uint64_t origin = 0);
+
+    /** Speech segments of a complete clip, padded and clamped to [0, n). */
+    static std::vector<VadSegment> detect(const float* samples, size_t n, const VadParams& params);
+
+private:
+    void process_frame(const float* frame);
+    void close_segment(uint64_t end);
+    uint64_t samples(int ms) const { return (uint64_t) ms * kSampleRate / 1000; }
+
+    const VadParams params_;
+
+    float frame_[kFrameSamples];
+    int frame_fill_ = 0;
+    uint64_t position_ = 0;           // absolute sample index after the last processed sample
+
+    float noise_db_ = 0.0f;           // adaptive noise floor
+
+    bool in_speech_ = false;
+    uint64_t onset_ = 0;              // first speech frame of the current run (unpadded)
+    uint64_t last_speech_ = 0;        // end of the last speech frame (unpadded)
+    float run_min_db_ = 0.0f;         // energy range since onset_
+    float run_max_db_ = 0.0f;
+    uint64_t last_end_ = 0;
+    std::vector<VadSegment> segments_;
+};
@@ -0,0 +1,327 @@
+/**
+ * whisper_batch.cpp - Parallel offline transcription of recordings
+ *
+ * See whisper_batch.h.
+ */
+
+#include "whisper_batch.h"
+#include "audio_dsp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <android/log.h>
+
+#define LOG_TAG "AILive-Batch"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+static constexpr int kSampleRate = 16000;
+
+// ===== Sources =====
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGE("❌ Cannot open %s: %s", path.c_str(), strerror(errno));
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        LOGE("❌ Empty or unreadable file %s", path.c_str());
+        close(fd);
+        return nullptr;
+    }
+    void* data = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        LOGE("❌ Cannot map %s: %s", path.c_str(), strerror(errno));
+        return nullptr;
+    }
+    return std::unique_ptr<MappedFile>(new MappedFile(data, (size_t) st.st_size));
+}
+
+MappedFile::~MappedFile() {
+    munmap(data_, bytes_);
+}
+
+BatchSource MappedFile::source() const {
+    BatchSource source;
+    source.data = static_cast<const uint8_t*>(data_);
+    source.bytes = bytes_;
+    return source;
+}
+
+static uint32_t read_u32(const uint8_t* p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static uint16_t read_u16(const uint8_t* p) {
+    return (uint16_t) (p[0] | p[1] << 8);
+}
+
+/** 16-bit samples of a source, read in place */
+struct SourcePcm {
+    const int16_t* data = nullptr;
+    size_t frames = 0;
+    int channels = 1;
+    int rate = kSampleRate;
+
+    /** Length at 16 kHz */
+    size_t frames_16k() const { return (size_t) ((double) frames * kSampleRate / rate); }
+};
+
+/** @return false if a RIFF header is present but the data is not 16-bit PCM */
+static bool parse_source(const BatchSource& source, SourcePcm* out) {
+    const uint8_t* pcm = source.data;
+    size_t pcm_bytes = source.bytes;
+    int rate = source.sample_rate;
+    int channels = 1;
+
+    if (source.bytes >= 12 && memcmp(source.data, "RIFF", 4) == 0 && memcmp(source.data + 8, "WAVE", 4) == 0) {
+        int bits = 0;
+        pcm = nullptr;
+        size_t offset = 12;
+        while (offset + 8 <= source.bytes) {
+            const uint8_t* chunk = source.data + offset;
+            const size_t length = read_u32(chunk + 4);
+            const size_t body = offset + 8;
+            if (memcmp(chunk, "fmt ", 4) == 0 && body + 16 <= source.bytes) {
+                channels = read_u16(chunk + 10);
+                rate = (int) read_u32(chunk + 12);
+                bits = read_u16(chunk + 22);
+            } else if (memcmp(chunk, "data", 4) == 0) {
+                pcm = source.data + body;
+                pcm_bytes = std::min(length, source.bytes - body);
+                break;
+            }
+            offset = body + length + (length & 1);
+        }
+        if (pcm == nullptr || bits != 16 || channels <= 0) {
+            return false;
+        }
+    }
+    if (rate <= 0) return false;
+
+    // Data chunks start at even offsets, so int16 access is aligned
+    out->data = reinterpret_cast<const int16_t*>(pcm);
+    out->frames = pcm_bytes / (2 * (size_t) channels);
+    out->channels = channels;
+    out->rate = rate;
+    return true;
+}
+
+/** First channel of frames [first, first + n) as floats */
+static void read_frames(const SourcePcm& pcm, size_t first, size_t n, float* out) {
+    if (pcm.channels == 1) {
+        dsp::pcm16_to_float(pcm.data + first, n, out);
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = pcm.data[(first + i) * pcm.channels] / 32768.0f;
+    }
+}
+
+/**
+ * 16 kHz samples [start, start + length) of a source. Resampled sources are
+ * converted from a slightly wider input range so the filter has context.
+ */
+static void read_16k(const SourcePcm& pcm, size_t start, size_t length, std::vector<float>* out) {
+    if (pcm.rate == kSampleRate) {
+        out->resize(length);
+        read_frames(pcm, start, length, out->data());
+        return;
+    }
+    const double ratio = (double) pcm.rate / kSampleRate;
+    const size_t margin = (size_t) pcm.rate / 100;   // 10 ms
+    const size_t first = (size_t) (start * ratio);
+    const size_t lead = std::min(first, margin);
+    const size_t last = std::min(pcm.frames, (size_t) ((start + length) * ratio) + margin);
+    std::vector<float> input(last - (first - lead));
+    read_frames(pcm, first - lead, input.size(), input.data());
+
+    *out = dsp::Resampler::convert(input.data(), input.size(), pcm.rate, kSampleRate);
+    const size_t skip = std::min(out->size(), (size_t) (lead / ratio));
+    out->erase(out->begin(), out->begin() + skip);
+    out->resize(length, 0.0f);
+}
+
+// ===== Splitting =====
+
+struct Piece {
+    int source;
+    size_t start;    // 16 kHz samples into the source
+    size_t length;
+};
+
+/** Speech segments of a source, found in one streaming pass over it */
+static std::vector<VadSegment> detect_speech(const SourcePcm& pcm, const VadParams& params) {
+    VoiceActivityDetector vad(params);
+    dsp::Resampler resampler(pcm.rate, kSampleRate);
+    std::vector<float> chunk;
+    std::vector<float> resampled;
+    const size_t chunk_frames = (size_t) pcm.rate;   // one second
+    for (size_t first = 0; first < pcm.frames; first += chunk_frames) {
+        const size_t n = std::min(chunk_frames, pcm.frames - first);
+        chunk.resize(n);
+        read_frames(pcm, first, n, chunk.data());
+        resampled.clear();
+        resampler.process(chunk.data(), n, &resampled);
+        vad.process(resampled.data(), resampled.size());
+    }
+    vad.finish();
+
+    std::vector<VadSegment> segments = vad.take_segments();
+    for (VadSegment& segment : segments) {
+        segment.end = std::min<uint64_t>(segment.end, pcm.frames_16k());
+    }
+    return segments;
+}
+
+/**
+ * Cut a source into pieces of at most max_piece_ms: at speech segment
+ * boundaries when VAD is on (silence between pieces is dropped), else evenly.
+ */
+static void split(int source, const SourcePcm& pcm, const BatchParams& params, std::vector<Piece>* pieces) {
+    const size_t max_len = (size_t) params.max_piece_ms * kSampleRate / 1000;
+    auto add_span = [&](size_t start, size_t end) {
+        if (end <= start) return;
+        // A single span longer than a piece is cut evenly
+        const size_t n_parts = (end - start + max_len - 1) / max_len;
+        const size_t part = (end - start + n_parts - 1) / n_parts;
+        for (size_t s = start; s < end; s += part) {
+            pieces->push_back({ source, s, std::min(part, end - s) });
+        }
+    };
+
+    if (!params.use_vad) {
+        add_span(0, pcm.frames_16k());
+        return;
+    }
+
+    size_t piece_start = 0;
+    size_t piece_end = 0;
+    bool open = false;
+    for (const VadSegment& segment : detect_speech(pcm, params.vad)) {
+        if (open && segment.end - piece_start <= max_len) {
+            piece_end = segment.end;   // grow the piece, silence in between included
+            continue;
+        }
+        if (open) add_span(piece_start, piece_end);
+        piece_start = segment.start;
+        piece_end = segment.end;
+        open = true;
+    }
+    if (open) add_span(piece_start, piece_end);
+}
+
+// ===== Decoding =====
+
+/** Decode one piece with `state`; segments get timestamps from the start of the source. */
+static void decode_piece(whisper_context* ctx, whisper_state* state, const WhisperProfile& profile, int n_threads,
+                         const Piece& piece, const std::vector<float>& samples, std::vector<BatchSegment>* out) {
+    whisper_full_params params = whisper_profile_params(profile, ctx, piece.length);
+    params.n_threads = n_threads;
+    params.no_context = true;   // pieces finish out of order; none may prompt another
+
+    if (whisper_full_with_state(ctx, state, params, samples.data(), (int) samples.size()) != 0) {
+        LOGE("Batch decode failed (source %d at %zu ms)", piece.source, piece.start * 1000 / kSampleRate);
+        return;
+    }
+
+    const int64_t offset_ms = (int64_t) (piece.start * 1000 / kSampleRate);
+    const int n_segments = whisper_full_n_segments_from_state(state);
+    for (int i = 0; i < n_segments; ++i) {
+        const char* text = whisper_full_get_segment_text_from_state(state, i);
+        if (text == nullptr || text[0] == '\0') continue;
+        // Timestamps are in 10 ms units
+        out->push_back({ piece.source,
+                         offset_ms + whisper_full_get_segment_t0_from_state(state, i) * 10,
+                         offset_ms + whisper_full_get_segment_t1_from_state(state, i) * 10,
+                         text });
+    }
+}
+
+std::vector<BatchSegment> transcribe_batch(whisper_context* ctx,
+                                           const std::vector<BatchSource>& sources,
+                                           const BatchParams& params) {
+    const auto t_start = std::chrono::steady_clock::now();
+    const WhisperProfile& profile = params.profile != nullptr ? *params.profile : default_whisper_profile();
+
+    // Sources stay in their mappings; each worker converts only the piece
+    // it decodes, so memory does not grow with recording length
+    std::vector<SourcePcm> pcm(sources.size());
+    std::vector<Piece> pieces;
+    size_t total_samples = 0;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (!parse_source(sources[i], &pcm[i])) {
+            LOGW("⚠️ Source %zu is not 16-bit PCM, skipped", i);
+            continue;
+        }
+        total_samples += pcm[i].frames_16k();
+        split((int) i, pcm[i], params, &pieces);
+    }
+    if (pieces.empty()) {
+        LOGI("🔇 No speech in %zu source(s)", sources.size());
+        return {};
+    }
+
+    // Longest pieces first so no worker is left with a long tail
+    std::vector<size_t> order(pieces.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return pieces[a].length > pieces[b].length; });
+
+    const int cores = (int) std::max(1u, std::thread::hardware_concurrency());
+    const int max_parallel = params.max_parallel > 0 ? params.max_parallel : std::max(1, cores / 2);
+    const int n_workers = std::min<int>(max_parallel, (int) pieces.size());
+    const int threads_per_worker = std::max(1, std::min(profile.max_threads, cores / n_workers));
+
+    std::vector<std::vector<BatchSegment>> results(pieces.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        whisper_state* state = whisper_init_state(ctx);
+        if (state == nullptr) {
+            LOGE("Failed to allocate whisper state for a batch worker");
+            return;
+        }
+        std::vector<float> samples;
+        for (size_t i = next++; i < order.size(); i = next++) {
+            const Piece& piece = pieces[order[i]];
+            read_16k(pcm[piece.source], piece.start, piece.length, &samples);
+            decode_piece(ctx, state, profile, threads_per_worker, piece, samples, &results[order[i]]);
+        }
+        whisper_free_state(state);
+    };
+
+    std::vector<std::thread> threads;
+    for (int w = 1; w < n_workers; ++w) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    // Pieces were created in source and time order
+    std::vector<BatchSegment> segments;
+    for (std::vector<BatchSegment>& piece_segments : results) {
+        for (BatchSegment& segment : piece_segments) {
+            segments.push_back(std::move(segment));
+        }
+    }
+
+    const float elapsed_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t_start).count();
+    const float audio_ms = total_samples * 1000.0f / kSampleRate;
+    LOGI("📚 Batch: %zu source(s), %zu pieces on %d workers x %d threads, %.1f s audio in %.1f s (RTF %.3f)",
+         sources.size(), pieces.size(), n_workers, threads_per_worker,
+         audio_ms / 1000.0f, elapsed_ms / 1000.0f, audio_ms > 0 ? elapsed_ms / audio_ms : 0.0f);
+    return segments;
+}
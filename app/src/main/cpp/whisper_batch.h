@@ -0,0 +1,77 @@
+/**
+ * whisper_batch.h - Parallel offline transcription of recordings
+ *
+ * Each source (a WAV file or raw 16-bit PCM, read through mmap or a direct
+ * buffer) is converted to 16 kHz, split at voice activity boundaries into
+ * pieces of at most max_piece_ms, and the pieces of all sources are decoded
+ * by a pool of workers. Every worker owns a whisper_state on the shared,
+ * read-only model, so throughput grows with the number of cores instead of
+ * being limited to one decode at a time.
+ *
+ * Segments come back ordered by source and time, with timestamps relative
+ * to the start of their source.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "voice_activity.h"
+#include "whisper.h"
+#include "whisper_profile.h"
+
+/**
+ * Audio bytes of one source: a RIFF/WAVE file (16-bit PCM, any rate and
+ * channel count) or, without a RIFF header, raw mono 16-bit PCM at
+ * `sample_rate`. Not owned.
+ */
+struct BatchSource {
+    const uint8_t* data = nullptr;
+    size_t bytes = 0;
+    int sample_rate = 16000;   // raw PCM only
+};
+
+/** Read-only mapping of a file, unmapped on destruction */
+class MappedFile {
+public:
+    /** @return nullptr (logged) if the file cannot be opened or mapped */
+    static std::unique_ptr<MappedFile> open(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    BatchSource source() const;
+
+private:
+    MappedFile(void* data, size_t bytes) : data_(data), bytes_(bytes) {}
+
+    void* data_;
+    size_t bytes_;
+};
+
+struct BatchSegment {
+    int source;        // index into the sources passed in
+    int64_t t0_ms;     // from the start of the source
+    int64_t t1_ms;
+    std::string text;
+};
+
+struct BatchParams {
+    int max_parallel = 0;          // decoder states, 0 = half the cores
+    int max_piece_ms = 25000;      // below Whisper's 30 s window
+    bool use_vad = true;           // split at speech boundaries and skip silence
+    VadParams vad;
+    const WhisperProfile* profile = nullptr;   // default_whisper_profile() if null
+};
+
+/**
+ * Transcribe all sources. Sources that cannot be parsed yield no segments.
+ * Blocks until every piece is decoded.
+ */
+std::vector<BatchSegment> transcribe_batch(whisper_context* ctx,
+                                           const std::vector<BatchSource>& sources,
+                                           const BatchParams& params);
@@ -0,0 +1,64 @@
+/**
+ * whisper_profile.cpp - Named Whisper decoding configurations
+ *
+ * See whisper_profile.h.
+ */
+
+#include "whisper_profile.h"
+
+#include <algorithm>
+#include <thread>
+
+static constexpr int kSampleRate = 16000;
+
+static const WhisperProfile kProfiles[] = {
+    //  name          strategy                      beam threads no_ctx single fit    tokens temp_inc
+    { "command",    WHISPER_SAMPLING_GREEDY,      1,   4,      true,  true,  true,  48,    0.0f },
+    { "dictation",  WHISPER_SAMPLING_BEAM_SEARCH, 5,   4,      false, false, false, 0,     0.2f },
+    { "background", WHISPER_SAMPLING_GREEDY,      1,   2,      true,  false, true,  0,     0.0f },
+};
+
+const WhisperProfile* find_whisper_profile(const std::string& name) {
+    for (const WhisperProfile& profile : kProfiles) {
+        if (name == profile.name) return &profile;
+    }
+    return nullptr;
+}
+
+const WhisperProfile& default_whisper_profile() {
+    return kProfiles[0];
+}
+
+int whisper_profile_threads(const WhisperProfile& profile) {
+    // More threads than big cores slows the encoder down on big.LITTLE
+    const int cores = (int) std::max(1u, std::thread::hardware_concurrency());
+    return std::max(1, std::min(profile.max_threads, cores));
+}
+
+int fitted_audio_ctx(whisper_context* ctx, size_t n_samples) {
+    const int frames = (int) (n_samples * 1000 / kSampleRate / 20);
+    return std::min(((frames + 63) / 64 + 1) * 64, whisper_n_audio_ctx(ctx));
+}
+
+whisper_full_params whisper_profile_params(const WhisperProfile& profile, whisper_context* ctx, size_t n_samples) {
+    whisper_full_params params = whisper_full_default_params(profile.strategy);
+    params.print_progress = false;
+    params.print_special = false;
+    params.print_timestamps = false;
+    params.print_realtime = false;
+    params.language = "en";
+
+    params.n_threads = whisper_profile_threads(profile);
+    params.no_context = profile.no_context;
+    params.single_segment = profile.single_segment;
+    params.max_tokens = profile.max_tokens;
+    params.temperature_inc = profile.temperature_inc;
+    params.suppress_blank = true;
+    if (profile.strategy == WHISPER_SAMPLING_BEAM_SEARCH) {
+        params.beam_search.beam_size = profile.beam_size;
+    }
+    if (profile.fit_audio_ctx) {
+        params.audio_ctx = fitted_audio_ctx(ctx, n_samples);
+    }
+    return params;
+}
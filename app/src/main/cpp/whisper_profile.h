@@ -0,0 +1,54 @@
+/**
+ * whisper_profile.h - Named Whisper decoding configurations
+ *
+ * whisper_full_default_params() is tuned for transcribing long recordings on
+ * a desktop. A profile fixes the parameters that matter for on-device use:
+ *
+ *   command     short voice commands: greedy, one segment, no temperature
+ *               fallback, encoder context cut to the clip length, few tokens
+ *   dictation   longer free speech: beam search, full encoder context,
+ *               previous text as context, temperature fallback
+ *   background  transcription that must not compete with the UI or the LLM:
+ *               greedy on two threads, shortened encoder context
+ *
+ * Compare them on real recordings with WhisperBenchmark (real-time factor).
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "whisper.h"
+
+struct WhisperProfile {
+    const char* name;
+    whisper_sampling_strategy strategy;
+    int beam_size;            // beam search only
+    int max_threads;          // capped by the available cores
+    bool no_context;          // ignore text decoded by the previous call
+    bool single_segment;      // one segment for the whole clip
+    bool fit_audio_ctx;       // shrink the encoder context to the clip length
+    int max_tokens;           // per segment, 0 = unlimited
+    float temperature_inc;    // 0 disables the temperature fallback
+};
+
+/** Profile by name, or nullptr if unknown */
+const WhisperProfile* find_whisper_profile(const std::string& name);
+
+/** The "command" profile */
+const WhisperProfile& default_whisper_profile();
+
+/** Thread count for a profile on this device */
+int whisper_profile_threads(const WhisperProfile& profile);
+
+/**
+ * Encoder context covering n_samples of 16 kHz audio: 20 ms frames rounded
+ * up to 64, plus one block of margin, at most the model's context.
+ */
+int fitted_audio_ctx(whisper_context* ctx, size_t n_samples);
+
+/**
+ * whisper_full parameters for transcribing n_samples with `profile`.
+ * Print flags are off and the language is English.
+ */
+whisper_full_params whisper_profile_params(const WhisperProfile& profile, whisper_context* ctx, size_t n_samples);
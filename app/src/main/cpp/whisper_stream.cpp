@@ -0,0 +1,297 @@
+/**
+ * whisper_stream.cpp - Streaming speech-to-text on top of whisper.cpp
+ *
+ * See whisper_stream.h.
+ */
+
+#include "whisper_stream.h"
+#include "audio_dsp.h"
+#include "utf8_util.h"
+#include "whisper_profile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <android/log.h>
+
+#define LOG_TAG "AILive-Stream"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// Whisper pads shorter input and tends to hallucinate on it
+static constexpr int kMinWindowMs = 1000;
+
+// Audio kept when a window decodes to nothing, in case it holds the start of a word
+static constexpr int kKeepMs = 200;
+
+// Audio that can arrive while a full window is being decoded
+static constexpr int kRingSlackMs = 5000;
+
+std::unique_ptr<WhisperStream> WhisperStream::create(whisper_context* ctx, const WhisperStreamParams& params) {
+    whisper_state* state = whisper_init_state(ctx);
+    if (state == nullptr) {
+        LOGE("Failed to allocate whisper state for streaming");
+        return nullptr;
+    }
+    LOGI("🎙️ Streaming transcriber ready (step %d ms, window %d ms, %d threads)",
+         params.step_ms, params.max_window_ms, params.n_threads);
+    return std::unique_ptr<WhisperStream>(new WhisperStream(ctx, state, params));
+}
+
+WhisperStream::WhisperStream(whisper_context* ctx, whisper_state* state, const WhisperStreamParams& params)
+        : ctx_(ctx), state_(state), params_(params), vad_(params.vad) {
+    ring_.resize(samples(params_.max_window_ms + kRingSlackMs));
+}
+
+WhisperStream::~WhisperStream() {
+    std::lock_guard<std::mutex> lock(decode_mutex_);
+    whisper_free_state(state_);
+}
+
+void WhisperStream::push(const int16_t* pcm, size_t n) {
+    std::lock_guard<std::mutex> lock(buffer_mutex_);
+    const size_t cap = ring_.size();
+    while (n > 0) {
+        // At most one wrap per chunk
+        const size_t chunk = std::min(n, cap);
+        const size_t first = (size_t) (end_ % cap);
+        const size_t head = std::min(chunk, cap - first);
+        dsp::pcm16_to_float(pcm, head, ring_.data() + first);
+        dsp::pcm16_to_float(pcm + head, chunk - head, ring_.data());
+        appended(first, chunk);
+        pcm += chunk;
+        n -= chunk;
+    }
+}
+
+void WhisperStream::push(const float* samples, size_t n) {
+    std::lock_guard<std::mutex> lock(buffer_mutex_);
+    const size_t cap = ring_.size();
+    while (n > 0) {
+        const size_t chunk = std::min(n, cap);
+        const size_t first = (size_t) (end_ % cap);
+        const size_t head = std::min(chunk, cap - first);
+        memcpy(ring_.data() + first, samples, head * sizeof(float));
+        memcpy(ring_.data(), samples + head, (chunk - head) * sizeof(float));
+        appended(first, chunk);
+        samples += chunk;
+        n -= chunk;
+    }
+}
+
+/** Account for n samples written at ring index `first`; buffer_mutex_ held. */
+void WhisperStream::appended(size_t first, size_t n) {
+    const size_t cap = ring_.size();
+    end_ += n;
+
+    if (params_.use_vad) {
+        const size_t head = std::min(n, cap - first);
+        vad_.process(ring_.data() + first, head);
+        vad_.process(ring_.data(), n - head);
+        vad_.take_segments();   // only the open / last segment is used
+    }
+
+    if (end_ - start_ > cap) {
+        // Decoding fell behind by more than the slack; the oldest audio is lost
+        LOGW("⚠️ Stream buffer overrun, dropping %llu samples",
+             (unsigned long long) (end_ - start_ - cap));
+        start_ = end_ - cap;
+        decoded_end_ = std::max(decoded_end_, start_);
+    }
+}
+
+bool WhisperStream::decode(WhisperStreamUpdate* out, bool flush) {
+    std::lock_guard<std::mutex> decode_lock(decode_mutex_);
+
+    uint64_t begin;
+    size_t n;
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        uint64_t limit = end_;
+        if (params_.use_vad) {
+            const uint64_t speech_end = vad_.last_speech_end();
+            if (!vad_.in_speech() && speech_end <= start_) {
+                // No speech since the last commit: skip Whisper and keep
+                // only the padding that may precede the next onset
+                const uint64_t keep = samples(params_.vad.padding_ms);
+                start_ = std::max(start_, end_ > keep ? end_ - keep : 0);
+                decoded_end_ = std::max(decoded_end_, start_);
+                return false;
+            }
+            if (!vad_.in_speech() && speech_end <= end_) {
+                // Utterance over: decode up to its padded end and commit it
+                limit = speech_end;
+                flush = true;
+            }
+        }
+
+        begin = start_;
+        n = (size_t) (limit - start_);
+        if (!flush && (end_ - decoded_end_ < samples(params_.step_ms) || n < samples(kMinWindowMs))) {
+            return false;
+        }
+        if (n == 0) {
+            return false;
+        }
+
+        // Copy the window out so pushes can continue during the decode
+        const size_t cap = ring_.size();
+        const size_t first = (size_t) (begin % cap);
+        const size_t head = std::min(n, cap - first);
+        window_.resize(n);
+        memcpy(window_.data(), ring_.data() + first, head * sizeof(float));
+        memcpy(window_.data() + head, ring_.data(), (n - head) * sizeof(float));
+        decoded_end_ = limit;
+    }
+
+    auto t_start = std::chrono::steady_clock::now();
+    std::vector<Segment> segments;
+    if (!run(n, flush, &segments)) {
+        return false;
+    }
+    out->decode_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t_start).count();
+    out->window_ms = n * 1000.0f / kSampleRate;
+
+    // Commit the leading segments that the previous decode produced too. The
+    // last segment may still grow, unless enough audio follows it to end the
+    // utterance.
+    auto agreed = [&](size_t i) { return i < prev_texts_.size() && prev_texts_[i] == segments[i].text; };
+    size_t n_commit = 0;
+    while (n_commit + 1 < segments.size() && agreed(n_commit)) {
+        ++n_commit;
+    }
+    if (n_commit + 1 == segments.size() && agreed(n_commit) &&
+        n - segments[n_commit].end >= samples(params_.commit_silence_ms)) {
+        ++n_commit;
+    }
+    if (flush) {
+        n_commit = segments.size();
+    } else if (n_commit == 0 && !segments.empty() && n >= samples(params_.max_window_ms)) {
+        // Window full without agreement: keep only the last segment open
+        n_commit = segments.size() > 1 ? segments.size() - 1 : 1;
+    }
+
+    size_t advance = 0;
+    if (flush) {
+        advance = n;
+    } else if (n_commit > 0) {
+        advance = std::min(n, segments[n_commit - 1].end);
+    } else if (segments.empty() && n > samples(params_.commit_silence_ms)) {
+        advance = n - samples(kKeepMs);   // silence or noise
+    }
+
+    out->committed.clear();
+    for (size_t i = 0; i < n_commit; ++i) {
+        out->committed += segments[i].text;
+        prompt_.insert(prompt_.end(), segments[i].tokens.begin(), segments[i].tokens.end());
+    }
+    if (prompt_.size() > (size_t) params_.max_prompt_tokens) {
+        prompt_.erase(prompt_.begin(), prompt_.end() - params_.max_prompt_tokens);
+    }
+
+    // Split the open hypothesis at its longest common token prefix with the
+    // previous one
+    std::vector<whisper_token> tokens;
+    std::vector<const std::string*> pieces;
+    prev_texts_.clear();
+    for (size_t i = n_commit; i < segments.size(); ++i) {
+        prev_texts_.push_back(segments[i].text);
+        tokens.insert(tokens.end(), segments[i].tokens.begin(), segments[i].tokens.end());
+        for (const std::string& piece : segments[i].pieces) {
+            pieces.push_back(&piece);
+        }
+    }
+    size_t n_stable = 0;
+    while (n_stable < tokens.size() && n_stable < prev_tokens_.size() && tokens[n_stable] == prev_tokens_[n_stable]) {
+        ++n_stable;
+    }
+    out->stable.clear();
+    out->pending.clear();
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        (i < n_stable ? out->stable : out->pending) += *pieces[i];
+    }
+    size_t complete = utf8_complete_prefix(out->stable);
+    out->pending.insert(0, out->stable, complete, std::string::npos);
+    out->stable.resize(complete);
+    out->pending.resize(utf8_complete_prefix(out->pending));
+    prev_tokens_ = std::move(tokens);
+
+    if (flush) {
+        prev_texts_.clear();
+        prev_tokens_.clear();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(buffer_mutex_);
+        start_ = std::max(start_, begin + advance);
+        decoded_end_ = std::max(decoded_end_, start_);
+    }
+    return true;
+}
+
+bool WhisperStream::run(size_t n, bool flush, std::vector<Segment>* segments) {
+    whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    params.print_progress = false;
+    params.print_special = false;
+    params.print_timestamps = false;
+    params.print_realtime = false;
+    params.n_threads = params_.n_threads;
+    params.language = params_.language.c_str();
+    params.suppress_blank = true;
+
+    // Context comes from the committed prompt only: the previous decode
+    // covered the same audio and must not be fed back
+    params.no_context = true;
+    params.prompt_tokens = prompt_.empty() ? nullptr : prompt_.data();
+    params.prompt_n_tokens = (int) prompt_.size();
+
+    if (!flush) {
+        // Interim windows are decoded again next step; skip temperature fallback
+        params.temperature_inc = 0.0f;
+    }
+
+    if (params_.fit_audio_ctx) {
+        params.audio_ctx = fitted_audio_ctx(ctx_, n);
+    }
+
+    if (whisper_full_with_state(ctx_, state_, params, window_.data(), (int) n) != 0) {
+        LOGE("Streaming decode failed (%zu samples)", n);
+        return false;
+    }
+
+    const whisper_token eot = whisper_token_eot(ctx_);
+    const int n_segments = whisper_full_n_segments_from_state(state_);
+    segments->reserve(n_segments);
+    for (int i = 0; i < n_segments; ++i) {
+        Segment segment;
+        segment.text = whisper_full_get_segment_text_from_state(state_, i);
+
+        // Timestamps are in 10 ms units
+        int64_t t1 = whisper_full_get_segment_t1_from_state(state_, i);
+        segment.end = std::min(n, (size_t) std::max<int64_t>(0, t1) * kSampleRate / 100);
+
+        const int n_tokens = whisper_full_n_tokens_from_state(state_, i);
+        for (int j = 0; j < n_tokens; ++j) {
+            whisper_token id = whisper_full_get_token_id_from_state(state_, i, j);
+            if (id >= eot) continue;   // timestamps and other special tokens
+            segment.tokens.push_back(id);
+            segment.pieces.emplace_back(whisper_full_get_token_text_from_state(ctx_, state_, i, j));
+        }
+        if (!segment.tokens.empty()) {
+            segments->push_back(std::move(segment));
+        }
+    }
+    return true;
+}
+
+void WhisperStream::reset() {
+    std::lock_guard<std::mutex> decode_lock(decode_mutex_);
+    std::lock_guard<std::mutex> lock(buffer_mutex_);
+    start_ = end_;
+    decoded_end_ = end_;
+    vad_.reset(end_);
+    prompt_.clear();
+    prev_texts_.clear();
+    prev_tokens_.clear();
+}
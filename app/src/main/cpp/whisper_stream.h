@@ -0,0 +1,117 @@
+/**
+ * whisper_stream.h - Streaming speech-to-text on top of whisper.cpp
+ *
+ * Microphone audio is pushed in small hops into a ring buffer. Every step
+ * the uncommitted part of the buffer (a sliding window of at most
+ * max_window_ms) is re-decoded with one persistent whisper_state, prompted
+ * with the tail of the text committed so far. Segments that two consecutive
+ * decodes agree on are committed and their audio leaves the window, so words
+ * crossing a hop boundary are decoded with context on both sides.
+ *
+ * Each decode reports newly committed text plus the current hypothesis for
+ * the rest of the window, split into the prefix that matched the previous
+ * decode (stable) and the remainder (pending).
+ *
+ * With VAD enabled, pushed audio is classified as it arrives: Whisper only
+ * runs while speech is buffered, and the end of an utterance commits it
+ * at once instead of waiting for agreement.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "voice_activity.h"
+#include "whisper.h"
+
+struct WhisperStreamParams {
+    int step_ms = 500;              // new audio required between decodes
+    int max_window_ms = 10000;      // uncommitted audio decoded at once
+    int commit_silence_ms = 800;    // trailing audio after the last segment that ends an utterance
+    int max_prompt_tokens = 64;     // committed tokens fed back as prompt
+    int n_threads = 4;
+    bool fit_audio_ctx = true;      // shrink the encoder context to the window length
+    bool use_vad = true;            // skip decodes without speech, commit at utterance end
+    VadParams vad;
+    std::string language = "en";
+};
+
+struct WhisperStreamUpdate {
+    std::string committed;   // text finalized by this decode
+    std::string stable;      // hypothesis prefix unchanged since the previous decode
+    std::string pending;     // rest of the hypothesis
+    float decode_ms = 0.0f;
+    float window_ms = 0.0f;
+};
+
+class WhisperStream {
+public:
+    static constexpr int kSampleRate = 16000;
+
+    /**
+     * Create a stream on a loaded model. The context is not owned and must
+     * outlive the stream.
+     * @return nullptr if the decoder state cannot be allocated
+     */
+    static std::unique_ptr<WhisperStream> create(whisper_context* ctx, const WhisperStreamParams& params);
+
+    ~WhisperStream();
+
+    WhisperStream(const WhisperStream&) = delete;
+    WhisperStream& operator=(const WhisperStream&) = delete;
+
+    /** Append 16 kHz mono PCM. Safe to call while decode() runs. */
+    void push(const int16_t* pcm, size_t n);
+
+    /** Append 16 kHz mono samples in [-1, 1] (e.g. resampler output). */
+    void push(const float* samples, size_t n);
+
+    /**
+     * Decode the current window if at least step_ms of new audio arrived.
+     * With `flush` the whole window is decoded and committed regardless.
+     * @return false if nothing was decoded
+     */
+    bool decode(WhisperStreamUpdate* out, bool flush);
+
+    /** Drop buffered audio, hypothesis and prompt (new utterance context). */
+    void reset();
+
+    const WhisperStreamParams& params() const { return params_; }
+
+private:
+    struct Segment {
+        std::string text;
+        std::vector<whisper_token> tokens;
+        std::vector<std::string> pieces;   // token texts, for the stable/pending split
+        size_t end;                        // end sample, relative to the window
+    };
+
+    WhisperStream(whisper_context* ctx, whisper_state* state, const WhisperStreamParams& params);
+
+    bool run(size_t n, bool flush, std::vector<Segment>* segments);
+    void appended(size_t first, size_t n);
+    size_t samples(int ms) const { return (size_t) ms * kSampleRate / 1000; }
+
+    whisper_context* const ctx_;
+    whisper_state* const state_;
+    const WhisperStreamParams params_;
+
+    // Ring buffer of pushed audio. Positions are absolute sample counts:
+    // [start_, end_) is uncommitted, decoded_end_ is where the last decode stopped.
+    mutable std::mutex buffer_mutex_;
+    std::vector<float> ring_;
+    uint64_t start_ = 0;
+    uint64_t end_ = 0;
+    uint64_t decoded_end_ = 0;
+    VoiceActivityDetector vad_;
+
+    // Decoder side, owned by the thread calling decode()
+    std::mutex decode_mutex_;
+    std::vector<float> window_;
+    std::vector<whisper_token> prompt_;
+    std::vector<std::string> prev_texts_;          // uncommitted segments of the previous decode
+    std::vector<whisper_token> prev_tokens_;
+};
@@ -26,6 +26,8 @@ import com.ailive.ai.models.ModelManager
 import com.ailive.audio.AudioManager
 import com.ailive.audio.CommandRouter
 import com.ailive.audio.WhisperProcessor
+import com.ailive.audio.WhisperBenchmark
+import com.ailive.audio.KeywordSpotter
 import com.ailive.audio.WakeWordDetector
 import com.ailive.camera.CameraManager
 import com.ailive.core.AILiveCore
@@ -51,6 +53,7 @@ class MainActivity : AppCompatActivity() {
     private lateinit var audioManager: AudioManager
     private lateinit var whisperProcessor: WhisperProcessor
     private lateinit var wakeWordDetector: WakeWordDetector
+    private var keywordSpotter: KeywordSpotter? = null
     private lateinit var commandRouter: CommandRouter
 
     // UI
@@ -441,7 +444,7 @@ class MainActivity : AppCompatActivity() {
             cameraManager.startCamera(cameraPreview)
 
             // Initialize VisionManager
-            visionManager = VisionManager(aiLiveCore.hybridModelManager.llmBridge)
+            visionManager = VisionManager(aiLiveCore.hybridModelManager.llmBridge) { modelDownloadManager.getVisionProjectorFile() }
             Log.i(TAG, "✓ VisionManager initialized")
 
             val visionTool = com.ailive.personality.tools.VisionAnalysisTool(
@@ -518,8 +521,18 @@ class MainActivity : AppCompatActivity() {
                 Log.e(TAG, "❌ Whisper processor failed to initialize")
                 return
             }
+            whisperProcessor.setVadConfig(
+                WhisperProcessor.VadConfig(enabled = settings.vadEnabled, thresholdDb = settings.vadThresholdDb)
+            )
             Log.i(TAG, "✓ Whisper processor ready")
 
+            if (intent.getBooleanExtra(WhisperBenchmark.EXTRA_RUN, false)) {
+                lifecycleScope.launch {
+                    Log.i(TAG, "📊 Running Whisper benchmark...")
+                    val results = WhisperBenchmark.runAll(applicationContext, whisperProcessor)
+                    Log.i(TAG, "📊 Whisper benchmark finished: ${results.size} results (see WhisperBenchmark log)")
+                }
+            }
 
             // 2. Initialize other audio components
             wakeWordDetector = WakeWordDetector(settings.wakePhrase, aiLiveCore.ttsManager)
@@ -533,6 +546,10 @@ class MainActivity : AppCompatActivity() {
                 }
             }
 
+            whisperProcessor.onKeywordDetected = {
+                wakeWordDetector.onKeywordSpotted()
+            }
+
             whisperProcessor.onFinalResult = { text ->
                 runOnUiThread {
                     editTextCommand.setText(text)
@@ -550,6 +567,15 @@ class MainActivity : AppCompatActivity() {
                 }
             }
 
+            // Streaming hypothesis while the user is still speaking
+            whisperProcessor.onPartialResult = { stable, pending ->
+                runOnUiThread {
+                    if (!isListeningForWakeWord && (stable.isNotEmpty() || pending.isNotEmpty())) {
+                        editTextCommand.setText(stable + pending)
+                    }
+                }
+            }
+
             whisperProcessor.onReadyForSpeech = {
                 runOnUiThread {
                     statusIndicator.text = if (isListeningForWakeWord) "● LISTENING" else "● COMMAND"
@@ -608,6 +634,12 @@ class MainActivity : AppCompatActivity() {
                 }
             }
 
+            // Enroll the audio wake word spotter in the background; until it
+            // is ready the wake phrase is found in Whisper transcripts
+            lifecycleScope.launch {
+                keywordSpotter = KeywordSpotter.enroll(applicationContext, settings.wakePhrase)
+            }
+
             Log.i(TAG, "✓ Phase 2.3: Offline Audio pipeline operational")
             Log.i(TAG, "✓ Phase 2.4: TTS ready")
         } catch (e: Exception) {
@@ -619,7 +651,14 @@ class MainActivity : AppCompatActivity() {
     private fun startWakeWordListening() {
         editTextCommand.setText("")
         editTextCommand.hint = "Say \"${settings.wakePhrase}\" or type..."
-        whisperProcessor.startListening()
+        val spotter = keywordSpotter
+        if (spotter != null) {
+            // Whisper stays idle until the spotter hears the wake phrase
+            whisperProcessor.startKeywordSpotting(spotter)
+            statusIndicator.text = "● LISTENING"
+        } else {
+            whisperProcessor.startListening()
+        }
         Log.i(TAG, "Listening for wake word...")
     }
 
@@ -1006,6 +1045,7 @@ class MainActivity : AppCompatActivity() {
     override fun onDestroy() {
         super.onDestroy()
         try { if (::whisperProcessor.isInitialized) whisperProcessor.release() } catch (e: Exception) {}
+        keywordSpotter?.close()
         try { if (::cameraManager.isInitialized) cameraManager.stopCamera() } catch (e: Exception) {}
         try { if (::modelManager.isInitialized) modelManager.close() } catch (e: Exception) {} // ModelManager is deprecated, but still has a close() method
         try { if (::aiLiveCore.isInitialized) aiLiveCore.stop() } catch (e: Exception) {}
@@ -3,9 +3,21 @@ package com.ailive.ai.llm
 import android.content.Context
 import android.graphics.Bitmap
 import android.util.Log
+import com.ailive.ai.vision.VisionManager
+import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
 import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.flow.catch
+import kotlinx.coroutines.flow.flow
+import kotlinx.coroutines.flow.flowOn
+import kotlinx.coroutines.flow.onCompletion
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
 import kotlinx.coroutines.withContext
+import java.io.File
+import java.util.concurrent.ConcurrentHashMap
 
 /**
  * HybridModelManager - Manages dual GGUF models for optimal performance
@@ -35,6 +47,11 @@ class HybridModelManager(private val context: Context) {
     // Heavy model - load on demand
     private val visionModel = LLMBridge()
     private var isVisionModelLoaded = false
+
+    // Image input for the heavy model; its projector loads on the first image
+    private val visionManager by lazy {
+        VisionManager(visionModel) { modelDownloadManager.getVisionProjectorFile() }
+    }
     
     // Expose LLMBridge for compatibility with legacy code
     val llmBridge: LLMBridge
@@ -46,6 +63,15 @@ class HybridModelManager(private val context: Context) {
     // Model settings
     private var settings: ModelSettings = ModelSettings.load(context)
 
+    // KV snapshots of the chat sessions, so a conversation resumes after a
+    // model reload or app restart without prefilling its history again.
+    // Native code ignores a snapshot taken on another model, context size or KV cache type.
+    private val sessionStateDir = File(context.filesDir, "session_state")
+    private val sessionStateScope = CoroutineScope(Dispatchers.IO + SupervisorJob())
+    private val sessionStateLock = Mutex()
+    // "<model>/<session>" restored (or found without snapshot) since its model was loaded
+    private val restoredSessions = ConcurrentHashMap.newKeySet<String>()
+
     /**
      * Initialize the hybrid system
      * Loads SmolLM2 immediately, Qwen on first vision request
@@ -68,6 +94,8 @@ class HybridModelManager(private val context: Context) {
 
         if (fastModel.loadModel(fastModelPath, 2048)) {
             isFastModelLoaded = true
+            restoredSessions.clear()
+            fastModel.applySettings(settings)
             Log.i(TAG, "✅ Fast model loaded successfully!")
             Log.i(TAG, "   RAM: ~350MB")
             Log.i(TAG, "   Ready for instant chat")
@@ -104,8 +132,14 @@ class HybridModelManager(private val context: Context) {
 
         Log.i(TAG, "📂 Loading vision model: ${visionModelFile.name}")
 
-        if (visionModel.loadModel(visionModelFile.absolutePath, 4096)) {
+        // Hot swap: the fast model keeps answering while Qwen loads and warms up.
+        // If both cannot fit in memory at once, fall back to a cold reload.
+        val loaded = visionModel.swapModel(visionModelFile.absolutePath, 4096) ||
+            visionModel.loadModel(visionModelFile.absolutePath, 4096)
+        if (loaded) {
             isVisionModelLoaded = true
+            restoredSessions.clear()
+            visionModel.applySettings(settings)
             Log.i(TAG, "✅ Vision model loaded successfully!")
             Log.i(TAG, "   RAM: ~1.2GB")
             Log.i(TAG, "   Total RAM: ~1.5GB (both models)")
@@ -174,10 +208,14 @@ class HybridModelManager(private val context: Context) {
     suspend fun generateStreaming(
         prompt: String,
         image: Bitmap? = null,
-        agentName: String = "AILive"
+        agentName: String = "AILive",
+        sessionName: String? = null,
+        pinnedPrefix: String? = null,
+        speculation: Int = LLMBridge.SPECULATION_AUTO
     ): Flow<String> {
         // Reload settings
         settings = ModelSettings.load(context)
+        llmBridge.applySettings(settings)
 
         val hasImage = image != null
         val useFastModel = shouldUseFastModel(prompt, hasImage)
@@ -185,47 +223,96 @@ class HybridModelManager(private val context: Context) {
         return if (useFastModel && isFastModelLoaded) {
             // Fast path: SmolLM2 instant response
             Log.i(TAG, "⚡ Using fast model (SmolLM2)")
-            generateWithFastModel(prompt)
+            generateWithFastModel(prompt, sessionName, pinnedPrefix, speculation)
         } else {
             // Complex path: Qwen2-VL for vision/reasoning
             Log.i(TAG, "🎨 Using vision model (Qwen2-VL)")
             ensureVisionModelLoaded()
-            generateWithVisionModel(prompt, image)
+            generateWithVisionModel(prompt, image, sessionName, pinnedPrefix, speculation)
         }
     }
 
     /**
      * Generate with fast model (SmolLM2)
+     * Streams pieces as they are sampled
+     *
+     * @param sessionName Named native session (own KV cache), or null for the default chat session
+     * @param pinnedPrefix Start of [prompt] kept when the conversation outgrows the context window
+     * @param speculation LLMBridge.SPECULATION_* mode
      */
-    private suspend fun generateWithFastModel(prompt: String): Flow<String> {
-        return kotlinx.coroutines.flow.flow {
-            try {
-                val result = fastModel.generate(prompt, settings.maxTokens)
-                emit(result)
-            } catch (e: Exception) {
+    private suspend fun generateWithFastModel(
+        prompt: String,
+        sessionName: String?,
+        pinnedPrefix: String?,
+        speculation: Int
+    ): Flow<String> {
+        val session = sessionName?.let { fastModel.sessionFor(it) } ?: LLMBridge.DEFAULT_SESSION
+        pinnedPrefix?.let { fastModel.setPinnedPrefix(session, it) }
+        restoreSessionOnce(fastModel, "fast", sessionName, session)
+        return fastModel.generateFlow(prompt, settings.maxTokens, session, speculation)
+            .onCompletion { cause -> if (cause == null) saveSessionInBackground(fastModel, "fast", sessionName, session) }
+            .catch { e ->
                 Log.e(TAG, "❌ Fast model error", e)
                 emit("[Error: ${e.message}]")
             }
-        }
     }
 
     /**
      * Generate with vision model (Qwen2-VL)
+     * Streams pieces as they are sampled; with an [image] the answer comes
+     * from VisionManager in one piece, outside the named sessions.
      */
-    private suspend fun generateWithVisionModel(prompt: String, image: Bitmap?): Flow<String> {
-        return kotlinx.coroutines.flow.flow {
-            try {
-                if (image != null) {
-                    Log.w(TAG, "⚠️ Vision input not yet fully supported")
-                    Log.i(TAG, "   Generating text-only response...")
+    private suspend fun generateWithVisionModel(
+        prompt: String,
+        image: Bitmap?,
+        sessionName: String?,
+        pinnedPrefix: String?,
+        speculation: Int
+    ): Flow<String> {
+        if (image != null) {
+            return flow { emit(visionManager.generateResponseWithImage(image, prompt, settings.maxTokens)) }
+                .flowOn(Dispatchers.IO)
+                .catch { e ->
+                    Log.e(TAG, "❌ Vision model error", e)
+                    emit("[Error: ${e.message}]")
                 }
+        }
 
-                val result = visionModel.generate(prompt, settings.maxTokens)
-                emit(result)
-            } catch (e: Exception) {
+        val session = sessionName?.let { visionModel.sessionFor(it) } ?: LLMBridge.DEFAULT_SESSION
+        pinnedPrefix?.let { visionModel.setPinnedPrefix(session, it) }
+        restoreSessionOnce(visionModel, "vision", sessionName, session)
+        return visionModel.generateFlow(prompt, settings.maxTokens, session, speculation)
+            .onCompletion { cause -> if (cause == null) saveSessionInBackground(visionModel, "vision", sessionName, session) }
+            .catch { e ->
                 Log.e(TAG, "❌ Vision model error", e)
                 emit("[Error: ${e.message}]")
             }
+    }
+
+    private fun sessionStateFile(model: String, sessionName: String?): File =
+        File(sessionStateDir, "$model-${sessionName ?: "chat"}.kvs")
+
+    /**
+     * Restore a session's KV cache from its snapshot, once per model load
+     */
+    private suspend fun restoreSessionOnce(bridge: LLMBridge, model: String, sessionName: String?, session: Int) {
+        if (!restoredSessions.add("$model/${sessionName ?: "chat"}")) return
+        withContext(Dispatchers.IO) {
+            sessionStateLock.withLock {
+                bridge.restoreSessionState(session, sessionStateFile(model, sessionName))
+            }
+        }
+    }
+
+    /**
+     * Snapshot a session after a turn, off the generating thread
+     */
+    private fun saveSessionInBackground(bridge: LLMBridge, model: String, sessionName: String?, session: Int) {
+        sessionStateScope.launch {
+            sessionStateLock.withLock {
+                sessionStateDir.mkdirs()
+                bridge.saveSessionState(session, sessionStateFile(model, sessionName))
+            }
         }
     }
 
@@ -253,6 +340,7 @@ class HybridModelManager(private val context: Context) {
             Log.i(TAG, "🗑️ Freeing vision model to save memory...")
             visionModel.free()
             isVisionModelLoaded = false
+            restoredSessions.clear()
             Log.i(TAG, "✅ Vision model freed (~1.2GB released)")
         }
     }
@@ -275,6 +363,7 @@ class HybridModelManager(private val context: Context) {
             Log.i(TAG, "   Vision model freed")
         }
 
+        restoredSessions.clear()
         Log.i(TAG, "✅ All models freed")
     }
 
@@ -308,6 +397,7 @@ class HybridModelManager(private val context: Context) {
      */
     fun reloadSettings() {
         settings = ModelSettings.load(context)
+        llmBridge.applySettings(settings)
         Log.i(TAG, "⚙️ Settings reloaded")
     }
 }
@@ -1,6 +1,14 @@
 package com.ailive.ai.llm
 
 import android.util.Log
+import java.io.File
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.channels.trySendBlocking
+import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.flow.channelFlow
+import kotlinx.coroutines.flow.flowOn
+import kotlinx.coroutines.suspendCancellableCoroutine
+import kotlin.coroutines.resume
 
 /**
  * LLMBridge - JNI interface to native llama.cpp library
@@ -12,9 +20,28 @@ import android.util.Log
  */
 class LLMBridge {
 
+    // Named session handles created by sessionFor()
+    private val namedSessions = mutableMapOf<String, Int>()
+
     companion object {
         private const val TAG = "LLMBridge"
 
+        /** Session used by the calls without a session argument (always valid while loaded) */
+        const val DEFAULT_SESSION = 0
+
+        /** Tokens drafted per step by a draft model */
+        const val DEFAULT_DRAFT_TOKENS = 4
+
+        /** Speculative decoding per request (native Speculation) */
+        const val SPECULATION_OFF = 0
+        const val SPECULATION_AUTO = 1            // draft model if attached
+        const val SPECULATION_PROMPT_LOOKUP = 2   // copy runs of the prompt/output; for answers quoting context
+
+        /** Embedding pooling modes (llama_pooling_type) */
+        const val POOLING_DEFAULT = -1
+        const val POOLING_MEAN = 1
+        const val POOLING_CLS = 2
+
         @Volatile
         private var isLibraryLoaded = false
         private var libraryLoadError: String? = null
@@ -48,6 +75,27 @@ class LLMBridge {
         fun getLibraryError(): String? = libraryLoadError
     }
 
+    /**
+     * Receives generated text pieces from native code as they are sampled
+     *
+     * Called on the generating thread. Each piece is complete UTF-8 text.
+     * Return false to stop generation early.
+     */
+    fun interface TokenCallback {
+        fun onToken(piece: String): Boolean
+    }
+
+    /**
+     * Receives progress of [nativeLoadModelAsync], on the native loading thread
+     */
+    interface ModelLoadListener {
+        /** Fraction of tensors loaded (0..1); return false to cancel */
+        fun onProgress(progress: Float): Boolean
+
+        /** Model loaded and warmed up, or the load failed or was cancelled */
+        fun onLoaded(success: Boolean)
+    }
+
     /**
      * Load GGUF model from file path
      *
@@ -57,6 +105,65 @@ class LLMBridge {
      */
     external fun nativeLoadModel(modelPath: String, contextSize: Int = 2048): Boolean
 
+    /**
+     * Load GGUF model on a native worker thread; returns immediately
+     *
+     * @param useMlock Pin the weights in RAM so memory pressure cannot page them out
+     * @param warmup Decode once after loading so the first prompt runs at full speed
+     * @param memoryBudgetBytes RAM for weights plus context; KV cache type, batch sizes
+     *        and if need be the context size are chosen to fit (0 = no budget)
+     * @param listener Progress and completion, called on the loading thread
+     * @return false if the load could not be started
+     */
+    external fun nativeLoadModelAsync(
+        modelPath: String,
+        contextSize: Int,
+        useMlock: Boolean,
+        warmup: Boolean,
+        memoryBudgetBytes: Long,
+        listener: ModelLoadListener
+    ): Boolean
+
+    /**
+     * Replace the loaded model without downtime: the current model keeps
+     * serving while the new one loads and warms up in the background, then
+     * the two are swapped atomically. Generations already running finish on
+     * the old model, which is freed afterwards. Session handles of the old
+     * model become invalid ([sessionFor] creates new ones).
+     *
+     * @return false if the load could not be started, or if both models would
+     *         not fit in memory at once (the current model stays loaded)
+     */
+    external fun nativeSwapModelAsync(
+        modelPath: String, contextSize: Int, useMlock: Boolean, memoryBudgetBytes: Long, listener: ModelLoadListener
+    ): Boolean
+
+    /**
+     * Plan the context a model would get under a memory budget, reading only
+     * its metadata (no weights are loaded)
+     *
+     * @return { nCtx, nBatch, nUbatch, typeK, typeV, flashAttn, weightsBytes, kvBytes, computeBytes },
+     *         or null if not even a small context fits
+     */
+    external fun nativePlanContext(modelPath: String, contextSize: Int, memoryBudgetBytes: Long): LongArray?
+
+    /**
+     * Context plan of the loaded model, same layout as [nativePlanContext]
+     */
+    external fun nativeGetContextPlan(): LongArray?
+
+    /**
+     * Cancel a load started by [nativeLoadModelAsync] or [nativeSwapModelAsync]
+     */
+    external fun nativeCancelLoad()
+
+    /**
+     * Get load timings of the current model
+     *
+     * @return { modelUs, contextUs, warmupUs, totalUs, firstTokenUs (-1 = no generation yet) }
+     */
+    external fun nativeGetLoadTimings(): LongArray
+
     /**
      * Generate text completion
      * 
@@ -93,9 +200,117 @@ class LLMBridge {
      */
     external fun nativeGenerate(prompt: String, maxTokens: Int = 80): String
 
+    /**
+     * Generate text completion, streaming pieces to [callback] as they are sampled
+     *
+     * @param prompt Input text
+     * @param maxTokens Maximum tokens to generate
+     * @param callback Receives each piece; return false to cancel
+     * @return The complete generated text
+     */
+    external fun nativeGenerateStream(prompt: String, maxTokens: Int, callback: TokenCallback): String
+
+    /**
+     * Create an inference session with its own KV cache sequence
+     *
+     * @return Session handle, or -1 if no model is loaded or all slots are in use
+     */
+    external fun nativeCreateSession(): Int
+
+    /**
+     * Destroy a session created with [nativeCreateSession]
+     *
+     * @return false for the default session, unknown handles or a busy session
+     */
+    external fun nativeDestroySession(session: Int): Boolean
+
+    /**
+     * Check whether a session handle is still valid (handles are invalidated by model reloads)
+     */
+    external fun nativeIsSessionActive(session: Int): Boolean
+
+    /**
+     * Save a session's KV cache and tokens to a snapshot file (blocking I/O)
+     *
+     * @return false if the session is empty, generating, or the write failed
+     */
+    external fun nativeSaveSessionState(session: Int, path: String): Boolean
+
+    /**
+     * Pin the text every prompt of a session starts with (the system prompt);
+     * when the conversation outgrows the context window its oldest turns are
+     * evicted natively and this prefix is kept
+     */
+    external fun nativeSetPinnedPrefix(session: Int, prefix: String): Boolean
+
+    /**
+     * Attach a draft model (same tokenizer, much smaller) for speculative
+     * decoding; it is freed with the model
+     *
+     * @param nDraft Tokens drafted per session and step (at most 8)
+     * @return false if no model is loaded or the draft's vocabulary differs
+     */
+    external fun nativeLoadDraftModel(path: String, nDraft: Int): Boolean
+
+    /**
+     * Detach and free the draft model
+     */
+    external fun nativeFreeDraftModel()
+
+    /**
+     * Get speculative decoding statistics
+     *
+     * @return { steps, draftedTokens, acceptedTokens, draftTimeUs, sampledTokens, decodeTimeUs,
+     *           lookupSteps, lookupDraftedTokens, lookupAcceptedTokens }
+     */
+    external fun nativeGetSpeculativeStats(): LongArray
+
+    /**
+     * Restore a session from a snapshot taken on the same model, context size and KV cache type
+     *
+     * @return Number of tokens restored (their prefill is skipped), or -1
+     */
+    external fun nativeRestoreSessionState(session: Int, path: String): Int
+
+    /**
+     * Generate text completion in a specific session
+     *
+     * @param session Handle from [nativeCreateSession] or [DEFAULT_SESSION]
+     * @param speculation One of the SPECULATION_* modes
+     */
+    external fun nativeGenerateSession(session: Int, prompt: String, maxTokens: Int, speculation: Int): String
+
+    /**
+     * Streaming generation in a specific session
+     *
+     * @param session Handle from [nativeCreateSession] or [DEFAULT_SESSION]
+     * @param speculation One of the SPECULATION_* modes
+     */
+    external fun nativeGenerateSessionStream(
+        session: Int,
+        prompt: String,
+        maxTokens: Int,
+        speculation: Int,
+        callback: TokenCallback
+    ): String
+
+    /**
+     * Load the vision projector (mmproj GGUF) for the loaded chat model
+     *
+     * @param mmprojPath Absolute path to the projector .gguf file
+     * @param maxImageSide Longer image side fed to the encoder (0 = default 512);
+     *        smaller means fewer image tokens and a faster encoder
+     */
+    external fun nativeLoadVisionProjector(mmprojPath: String, maxImageSide: Int): Boolean
+
     /**
      * Generate text completion with image input (multimodal)
      *
+     * The image goes at the "<__media__>" marker in [prompt]; without one the
+     * prompt is wrapped in the model's chat template with the image first.
+     * Embeddings of recent images are cached by content, so follow-up
+     * questions about the same image skip the vision encoder.
+     *
      * @param prompt Input text
      * @param imageBytes Raw image data (e.g., JPEG, PNG)
      * @param maxTokens Maximum tokens to generate
@@ -103,6 +318,18 @@ class LLMBridge {
      */
     external fun nativeGenerateWithImage(prompt: String, imageBytes: ByteArray, maxTokens: Int = 80): String
 
+    /**
+     * Get vision statistics
+     *
+     * @return { imageTokens, decodeUs, encodeUs, lastCacheHit, cacheHits, cacheMisses, cachedBytes }
+     */
+    external fun nativeGetVisionStats(): LongArray
+
+    /**
+     * Check if a vision projector is loaded
+     */
+    external fun nativeIsVisionLoaded(): Boolean
+
     /**
      * Generate an embedding for a given prompt.
      *
@@ -111,6 +338,39 @@ class LLMBridge {
      */
     external fun nativeGenerateEmbedding(prompt: String): FloatArray?
 
+    /**
+     * Load a dedicated embedding model (e.g. bge-small GGUF)
+     * Without one, embeddings are computed on the chat model with mean pooling.
+     *
+     * @param modelPath Absolute path to the embedding .gguf file
+     * @param pooling [POOLING_MEAN], [POOLING_CLS] or [POOLING_DEFAULT]
+     */
+    external fun nativeLoadEmbeddingModel(modelPath: String, pooling: Int): Boolean
+
+    /**
+     * Embed many texts, packed into as few native batches as possible
+     *
+     * @return Contiguous vectors (texts.size * dim, row i = texts[i]), L2-normalized, or null on failure
+     */
+    external fun nativeEmbedBatch(texts: Array<String>): FloatArray?
+
+    /**
+     * Dimension of the embeddings (0 if no model is available)
+     */
+    external fun nativeGetEmbeddingDim(): Int
+
+    /**
+     * Signature of the current embedding space (model, pooling, method
+     * version). Vectors stored under another signature must be re-embedded.
+     * Empty if no model is available.
+     */
+    external fun nativeGetEmbeddingSignature(): String
+
+    /**
+     * Free the dedicated embedding model
+     */
+    external fun nativeFreeEmbeddingModel()
+
     /**
      * Free model resources
      */
@@ -121,6 +381,42 @@ class LLMBridge {
      */
     external fun nativeIsLoaded(): Boolean
 
+    /**
+     * Get prompt prefix cache statistics
+     *
+     * @return { hits, misses, reusedTokens, prefilledTokens }
+     */
+    external fun nativeGetPrefixCacheStats(): LongArray
+
+    /**
+     * Get context window statistics
+     *
+     * @return { shifts, evictedTokens, overflows }
+     */
+    external fun nativeGetContextStats(): LongArray
+
+    /**
+     * Get continuous batching scheduler statistics
+     *
+     * @return { decodeCalls, decodedTokens, sampledTokens, maxBatchSequences, decodeTimeUs }
+     */
+    external fun nativeGetSchedulerStats(): LongArray
+
+    /**
+     * Set sampling parameters used by the persistent native sampler chain
+     */
+    external fun nativeSetSamplingParams(
+        temperature: Float,
+        topP: Float,
+        topK: Int,
+        repetitionPenalty: Float,
+        presencePenalty: Float,
+        frequencyPenalty: Float,
+        mirostat: Int,
+        mirostatTau: Float,
+        mirostatEta: Float
+    )
+
     /**
      * Kotlin-friendly wrapper for model loading
      */
@@ -146,6 +442,122 @@ class LLMBridge {
         return result
     }
 
+    /**
+     * Load a model without blocking a thread: loading, mlock and warm-up run
+     * natively in the background. Cancelling the coroutine cancels the load.
+     *
+     * @param onProgress Fraction of tensors loaded, called on the loading thread
+     */
+    suspend fun loadModelAsync(
+        modelPath: String,
+        contextSize: Int = 2048,
+        useMlock: Boolean = false,
+        warmup: Boolean = true,
+        memoryBudgetBytes: Long = 0,
+        onProgress: (Float) -> Unit = {}
+    ): Boolean {
+        if (!isLibraryLoaded) {
+            Log.e(TAG, "❌ Cannot load model: Native library not loaded (${libraryLoadError})")
+            return false
+        }
+
+        Log.i(TAG, "📂 Loading model in background: $modelPath")
+        Log.i(TAG, "   Context size: $contextSize, mlock: $useMlock, warm-up: $warmup, budget: ${memoryBudgetBytes shr 20} MB")
+
+        val result = awaitLoad(onProgress) { listener ->
+            nativeLoadModelAsync(modelPath, contextSize, useMlock, warmup, memoryBudgetBytes, listener)
+        }
+
+        if (result) {
+            Log.i(TAG, "✅ Model loaded successfully! ${getLoadTimings()}")
+            Log.i(TAG, "   Context: ${getContextPlan()}")
+        } else {
+            Log.e(TAG, "❌ Failed to load model")
+        }
+        return result
+    }
+
+    /**
+     * Hot-swap to another model (or the same one with a new context size)
+     * while the current one keeps answering; see [nativeSwapModelAsync].
+     * Cancelling the coroutine cancels the load and keeps the current model.
+     */
+    suspend fun swapModel(
+        modelPath: String,
+        contextSize: Int = 2048,
+        useMlock: Boolean = false,
+        memoryBudgetBytes: Long = 0,
+        onProgress: (Float) -> Unit = {}
+    ): Boolean {
+        if (!isLibraryLoaded) {
+            Log.e(TAG, "❌ Cannot swap model: Native library not loaded (${libraryLoadError})")
+            return false
+        }
+
+        Log.i(TAG, "🔁 Swapping to model: $modelPath (context $contextSize)")
+
+        val result = awaitLoad(onProgress) { listener ->
+            nativeSwapModelAsync(modelPath, contextSize, useMlock, memoryBudgetBytes, listener)
+        }
+
+        if (result) {
+            Log.i(TAG, "✅ Model swapped! ${getLoadTimings()}")
+            Log.i(TAG, "   Context: ${getContextPlan()}")
+        } else {
+            Log.e(TAG, "❌ Model swap failed or was refused; previous model still active")
+        }
+        return result
+    }
+
+    /**
+     * Suspend until a background load started by [start] reports completion
+     */
+    private suspend fun awaitLoad(onProgress: (Float) -> Unit, start: (ModelLoadListener) -> Boolean): Boolean =
+        suspendCancellableCoroutine { cont ->
+            val listener = object : ModelLoadListener {
+                override fun onProgress(progress: Float): Boolean {
+                    onProgress(progress)
+                    return cont.isActive
+                }
+
+                override fun onLoaded(success: Boolean) {
+                    if (cont.isActive) cont.resume(success)
+                }
+            }
+            cont.invokeOnCancellation { nativeCancelLoad() }
+            if (!start(listener)) {
+                cont.resume(false)
+            }
+        }
+
+    /**
+     * Load, warm-up and first-token times of the current model
+     */
+    fun getLoadTimings(): LoadTimings {
+        if (!isLibraryLoaded) {
+            return LoadTimings(0, 0, 0, 0, -1)
+        }
+        val timings = nativeGetLoadTimings()
+        return LoadTimings(timings[0], timings[1], timings[2], timings[3], timings[4])
+    }
+
+    /**
+     * Context the model at [modelPath] would get within [memoryBudgetBytes];
+     * cheap enough to show in settings before committing to a load
+     */
+    fun planContext(modelPath: String, contextSize: Int, memoryBudgetBytes: Long): ContextPlan? {
+        if (!isLibraryLoaded) return null
+        return nativePlanContext(modelPath, contextSize, memoryBudgetBytes)?.let { ContextPlan.fromArray(it) }
+    }
+
+    /**
+     * Context configuration of the loaded model and its estimated memory
+     */
+    fun getContextPlan(): ContextPlan? {
+        if (!isLibraryLoaded) return null
+        return nativeGetContextPlan()?.let { ContextPlan.fromArray(it) }
+    }
+
     /**
      * Kotlin-friendly wrapper for text generation
      * 
@@ -168,7 +580,12 @@ class LLMBridge {
      * - Returns final response to LLMManager for user display
      * - Handles any native-level errors transparently
      */
-    fun generate(prompt: String, maxTokens: Int = 80): String {
+    fun generate(
+        prompt: String,
+        maxTokens: Int = 80,
+        session: Int = DEFAULT_SESSION,
+        speculation: Int = SPECULATION_AUTO
+    ): String {
         // CRITICAL: Check if native library is loaded first
         if (!isLibraryLoaded) {
             val error = "Cannot generate: Native library not loaded (${libraryLoadError})"
@@ -182,12 +599,161 @@ class LLMBridge {
         }
 
         Log.d(TAG, "🔍 Generating response...")
-        val result = nativeGenerate(prompt, maxTokens)
+        val result = if (session == DEFAULT_SESSION && speculation == SPECULATION_AUTO) {
+            nativeGenerate(prompt, maxTokens)
+        } else {
+            nativeGenerateSession(session, prompt, maxTokens, speculation)
+        }
+        Log.d(TAG, "✨ Generated: ${result.take(50)}...")
+
+        return result
+    }
+
+    /**
+     * Kotlin-friendly wrapper for streaming text generation
+     *
+     * Blocks until generation finishes; [onToken] runs on the calling thread.
+     */
+    fun generateStream(
+        prompt: String,
+        maxTokens: Int = 80,
+        session: Int = DEFAULT_SESSION,
+        speculation: Int = SPECULATION_AUTO,
+        onToken: (String) -> Boolean
+    ): String {
+        if (!isLibraryLoaded) {
+            val error = "Cannot generate: Native library not loaded (${libraryLoadError})"
+            Log.e(TAG, "❌ $error")
+            throw UnsatisfiedLinkError(error)
+        }
+
+        if (!nativeIsLoaded()) {
+            Log.w(TAG, "⚠️ Model not loaded")
+            return ""
+        }
+
+        Log.d(TAG, "🔍 Generating streaming response...")
+        val result = if (session == DEFAULT_SESSION && speculation == SPECULATION_AUTO) {
+            nativeGenerateStream(prompt, maxTokens, TokenCallback(onToken))
+        } else {
+            nativeGenerateSessionStream(session, prompt, maxTokens, speculation, TokenCallback(onToken))
+        }
         Log.d(TAG, "✨ Generated: ${result.take(50)}...")
 
         return result
     }
 
+    /**
+     * Streaming generation as a Flow of text pieces
+     *
+     * Runs the blocking native call on the IO dispatcher. Cancelling the
+     * collector stops native generation at the next token.
+     */
+    fun generateFlow(
+        prompt: String,
+        maxTokens: Int = 80,
+        session: Int = DEFAULT_SESSION,
+        speculation: Int = SPECULATION_AUTO
+    ): Flow<String> = channelFlow {
+        generateStream(prompt, maxTokens, session, speculation) { piece ->
+            trySendBlocking(piece).isSuccess
+        }
+    }.flowOn(Dispatchers.IO)
+
+    /**
+     * Session handle for a named conversation (e.g. "memory", "facts")
+     *
+     * Created on first use and recreated after a model reload. Falls back to
+     * [DEFAULT_SESSION] when no slot is free, so callers can always generate.
+     */
+    @Synchronized
+    fun sessionFor(name: String): Int {
+        if (!isLibraryLoaded || !nativeIsLoaded()) return DEFAULT_SESSION
+
+        val existing = namedSessions[name]
+        if (existing != null && nativeIsSessionActive(existing)) {
+            return existing
+        }
+
+        val created = nativeCreateSession()
+        if (created < 0) {
+            Log.w(TAG, "⚠️ No free session slot for '$name', using default session")
+            namedSessions.remove(name)
+            return DEFAULT_SESSION
+        }
+        Log.i(TAG, "🧵 Session '$name' -> $created")
+        namedSessions[name] = created
+        return created
+    }
+
+    /**
+     * Release the session created for [name], if any
+     */
+    @Synchronized
+    fun releaseSession(name: String) {
+        val session = namedSessions.remove(name) ?: return
+        if (isLibraryLoaded && nativeIsLoaded()) {
+            nativeDestroySession(session)
+        }
+    }
+
+    /**
+     * Keep [prefix] at the start of [session]'s context window; see [nativeSetPinnedPrefix]
+     */
+    fun setPinnedPrefix(session: Int, prefix: String): Boolean {
+        if (!isLibraryLoaded || !nativeIsLoaded()) return false
+        return nativeSetPinnedPrefix(session, prefix)
+    }
+
+    /**
+     * Speculative decoding with [draftPath] as draft model; blocks while it
+     * loads, so call off the main thread. Output is unchanged, only faster
+     */
+    fun loadDraftModel(draftPath: String, nDraft: Int = DEFAULT_DRAFT_TOKENS): Boolean {
+        if (!isLibraryLoaded || !nativeIsLoaded()) return false
+        Log.i(TAG, "📂 Loading draft model: $draftPath")
+        return nativeLoadDraftModel(draftPath, nDraft)
+    }
+
+    fun freeDraftModel() {
+        if (isLibraryLoaded) {
+            nativeFreeDraftModel()
+        }
+    }
+
+    /**
+     * Drafted and accepted tokens, and tokens/sec with drafting time included
+     */
+    fun getSpeculativeStats(): SpeculativeStats {
+        if (!isLibraryLoaded) {
+            return SpeculativeStats(0, 0, 0, 0, 0, 0, 0, 0, 0)
+        }
+        val stats = nativeGetSpeculativeStats()
+        return SpeculativeStats(stats[0], stats[1], stats[2], stats[3], stats[4], stats[5], stats[6], stats[7], stats[8])
+    }
+
+    /**
+     * Snapshot [session]'s KV cache to [file]; call off the main thread
+     */
+    fun saveSessionState(session: Int, file: File): Boolean {
+        if (!isLibraryLoaded || !nativeIsLoaded()) return false
+        return nativeSaveSessionState(session, file.absolutePath)
+    }
+
+    /**
+     * Restore [session] from [file] if it was saved for the loaded model
+     *
+     * @return Number of tokens restored, or -1 if there was no usable snapshot
+     */
+    fun restoreSessionState(session: Int, file: File): Int {
+        if (!isLibraryLoaded || !nativeIsLoaded() || !file.exists()) return -1
+        val restored = nativeRestoreSessionState(session, file.absolutePath)
+        if (restored > 0) {
+            Log.i(TAG, "💾 Restored $restored cached tokens from ${file.name}")
+        }
+        return restored
+    }
+
     /**
      * Kotlin-friendly wrapper for embedding generation
      */
@@ -202,12 +768,128 @@ class LLMBridge {
         return result?.toList()
     }
 
+    /**
+     * Load a dedicated embedding model for [embedBatch] and [generateEmbedding]
+     */
+    fun loadEmbeddingModel(modelPath: String, pooling: Int = POOLING_MEAN): Boolean {
+        if (!isLibraryLoaded) {
+            Log.e(TAG, "❌ Cannot load embedding model: Native library not loaded (${libraryLoadError})")
+            return false
+        }
+
+        Log.i(TAG, "📂 Loading embedding model: $modelPath")
+        return nativeLoadEmbeddingModel(modelPath, pooling)
+    }
+
+    /**
+     * Batched embedding generation
+     *
+     * One JNI call for the whole list; the native side decodes many texts per batch.
+     *
+     * @return One L2-normalized vector per text (same order), or null on failure
+     */
+    fun embedBatch(texts: List<String>): List<FloatArray>? {
+        if (!isLibraryLoaded) return null
+        if (texts.isEmpty()) return emptyList()
+
+        val dim = nativeGetEmbeddingDim()
+        if (dim <= 0) {
+            Log.w(TAG, "⚠️ No embedding model available")
+            return null
+        }
+
+        Log.d(TAG, "🧠 Embedding batch of ${texts.size} texts...")
+        val flat = nativeEmbedBatch(texts.toTypedArray()) ?: return null
+        return List(texts.size) { i -> flat.copyOfRange(i * dim, (i + 1) * dim) }
+    }
+
+    /**
+     * Push sampling settings to the native sampler chain
+     * Takes effect from the next generation
+     */
+    fun applySettings(settings: ModelSettings) {
+        if (!isLibraryLoaded) return
+
+        val validated = settings.validate()
+        nativeSetSamplingParams(
+            validated.temperature,
+            validated.topP,
+            validated.topK,
+            validated.repetitionPenalty,
+            validated.presencePenalty,
+            validated.frequencyPenalty,
+            validated.mirostat,
+            validated.mirostatTau,
+            validated.mirostatEta
+        )
+    }
+
+    /**
+     * Prompt prefix cache statistics (KV cache reuse across generate calls)
+     */
+    fun getPrefixCacheStats(): PrefixCacheStats {
+        if (!isLibraryLoaded) {
+            return PrefixCacheStats(0, 0, 0, 0)
+        }
+        val stats = nativeGetPrefixCacheStats()
+        return PrefixCacheStats(stats[0], stats[1], stats[2], stats[3])
+    }
+
+    /**
+     * Context window statistics (tokens evicted to keep long conversations in the window)
+     */
+    fun getContextStats(): ContextStats {
+        if (!isLibraryLoaded) {
+            return ContextStats(0, 0, 0)
+        }
+        val stats = nativeGetContextStats()
+        return ContextStats(stats[0], stats[1], stats[2])
+    }
+
+    /**
+     * Load the vision projector for the current model; required before
+     * [nativeGenerateWithImage]. Freed together with the model.
+     */
+    fun loadVisionProjector(mmprojPath: String, maxImageSide: Int = 0): Boolean {
+        if (!isLibraryLoaded || !nativeIsLoaded()) {
+            Log.e(TAG, "❌ Cannot load vision projector: no model loaded")
+            return false
+        }
+        Log.i(TAG, "📂 Loading vision projector: $mmprojPath")
+        return nativeLoadVisionProjector(mmprojPath, maxImageSide)
+    }
+
+    fun isVisionLoaded(): Boolean = isLibraryLoaded && nativeIsVisionLoaded()
+
+    /**
+     * Last image (tokens, encoder time, cache hit) and embedding cache statistics
+     */
+    fun getVisionStats(): VisionStats {
+        if (!isLibraryLoaded) {
+            return VisionStats(0, 0, 0, false, 0, 0, 0)
+        }
+        val stats = nativeGetVisionStats()
+        return VisionStats(stats[0], stats[1], stats[2], stats[3] != 0L, stats[4], stats[5], stats[6])
+    }
+
+    /**
+     * Batched decoding statistics, aggregated over all sessions
+     */
+    fun getSchedulerStats(): SchedulerStats {
+        if (!isLibraryLoaded) {
+            return SchedulerStats(0, 0, 0, 0, 0)
+        }
+        val stats = nativeGetSchedulerStats()
+        return SchedulerStats(stats[0], stats[1], stats[2], stats[3], stats[4])
+    }
+
     /**
      * Free resources
      */
     fun free() {
         if (nativeIsLoaded()) {
             Log.i(TAG, "🔒 Freeing model resources...")
+            synchronized(this) { namedSessions.clear() }
             nativeFreeModel()
         }
     }
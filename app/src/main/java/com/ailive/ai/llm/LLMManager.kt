@@ -1,16 +1,22 @@
 package com.ailive.ai.llm
 
+import android.app.ActivityManager
 import android.content.Context
 import android.graphics.Bitmap
 import android.util.Log
+import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.cancel
 import kotlinx.coroutines.flow.Flow
 import kotlinx.coroutines.flow.catch
 import kotlinx.coroutines.flow.collect
 import kotlinx.coroutines.flow.flow
 import kotlinx.coroutines.flow.flowOn
+import kotlinx.coroutines.launch
 import kotlinx.coroutines.runBlocking
 import kotlinx.coroutines.withContext
+import java.io.File
 
 // Note: GPUInfo, InferenceStats, and PerformanceMonitor are now defined in PerformanceMetrics.kt
 // to avoid redeclaration errors. Import them from there if needed.
@@ -56,6 +62,10 @@ class LLMManager(private val context: Context) {
 
     companion object {
         private const val TAG = "LLMManager"
+
+        // Share of device RAM the chat model (weights + context) may take; the
+        // rest is left to Whisper, embeddings, the app and the system
+        private const val LLM_RAM_FRACTION = 0.5
     }
 
     // LLM Bridge for native llama.cpp
@@ -74,6 +84,14 @@ class LLMManager(private val context: Context) {
 
     // Current model info
     private var currentModelName: String? = null
+    // Load timings are logged with the first generation, once first-token time is known
+    private var loadTimingsLogged = false
+    // What the loaded model was loaded with, to detect changes that need a reload
+    private var loadedModelPath: String? = null
+    private var loadedCtxSize = 0
+
+    // Background model reloads (hot swaps); the current model serves meanwhile
+    private val reloadScope = CoroutineScope(Dispatchers.IO + SupervisorJob())
 
     // GPU acceleration tracking (v1.1)
     private var gpuInfo: GPUInfo? = null
@@ -165,11 +183,27 @@ class LLMManager(private val context: Context) {
                 Log.i(TAG, "   Expected performance: 7-8 tokens/second")
             }
 
-            // Load model using LLM Bridge
+            // Load model using LLM Bridge (native worker; warm-up included)
             Log.i(TAG, "📥 Loading llama.cpp model...")
-            if (!llmBridge.loadModel(modelFile.absolutePath, settings.ctxSize)) {
+            var lastReported = -1
+            val loaded = llmBridge.loadModelAsync(
+                modelFile.absolutePath,
+                settings.ctxSize,
+                memoryBudgetBytes = memoryBudgetBytes()
+            ) { progress ->
+                val percent = (progress * 100).toInt() / 10 * 10
+                if (percent != lastReported) {
+                    lastReported = percent
+                    Log.i(TAG, "   Loading: $percent%")
+                }
+            }
+            if (!loaded) {
                 throw Exception("Failed to load model")
             }
+            llmBridge.applySettings(settings)
+            attachDraftModel(modelFile)
+            loadedModelPath = modelFile.absolutePath
+            loadedCtxSize = settings.ctxSize
 
             isInitialized = true
             isInitializing = false
@@ -304,7 +338,7 @@ class LLMManager(private val context: Context) {
      * - Returns Kotlin Flow for reactive programming
      * - Non-blocking: UI can collect tokens safely on main thread
      * - Handles errors gracefully with proper exception propagation
-     * - Currently simulates streaming (emits complete result at once)
+     * - Pieces are emitted as native code samples them (nativeGenerateStream)
      * 
      * ERROR HANDLING FOR USER EXPERIENCE:
      * - Validates LLM state before generation
@@ -341,6 +375,7 @@ class LLMManager(private val context: Context) {
 
         // Reload settings in case they changed
         settings = ModelSettings.load(context)
+        llmBridge.applySettings(settings)
         Log.i(TAG, "   Using settings: maxTokens=${settings.maxTokens}, temp=${settings.temperature}")
 
         // CRITICAL FIX: Let llama.cpp handle chat formatting automatically
@@ -376,29 +411,29 @@ class LLMManager(private val context: Context) {
         Log.d(TAG, "   Message length: ${messageToSend.length} chars")
         Log.d(TAG, "   Using formatChat=$useFormatChat")
 
-        // Generate text using LLM Bridge (non-streaming)
+        // Generate text using LLM Bridge (streaming)
         val backend = gpuInfo?.backend ?: "CPU"
 
         try {
-            // CRITICAL FIX: Move blocking JNI call to IO dispatcher
+            // CRITICAL FIX: Blocking JNI call runs on the IO dispatcher inside generateFlow
             // This prevents crashes from calling native code on wrong thread
-            val result = withContext(Dispatchers.IO) {
-                try {
-                    Log.d(TAG, "📞 Calling native generate() on IO thread...")
-                    llmBridge.generate(messageToSend, settings.maxTokens)
-                } catch (e: Exception) {
-                    Log.e(TAG, "❌ Native generate() crashed", e)
-                    throw e
+            val resultBuilder = StringBuilder()
+            var tokenCount = 0
+            var firstTokenTime = 0L
+
+            Log.d(TAG, "📞 Calling native generateStream() on IO thread...")
+            llmBridge.generateFlow(messageToSend, settings.maxTokens).collect { piece ->
+                if (tokenCount == 0) {
+                    firstTokenTime = System.currentTimeMillis() - startTime
+                    Log.d(TAG, "⚡ First token after ${firstTokenTime}ms")
                 }
+                tokenCount++
+                resultBuilder.append(piece)
+                emit(piece)
             }
+            val result = resultBuilder.toString()
 
-            Log.d(TAG, "✅ Native generate() returned successfully")
-
-            // Emit the result (simulating streaming by emitting the whole result)
-            emit(result)
-
-            // Estimate token count (rough approximation: ~4 chars per token)
-            val tokenCount = result.length / 4
+            Log.d(TAG, "✅ Native generateStream() returned successfully")
 
             // Check if we got any tokens
             if (result.isEmpty()) {
@@ -426,6 +461,31 @@ class LLMManager(private val context: Context) {
         }
     }.flowOn(Dispatchers.Default)  // CRITICAL: Ensure Flow runs on background thread, safe for Main collection
 
+    /**
+     * RAM budget for the model and its context; the native side picks the KV
+     * cache type, batch sizes and if need be a shorter context to stay within it
+     */
+    private fun memoryBudgetBytes(): Long {
+        val activityManager = context.getSystemService(Context.ACTIVITY_SERVICE) as ActivityManager
+        val memInfo = ActivityManager.MemoryInfo()
+        activityManager.getMemoryInfo(memInfo)
+        return (memInfo.totalMem * LLM_RAM_FRACTION).toLong()
+    }
+
+    /**
+     * Speculative decoding: a much smaller downloaded model with the same
+     * tokenizer drafts tokens for [modelFile] to verify. Without one (or if
+     * its vocabulary differs) decoding stays one token per step.
+     */
+    private fun attachDraftModel(modelFile: File) {
+        val draftFile = modelDownloadManager.getDraftModelFile(modelFile) ?: return
+        if (llmBridge.loadDraftModel(draftFile.absolutePath)) {
+            Log.i(TAG, "🏎️ Speculative decoding with draft model ${draftFile.name}")
+        } else {
+            Log.i(TAG, "ℹ️ ${draftFile.name} cannot draft for ${modelFile.name}, decoding without a draft model")
+        }
+    }
+
     /**
      * Detect GPU acceleration support
      * Calls native JNI function to query OpenCL availability
@@ -506,6 +566,7 @@ class LLMManager(private val context: Context) {
 
         // Reload settings in case they changed
         settings = ModelSettings.load(context)
+        llmBridge.applySettings(settings)
 
         // Generate using LLM Bridge
         val result = llmBridge.generate(prompt, settings.maxTokens)
@@ -528,6 +589,14 @@ class LLMManager(private val context: Context) {
         Log.i(TAG, "✓ Generated ~$tokenCount tokens in ${totalTime}ms")
         Log.i(TAG, "   Performance: ${String.format("%.2f", tokensPerSec)} tokens/second")
         Log.i(TAG, "   Backend: $backend")
+        Log.i(TAG, "   Prefix cache: ${llmBridge.getPrefixCacheStats()}")
+        Log.i(TAG, "   Scheduler: ${llmBridge.getSchedulerStats()}")
+        Log.i(TAG, "   Context window: ${llmBridge.getContextStats()}")
+        Log.i(TAG, "   Speculative: ${llmBridge.getSpeculativeStats()}")
+        if (!loadTimingsLogged) {
+            loadTimingsLogged = true
+            Log.i(TAG, "   Load timings: ${llmBridge.getLoadTimings()}")
+        }
         Log.i(TAG, "   Average speed (last 10): ${String.format("%.2f", performanceMonitor.getRecentSpeed())} tok/s")
 
         return response.toString()
@@ -578,8 +647,41 @@ class LLMManager(private val context: Context) {
      */
     fun reloadSettings() {
         settings = ModelSettings.load(context)
+        llmBridge.applySettings(settings)
         Log.i(TAG, "⚙️ Settings reloaded: max_tokens=${settings.maxTokens}, temp=${settings.temperature}")
         Log.i(TAG, "   Estimated RAM: ${settings.estimateRamUsageMB()} MB")
+
+        // A new context size needs a new context: hot-swap in the background
+        if (isInitialized && settings.ctxSize != loadedCtxSize) {
+            Log.i(TAG, "   Context size changed ($loadedCtxSize -> ${settings.ctxSize}), reloading model")
+            reloadScope.launch { reloadModel() }
+        }
+    }
+
+    /**
+     * Reload the active model (e.g. after the user picked another one) with
+     * the current settings. The loaded model keeps answering until the new one
+     * is warmed up; if both cannot fit in memory the old one stays loaded.
+     */
+    suspend fun reloadModel(): Boolean {
+        if (!isInitialized) return initialize()
+        val modelFile = modelDownloadManager.getActiveModelFile() ?: return false
+        if (modelFile.absolutePath == loadedModelPath && settings.ctxSize == loadedCtxSize) {
+            return true
+        }
+
+        val ctxSize = settings.ctxSize
+        if (!llmBridge.swapModel(modelFile.absolutePath, ctxSize, memoryBudgetBytes = memoryBudgetBytes())) {
+            return false
+        }
+        llmBridge.applySettings(settings)
+        attachDraftModel(modelFile)
+        loadedModelPath = modelFile.absolutePath
+        loadedCtxSize = ctxSize
+        currentModelName = modelFile.nameWithoutExtension
+        loadTimingsLogged = false
+        Log.i(TAG, "✅ Now serving $currentModelName (context $ctxSize)")
+        return true
     }
 
     /**
@@ -673,6 +775,9 @@ class LLMManager(private val context: Context) {
                     append("Slowest: ${String.format("%.2f", slowest?.tokensPerSecond ?: 0f)} tok/s\n")
                 }
             }
+            append("Prefix Cache: ${llmBridge.getPrefixCacheStats()}\n")
+            append("Scheduler: ${llmBridge.getSchedulerStats()}\n")
+            append("Speculative: ${llmBridge.getSpeculativeStats()}\n")
             append("==============================")
         }
     }
@@ -681,6 +786,8 @@ class LLMManager(private val context: Context) {
      * Cleanup resources
      */
     fun close() {
+        reloadScope.cancel()
+
         // Log final performance summary before cleanup
         if (isInitialized && performanceMonitor.getTotalInferences() > 0) {
             Log.i(TAG, "\n${getPerformanceSummary()}")
@@ -697,6 +804,9 @@ class LLMManager(private val context: Context) {
 
         isInitialized = false
         currentModelName = null
+        loadedModelPath = null
+        loadedCtxSize = 0
+        loadTimingsLogged = false
         gpuInfo = null
         Log.i(TAG, "🔒 llama.cpp resources released")
     }
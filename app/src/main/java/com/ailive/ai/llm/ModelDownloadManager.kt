@@ -40,7 +40,7 @@ import kotlin.coroutines.resumeWithException
  * INTEGRATION STATUS:
  * - HybridModelManager: Created but not wired to MainActivity (TODO)
  * - Current: MainActivity still uses LLMManager (single Qwen model)
- * - Vision: Qwen2-VL lacks mmproj file, currently text-only
+ * - Vision: place a Qwen2-VL mmproj*.gguf next to the model to enable image input
  *
  * @author AILive Team
  * @since Phase 7.2 (Refactored with Coroutines + SmolLM2)
@@ -76,6 +76,15 @@ class ModelDownloadManager(private val context: Context) {
         @Deprecated("BGE model is now built-in to APK")
         const val BGE_CONFIG_JSON = "config.json"
 
+        // Optional BGE-small GGUF for batched native embeddings (placed in the models directory)
+        const val BGE_MODEL_GGUF = "bge-small-en-v1.5-q8_0.gguf"
+
+        // Vision projectors (placed in the models directory) are named mmproj*.gguf,
+        // e.g. mmproj-Qwen2-VL-2B-Instruct-Q8_0.gguf; not chat models themselves
+        private const val MMPROJ_PREFIX = "mmproj"
+        // File name parts of embedding and speech models, never used as draft models
+        private val AUXILIARY_MODEL_MARKERS = listOf("bge-", "embed", "whisper")
+
         private const val MODELS_DIR = "models"
         private const val MIN_MODEL_SIZE_BYTES = 10 * 1024 * 1024L
         private const val MIN_GGUF_SIZE_BYTES = 100 * 1024 * 1024L
@@ -205,10 +214,39 @@ class ModelDownloadManager(private val context: Context) {
         if (!downloadsDir.exists()) return emptyList()
 
         return downloadsDir.listFiles()?.filter {
-            it.isFile && it.name.endsWith(".gguf", ignoreCase = true)
+            it.isFile && it.name.endsWith(".gguf", ignoreCase = true) && !isVisionProjector(it)
         }?.sortedByDescending { it.lastModified() } ?: emptyList()
     }
 
+    /**
+     * Vision projector (mmproj*.gguf) in the models directory, the smallest
+     * if there are several (a quantized projector encodes faster on the CPU)
+     */
+    fun getVisionProjectorFile(): File? =
+        getModelsDir().listFiles()
+            ?.filter { it.isFile && isVisionProjector(it) }
+            ?.minByOrNull { it.length() }
+
+    /**
+     * Draft model candidate for speculative decoding with [target]: the
+     * smallest other chat GGUF at most a quarter of its size. Embedding and
+     * speech models are never candidates; whether the tokenizer matches is
+     * checked natively (vocabulary only) when it is attached.
+     */
+    fun getDraftModelFile(target: File): File? =
+        getAvailableModelsInDownloads()
+            .filter { it.absolutePath != target.absolutePath && it.length() * 4 <= target.length() }
+            .filter { !isAuxiliaryModel(it) }
+            .minByOrNull { it.length() }
+
+    private fun isVisionProjector(file: File): Boolean =
+        file.name.startsWith(MMPROJ_PREFIX, ignoreCase = true) && file.name.endsWith(".gguf", ignoreCase = true)
+
+    /** GGUFs in the models directory that are not chat models (embeddings, Whisper) */
+    private fun isAuxiliaryModel(file: File): Boolean =
+        file.name.equals(BGE_MODEL_GGUF, ignoreCase = true) ||
+            AUXILIARY_MODEL_MARKERS.any { file.name.contains(it, ignoreCase = true) }
+
     // ========== DOWNLOAD METHODS (SUSPEND) ==========
 
     suspend fun downloadQwenVLModel(onProgress: (String, Int, Int) -> Unit) {
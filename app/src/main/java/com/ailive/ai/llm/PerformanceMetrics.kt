@@ -35,6 +35,197 @@ data class InferenceStats(
     val timestamp: Long = System.currentTimeMillis()
 )
 
+/**
+ * Prompt Prefix Cache Statistics
+ * Reported by the native layer, which keeps the KV cache of the previous
+ * prompt and only prefills the part of the next prompt that differs
+ */
+data class PrefixCacheStats(
+    val hits: Long,
+    val misses: Long,
+    val reusedTokens: Long,
+    val prefilledTokens: Long
+) {
+    fun hitRate(): Float {
+        val total = hits + misses
+        return if (total > 0) hits.toFloat() / total else 0f
+    }
+
+    fun reuseRatio(): Float {
+        val total = reusedTokens + prefilledTokens
+        return if (total > 0) reusedTokens.toFloat() / total else 0f
+    }
+
+    override fun toString(): String {
+        return "hits=$hits, misses=$misses, reused=$reusedTokens tok, prefilled=$prefilledTokens tok " +
+               "(${String.format("%.0f", reuseRatio() * 100)}% reused)"
+    }
+}
+
+/**
+ * Context Window Statistics
+ * A conversation longer than the context window keeps its pinned system
+ * prompt; the oldest turns after it are evicted from the KV cache and the
+ * rest shifted down, so each turn still only prefills what is new
+ */
+data class ContextStats(
+    val shifts: Long,
+    val evictedTokens: Long,
+    val overflows: Long
+) {
+    override fun toString(): String {
+        return "shifts=$shifts, evicted=$evictedTokens tok, overflows=$overflows"
+    }
+}
+
+/**
+ * Model load timings: loading, context creation and warm-up are reported
+ * separately from the first generation's time to first token.
+ */
+data class LoadTimings(
+    val modelUs: Long,
+    val contextUs: Long,
+    val warmupUs: Long,
+    val totalUs: Long,
+    val firstTokenUs: Long
+) {
+    override fun toString(): String {
+        val firstToken = if (firstTokenUs >= 0) "${firstTokenUs / 1000} ms" else "n/a"
+        return "load=${modelUs / 1000} ms, context=${contextUs / 1000} ms, warm-up=${warmupUs / 1000} ms, " +
+               "total=${totalUs / 1000} ms, first token=$firstToken"
+    }
+}
+
+/**
+ * Context configuration chosen natively to fit a memory budget: KV cache
+ * type (f16, or q8_0/q4_0 blocks of 32), batch sizes and context length,
+ * with the estimated KV cache and compute buffer sizes
+ */
+data class ContextPlan(
+    val nCtx: Int,
+    val nBatch: Int,
+    val nUbatch: Int,
+    val typeK: String,
+    val typeV: String,
+    val flashAttention: Boolean,
+    val weightsBytes: Long,
+    val kvBytes: Long,
+    val computeBytes: Long
+) {
+    val totalBytes: Long get() = weightsBytes + kvBytes + computeBytes
+
+    override fun toString(): String {
+        return "n_ctx=$nCtx, batch=$nBatch/$nUbatch, KV $typeK/$typeV, flash attention ${if (flashAttention) "on" else "auto"}, " +
+               "weights=${weightsBytes shr 20} MB + KV=${kvBytes shr 20} MB + compute=${computeBytes shr 20} MB"
+    }
+
+    companion object {
+        // ggml_type values used for the KV cache
+        private fun typeName(type: Long): String = when (type) {
+            1L -> "f16"
+            8L -> "q8_0"
+            2L -> "q4_0"
+            else -> "type $type"
+        }
+
+        fun fromArray(values: LongArray): ContextPlan = ContextPlan(
+            nCtx = values[0].toInt(),
+            nBatch = values[1].toInt(),
+            nUbatch = values[2].toInt(),
+            typeK = typeName(values[3]),
+            typeV = typeName(values[4]),
+            flashAttention = values[5] != 0L,
+            weightsBytes = values[6],
+            kvBytes = values[7],
+            computeBytes = values[8]
+        )
+    }
+}
+
+/**
+ * Continuous batching scheduler statistics
+ * One decode call carries the next token of every running generation,
+ * so aggregate tokens/sec grows with the number of concurrent requests.
+ */
+data class SchedulerStats(
+    val decodeCalls: Long,
+    val decodedTokens: Long,
+    val sampledTokens: Long,
+    val maxBatchSequences: Long,
+    val decodeTimeUs: Long
+) {
+    fun tokensPerSecond(): Float {
+        return if (decodeTimeUs > 0) sampledTokens * 1_000_000f / decodeTimeUs else 0f
+    }
+
+    fun tokensPerDecode(): Float {
+        return if (decodeCalls > 0) decodedTokens.toFloat() / decodeCalls else 0f
+    }
+
+    override fun toString(): String {
+        return "decodes=$decodeCalls, decoded=$decodedTokens tok, sampled=$sampledTokens tok, " +
+               "max seqs/batch=$maxBatchSequences (${String.format("%.1f", tokensPerSecond())} tok/s aggregate)"
+    }
+}
+
+/**
+ * Speculative decoding statistics
+ * A draft model, or prompt lookup without one, proposes tokens that the main
+ * model verifies in the same decode; effective tokens/sec counts drafting
+ * time against the gain.
+ */
+data class SpeculativeStats(
+    val steps: Long,
+    val draftedTokens: Long,
+    val acceptedTokens: Long,
+    val draftTimeUs: Long,
+    val sampledTokens: Long,
+    val decodeTimeUs: Long,
+    val lookupSteps: Long,
+    val lookupDraftedTokens: Long,
+    val lookupAcceptedTokens: Long
+) {
+    fun acceptanceRate(): Float {
+        return if (draftedTokens > 0) acceptedTokens.toFloat() / draftedTokens else 0f
+    }
+
+    fun lookupAcceptanceRate(): Float {
+        return if (lookupDraftedTokens > 0) lookupAcceptedTokens.toFloat() / lookupDraftedTokens else 0f
+    }
+
+    fun effectiveTokensPerSecond(): Float {
+        val timeUs = decodeTimeUs + draftTimeUs
+        return if (timeUs > 0) sampledTokens * 1_000_000f / timeUs else 0f
+    }
+
+    override fun toString(): String {
+        return "drafted=$draftedTokens tok, accepted=$acceptedTokens tok " +
+               "(${String.format("%.0f", acceptanceRate() * 100)}%), " +
+               "lookup drafted=$lookupDraftedTokens tok, accepted=$lookupAcceptedTokens tok " +
+               "(${String.format("%.0f", lookupAcceptanceRate() * 100)}%), draft time=${draftTimeUs / 1000} ms, " +
+               "${String.format("%.1f", effectiveTokensPerSecond())} tok/s effective"
+    }
+}
+
+/**
+ * Vision statistics: the most recent image and the image-embedding cache
+ * Cache hits (same frame asked about again) skip the vision encoder.
+ */
+data class VisionStats(
+    val imageTokens: Long,
+    val decodeUs: Long,
+    val encodeUs: Long,
+    val lastCacheHit: Boolean,
+    val cacheHits: Long,
+    val cacheMisses: Long,
+    val cachedBytes: Long
+) {
+    override fun toString(): String {
+        return "image=$imageTokens tok, encoder=${encodeUs / 1000} ms${if (lastCacheHit) " (cached)" else ""}, " +
+               "cache hits=$cacheHits misses=$cacheMisses (${cachedBytes / 1024} KB)"
+    }
+}
+
 /**
  * Performance Monitor (Moved from LLMManager)
  * Tracks and aggregates performance metrics over time
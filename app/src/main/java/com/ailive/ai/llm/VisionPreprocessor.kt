@@ -2,15 +2,17 @@ package com.ailive.ai.llm
 
 import android.graphics.Bitmap
 import android.util.Log
+import com.ailive.ai.vision.ImagePreprocessor
 import java.nio.FloatBuffer
 
 /**
  * Vision preprocessing utilities for Qwen2-VL
  *
  * Handles image preprocessing for vision encoder:
- * - Resize to 224x224
+ * - Resize to 960x960
  * - RGB normalization
  * - Tensor conversion for ONNX input
+ * in a single native pass (ImagePreprocessor), without Kotlin pixel loops.
  *
  * @author AILive Team
  * @since Phase 8.0
@@ -26,84 +28,42 @@ object VisionPreprocessor {
     // From infer.py: image_array / 255.0
     // No mean/std subtraction needed for Qwen2-VL!
 
+    // Native fused resize + NCHW conversion; the tensor buffer is reused
+    private val preprocessor by lazy {
+        ImagePreprocessor(ImagePreprocessor.Config(TARGET_SIZE, TARGET_SIZE, ImagePreprocessor.Layout.NCHW))
+    }
+
     /**
      * Preprocess Bitmap for Qwen2-VL vision encoder
      *
-     * Steps (from official ONNX export infer.py):
-     * 1. Resize to 960x960
+     * Steps (from official ONNX export infer.py), fused in one native pass:
+     * 1. Resize to 960x960 (bilinear)
      * 2. Convert to RGB
      * 3. Normalize to [0,1] by dividing by 255
      * 4. Convert to NCHW format (batch, channels, height, width)
      *
+     * The returned buffer is direct and shared: it is overwritten by the next
+     * call, so consume (or copy) it first.
+     *
      * @param image Input bitmap (any size)
      * @return Float buffer in NCHW format, ready for ONNX input
      */
+    @Synchronized
     fun preprocessImage(image: Bitmap): FloatBuffer {
-        val startTime = System.currentTimeMillis()
+        val startTime = System.nanoTime()
         Log.i(TAG, "🖼️  Preprocessing image: ${image.width}x${image.height}")
 
-        // Step 1: Resize to 960x960
-        val resized = resizeImage(image, TARGET_SIZE, TARGET_SIZE)
-        Log.d(TAG, "   ✓ Resized to ${resized.width}x${resized.height}")
-
-        // Step 2: Extract RGB pixels
-        val pixels = IntArray(TARGET_SIZE * TARGET_SIZE)
-        resized.getPixels(pixels, 0, TARGET_SIZE, 0, 0, TARGET_SIZE, TARGET_SIZE)
-
-        // Step 3: Normalize to [0,1] and convert to NCHW format
-        val bufferSize = 3 * TARGET_SIZE * TARGET_SIZE  // 3 channels (RGB)
-        val buffer = FloatBuffer.allocate(bufferSize)
-
-        // NCHW format: [batch=1, channels=3, height=960, width=960]
-        // Layout: all R values, then all G values, then all B values
-        for (c in 0 until 3) {  // Channels: R=0, G=1, B=2
-            for (y in 0 until TARGET_SIZE) {
-                for (x in 0 until TARGET_SIZE) {
-                    val pixel = pixels[y * TARGET_SIZE + x]
-
-                    // Extract RGB components (Android uses ARGB format)
-                    val value = when (c) {
-                        0 -> ((pixel shr 16) and 0xFF)  // Red
-                        1 -> ((pixel shr 8) and 0xFF)   // Green
-                        2 -> (pixel and 0xFF)           // Blue
-                        else -> 0
-                    }
-
-                    // Qwen2-VL normalization: simple division by 255 (no mean/std)
-                    val normalized = value / 255.0f
-                    buffer.put(normalized)
-                }
-            }
-        }
-
-        buffer.rewind()
+        val buffer = preprocessor.process(image)
+            ?: throw IllegalArgumentException("Cannot preprocess ${image.width}x${image.height} ${image.config} bitmap")
 
-        val preprocessTime = (System.currentTimeMillis() - startTime) / 1000.0
-        Log.i(TAG, "✅ Image preprocessed in ${preprocessTime}s")
+        val preprocessMs = (System.nanoTime() - startTime) / 1_000_000.0
+        Log.i(TAG, "✅ Image preprocessed in ${"%.1f".format(preprocessMs)} ms")
         Log.d(TAG, "   Output shape: [1, 3, $TARGET_SIZE, $TARGET_SIZE]")
-        Log.d(TAG, "   Buffer size: $bufferSize floats (${bufferSize * 4 / 1024 / 1024}MB)")
+        Log.d(TAG, "   Buffer size: ${buffer.capacity()} floats (${buffer.capacity() * 4 / 1024 / 1024}MB)")
 
         return buffer
     }
 
-    /**
-     * Resize bitmap to target dimensions
-     *
-     * @param image Source bitmap
-     * @param targetWidth Target width
-     * @param targetHeight Target height
-     * @return Resized bitmap
-     */
-    private fun resizeImage(image: Bitmap, targetWidth: Int, targetHeight: Int): Bitmap {
-        return if (image.width == targetWidth && image.height == targetHeight) {
-            // Already correct size
-            image
-        } else {
-            // Resize using bilinear filtering (good quality, fast)
-            Bitmap.createScaledBitmap(image, targetWidth, targetHeight, true)
-        }
-    }
-
     /**
      * Get expected input shape for vision encoder
      * Format: [batch_size, channels, height, width]
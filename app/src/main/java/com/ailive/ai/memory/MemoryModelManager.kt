@@ -3,6 +3,7 @@ package com.ailive.ai.memory
 import android.content.Context
 import android.util.Log
 import com.ailive.ai.llm.HybridModelManager
+import com.ailive.ai.llm.LLMBridge
 import com.ailive.memory.database.entities.FactCategory
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.withContext
@@ -38,6 +39,7 @@ class MemoryModelManager(private val context: Context) {
     companion object {
         private const val TAG = "MemoryModelManager"
         private const val MAX_RESPONSE_TOKENS = 512  // Limit response length
+        private const val SESSION_NAME = "memory"  // Background session, keeps the chat KV cache intact
     }
 
     // Use HybridModelManager (which has Qwen loaded) instead of separate llama.cpp instance
@@ -143,7 +145,13 @@ class MemoryModelManager(private val context: Context) {
 
             // Use Qwen via HybridModelManager instead of TinyLlama
             var response = ""
-            hybridModelManager!!.generateStreaming(prompt, agentName = "FactExtractor").collect { chunk ->
+            // Facts are quoted from the conversation: prompt lookup drafts them
+            hybridModelManager!!.generateStreaming(
+                prompt,
+                agentName = "FactExtractor",
+                sessionName = SESSION_NAME,
+                speculation = LLMBridge.SPECULATION_PROMPT_LOOKUP
+            ).collect { chunk ->
                 response += chunk
             }
 
@@ -189,7 +197,12 @@ class MemoryModelManager(private val context: Context) {
 
             // Use Qwen via HybridModelManager
             var summary = ""
-            hybridModelManager!!.generateStreaming(prompt, agentName = "Summarizer").collect { chunk ->
+            hybridModelManager!!.generateStreaming(
+                prompt,
+                agentName = "Summarizer",
+                sessionName = SESSION_NAME,
+                speculation = LLMBridge.SPECULATION_PROMPT_LOOKUP
+            ).collect { chunk ->
                 summary += chunk
             }
             summary = summary.trim()
@@ -225,7 +238,7 @@ class MemoryModelManager(private val context: Context) {
 
             // Use Qwen via HybridModelManager
             var enhanced = ""
-            hybridModelManager!!.generateStreaming(prompt, agentName = "ContextEnhancer").collect { chunk ->
+            hybridModelManager!!.generateStreaming(prompt, agentName = "ContextEnhancer", sessionName = SESSION_NAME).collect { chunk ->
                 enhanced += chunk
             }
             enhanced.trim()
@@ -0,0 +1,133 @@
+package com.ailive.ai.vision
+
+import android.graphics.Bitmap
+import android.graphics.Rect
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.FloatBuffer
+
+/**
+ * ImagePreprocessor - Native resize + normalization into a model input tensor
+ *
+ * One fused SIMD pass (image_preprocess.cpp) turns a bitmap of any size into
+ * a [Config.width] x [Config.height] float tensor: bilinear resize, channel
+ * extraction to planar NCHW or interleaved NHWC, and (pixel / 255 - mean) / std
+ * per channel. Pixels are read in place and the tensor lives in native
+ * aligned memory that every call overwrites, so a preprocessor per model
+ * allocates nothing per frame.
+ *
+ * The returned FloatBuffer is direct and can be wrapped by ONNX Runtime or
+ * TFLite without a copy; it is only valid until the next process() or close().
+ */
+class ImagePreprocessor(val config: Config) : AutoCloseable {
+
+    enum class Layout { NCHW, NHWC }
+
+    /**
+     * @param letterbox keep the aspect ratio and fill the borders with
+     *        [padColor] (0xRRGGBB) instead of stretching
+     * @param mean, std per R, G, B, applied to pixel / 255
+     */
+    data class Config(
+        val width: Int,
+        val height: Int,
+        val layout: Layout = Layout.NCHW,
+        val letterbox: Boolean = false,
+        val mean: FloatArray = floatArrayOf(0f, 0f, 0f),
+        val std: FloatArray = floatArrayOf(1f, 1f, 1f),
+        val padColor: Int = 0x000000
+    ) {
+        /** [1, 3, H, W] or [1, H, W, 3] */
+        fun shape(): LongArray = when (layout) {
+            Layout.NCHW -> longArrayOf(1, 3, height.toLong(), width.toLong())
+            Layout.NHWC -> longArrayOf(1, height.toLong(), width.toLong(), 3)
+        }
+
+        companion object {
+            /** torchvision / ImageNet statistics */
+            val IMAGENET_MEAN = floatArrayOf(0.485f, 0.456f, 0.406f)
+            val IMAGENET_STD = floatArrayOf(0.229f, 0.224f, 0.225f)
+        }
+    }
+
+    // Calls are synchronized so close() cannot free the tensor mid-call
+    private var handle: Long = nativeCreate(
+        config.width, config.height, config.layout == Layout.NHWC, config.letterbox,
+        config.mean, config.std, config.padColor
+    )
+
+    private val output: FloatBuffer? = handle.takeIf { it != 0L }?.let {
+        nativeOutput(it).order(ByteOrder.nativeOrder()).asFloatBuffer()
+    }
+
+    /** False if the native tensor could not be allocated */
+    val isValid: Boolean get() = handle != 0L
+
+    /**
+     * Preprocess [bitmap]. ARGB_8888 bitmaps are read in place; other
+     * configs are converted first.
+     * @return the shared output tensor, rewound, or null on failure
+     */
+    @Synchronized
+    fun process(bitmap: Bitmap): FloatBuffer? {
+        val h = handle
+        if (h == 0L || bitmap.width <= 0 || bitmap.height <= 0) return null
+        val ok = if (bitmap.config == Bitmap.Config.ARGB_8888) {
+            nativeProcessBitmap(h, bitmap)
+        } else {
+            val converted = bitmap.copy(Bitmap.Config.ARGB_8888, false) ?: return null
+            try {
+                nativeProcessBitmap(h, converted)
+            } finally {
+                converted.recycle()
+            }
+        }
+        return if (ok) output?.also { it.rewind() } else null
+    }
+
+    /**
+     * Preprocess RGBA_8888 pixels (bytes R, G, B, A) in a direct buffer,
+     * e.g. from Bitmap.copyPixelsToBuffer or an ImageReader plane.
+     */
+    @Synchronized
+    fun process(pixels: ByteBuffer, width: Int, height: Int, rowStride: Int = width * 4): FloatBuffer? {
+        require(pixels.isDirect) { "Pixel buffer must be a direct ByteBuffer" }
+        val h = handle
+        if (h == 0L) return null
+        return if (nativeProcessBuffer(h, pixels, width, height, rowStride)) output?.also { it.rewind() } else null
+    }
+
+    /**
+     * Where the image landed in the tensor after the last call; smaller than
+     * the tensor only when letterboxing. Used to map detections back.
+     */
+    @Synchronized
+    fun contentRect(): Rect {
+        val h = handle
+        if (h == 0L) return Rect()
+        val (x, y, w, hgt) = nativePlacement(h).toList()
+        return Rect(x, y, x + w, y + hgt)
+    }
+
+    @Synchronized
+    override fun close() {
+        val h = handle
+        handle = 0L
+        if (h != 0L) nativeDestroy(h)
+    }
+
+    private external fun nativeCreate(
+        width: Int, height: Int, nhwc: Boolean, letterbox: Boolean, mean: FloatArray, std: FloatArray, padRgb: Int
+    ): Long
+    private external fun nativeDestroy(handle: Long)
+    private external fun nativeOutput(handle: Long): ByteBuffer
+    private external fun nativeProcessBitmap(handle: Long, bitmap: Bitmap): Boolean
+    private external fun nativeProcessBuffer(handle: Long, pixels: ByteBuffer, width: Int, height: Int, rowStride: Int): Boolean
+    private external fun nativePlacement(handle: Long): IntArray
+
+    companion object {
+        init {
+            System.loadLibrary("ailive_llm")
+        }
+    }
+}
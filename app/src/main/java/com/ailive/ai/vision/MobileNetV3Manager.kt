@@ -25,16 +25,36 @@ import java.io.File
  * @author AILive Team
  * @since Multimodal MVP - testing-123 branch
  */
-class MobileNetV3Manager(private val context: Context) {
+class MobileNetV3Manager(
+    private val context: Context,
+    /**
+     * Input preprocessing. Defaults to 224x224 NHWC (TFLite) letterboxed
+     * with ImageNet statistics; match it to the exported model.
+     */
+    private val inputConfig: ImagePreprocessor.Config = DEFAULT_INPUT
+) {
 
     companion object {
         private const val TAG = "MobileNetV3Manager"
         private const val MODEL_FILE = "mobilenet_v3_small.tflite"
         private const val LABELS_FILE = "labels.txt"
+        private const val TOP_K = 5
+        private const val MIN_CONFIDENCE = 0.1f
+
+        val DEFAULT_INPUT = ImagePreprocessor.Config(
+            width = 224,
+            height = 224,
+            layout = ImagePreprocessor.Layout.NHWC,
+            letterbox = true,
+            mean = ImagePreprocessor.Config.IMAGENET_MEAN,
+            std = ImagePreprocessor.Config.IMAGENET_STD,
+            padColor = 0x7C7468   // the mean colour, normalizes to ~0
+        )
     }
 
     private var interpreter: Interpreter? = null
     private var labels: List<String> = emptyList()
+    private var preprocessor: ImagePreprocessor? = null
     private var isInitialized = false
 
     /**
@@ -59,12 +79,10 @@ class MobileNetV3Manager(private val context: Context) {
                 return false
             }
 
-            // TODO: Load labels
-            // labels = labelsFile.readLines()
-
-            // TODO: Create interpreter
-            // interpreter = Interpreter(modelFile)
+            labels = labelsFile.readLines().map { it.trim() }.filter { it.isNotEmpty() }
+            interpreter = Interpreter(modelFile)
 
+            preprocessor = ImagePreprocessor(inputConfig)
             isInitialized = true
             Log.i(TAG, "✅ MobileNetV3 initialized successfully")
             return true
@@ -88,16 +106,25 @@ class MobileNetV3Manager(private val context: Context) {
         }
 
         try {
-            // TODO: Implement classification
-            // 1. Resize bitmap to 224x224
-            // 2. Normalize pixels
-            // 3. Run inference
-            // 4. Parse top-k results
-
             Log.i(TAG, "👁️ Classifying image (${bitmap.width}x${bitmap.height})...")
 
-            // Placeholder
-            return emptyList()
+            // Resize + normalize into the model's input tensor (native, reused)
+            val input = preprocessor?.process(bitmap) ?: run {
+                Log.e(TAG, "❌ Image preprocessing failed")
+                return emptyList()
+            }
+
+            val model = interpreter ?: return emptyList()
+            val scores = Array(1) { FloatArray(model.getOutputTensor(0).shape().last()) }
+            model.run(input, scores)
+
+            // Top-k labels (the output may carry a leading background class)
+            val offset = scores[0].size - labels.size
+            return scores[0].indices
+                .filter { it >= offset && scores[0][it] >= MIN_CONFIDENCE }
+                .sortedByDescending { scores[0][it] }
+                .take(TOP_K)
+                .map { DetectionResult(labels[it - offset], scores[0][it]) }
 
         } catch (e: Exception) {
             Log.e(TAG, "❌ Classification failed", e)
@@ -141,6 +168,8 @@ class MobileNetV3Manager(private val context: Context) {
     fun free() {
         interpreter?.close()
         interpreter = null
+        preprocessor?.close()
+        preprocessor = null
         isInitialized = false
         Log.i(TAG, "🗑️ MobileNetV3 resources freed")
     }
@@ -4,12 +4,20 @@ import android.graphics.Bitmap
 import android.util.Log
 import com.ailive.ai.llm.LLMBridge
 import java.io.ByteArrayOutputStream
+import java.io.File
 
 /**
  * Manages multimodal vision capabilities, integrating with the LLMBridge
  * to send image data and text prompts to the LLaVA model.
+ *
+ * The vision projector ([projectorFile]) is loaded on first use. Native code
+ * caches image embeddings by content, so asking again about the same frame
+ * only costs text generation.
  */
-class VisionManager(private val llmBridge: LLMBridge) {
+class VisionManager(
+    private val llmBridge: LLMBridge,
+    private val projectorFile: () -> File? = { null }
+) {
     private val TAG = "VisionManager"
 
     /**
@@ -41,7 +49,24 @@ class VisionManager(private val llmBridge: LLMBridge) {
             return "[ERROR: Image conversion failed]"
         }
 
+        if (!ensureProjector()) {
+            return "[ERROR: Vision projector (mmproj) not available]"
+        }
+
         Log.i(TAG, "Sending image (${imageBytes.size} bytes) and prompt to LLaVA model.")
-        return llmBridge.nativeGenerateWithImage(prompt, imageBytes, maxTokens)
+        val response = llmBridge.nativeGenerateWithImage(prompt, imageBytes, maxTokens)
+        Log.i(TAG, "📊 Vision: ${llmBridge.getVisionStats()}")
+        return response
+    }
+
+    /** Load the projector on first use, and again after a model reload freed it */
+    @Synchronized
+    private fun ensureProjector(): Boolean {
+        if (llmBridge.isVisionLoaded()) return true
+        val file = projectorFile() ?: run {
+            Log.e(TAG, "No vision projector (mmproj*.gguf) found")
+            return false
+        }
+        return llmBridge.loadVisionProjector(file.absolutePath)
     }
 }
@@ -0,0 +1,228 @@
+package com.ailive.audio
+
+import android.content.Context
+import android.media.MediaCodec
+import android.media.MediaExtractor
+import android.media.MediaFormat
+import android.util.Log
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.withContext
+import java.io.File
+import java.nio.ByteOrder
+
+/**
+ * KeywordSpotter - Native wake word spotting on raw microphone audio
+ *
+ * MFCC features matched against enrolled examples of the wake phrase with
+ * dynamic time warping, every 10 ms, at well under 1% of real time. Used
+ * instead of running Whisper continuously: only a detection starts the
+ * full transcriber.
+ *
+ * Examples come from the wake phrase recordings made during setup; without
+ * them the phrase is synthesized with the system text-to-speech engine at a
+ * few speaking rates (less accurate for the user's own voice).
+ */
+class KeywordSpotter private constructor() : AutoCloseable {
+
+    // Calls are synchronized so close() cannot free the native spotter
+    // while the microphone thread is inside process()
+    private var handle: Long = nativeCreate()
+
+    /** Number of enrolled examples */
+    var templateCount = 0
+        private set
+
+    /**
+     * Enroll one example (mono 16-bit PCM at any sample rate).
+     * @return false if it holds no usable speech
+     */
+    @Synchronized
+    fun addTemplate(pcm: ShortArray, sampleRate: Int): Boolean {
+        val h = handle
+        if (h == 0L || pcm.isEmpty()) return false
+        val added = nativeAddTemplate(h, pcm, sampleRate)
+        if (added) templateCount++
+        return added
+    }
+
+    /** Derive the detection threshold from the enrolled examples. */
+    @Synchronized
+    fun calibrate(): Float = handle.let { if (it != 0L) nativeCalibrate(it) else 0f }
+
+    /** Scale the calibrated threshold: > 1 detects more readily, < 1 less. */
+    @Synchronized
+    fun setSensitivity(scale: Float) {
+        handle.let { if (it != 0L) nativeSetSensitivity(it, scale) }
+    }
+
+    /**
+     * Feed 16 kHz mono PCM.
+     * @return true if the wake phrase was spotted
+     */
+    @Synchronized
+    fun process(pcm: ShortArray, count: Int): Boolean {
+        val h = handle
+        if (h == 0L || count <= 0) return false
+        return nativeProcess(h, pcm, count)
+    }
+
+    /** Closest match (normalized DTW distance) since the last call */
+    @Synchronized
+    fun takeBestScore(): Float = handle.let { if (it != 0L) nativeTakeBestScore(it) else Float.MAX_VALUE }
+
+    /** Forget buffered audio and partial matches (e.g. when the mic restarts). */
+    @Synchronized
+    fun reset() {
+        handle.let { if (it != 0L) nativeReset(it) }
+    }
+
+    @Synchronized
+    override fun close() {
+        val h = handle
+        handle = 0L
+        if (h != 0L) nativeDestroy(h)
+    }
+
+    private external fun nativeCreate(): Long
+    private external fun nativeDestroy(handle: Long)
+    private external fun nativeAddTemplate(handle: Long, pcm: ShortArray, sampleRate: Int): Boolean
+    private external fun nativeCalibrate(handle: Long): Float
+    private external fun nativeSetSensitivity(handle: Long, scale: Float)
+    private external fun nativeProcess(handle: Long, pcm: ShortArray, count: Int): Boolean
+    private external fun nativeTakeBestScore(handle: Long): Float
+    private external fun nativeReset(handle: Long)
+
+    companion object {
+        private const val TAG = "KeywordSpotter"
+        private const val SAMPLES_DIR = "voice_samples"
+        private const val WAKE_SAMPLE_PREFIX = "wake_sample_"
+        private val SYNTHESIS_RATES = floatArrayOf(0.85f, 1.0f, 1.15f)
+        private const val CODEC_TIMEOUT_US = 10_000L
+
+        init {
+            System.loadLibrary("ailive_llm")
+        }
+
+        /**
+         * Build a spotter for [wakePhrase] from the setup recordings, or from
+         * synthesized speech when there are none.
+         * @return null if no example could be enrolled
+         */
+        suspend fun enroll(context: Context, wakePhrase: String): KeywordSpotter? = withContext(Dispatchers.IO) {
+            val spotter = KeywordSpotter()
+
+            File(context.filesDir, SAMPLES_DIR)
+                .listFiles { file -> file.name.startsWith(WAKE_SAMPLE_PREFIX) }
+                ?.sortedBy { it.name }
+                ?.forEach { file ->
+                    val (pcm, rate) = decodeAudioFile(file) ?: return@forEach
+                    if (!spotter.addTemplate(pcm, rate)) {
+                        Log.w(TAG, "No speech in ${file.name}, skipped")
+                    }
+                }
+            val recorded = spotter.templateCount
+
+            if (recorded == 0 && wakePhrase.isNotBlank()) {
+                synthesize(context, wakePhrase).forEach { (pcm, rate) -> spotter.addTemplate(pcm, rate) }
+            }
+
+            if (spotter.templateCount == 0) {
+                Log.w(TAG, "⚠️ No wake phrase examples enrolled; keyword spotting unavailable")
+                spotter.close()
+                return@withContext null
+            }
+
+            val threshold = spotter.calibrate()
+            Log.i(TAG, "✅ Enrolled '$wakePhrase': ${spotter.templateCount} examples " +
+                    "(${if (recorded > 0) "recorded" else "synthesized"}), threshold %.2f".format(threshold))
+            spotter
+        }
+
+        /**
+         * Decode a compressed recording (e.g. the setup's AMR .3gp files)
+         * to 16-bit PCM, first channel only.
+         */
+        private fun decodeAudioFile(file: File): Pair<ShortArray, Int>? {
+            val extractor = MediaExtractor()
+            var codec: MediaCodec? = null
+            try {
+                extractor.setDataSource(file.absolutePath)
+                val track = (0 until extractor.trackCount).firstOrNull {
+                    extractor.getTrackFormat(it).getString(MediaFormat.KEY_MIME)?.startsWith("audio/") == true
+                } ?: return null
+                extractor.selectTrack(track)
+                val format = extractor.getTrackFormat(track)
+                var sampleRate = format.getInteger(MediaFormat.KEY_SAMPLE_RATE)
+                var channels = format.getInteger(MediaFormat.KEY_CHANNEL_COUNT)
+
+                val decoder = MediaCodec.createDecoderByType(format.getString(MediaFormat.KEY_MIME)!!)
+                codec = decoder
+                decoder.configure(format, null, null, 0)
+                decoder.start()
+
+                var pcm = ShortArray(sampleRate * 4)
+                var size = 0
+                val info = MediaCodec.BufferInfo()
+                var inputDone = false
+                while (true) {
+                    if (!inputDone) {
+                        val index = decoder.dequeueInputBuffer(CODEC_TIMEOUT_US)
+                        if (index >= 0) {
+                            val n = extractor.readSampleData(decoder.getInputBuffer(index)!!, 0)
+                            if (n < 0) {
+                                decoder.queueInputBuffer(index, 0, 0, 0, MediaCodec.BUFFER_FLAG_END_OF_STREAM)
+                                inputDone = true
+                            } else {
+                                decoder.queueInputBuffer(index, 0, n, extractor.sampleTime, 0)
+                                extractor.advance()
+                            }
+                        }
+                    }
+
+                    val index = decoder.dequeueOutputBuffer(info, CODEC_TIMEOUT_US)
+                    if (index == MediaCodec.INFO_OUTPUT_FORMAT_CHANGED) {
+                        sampleRate = decoder.outputFormat.getInteger(MediaFormat.KEY_SAMPLE_RATE)
+                        channels = decoder.outputFormat.getInteger(MediaFormat.KEY_CHANNEL_COUNT)
+                    } else if (index >= 0) {
+                        val buffer = decoder.getOutputBuffer(index)!!
+                        buffer.position(info.offset).limit(info.offset + info.size)
+                        val shorts = buffer.order(ByteOrder.nativeOrder()).asShortBuffer()
+                        val frames = shorts.remaining() / channels
+                        if (size + frames > pcm.size) pcm = pcm.copyOf(maxOf(pcm.size * 2, size + frames))
+                        for (i in 0 until frames) {
+                            pcm[size++] = shorts.get(i * channels)
+                        }
+                        decoder.releaseOutputBuffer(index, false)
+                        if (info.flags and MediaCodec.BUFFER_FLAG_END_OF_STREAM != 0) break
+                    }
+                }
+                return pcm.copyOf(size) to sampleRate
+            } catch (e: Exception) {
+                Log.w(TAG, "Failed to decode ${file.name}: ${e.message}")
+                return null
+            } finally {
+                codec?.let {
+                    try { it.stop() } catch (e: Exception) {}
+                    it.release()
+                }
+                extractor.release()
+            }
+        }
+
+        /**
+         * Speak [phrase] into WAV files with the system TTS engine, one per
+         * rate in SYNTHESIS_RATES.
+         */
+        private suspend fun synthesize(context: Context, phrase: String): List<Pair<ShortArray, Int>> {
+            val requests = SYNTHESIS_RATES.withIndex().map { (i, rate) ->
+                SpeechSynthesis.Request(phrase, File(context.cacheDir, "kws_enroll_$i.wav"), rate)
+            }
+            val written = SpeechSynthesis.toFiles(context, requests)
+            return requests.zip(written).mapNotNull { (request, ok) ->
+                val pcm = if (ok) WavFile.read(request.file) else null
+                request.file.delete()
+                pcm
+            }
+        }
+    }
+}
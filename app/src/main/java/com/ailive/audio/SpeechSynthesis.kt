@@ -0,0 +1,69 @@
+package com.ailive.audio
+
+import android.content.Context
+import android.speech.tts.TextToSpeech
+import android.speech.tts.UtteranceProgressListener
+import android.util.Log
+import kotlinx.coroutines.CompletableDeferred
+import kotlinx.coroutines.withTimeoutOrNull
+import java.io.File
+import java.util.Locale
+
+/**
+ * SpeechSynthesis - Render text to WAV files with the system TTS engine
+ *
+ * Used for wake phrase examples (KeywordSpotter) and Whisper benchmark
+ * fixtures (WhisperBenchmark) when no recordings are available.
+ */
+internal object SpeechSynthesis {
+    private const val TAG = "SpeechSynthesis"
+    private const val INIT_TIMEOUT_MS = 5000L
+
+    /** Speak [text] at [rate] into [file] */
+    class Request(val text: String, val file: File, val rate: Float = 1.0f)
+
+    /**
+     * Synthesize every request in order with one engine instance.
+     *
+     * @param locale voice language, or the engine default
+     * @param timeoutMs limit per request
+     * @return whether each request's file was written
+     */
+    suspend fun toFiles(
+        context: Context,
+        requests: List<Request>,
+        locale: Locale? = null,
+        timeoutMs: Long = 5000L
+    ): List<Boolean> {
+        if (requests.isEmpty()) return emptyList()
+
+        val ready = CompletableDeferred<Boolean>()
+        val tts = TextToSpeech(context) { status -> ready.complete(status == TextToSpeech.SUCCESS) }
+        try {
+            if (withTimeoutOrNull(INIT_TIMEOUT_MS) { ready.await() } != true) {
+                Log.w(TAG, "System TTS unavailable, cannot synthesize speech")
+                return requests.map { false }
+            }
+            locale?.let { tts.language = it }
+
+            val done = HashMap<String, CompletableDeferred<Boolean>>()
+            tts.setOnUtteranceProgressListener(object : UtteranceProgressListener() {
+                override fun onStart(utteranceId: String) {}
+                override fun onDone(utteranceId: String) { synchronized(done) { done[utteranceId] }?.complete(true) }
+                @Deprecated("Deprecated in Java")
+                override fun onError(utteranceId: String) { synchronized(done) { done[utteranceId] }?.complete(false) }
+            })
+
+            return requests.mapIndexed { i, request ->
+                val id = "synth_$i"
+                val finished = CompletableDeferred<Boolean>()
+                synchronized(done) { done[id] = finished }
+                tts.setSpeechRate(request.rate)
+                tts.synthesizeToFile(request.text, null, request.file, id)
+                withTimeoutOrNull(timeoutMs) { finished.await() } == true
+            }
+        } finally {
+            tts.shutdown()
+        }
+    }
+}
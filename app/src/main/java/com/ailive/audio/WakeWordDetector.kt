@@ -12,7 +12,7 @@ import android.util.Log
  * - Supports user-defined AI names
  * - Phonetic matching for similar-sounding names
  * - Automatic alternative generation
- * - ML-ready architecture for future audio-based detection
+ * - Audio-based detection via KeywordSpotter (no transcription needed)
  *
  * @since Phase 8 - Custom AI names
  */
@@ -131,13 +131,12 @@ class WakeWordDetector(
     }
 
     /**
-     * Process audio data (for future ML-based detection)
-     * Currently not implemented - using text-based detection
+     * Wake phrase spotted directly in the audio (KeywordSpotter), before
+     * any transcription
      */
-    fun processAudioData(audioData: FloatArray): Boolean {
-        // TODO: Implement ML-based wake word detection
-        // For now, we rely on SpeechRecognizer + text matching
-        return false
+    fun onKeywordSpotted() {
+        Log.i(TAG, "🎯 Wake word detected (audio): '$wakePhrase'")
+        triggerWakeWordResponse()
     }
 
     /**
@@ -0,0 +1,59 @@
+package com.ailive.audio
+
+import java.io.File
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * WavFile - Minimal reader for 16-bit PCM RIFF/WAVE files
+ *
+ * Used for synthesized wake phrase examples and benchmark fixtures. Only the
+ * first channel is kept.
+ */
+object WavFile {
+
+    /**
+     * @return samples of the first channel and the sample rate, or null if
+     *         the file is not 16-bit PCM WAV
+     */
+    fun read(file: File): Pair<ShortArray, Int>? {
+        val bytes = ByteBuffer.wrap(file.readBytes()).order(ByteOrder.LITTLE_ENDIAN)
+        if (bytes.remaining() < 12 || bytes.getInt(0) != 0x46464952 || bytes.getInt(8) != 0x45564157) {
+            return null   // not RIFF/WAVE
+        }
+        var sampleRate = 0
+        var channels = 1
+        var bits = 0
+        var offset = 12
+        while (offset + 8 <= bytes.limit()) {
+            val id = bytes.getInt(offset)
+            val length = bytes.getInt(offset + 4)
+            val body = offset + 8
+            when (id) {
+                0x20746d66 -> {   // "fmt "
+                    channels = bytes.getShort(body + 2).toInt()
+                    sampleRate = bytes.getInt(body + 4)
+                    bits = bytes.getShort(body + 14).toInt()
+                }
+                0x61746164 -> {   // "data"
+                    if (bits != 16 || sampleRate <= 0 || channels <= 0) return null
+                    val frames = minOf(length, bytes.limit() - body) / (2 * channels)
+                    val pcm = ShortArray(frames) { bytes.getShort(body + it * 2 * channels) }
+                    return pcm to sampleRate
+                }
+            }
+            offset = body + length + (length and 1)
+        }
+        return null
+    }
+
+    /**
+     * Copy samples into a direct buffer in native byte order, as expected by
+     * WhisperProcessor.transcribe(ByteBuffer, ...).
+     */
+    fun toDirectBuffer(pcm: ShortArray): ByteBuffer {
+        val buffer = ByteBuffer.allocateDirect(pcm.size * 2).order(ByteOrder.nativeOrder())
+        buffer.asShortBuffer().put(pcm)
+        return buffer
+    }
+}
@@ -0,0 +1,193 @@
+package com.ailive.audio
+
+import android.content.Context
+import android.util.Log
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.withContext
+import java.io.File
+import java.nio.ByteBuffer
+import java.util.Locale
+
+/**
+ * Real-time factor benchmark of the Whisper decoding profiles.
+ *
+ * Every profile transcribes the same WAV fixtures (16-bit PCM, any rate)
+ * through the one-shot path. RTF is processing time divided by audio
+ * duration, so below 1 is faster than real time. VAD is off while the
+ * benchmark runs, so the whole clip is decoded and the RTF is over the
+ * audio Whisper actually saw. The first pass of each profile is a warm-up
+ * and not counted; transcripts are scored against the fixture text (word
+ * error rate) so accuracy can be compared next to speed.
+ *
+ * Fixtures are scripted in assets/whisper_bench/fixtures.tsv and rendered
+ * once with the system TTS into filesDir/whisper_bench, then reused, so
+ * repeated runs on a device decode identical audio. Recordings dropped into
+ * that directory (optionally with a <name>.txt reference) are included too.
+ *
+ * Run it on a device with:
+ *   adb shell am start -n <package>/com.ailive.MainActivity --ez run_whisper_benchmark true
+ * and read the "WhisperBenchmark" log tag.
+ */
+object WhisperBenchmark {
+    private const val TAG = "WhisperBenchmark"
+
+    /** Fixtures are rendered to and read from here */
+    const val FIXTURE_DIR = "whisper_bench"
+    private const val FIXTURE_SCRIPT = "whisper_bench/fixtures.tsv"
+    private const val SYNTHESIS_TIMEOUT_MS = 30_000L
+
+    /** Intent extra (boolean) that makes MainActivity run the benchmark */
+    const val EXTRA_RUN = "run_whisper_benchmark"
+
+    /** A WAV clip and, when known, what is said in it */
+    data class Fixture(val file: File, val reference: String?)
+
+    data class Result(
+        val profile: WhisperProcessor.Profile,
+        val fixture: String,
+        val audioMs: Long,
+        val meanMs: Float,
+        val minMs: Float,
+        val transcript: String,
+        val reference: String?
+    ) {
+        /** Mean processing time / audio duration */
+        fun rtf(): Float = if (audioMs > 0) meanMs / audioMs else 0f
+
+        /** Word error rate against the reference, or null without one */
+        fun wer(): Float? = reference?.let { wordErrorRate(it, transcript) }
+    }
+
+    private class Clip(val name: String, val pcm: ByteBuffer, val sampleRate: Int, val audioMs: Long, val reference: String?)
+
+    /**
+     * The scripted fixtures, rendering the ones not on disk yet, plus any
+     * other WAV files in filesDir/whisper_bench; sorted by name.
+     */
+    suspend fun prepareFixtures(context: Context): List<Fixture> = withContext(Dispatchers.IO) {
+        val dir = File(context.filesDir, FIXTURE_DIR).apply { mkdirs() }
+        val scripted = context.assets.open(FIXTURE_SCRIPT).bufferedReader().useLines { lines ->
+            lines.map { it.trim() }
+                .filter { it.isNotEmpty() && !it.startsWith("#") }
+                .mapNotNull { line ->
+                    val (name, text) = line.split('\t', limit = 2).takeIf { it.size == 2 } ?: return@mapNotNull null
+                    name to text
+                }
+                .toList()
+        }
+
+        val missing = scripted.filter { (name, _) -> !File(dir, "$name.wav").exists() }
+        if (missing.isNotEmpty()) {
+            Log.i(TAG, "🎙️ Rendering ${missing.size} benchmark fixtures with the system TTS...")
+            val requests = missing.map { (name, text) -> SpeechSynthesis.Request(text, File(dir, "$name.wav")) }
+            SpeechSynthesis.toFiles(context, requests, Locale.US, SYNTHESIS_TIMEOUT_MS)
+                .zip(requests)
+                .filter { (ok, _) -> !ok }
+                .forEach { (_, request) ->
+                    Log.w(TAG, "Could not render ${request.file.name}")
+                    request.file.delete()
+                }
+        }
+
+        val references = scripted.toMap()
+        (dir.listFiles { file -> file.extension.equals("wav", ignoreCase = true) } ?: emptyArray())
+            .sortedBy { it.name }
+            .map { file ->
+                val reference = references[file.nameWithoutExtension]
+                    ?: File(dir, "${file.nameWithoutExtension}.txt").takeIf { it.exists() }?.readText()?.trim()
+                Fixture(file, reference)
+            }
+    }
+
+    /**
+     * Prepare the fixtures and benchmark every profile on them.
+     */
+    suspend fun runAll(context: Context, processor: WhisperProcessor): List<Result> =
+        run(processor, prepareFixtures(context))
+
+    /**
+     * @param processor an initialized processor; its profile is reset to
+     *        COMMAND and its VAD settings restored afterwards
+     * @return one result per profile and fixture; unreadable fixtures are skipped
+     */
+    suspend fun run(
+        processor: WhisperProcessor,
+        fixtures: List<Fixture>,
+        profiles: List<WhisperProcessor.Profile> = WhisperProcessor.Profile.values().toList(),
+        repetitions: Int = 3
+    ): List<Result> = withContext(Dispatchers.Default) {
+        val clips = fixtures.mapNotNull { fixture ->
+            val (pcm, rate) = WavFile.read(fixture.file) ?: run {
+                Log.w(TAG, "Skipping ${fixture.file.name}: not 16-bit PCM WAV")
+                return@mapNotNull null
+            }
+            Clip(fixture.file.name, WavFile.toDirectBuffer(pcm), rate, pcm.size * 1000L / rate, fixture.reference)
+        }
+        if (clips.isEmpty()) {
+            Log.w(TAG, "No benchmark fixtures available")
+            return@withContext emptyList()
+        }
+
+        // Decode whole clips: with VAD only the speech spans would be timed
+        val vad = processor.vadConfig
+        processor.setVadConfig(vad.copy(enabled = false))
+        try {
+            profiles.flatMap { profile ->
+                processor.setProfile(profile)
+                // Warm-up: first decode with new parameters allocates buffers
+                clips.first().let { processor.transcribe(it.pcm, it.pcm.capacity(), it.sampleRate) }
+
+                val results = clips.map { clip ->
+                    val times = FloatArray(repetitions.coerceAtLeast(1))
+                    var transcript = ""
+                    for (i in times.indices) {
+                        val start = System.nanoTime()
+                        transcript = processor.transcribe(clip.pcm, clip.pcm.capacity(), clip.sampleRate)
+                        times[i] = (System.nanoTime() - start) / 1_000_000f
+                    }
+                    Result(profile, clip.name, clip.audioMs, times.average().toFloat(), times.minOrNull() ?: 0f,
+                           transcript.trim(), clip.reference)
+                }
+
+                results.forEach {
+                    val wer = it.wer()?.let { w -> ", WER ${"%.1f".format(w * 100)}%" } ?: ""
+                    Log.i(TAG, "📊 ${profile.nativeName} ${it.fixture} (${it.audioMs} ms): " +
+                            "mean ${"%.0f".format(it.meanMs)} ms, min ${"%.0f".format(it.minMs)} ms, " +
+                            "RTF ${"%.3f".format(it.rtf())}$wer → '${it.transcript}'")
+                }
+                val totalAudio = results.sumOf { it.audioMs }
+                val totalMs = results.sumOf { it.meanMs.toDouble() }
+                val scored = results.mapNotNull { it.wer() }
+                val meanWer = if (scored.isNotEmpty()) ", mean WER ${"%.1f".format(scored.average() * 100)}%" else ""
+                Log.i(TAG, "📊 ${profile.nativeName}: overall RTF ${"%.3f".format(totalMs / totalAudio.coerceAtLeast(1))}" +
+                        "$meanWer over ${results.size} fixtures")
+                results
+            }
+        } finally {
+            processor.setProfile(WhisperProcessor.Profile.COMMAND)
+            processor.setVadConfig(vad)
+        }
+    }
+
+    /**
+     * Word-level edit distance / reference length, ignoring case and punctuation.
+     */
+    fun wordErrorRate(reference: String, hypothesis: String): Float {
+        fun words(text: String) = text.lowercase().replace(Regex("[^a-z0-9' ]"), " ").split(' ').filter { it.isNotEmpty() }
+        val ref = words(reference)
+        val hyp = words(hypothesis)
+        if (ref.isEmpty()) return if (hyp.isEmpty()) 0f else 1f
+
+        var prev = IntArray(hyp.size + 1) { it }
+        for (i in 1..ref.size) {
+            val cur = IntArray(hyp.size + 1)
+            cur[0] = i
+            for (j in 1..hyp.size) {
+                val substitution = prev[j - 1] + if (ref[i - 1] == hyp[j - 1]) 0 else 1
+                cur[j] = minOf(substitution, prev[j] + 1, cur[j - 1] + 1)
+            }
+            prev = cur
+        }
+        return prev[hyp.size].toFloat() / ref.size
+    }
+}
@@ -11,30 +11,65 @@ import androidx.core.app.ActivityCompat
 import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.Job
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.isActive
 import kotlinx.coroutines.launch
+import kotlinx.coroutines.withContext
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 
 /**
  * WhisperProcessor - High-performance, on-device speech-to-text using whisper.cpp
  *
- * This class handles raw audio recording, buffering, and passes the data
- * to the native whisper.cpp library for transcription.
+ * This class handles raw audio recording and streams it to the native
+ * whisper.cpp library: the microphone is read in short hops and a decoder
+ * loop re-decodes the uncommitted audio every STREAM_STEP_MS, so partial
+ * text shows up within a second and words spanning a hop are not cut.
+ * Text is committed (onFinalResult) once consecutive decodes agree on it.
+ *
+ * Native voice activity detection gates both paths: while nothing but
+ * silence or background noise is heard the Whisper encoder does not run,
+ * and the end of an utterance commits its text immediately.
+ *
+ * While waiting for the wake phrase the microphone can feed a native
+ * KeywordSpotter instead (startKeywordSpotting), so Whisper only runs
+ * after the phrase is heard.
+ *
+ * The microphone records at the device's native rate into a direct
+ * ByteBuffer that native code reads in place: conversion to float and
+ * resampling to 16 kHz happen there, without per-sample Kotlin loops or
+ * JVM array copies.
+ *
+ * Whole recordings are transcribed offline with transcribeFiles /
+ * transcribeBuffers: they are split at speech boundaries and the pieces
+ * decoded in parallel, each core with its own decoder state on the one model.
  */
 class WhisperProcessor(private val context: Context) {
     private val TAG = "WhisperProcessor"
 
     // Callbacks
     var onFinalResult: ((String) -> Unit)? = null
+    /** Hypothesis for the audio not yet committed: stable prefix and the still changing rest */
+    var onPartialResult: ((stable: String, pending: String) -> Unit)? = null
     var onError: ((String) -> Unit)? = null
     var onReadyForSpeech: (() -> Unit)? = null
+    /** Wake phrase spotted while in startKeywordSpotting() mode */
+    var onKeywordDetected: (() -> Unit)? = null
 
     private var audioRecord: AudioRecord? = null
     private var recordingJob: Job? = null
+    @Volatile
     private var isListening = false
 
     companion object {
         private const val SAMPLE_RATE = 16000 // Whisper requires 16kHz
         private const val CHANNEL_CONFIG = AudioFormat.CHANNEL_IN_MONO
         private const val AUDIO_FORMAT = AudioFormat.ENCODING_PCM_16BIT
+
+        private const val HOP_SAMPLES = SAMPLE_RATE / 10   // 100 ms microphone reads
+        private const val STREAM_STEP_MS = 500             // new audio between decodes
+        private const val STREAM_WINDOW_MS = 10000         // longest uncommitted window
+        private const val DECODE_POLL_MS = 50L
     }
 
     // Load native library
@@ -42,10 +77,55 @@ class WhisperProcessor(private val context: Context) {
         System.loadLibrary("ailive_llm")
     }
 
+    /**
+     * Voice activity detection settings.
+     *
+     * @param thresholdDb Frame energy above the adaptive noise floor that counts as speech
+     * @param hangoverMs Speech continues this long after the last speech frame
+     * @param paddingMs Audio kept before and after each speech segment
+     * @param minSpeechMs Shorter bursts (clicks, taps) are ignored
+     */
+    data class VadConfig(
+        val enabled: Boolean = true,
+        val thresholdDb: Float = 12f,
+        val hangoverMs: Int = 300,
+        val paddingMs: Int = 200,
+        val minSpeechMs: Int = 100
+    )
+
+    /**
+     * Decoding profiles for one-shot transcription (see whisper_profile.h).
+     * Compare them with WhisperBenchmark.
+     */
+    enum class Profile(val nativeName: String) {
+        /** Short voice commands: greedy, one segment, encoder context cut to the clip */
+        COMMAND("command"),
+        /** Longer free speech: beam search, full context, temperature fallback */
+        DICTATION("dictation"),
+        /** Low priority: greedy on two threads */
+        BACKGROUND("background")
+    }
+
+    /** A transcribed segment of batch input [source], times from its start */
+    data class TimedSegment(val source: Int, val startMs: Long, val endMs: Long, val text: String)
+
     // --- Native JNI Functions ---
     private external fun nativeInit(modelPath: String): Boolean
     private external fun nativeProcess(audioData: FloatArray): String
+    private external fun nativeProcessDirect(pcm: ByteBuffer, byteCount: Int, sampleRate: Int): String
     private external fun nativeRelease()
+    private external fun nativeStreamStart(stepMs: Int, windowMs: Int): Boolean
+    private external fun nativeStreamPush(pcm: ShortArray, count: Int)
+    private external fun nativeStreamPushDirect(pcm: ByteBuffer, byteCount: Int, sampleRate: Int)
+    private external fun nativeStreamDecode(flush: Boolean): Array<String>?
+    private external fun nativeSetVadParams(
+        enabled: Boolean, thresholdDb: Float, hangoverMs: Int, paddingMs: Int, minSpeechMs: Int
+    )
+    private external fun nativeDetectSpeech(audioData: FloatArray): IntArray?
+    private external fun nativeSetProfile(name: String): Boolean
+    private external fun nativeTranscribeBatch(
+        paths: Array<String>?, buffers: Array<ByteBuffer>?, bufferRates: IntArray?, profile: String?, maxParallel: Int
+    ): Array<TimedSegment>?
 
     /**
      * Initialize the Whisper model. Must be called before starting to listen.
@@ -62,70 +142,234 @@ class WhisperProcessor(private val context: Context) {
 
     /**
      * Start listening for speech.
-     * Records audio and processes it when a chunk is ready.
+     * Records audio in short hops and transcribes it as a stream.
      */
     fun startListening() {
+        val sampleRate = captureSampleRate()
+        val record = openMicrophone(sampleRate) ?: return
+
+        recordingJob = CoroutineScope(Dispatchers.IO).launch {
+            // Waits for a decode still running from the previous session
+            if (!nativeStreamStart(STREAM_STEP_MS, STREAM_WINDOW_MS)) {
+                isListening = false
+                CoroutineScope(Dispatchers.Main).launch {
+                    onError?.invoke("Failed to start Whisper stream.")
+                }
+                return@launch
+            }
+
+            if (!beginRecording(record)) return@launch
+            onReadyForSpeech?.invoke()
+            Log.i(TAG, "🎤 Listening started with Whisper (streaming).")
+            launch(Dispatchers.Default) { decodeLoop() }
+
+            // 100 ms of 16-bit samples, read in place by native code
+            val hopBytes = sampleRate / 10 * 2
+            val buffer = ByteBuffer.allocateDirect(hopBytes).order(ByteOrder.nativeOrder())
+            while (isListening && isActive) {
+                val readBytes = record.read(buffer, hopBytes)
+                if (readBytes > 0) {
+                    nativeStreamPushDirect(buffer, readBytes, sampleRate)
+                }
+            }
+        }
+    }
+
+    /**
+     * Listen for the wake phrase only: the microphone feeds [spotter] and
+     * Whisper does not run. Each detection invokes onKeywordDetected on the
+     * main thread; stopListening() ends spotting.
+     */
+    fun startKeywordSpotting(spotter: KeywordSpotter) {
+        val record = openMicrophone(SAMPLE_RATE) ?: return
+
+        recordingJob = CoroutineScope(Dispatchers.IO).launch {
+            spotter.reset()
+            if (!beginRecording(record)) return@launch
+            Log.i(TAG, "👂 Keyword spotting started (${spotter.templateCount} templates).")
+
+            val buffer = ShortArray(HOP_SAMPLES)
+            while (isListening && isActive) {
+                val readSize = record.read(buffer, 0, buffer.size)
+                if (readSize > 0 && spotter.process(buffer, readSize)) {
+                    Log.i(TAG, "🎯 Keyword spotted (distance %.2f)".format(spotter.takeBestScore()))
+                    CoroutineScope(Dispatchers.Main).launch {
+                        onKeywordDetected?.invoke()
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Check the permission and create the recorder; marks the processor as
+     * listening. Null if already listening or not permitted.
+     */
+    private fun openMicrophone(sampleRate: Int): AudioRecord? {
         if (isListening) {
             Log.w(TAG, "Already listening.")
-            return
+            return null
         }
         if (ActivityCompat.checkSelfPermission(context, Manifest.permission.RECORD_AUDIO) != PackageManager.PERMISSION_GRANTED) {
             onError?.invoke("RECORD_AUDIO permission not granted.")
-            return
+            return null
         }
 
-        val bufferSize = AudioRecord.getMinBufferSize(SAMPLE_RATE, CHANNEL_CONFIG, AUDIO_FORMAT)
-        audioRecord = AudioRecord(
+        // Room for a few 100 ms hops in case a read is late
+        val bufferSize = maxOf(
+            AudioRecord.getMinBufferSize(sampleRate, CHANNEL_CONFIG, AUDIO_FORMAT),
+            sampleRate / 10 * 2 * 4
+        )
+        val record = AudioRecord(
             MediaRecorder.AudioSource.MIC,
-            SAMPLE_RATE,
+            sampleRate,
             CHANNEL_CONFIG,
             AUDIO_FORMAT,
             bufferSize
         )
-
+        audioRecord = record
         isListening = true
-        audioRecord?.startRecording()
-        onReadyForSpeech?.invoke()
-        Log.i(TAG, "🎤 Listening started with Whisper.")
+        return record
+    }
 
-        recordingJob = CoroutineScope(Dispatchers.IO).launch {
-            // We'll process audio in chunks of 5 seconds for this example
-            val chunkSizeBytes = SAMPLE_RATE * 2 * 5 // 5 seconds of 16-bit audio
-            val buffer = ShortArray(chunkSizeBytes / 2)
-
-            while (isListening) {
-                val readSize = audioRecord?.read(buffer, 0, buffer.size) ?: 0
-                if (readSize > 0) {
-                    processAudioChunk(buffer, readSize)
-                }
-            }
-        }
+    /**
+     * The device's native audio rate (typically 48 kHz), so the platform
+     * does not resample before us; 16 kHz if it cannot be determined.
+     */
+    private fun captureSampleRate(): Int {
+        val audioService = context.getSystemService(Context.AUDIO_SERVICE) as? android.media.AudioManager
+        val nativeRate = audioService
+            ?.getProperty(android.media.AudioManager.PROPERTY_OUTPUT_SAMPLE_RATE)
+            ?.toIntOrNull()
+        return if (nativeRate != null && nativeRate > 0 &&
+            AudioRecord.getMinBufferSize(nativeRate, CHANNEL_CONFIG, AUDIO_FORMAT) > 0) nativeRate else SAMPLE_RATE
     }
 
-    private fun processAudioChunk(audioData: ShortArray, size: Int) {
-        // 1. Convert ShortArray to FloatArray (and normalize)
-        val floatBuffer = FloatArray(size)
-        for (i in 0 until size) {
-            floatBuffer[i] = audioData[i] / 32768.0f
+    /** False if listening was stopped (and the recorder released) meanwhile */
+    private fun beginRecording(record: AudioRecord): Boolean {
+        return try {
+            if (!isListening) return false
+            record.startRecording()
+            true
+        } catch (e: IllegalStateException) {
+            false
         }
+    }
 
-        // 2. Call native function
-        val transcription = nativeProcess(floatBuffer)
+    /**
+     * Decode the stream whenever a step of new audio is buffered and
+     * deliver committed and partial text on the main thread.
+     */
+    private suspend fun decodeLoop() {
+        while (isListening) {
+            val update = nativeStreamDecode(false)
+            if (update == null) {
+                delay(DECODE_POLL_MS)
+                continue
+            }
+            if (!isListening) break
 
-        // 3. Invoke callback on the main thread
-        if (transcription.isNotBlank()) {
+            val (committed, stable, pending) = update
             CoroutineScope(Dispatchers.Main).launch {
-                onFinalResult?.invoke(transcription)
+                if (committed.isNotBlank()) {
+                    onFinalResult?.invoke(committed.trim())
+                }
+                onPartialResult?.invoke(stable.trimStart(), pending)
             }
         }
     }
 
+    /** Voice activity detection settings last applied with setVadConfig() */
+    var vadConfig = VadConfig()
+        private set
+
+    /**
+     * Change voice activity detection; takes effect on the next
+     * startListening() and transcribe().
+     */
+    fun setVadConfig(config: VadConfig) {
+        vadConfig = config
+        nativeSetVadParams(config.enabled, config.thresholdDb, config.hangoverMs, config.paddingMs, config.minSpeechMs)
+    }
+
+    /**
+     * Select the decoding profile for transcribe(); COMMAND by default.
+     */
+    fun setProfile(profile: Profile): Boolean = nativeSetProfile(profile.nativeName)
+
+    /**
+     * Speech segments of a clip (16 kHz mono) as sample ranges, padded.
+     */
+    fun detectSpeech(audioData: FloatArray): List<IntRange> {
+        val bounds = nativeDetectSpeech(audioData) ?: return emptyList()
+        return (0 until bounds.size / 2).map { bounds[2 * it] until bounds[2 * it + 1] }
+    }
+
+    /**
+     * One-shot transcription of a complete clip (16 kHz mono, [-1, 1]).
+     * Only its speech segments are decoded. Independent of the microphone stream.
+     */
+    fun transcribe(audioData: FloatArray): String = nativeProcess(audioData)
+
+    /**
+     * One-shot transcription of 16-bit mono PCM in a direct ByteBuffer
+     * (native byte order, from position 0) recorded at [sampleRate].
+     * The buffer is read in place and resampled natively.
+     */
+    fun transcribe(pcm: ByteBuffer, byteCount: Int, sampleRate: Int): String {
+        require(pcm.isDirect) { "PCM buffer must be a direct ByteBuffer" }
+        return nativeProcessDirect(pcm, byteCount, sampleRate)
+    }
+
+    /**
+     * Transcribe recordings (16-bit PCM WAV, or raw 16 kHz mono 16-bit PCM)
+     * in parallel. Files are memory-mapped, not read into the heap.
+     *
+     * @param maxParallel decoder states, 0 = half the cores
+     * @return segments of each file, in the order of [paths]; empty for
+     *         files that cannot be read
+     */
+    suspend fun transcribeFiles(
+        paths: List<String>,
+        profile: Profile = Profile.DICTATION,
+        maxParallel: Int = 0
+    ): List<List<TimedSegment>> = withContext(Dispatchers.Default) {
+        val segments = nativeTranscribeBatch(paths.toTypedArray(), null, null, profile.nativeName, maxParallel)
+        groupBySource(segments, paths.size)
+    }
+
+    /**
+     * Like transcribeFiles for direct buffers (e.g. FileChannel.map), read in
+     * place from position 0 to capacity. A buffer without a WAV header is raw
+     * mono 16-bit PCM (native byte order) at its [sampleRates] entry.
+     */
+    suspend fun transcribeBuffers(
+        buffers: List<ByteBuffer>,
+        sampleRates: IntArray = IntArray(buffers.size) { SAMPLE_RATE },
+        profile: Profile = Profile.DICTATION,
+        maxParallel: Int = 0
+    ): List<List<TimedSegment>> = withContext(Dispatchers.Default) {
+        require(buffers.all { it.isDirect }) { "Batch buffers must be direct ByteBuffers" }
+        val segments = nativeTranscribeBatch(null, buffers.toTypedArray(), sampleRates, profile.nativeName, maxParallel)
+        groupBySource(segments, buffers.size)
+    }
+
+    private fun groupBySource(segments: Array<TimedSegment>?, sources: Int): List<List<TimedSegment>> {
+        if (segments == null) {
+            Log.e(TAG, "Whisper model not loaded; cannot transcribe batch.")
+            return List(sources) { emptyList() }
+        }
+        val bySource = segments.groupBy { it.source }
+        return List(sources) { bySource[it] ?: emptyList() }
+    }
+
     /**
      * Stop listening for speech.
      */
     fun stopListening() {
         if (!isListening) return
 
+        // Audio not committed yet is dropped; the next start resets the stream
         isListening = false
         recordingJob?.cancel()
         recordingJob = null
@@ -10,6 +10,7 @@ import com.ailive.memory.embeddings.TextEmbedder
 import com.ailive.memory.storage.*
 import kotlinx.coroutines.*
 import kotlinx.coroutines.flow.collect
+import java.io.File
 
 /**
  * Memory AI - AILive's hippocampus for storing and recalling memories.
@@ -20,9 +21,16 @@ class MemoryAI(
     private val stateManager: StateManager
 ) {
     private val TAG = "MemoryAI"
+    private val REBUILD_BATCH_SIZE = 32
     private val scope = CoroutineScope(Dispatchers.Default + SupervisorJob())
     
-    private val vectorDB = VectorDB(dimensions = 384, maxEntries = 50000)
+    // Vectors and entries served from an mmap'ed index file: no reload or
+    // re-embedding at startup, and the vectors live in the page cache
+    private val vectorDB = VectorDB(
+        dimensions = 384,
+        maxEntries = 50000,
+        persistFile = File(context.filesDir, "memory_vectors.aiv")
+    )
     private val memoryStore = MemoryStore(context)
     private val embedder = TextEmbedder(context = context, dimensions = 384)
 
@@ -77,6 +85,7 @@ class MemoryAI(
         
         runBlocking {
             saveMemoriesToDisk()
+            vectorDB.close()
         }
         
         autoSaveJob?.cancel()
@@ -224,16 +233,40 @@ class MemoryAI(
     }
     
     /**
-     * Load memories from disk on startup.
+     * Load memories from disk on startup. The index file is used when it
+     * has entries; otherwise memories saved as JSON by earlier versions are
+     * imported into it. If the index file turns out to be damaged, its
+     * memories are re-embedded from their text and the index rebuilt.
      */
     private suspend fun loadMemoriesFromDisk() {
+        val restored = vectorDB.restore(onCorrupt = ::rebuildDamagedIndex)
+        if (restored > 0) {
+            Log.i(TAG, "Loaded $restored memories from index file")
+            return
+        }
+
         val entries = memoryStore.loadAll()
         entries.forEach { entry ->
             vectorDB.insert(entry)
         }
+        vectorDB.sync()
         Log.i(TAG, "Loaded ${entries.size} memories from disk")
     }
     
+    /**
+     * Re-embed the memories of a damaged index file from their content and
+     * replace the index with them. The damaged file is kept by VectorDB.
+     */
+    private suspend fun rebuildDamagedIndex(damaged: List<MemoryEntry>) {
+        Log.w(TAG, "Memory index damaged, re-embedding ${damaged.size} memories")
+        val rebuilt = damaged.chunked(REBUILD_BATCH_SIZE).flatMap { chunk ->
+            chunk.zip(embedder.embedBatch(chunk.map { it.content })) { entry, embedding ->
+                entry.copy(embedding = embedding)
+            }
+        }
+        vectorDB.rebuild(rebuilt)
+    }
+
     /**
      * Save memories to disk periodically.
      */
@@ -245,9 +278,15 @@ class MemoryAI(
     }
     
     /**
-     * Save all memories to disk.
+     * Flush new memories and access statistics to the index file, or save
+     * all memories as JSON when the native index is unavailable.
      */
     private suspend fun saveMemoriesToDisk() {
+        if (vectorDB.isPersistent) {
+            vectorDB.sync()
+            Log.d(TAG, "Auto-saved ${vectorDB.size()} memories")
+            return
+        }
         val allEntries = vectorDB.filter { true }
         memoryStore.saveAll(allEntries)
         Log.d(TAG, "Auto-saved ${allEntries.size} memories")
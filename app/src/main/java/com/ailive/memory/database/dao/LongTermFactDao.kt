@@ -121,6 +121,12 @@ interface LongTermFactDao {
     @Query("SELECT COUNT(*) FROM long_term_facts")
     suspend fun getFactCount(): Int
 
+    /**
+     * Get count of facts that have an embedding
+     */
+    @Query("SELECT COUNT(*) FROM long_term_facts WHERE embedding IS NOT NULL")
+    suspend fun getEmbeddedFactCount(): Int
+
     /**
      * Get average importance
      */
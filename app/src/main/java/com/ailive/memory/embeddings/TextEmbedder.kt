@@ -2,8 +2,11 @@ package com.ailive.memory.embeddings
 
 import android.content.Context
 import android.util.Log
+import com.ailive.ai.llm.LLMBridge
+import com.ailive.ai.llm.ModelDownloadManager
 import com.ailive.ai.memory.EmbeddingModelManager
 import kotlinx.coroutines.runBlocking
+import java.io.File
 import kotlin.random.Random
 
 /**
@@ -22,7 +25,7 @@ import kotlin.random.Random
  * FEATURES:
  * - Real semantic embeddings for accurate memory retrieval
  * - Graceful fallback to deterministic random if model unavailable
- * - Batch processing support
+ * - Batch processing support (native llama.cpp batches when a BGE GGUF is present)
  * - L2 normalized vectors for cosine similarity
  *
  * IMPACT:
@@ -43,6 +46,10 @@ class TextEmbedder(
         context?.let { EmbeddingModelManager(it) }
     }
 
+    // Native batched embedder (BGE-small GGUF via llama.cpp), preferred when available
+    @Volatile
+    private var nativeEmbedder: LLMBridge? = null
+
     @Volatile
     private var modelInitialized = false
 
@@ -66,6 +73,12 @@ class TextEmbedder(
 
         modelInitializationAttempted = true
 
+        if (initializeNativeEmbedder()) {
+            modelInitialized = true
+            Log.i(TAG, "✅ Real semantic embeddings enabled (BGE-small GGUF, batched native)")
+            return true
+        }
+
         val manager = embeddingModelManager ?: run {
             Log.w(TAG, "No context provided - using fallback random embeddings")
             return false
@@ -87,6 +100,14 @@ class TextEmbedder(
      * Uses BGE-small-en-v1.5 if available, otherwise falls back to deterministic random.
      */
     fun embed(text: String): FloatArray {
+        nativeEmbedder?.let { bridge ->
+            val embedding = bridge.embedBatch(listOf(text))?.firstOrNull()
+            if (embedding != null) {
+                return embedding
+            }
+            Log.w(TAG, "Native embedding failed, trying ONNX/fallback")
+        }
+
         // Try to use real embedding model if available
         if (modelInitialized && embeddingModelManager?.isReady() == true) {
             try {
@@ -109,9 +130,18 @@ class TextEmbedder(
 
     /**
      * Batch embed multiple texts.
-     * More efficient than calling embed() multiple times.
+     * More efficient than calling embed() multiple times: with the native
+     * embedder the whole list is one JNI call and a few batched decodes.
      */
     fun embedBatch(texts: List<String>): List<FloatArray> {
+        nativeEmbedder?.let { bridge ->
+            val embeddings = bridge.embedBatch(texts)
+            if (embeddings != null) {
+                return embeddings
+            }
+            Log.w(TAG, "Native batch embedding failed, trying ONNX/fallback")
+        }
+
         // Try to use real embedding model if available
         if (modelInitialized && embeddingModelManager?.isReady() == true) {
             try {
@@ -137,19 +167,50 @@ class TextEmbedder(
      * Check if real embeddings are available
      */
     fun isUsingRealEmbeddings(): Boolean {
-        return modelInitialized && embeddingModelManager?.isReady() == true
+        return nativeEmbedder != null || (modelInitialized && embeddingModelManager?.isReady() == true)
     }
 
     /**
      * Clean up embedding model resources
      */
     fun cleanup() {
+        nativeEmbedder?.nativeFreeEmbeddingModel()
+        nativeEmbedder = null
         embeddingModelManager?.cleanup()
         modelInitialized = false
     }
 
     // ===== PRIVATE HELPER METHODS =====
 
+    /**
+     * Load the BGE-small GGUF into the native embedding engine if it is in the models directory
+     */
+    private fun initializeNativeEmbedder(): Boolean {
+        val appContext = context ?: return false
+        if (!LLMBridge.isLibraryAvailable()) return false
+
+        val modelFile = File(ModelDownloadManager(appContext).getModelPath(ModelDownloadManager.BGE_MODEL_GGUF))
+        if (!modelFile.exists()) {
+            Log.d(TAG, "No BGE GGUF found, native batched embeddings disabled")
+            return false
+        }
+
+        val bridge = LLMBridge()
+        if (!bridge.loadEmbeddingModel(modelFile.absolutePath, LLMBridge.POOLING_CLS)) {
+            return false
+        }
+
+        val nativeDims = bridge.nativeGetEmbeddingDim()
+        if (nativeDims != dimensions) {
+            Log.w(TAG, "⚠️  BGE GGUF has $nativeDims dims, expected $dimensions - not using it")
+            bridge.nativeFreeEmbeddingModel()
+            return false
+        }
+
+        nativeEmbedder = bridge
+        return true
+    }
+
     /**
      * Generate fallback embedding using deterministic random
      * Used when real BGE model is not available
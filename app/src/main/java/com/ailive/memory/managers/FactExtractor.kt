@@ -25,6 +25,7 @@ class FactExtractor(private val llmBridge: LLMBridge) {
     companion object {
         // Max tokens for fact extraction (keep it short for speed)
         private const val MAX_EXTRACTION_TOKENS = 200
+        private const val SESSION_NAME = "facts"
 
         // Confidence threshold for accepting extracted facts
         private const val MIN_CONFIDENCE = 0.5f
@@ -54,7 +55,8 @@ class FactExtractor(private val llmBridge: LLMBridge) {
             val prompt = buildExtractionPrompt(userMessage, aiResponse)
 
             // Generate facts using LLM
-            val response = llmBridge.generate(prompt, MAX_EXTRACTION_TOKENS)
+            // Own session so extraction does not evict the conversation's cached prefix
+            val response = llmBridge.generate(prompt, MAX_EXTRACTION_TOKENS, llmBridge.sessionFor(SESSION_NAME))
 
             // Parse LLM response
             val facts = parseLLMResponse(response, conversationId)
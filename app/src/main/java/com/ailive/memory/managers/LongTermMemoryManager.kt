@@ -6,7 +6,15 @@ import com.ailive.ai.llm.LLMBridge
 import com.ailive.memory.database.MemoryDatabase
 import com.ailive.memory.database.entities.FactCategory
 import com.ailive.memory.database.entities.LongTermFactEntity
+import com.ailive.memory.storage.ContentType
+import com.ailive.memory.storage.MemoryEntry
+import com.ailive.memory.storage.NativeVectorIndex
+import com.ailive.memory.storage.VectorDB
+import com.ailive.memory.storage.VectorIndexBenchmark
 import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import java.io.File
 import java.util.UUID
 import java.util.concurrent.TimeUnit
 
@@ -23,10 +31,27 @@ class LongTermMemoryManager(
     private val llmBridge: LLMBridge  // Required for semantic search and fact extraction
 ) {
     private val TAG = "LongTermMemoryManager"
+    private val REINDEX_BATCH_SIZE = 32
+    // Fact metadata key holding the embedding signature (model, pooling, method)
+    private val EMBEDDING_SIGNATURE_KEY = "embeddingSignature"
+    private val FACT_INDEX_CAPACITY = 200_000
+    private val FACT_INDEX_CONFIG = NativeVectorIndex.HnswConfig(m = 16, efConstruction = 200, efSearch = 64)
 
     private val database = MemoryDatabase.getInstance(context)
     private val factDao = database.longTermFactDao()
 
+    // HNSW index over fact embeddings, kept in an index file: reopened on
+    // first search (built from the database only if it is missing or out of
+    // date), then updated incrementally as facts are learned or deleted
+    private val factIndexFile = File(context.filesDir, "fact_index.aiv")
+    private val factIndexMutex = Mutex()
+    @Volatile
+    private var factIndex: VectorDB? = null
+    @Volatile
+    private var factIndexDims = 0
+    @Volatile
+    private var factIndexStale = false
+
     // LLM-based fact extractor (lazy init)
     private val factExtractor: FactExtractor by lazy {
         FactExtractor(llmBridge)
@@ -68,6 +93,11 @@ class LongTermMemoryManager(
             Log.w(TAG, "Failed to generate embedding for fact: ${e.message}")
             null
         }
+        val metadata = if (embedding != null) {
+            mapOf(EMBEDDING_SIGNATURE_KEY to llmBridge.nativeGetEmbeddingSignature())
+        } else {
+            emptyMap()
+        }
 
         // Create new fact
         val fact = LongTermFactEntity(
@@ -80,10 +110,14 @@ class LongTermMemoryManager(
             firstMentioned = System.currentTimeMillis(),
             lastVerified = System.currentTimeMillis(),
             tags = tags,
-            embedding = embedding  // Store embedding for semantic search
+            embedding = embedding,  // Store embedding for semantic search
+            metadata = metadata
         )
 
         factDao.insertFact(fact)
+        if (embedding != null && embedding.size == factIndexDims) {
+            factIndex?.insert(fact.toMemoryEntry())
+        }
         Log.i(TAG, "Learned new fact [${category.name}] with ${if (embedding != null) "embedding" else "no embedding"}: ${factText.take(50)}...")
         return fact
     }
@@ -206,22 +240,29 @@ class LongTermMemoryManager(
             }
         }
 
-        // 2. Get all facts that have an embedding.
-        val allFacts = factDao.getAllFacts().filter { it.embedding != null }
+        // 2. Query the HNSW fact index (sublinear in the number of facts).
+        val index = getFactIndex(queryEmbedding.size)
+        val rankedFacts = if (index != null && index.size() > 0) {
+            index.search(queryEmbedding.toFloatArray(), k = topN, minSimilarity = -1f)
+                .mapNotNull { factDao.getFact(it.entry.id) }
+        } else {
+            // No index (native library unavailable): score every fact.
+            val allFacts = factDao.getAllFacts().filter { it.embedding != null }
 
-        if (allFacts.isEmpty()) {
-            Log.w(TAG, "No facts with embeddings found. Falling back to text search.")
-            return factDao.searchByText(queryText).take(topN)
-        }
+            if (allFacts.isEmpty()) {
+                Log.w(TAG, "No facts with embeddings found. Falling back to text search.")
+                return factDao.searchByText(queryText).take(topN)
+            }
 
-        // 3. Calculate cosine similarity and sort.
-        val scoredFacts = allFacts.map { fact ->
-            val similarity = cosineSimilarity(queryEmbedding, fact.embedding!!)
-            fact to similarity
-        }.sortedByDescending { it.second }
+            // 3. Calculate cosine similarity and sort.
+            allFacts.map { fact ->
+                val similarity = cosineSimilarity(queryEmbedding, fact.embedding!!)
+                fact to similarity
+            }.sortedByDescending { it.second }.map { it.first }
+        }
 
         // 4. Update access stats for the retrieved facts.
-        val results = scoredFacts.take(topN).map { it.first }
+        val results = rankedFacts.take(topN)
         results.forEach { fact ->
             factDao.updateFact(fact.withAccessUpdate()) // Ensure access count is updated
         }
@@ -268,6 +309,7 @@ class LongTermMemoryManager(
     suspend fun deleteFact(factId: String) {
         factDao.getFact(factId)?.let { fact ->
             factDao.deleteFact(fact)
+            factIndex?.delete(factId)
             Log.i(TAG, "Deleted fact: $factId")
         }
     }
@@ -278,6 +320,9 @@ class LongTermMemoryManager(
     suspend fun cleanupOldFacts() {
         val cutoffTime = System.currentTimeMillis() - TimeUnit.DAYS.toMillis(180)  // 6 months
         val deleted = factDao.deleteLowImportanceOldFacts(minImportance = 0.3f, cutoffTime = cutoffTime)
+        if (deleted > 0) {
+            invalidateFactIndex()  // bulk delete by query; rebuild on next search
+        }
         Log.i(TAG, "Cleaned up $deleted old low-importance facts")
     }
 
@@ -333,6 +378,133 @@ class LongTermMemoryManager(
         return if (union > 0) intersection.toFloat() / union else 0f
     }
 
+    /**
+     * Re-embed facts whose embedding is missing or was made with another
+     * embedding signature: a different model, pooling or embedding method,
+     * whose vectors are not comparable even at the same dimension.
+     *
+     * Embeds in batches, one native call per batch instead of one per fact.
+     *
+     * @return Number of facts re-embedded
+     */
+    suspend fun reindexFactEmbeddings(batchSize: Int = REINDEX_BATCH_SIZE): Int {
+        val expectedDim = llmBridge.nativeGetEmbeddingDim()
+        if (expectedDim <= 0) {
+            Log.w(TAG, "No embedding model available, skipping re-index")
+            return 0
+        }
+
+        val signature = llmBridge.nativeGetEmbeddingSignature()
+        val stale = factDao.getAllFacts().filter {
+            it.embedding?.size != expectedDim || it.metadata[EMBEDDING_SIGNATURE_KEY] != signature
+        }
+        if (stale.isEmpty()) return 0
+
+        Log.i(TAG, "🔄 Re-indexing ${stale.size} fact embeddings (dim $expectedDim)...")
+        var updated = 0
+        for (chunk in stale.chunked(batchSize)) {
+            val embeddings = llmBridge.embedBatch(chunk.map { it.factText }) ?: break
+            chunk.zip(embeddings).forEach { (fact, embedding) ->
+                val reembedded = fact.copy(
+                    embedding = embedding.toList(),
+                    metadata = fact.metadata + (EMBEDDING_SIGNATURE_KEY to signature)
+                )
+                factDao.updateFact(reembedded)
+                if (embedding.size == factIndexDims) {
+                    factIndex?.insert(reembedded.toMemoryEntry())
+                }
+                updated++
+            }
+        }
+        Log.i(TAG, "✓ Re-indexed $updated fact embeddings")
+        return updated
+    }
+
+    /**
+     * Build the fact index ahead of the first search (called during maintenance).
+     */
+    suspend fun prepareFactIndex() {
+        val dims = llmBridge.nativeGetEmbeddingDim()
+        if (dims > 0) {
+            getFactIndex(dims)
+        }
+    }
+
+    /**
+     * Recall/latency of the fact index against exact search over the same
+     * fact embeddings, sampling facts as queries.
+     */
+    suspend fun benchmarkFactIndex(k: Int = 5): List<VectorIndexBenchmark.Result> {
+        val embeddings = factDao.getAllFacts().mapNotNull { it.embedding?.toFloatArray() }
+        val dims = embeddings.groupingBy { it.size }.eachCount().maxByOrNull { it.value }?.key
+            ?: return emptyList()
+        val vectors = embeddings.filter { it.size == dims }
+        return VectorIndexBenchmark.run(vectors, vectors.shuffled().take(100), k, FACT_INDEX_CONFIG)
+    }
+
+    /**
+     * The fact index for `dims`-dimensional embeddings, reopening its index
+     * file on first use and rebuilding it from the database when the file
+     * does not match the database or the embedding model changed.
+     * Returns null when the native library is unavailable.
+     */
+    private suspend fun getFactIndex(dims: Int): VectorDB? {
+        factIndex?.let { if (factIndexDims == dims && !factIndexStale) return it }
+        if (!NativeVectorIndex.isAvailable()) return null
+
+        return factIndexMutex.withLock {
+            factIndex?.let { if (factIndexDims == dims && !factIndexStale) return@withLock it }
+
+            var index = factIndex
+            if (index == null || factIndexDims != dims) {
+                index?.close()
+                // An index file of another dimension is recreated empty on open
+                index = VectorDB(
+                    dimensions = dims,
+                    maxEntries = FACT_INDEX_CAPACITY,
+                    hnsw = FACT_INDEX_CONFIG,
+                    persistFile = factIndexFile
+                )
+                // A damaged file is rebuilt from the database on next use
+                val restored = index.restore(onCorrupt = { invalidateFactIndex() })
+                if (restored > 0 && restored == factDao.getEmbeddedFactCount()) {
+                    Log.i(TAG, "🗂️ Opened HNSW fact index: $restored facts, dim $dims")
+                    factIndexStale = false
+                    factIndexDims = dims
+                    factIndex = index
+                    return@withLock index
+                }
+            }
+
+            // Rewrites the index file, dropping a damaged sealed part too
+            val facts = factDao.getAllFacts().filter { it.embedding?.size == dims }
+            index.rebuild(facts.map { it.toMemoryEntry() })
+            index.sync()
+            Log.i(TAG, "🗂️ Built HNSW fact index: ${facts.size} facts, dim $dims")
+
+            factIndexStale = false
+            factIndexDims = dims
+            factIndex = index
+            index
+        }
+    }
+
+    /**
+     * Resync the fact index from the database on next use (after changes
+     * that bypass the incremental updates).
+     */
+    private fun invalidateFactIndex() {
+        factIndexStale = true
+    }
+
+    private fun LongTermFactEntity.toMemoryEntry() = MemoryEntry(
+        id = id,
+        content = factText,
+        contentType = ContentType.TEXT,
+        embedding = embedding!!.toFloatArray(),
+        importance = importance
+    )
+
     /**
      * Calculates the cosine similarity between two vectors.
      * Used for semantic search to find relevant facts based on embedding similarity.
@@ -110,6 +110,10 @@ class UnifiedMemoryManager(private val context: Context) {
         // Clean up old facts
         longTermMemory.cleanupOldFacts()
 
+        // Embed facts stored without (or with outdated) embeddings
+        longTermMemory.reindexFactEmbeddings()
+        longTermMemory.prepareFactIndex()
+
         // Recalculate profile completeness
         userProfile.recalculateCompleteness()
     }
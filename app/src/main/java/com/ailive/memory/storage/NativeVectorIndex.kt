@@ -0,0 +1,372 @@
+package com.ailive.memory.storage
+
+import android.util.Log
+import java.io.Closeable
+import java.io.File
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Kotlin handle to a native vector index.
+ *
+ * Exact mode (vector_store.cpp): vectors are normalized once on insert and
+ * stored contiguously in native memory; search is a SIMD dot-product scan
+ * (NEON on device) with a partial top-k.
+ *
+ * HNSW mode (hnsw_index.cpp, when [hnsw] is set): approximate search over a
+ * navigable small-world graph, sublinear in the number of vectors. Deletes
+ * leave tombstones until [compact] rebuilds the graph.
+ *
+ * Quantized mode (quantized_store.cpp, when [quantization] is set): int8
+ * and/or 1-bit codes in RAM, fp32 vectors in an mmap'ed file used to rescore
+ * the best candidates. 4x (int8) to ~18x (1-bit only) less resident memory.
+ *
+ * Persistent mode (persistent_index.cpp, when [persistFile] is set): the
+ * index lives in a versioned, checksummed file that is mmap'ed on open and
+ * read in place, so it is searchable within milliseconds of process start.
+ * Writes are appended to the file and [compact] folds them in. Exact search,
+ * or HNSW when [hnsw] is also set (the graph is saved and restored, not rebuilt).
+ * Each key can carry opaque metadata bytes stored next to its vector.
+ *
+ * All data crosses JNI through direct buffers, reused per thread.
+ * Keys are Longs; VectorDB maps its String ids onto them.
+ */
+class NativeVectorIndex(
+    val dimensions: Int,
+    initialCapacity: Int,
+    val hnsw: HnswConfig? = null,
+    val quantization: QuantizationConfig? = null,
+    val persistFile: File? = null
+) : Closeable {
+
+    init {
+        require(hnsw == null || quantization == null) { "HNSW and quantized modes are exclusive" }
+        require(quantization == null || persistFile == null) { "Quantized mode is not persistent" }
+    }
+
+    /**
+     * HNSW tuning. Higher [m]/[efConstruction] build a better graph (more
+     * memory, slower inserts); higher [efSearch] trades latency for recall.
+     */
+    data class HnswConfig(
+        val m: Int = 16,
+        val efConstruction: Int = 200,
+        val efSearch: Int = 64
+    )
+
+    /**
+     * Quantized storage. [int8] codes alone lose almost no recall; the
+     * [binary] sign-bit prefilter is much smaller and faster but its recall
+     * depends on the data - validate it with VectorIndexBenchmark. fp32
+     * vectors go to [rescoreFile] (recreated on open) or the native heap.
+     */
+    data class QuantizationConfig(
+        val int8: Boolean = true,
+        val binary: Boolean = false,
+        val binaryCandidates: Int = 64,
+        val rescoreCandidates: Int = 4,
+        val rescoreFile: File? = null
+    )
+
+    @Volatile
+    private var handle: Long = when {
+        persistFile != null -> nativeOpenPersistent(
+            persistFile.absolutePath, dimensions, initialCapacity,
+            hnsw?.m ?: 0, hnsw?.efConstruction ?: 0, hnsw?.efSearch ?: 0
+        )
+        hnsw != null -> nativeCreateHnsw(dimensions, initialCapacity, hnsw.m, hnsw.efConstruction, hnsw.efSearch)
+        quantization != null -> nativeCreateQuantized(
+            dimensions, initialCapacity, quantization.int8, quantization.binary,
+            quantization.binaryCandidates, quantization.rescoreCandidates,
+            quantization.rescoreFile?.absolutePath
+        )
+        else -> nativeCreate(dimensions, initialCapacity)
+    }
+
+    /** Scratch direct buffers, grown on demand and reused across calls on the same thread */
+    private val scratch = ThreadLocal.withInitial { Scratch() }
+
+    val isValid: Boolean get() = handle != 0L
+
+    val isPersistent: Boolean get() = persistFile != null
+
+    /**
+     * A single search hit: the key passed to insert() and its cosine similarity.
+     */
+    data class Hit(val key: Long, val similarity: Float)
+
+    /**
+     * Insert or replace [key]. [metadata] is stored with the vector by
+     * persistent indexes and ignored by the others.
+     */
+    fun insert(key: Long, vector: FloatArray, metadata: ByteArray? = null): Boolean {
+        val h = handle
+        if (h == 0L || vector.size != dimensions) return false
+        val buffer = scratch.get().floats(0, vector.size)
+        buffer.asFloatBuffer().put(vector)
+        return if (metadata != null) {
+            nativeInsertWithMetadata(h, key, buffer, metadata)
+        } else {
+            nativeInsert(h, key, buffer)
+        }
+    }
+
+    /**
+     * Insert many vectors in one JNI call.
+     * @return number of vectors inserted
+     */
+    fun insertBatch(keys: LongArray, vectors: List<FloatArray>): Int {
+        val h = handle
+        if (h == 0L || keys.isEmpty() || keys.size != vectors.size) return 0
+        if (vectors.any { it.size != dimensions }) return 0
+
+        val s = scratch.get()
+        val keyBuffer = s.longs(0, keys.size)
+        keyBuffer.asLongBuffer().put(keys)
+        val vecBuffer = s.floats(1, keys.size * dimensions)
+        val floats = vecBuffer.asFloatBuffer()
+        vectors.forEach { floats.put(it) }
+        return nativeInsertBatch(h, keyBuffer, vecBuffer, keys.size)
+    }
+
+    /**
+     * The stored vector for [key] (normalized), or null if unknown.
+     */
+    fun getVector(key: Long): FloatArray? {
+        val h = handle
+        if (h == 0L) return null
+        val buffer = scratch.get().floats(0, dimensions)
+        if (!nativeGetVector(h, key, buffer)) return null
+        return FloatArray(dimensions).also { buffer.asFloatBuffer().get(it) }
+    }
+
+    fun delete(key: Long): Boolean {
+        val h = handle
+        return h != 0L && nativeDelete(h, key)
+    }
+
+    /**
+     * Top-k keys by cosine similarity to [query], best first.
+     */
+    fun search(query: FloatArray, k: Int, minSimilarity: Float = -1f): List<Hit> {
+        val h = handle
+        if (h == 0L || k <= 0 || query.size != dimensions) return emptyList()
+
+        val s = scratch.get()
+        val queryBuffer = s.floats(0, dimensions)
+        queryBuffer.asFloatBuffer().put(query)
+        val keyBuffer = s.longs(1, k)
+        val scoreBuffer = s.floats(2, k)
+
+        val count = nativeSearch(h, queryBuffer, k, minSimilarity, keyBuffer, scoreBuffer)
+        val keys = keyBuffer.asLongBuffer()
+        val scores = scoreBuffer.asFloatBuffer()
+        return List(count) { i -> Hit(keys.get(i), scores.get(i)) }
+    }
+
+    /**
+     * search() for several queries in one pass over the stored vectors.
+     */
+    fun searchBatch(queries: List<FloatArray>, k: Int, minSimilarity: Float = -1f): List<List<Hit>> {
+        val h = handle
+        if (h == 0L || k <= 0 || queries.isEmpty()) return queries.map { emptyList() }
+        if (queries.any { it.size != dimensions }) return queries.map { emptyList() }
+
+        val s = scratch.get()
+        val queryBuffer = s.floats(0, queries.size * dimensions)
+        val queryFloats = queryBuffer.asFloatBuffer()
+        queries.forEach { queryFloats.put(it) }
+        val keyBuffer = s.longs(1, queries.size * k)
+        val scoreBuffer = s.floats(2, queries.size * k)
+        val countBuffer = s.ints(3, queries.size)
+
+        if (!nativeSearchBatch(h, queryBuffer, queries.size, k, minSimilarity, keyBuffer, scoreBuffer, countBuffer)) {
+            return queries.map { emptyList() }
+        }
+
+        val keys = keyBuffer.asLongBuffer()
+        val scores = scoreBuffer.asFloatBuffer()
+        val counts = countBuffer.asIntBuffer()
+        return List(queries.size) { q ->
+            val base = q * k
+            List(counts.get(q)) { i -> Hit(keys.get(base + i), scores.get(base + i)) }
+        }
+    }
+
+    fun size(): Int = handle.let { if (it != 0L) nativeSize(it) else 0 }
+
+    fun clear() {
+        val h = handle
+        if (h != 0L) nativeClear(h)
+    }
+
+    fun memoryBytes(): Long = handle.let { if (it != 0L) nativeMemoryBytes(it) else 0L }
+
+    /** HNSW only: beam width per query (clamped up to k) */
+    fun setEfSearch(efSearch: Int) {
+        val h = handle
+        if (h != 0L) nativeSetEfSearch(h, efSearch)
+    }
+
+    /** Deleted entries not yet reclaimed by [compact] (always 0 in exact mode) */
+    fun deletedCount(): Int = handle.let { if (it != 0L) nativeDeletedCount(it) else 0 }
+
+    /**
+     * Rebuild without deleted entries. Blocks the caller for the rebuild but
+     * not concurrent searches or writes - run it off the main thread.
+     * @return number of entries reclaimed
+     */
+    fun compact(): Int = handle.let { if (it != 0L) nativeCompact(it) else 0 }
+
+    /** Persistent only: replace the metadata stored for [key] */
+    fun setMetadata(key: Long, metadata: ByteArray): Boolean {
+        val h = handle
+        return h != 0L && nativeSetMetadata(h, key, metadata)
+    }
+
+    /**
+     * Persistent only: every live key with its metadata, read in one call.
+     */
+    fun dumpMetadata(): Map<Long, ByteArray> {
+        val h = handle
+        if (h == 0L) return emptyMap()
+        val packed = ByteBuffer.wrap(nativeDumpMetadata(h) ?: return emptyMap()).order(ByteOrder.nativeOrder())
+        val result = HashMap<Long, ByteArray>()
+        while (packed.remaining() >= 12) {
+            val key = packed.long
+            val bytes = ByteArray(packed.int)
+            packed.get(bytes)
+            result[key] = bytes
+        }
+        return result
+    }
+
+    /** Persistent only: bytes appended since the last [compact] */
+    fun logBytes(): Long = handle.let { if (it != 0L) nativeLogBytes(it) else 0L }
+
+    /** Persistent only: flush appended writes to storage */
+    fun sync(): Boolean {
+        val h = handle
+        return h != 0L && nativeSync(h)
+    }
+
+    /**
+     * Persistent only: check the file against its checksums. Reads the
+     * whole file - run it off the main thread.
+     */
+    fun verify(): Boolean {
+        val h = handle
+        return h != 0L && nativeVerify(h)
+    }
+
+    override fun close() {
+        val h = handle
+        handle = 0L
+        if (h != 0L) nativeDestroy(h)
+    }
+
+    /**
+     * Per-thread direct buffers in native byte order, one per argument slot.
+     */
+    private class Scratch {
+        private val buffers = arrayOfNulls<ByteBuffer>(4)
+
+        fun floats(slot: Int, count: Int) = bytes(slot, count * 4)
+        fun longs(slot: Int, count: Int) = bytes(slot, count * 8)
+        fun ints(slot: Int, count: Int) = bytes(slot, count * 4)
+
+        private fun bytes(slot: Int, size: Int): ByteBuffer {
+            var buffer = buffers[slot]
+            if (buffer == null || buffer.capacity() < size) {
+                buffer = ByteBuffer.allocateDirect(maxOf(size, 4096)).order(ByteOrder.nativeOrder())
+                buffers[slot] = buffer
+            }
+            buffer!!.clear()
+            return buffer
+        }
+    }
+
+    // Native methods (ailive_vector.cpp)
+    private external fun nativeCreate(dim: Int, capacity: Int): Long
+    private external fun nativeCreateHnsw(dim: Int, capacity: Int, m: Int, efConstruction: Int, efSearch: Int): Long
+    private external fun nativeCreateQuantized(
+        dim: Int, capacity: Int, int8: Boolean, binary: Boolean,
+        binaryCandidates: Int, rescoreCandidates: Int, rescorePath: String?
+    ): Long
+    private external fun nativeOpenPersistent(
+        path: String, dim: Int, capacity: Int, m: Int, efConstruction: Int, efSearch: Int
+    ): Long
+    private external fun nativeDestroy(handle: Long)
+    private external fun nativeGetVector(handle: Long, key: Long, outVector: ByteBuffer): Boolean
+    private external fun nativeInsert(handle: Long, key: Long, vector: ByteBuffer): Boolean
+    private external fun nativeInsertWithMetadata(handle: Long, key: Long, vector: ByteBuffer, metadata: ByteArray): Boolean
+    private external fun nativeInsertBatch(handle: Long, keys: ByteBuffer, vectors: ByteBuffer, count: Int): Int
+    private external fun nativeDelete(handle: Long, key: Long): Boolean
+    private external fun nativeSearch(
+        handle: Long, query: ByteBuffer, k: Int, minSimilarity: Float,
+        outKeys: ByteBuffer, outScores: ByteBuffer
+    ): Int
+    private external fun nativeSearchBatch(
+        handle: Long, queries: ByteBuffer, nQueries: Int, k: Int, minSimilarity: Float,
+        outKeys: ByteBuffer, outScores: ByteBuffer, outCounts: ByteBuffer
+    ): Boolean
+    private external fun nativeSize(handle: Long): Int
+    private external fun nativeClear(handle: Long)
+    private external fun nativeMemoryBytes(handle: Long): Long
+    private external fun nativeSetEfSearch(handle: Long, efSearch: Int)
+    private external fun nativeDeletedCount(handle: Long): Int
+    private external fun nativeCompact(handle: Long): Int
+    private external fun nativeSetMetadata(handle: Long, key: Long, metadata: ByteArray): Boolean
+    private external fun nativeDumpMetadata(handle: Long): ByteArray?
+    private external fun nativeLogBytes(handle: Long): Long
+    private external fun nativeSync(handle: Long): Boolean
+    private external fun nativeVerify(handle: Long): Boolean
+    private external fun nativeKernelName(): String
+
+    companion object {
+        private const val TAG = "NativeVectorIndex"
+
+        private val libraryLoaded: Boolean by lazy {
+            try {
+                System.loadLibrary("ailive_llm")
+                true
+            } catch (e: UnsatisfiedLinkError) {
+                Log.w(TAG, "Native vector index unavailable: ${e.message}")
+                false
+            }
+        }
+
+        fun isAvailable(): Boolean = libraryLoaded
+
+        /**
+         * Create an index, or null when the native library is not available.
+         */
+        fun createOrNull(
+            dimensions: Int,
+            initialCapacity: Int,
+            hnsw: HnswConfig? = null,
+            quantization: QuantizationConfig? = null,
+            persistFile: File? = null
+        ): NativeVectorIndex? {
+            if (!libraryLoaded) return null
+            return try {
+                val index = NativeVectorIndex(dimensions, initialCapacity, hnsw, quantization, persistFile)
+                if (index.isValid) {
+                    val mode = when {
+                        persistFile != null -> "persistent ${persistFile.name}${if (hnsw != null) " + HNSW M=${hnsw.m}" else ""}"
+                        hnsw != null -> "HNSW M=${hnsw.m}"
+                        quantization != null -> "quantized int8=${quantization.int8} binary=${quantization.binary}"
+                        else -> "exact"
+                    }
+                    Log.i(TAG, "✅ Native vector index ready ($mode, kernel: ${index.nativeKernelName()})")
+                    index
+                } else {
+                    null
+                }
+            } catch (e: UnsatisfiedLinkError) {
+                Log.w(TAG, "Native vector index unavailable: ${e.message}")
+                null
+            }
+        }
+    }
+}
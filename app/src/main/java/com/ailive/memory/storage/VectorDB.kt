@@ -1,154 +1,512 @@
 package com.ailive.memory.storage
 
 import android.util.Log
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.cancel
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.launch
 import kotlinx.coroutines.sync.Mutex
 import kotlinx.coroutines.sync.withLock
+import java.io.ByteArrayInputStream
+import java.io.ByteArrayOutputStream
+import java.io.DataInputStream
+import java.io.DataOutputStream
+import java.io.File
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.atomic.AtomicBoolean
+import java.util.concurrent.atomic.AtomicLong
 import kotlin.math.sqrt
 
 /**
  * Lightweight in-memory vector database for AILive.
- * Uses brute-force cosine similarity (fast enough for <100K vectors).
+ *
+ * Embeddings live in a NativeVectorIndex: normalized once on insert, stored
+ * contiguously in native memory and scanned with SIMD dot products, so a
+ * search over 50K memories takes milliseconds. When the native library is
+ * unavailable, pre-normalized vectors are scanned in Kotlin instead.
+ *
+ * With [hnsw] set the native index is an HNSW graph instead: approximate,
+ * but query cost grows sublinearly with the number of memories. Deletes are
+ * tombstones, compacted in the background once they pile up.
+ *
+ * With [quantization] set it keeps int8 (and optionally 1-bit) codes in RAM
+ * and the fp32 vectors in an mmap'ed file for rescoring.
+ *
+ * With [persistFile] set the index and the entries (as metadata next to
+ * each vector) live in an mmap'ed index file: [restore] makes them
+ * searchable right after process start without re-reading or re-embedding
+ * anything, writes are appended to the file and folded in by background
+ * compaction, and [sync] flushes them (plus access statistics) to storage.
+ *
+ * Whenever a native index holds the vectors, entries are kept without their
+ * embedding on the JVM heap; it is read back from the index when an entry
+ * leaves the database.
+ *
+ * Searches do not take the write mutex; only insert/delete/clear serialize.
  */
 class VectorDB(
     private val dimensions: Int = 384,
-    private val maxEntries: Int = 50000
+    private val maxEntries: Int = 50000,
+    private val hnsw: NativeVectorIndex.HnswConfig? = null,
+    private val quantization: NativeVectorIndex.QuantizationConfig? = null,
+    private val persistFile: File? = null
 ) {
     private val TAG = "VectorDB"
-    
-    private val entries = mutableMapOf<String, MemoryEntry>()
+
+    private val entries = ConcurrentHashMap<String, MemoryEntry>()
     private val mutex = Mutex()
-    
-    private var totalSearches = 0L
+
+    // Native index keys are Longs; map them to/from entry ids
+    private val keyById = ConcurrentHashMap<String, Long>()
+    private val idByKey = ConcurrentHashMap<Long, String>()
+    private var nextKey = 0L
+
+    private val nativeIndex: NativeVectorIndex? =
+        NativeVectorIndex.createOrNull(dimensions, maxEntries, hnsw, quantization, persistFile)
+
+    /** True when entries are stored in [persistFile] (native library available) */
+    val isPersistent: Boolean get() = nativeIndex?.isPersistent == true
+
+    // Entries whose access statistics changed since the last sync()
+    private val dirtyIds = ConcurrentHashMap.newKeySet<String>()
+
+    // Background HNSW / index file compaction
+    private val compactionScope = CoroutineScope(Dispatchers.Default + SupervisorJob())
+    private val compacting = AtomicBoolean(false)
+
+    // Kotlin fallback: normalized copies of the embeddings
+    private val normalizedVectors = ConcurrentHashMap<String, FloatArray>()
+
+    private val totalSearches = AtomicLong(0)
     private var totalInserts = 0L
-    
+
     /**
      * Insert a memory entry.
      */
-    suspend fun insert(entry: MemoryEntry): Boolean = mutex.withLock {
+    suspend fun insert(entry: MemoryEntry): Boolean = mutex.withLock { insertLocked(entry) }
+
+    /**
+     * Insert body. Caller holds the mutex.
+     */
+    private fun insertLocked(entry: MemoryEntry): Boolean {
         if (entry.embedding.size != dimensions) {
             Log.e(TAG, "Invalid embedding dimensions: ${entry.embedding.size}, expected: $dimensions")
-            return@withLock false
+            return false
         }
-        
+
         if (entries.size >= maxEntries && !entries.containsKey(entry.id)) {
             evictLRU()
         }
-        
-        entries[entry.id] = entry
+
+        if (nativeIndex != null) {
+            val key = keyById.getOrPut(entry.id) { nextKey++ }
+            idByKey[key] = entry.id
+            val metadata = if (nativeIndex.isPersistent) encodeEntry(entry) else null
+            if (!nativeIndex.insert(key, entry.embedding, metadata)) {
+                Log.e(TAG, "Native index insert failed for ${entry.id}")
+                return false
+            }
+            entries[entry.id] = entry.copy(embedding = NO_EMBEDDING)
+        } else {
+            normalizedVectors[entry.id] = normalize(entry.embedding)
+            entries[entry.id] = entry
+        }
+        dirtyIds.remove(entry.id)
         totalInserts++
-        
+
         if (totalInserts % 100 == 0L) {
             Log.d(TAG, "Inserted $totalInserts memories, current size: ${entries.size}")
+            scheduleCompactionIfNeeded()
         }
-        
-        return@withLock true
+
+        return true
     }
-    
+
     /**
-     * Search for k nearest neighbors using cosine similarity.
+     * Search for k nearest neighbors using cosine similarity, most similar first.
      */
     suspend fun search(
         queryEmbedding: FloatArray,
         k: Int = 10,
         minSimilarity: Float = 0.0f,
         filter: ((MemoryEntry) -> Boolean)? = null
-    ): List<SearchResult> = mutex.withLock {
+    ): List<SearchResult> {
         if (queryEmbedding.size != dimensions) {
             Log.e(TAG, "Invalid query dimensions: ${queryEmbedding.size}")
-            return@withLock emptyList()
-        }
-        
-        totalSearches++
-        
-        val normalizedQuery = normalize(queryEmbedding)
-        
-        val results = entries.values
-            .asSequence()
-            .filter { filter?.invoke(it) ?: true }
-            .map { entry ->
-                val similarity = cosineSimilarity(normalizedQuery, normalize(entry.embedding))
-                SearchResult(entry, similarity)
-            }
-            .filter { it.similarity >= minSimilarity }
-            .sortedDescending()
-            .take(k)
-            .toList()
-        
-        results.forEach { result ->
-            entries[result.entry.id] = result.entry.withAccessUpdate()
+            return emptyList()
         }
-        
+
+        totalSearches.incrementAndGet()
+
+        val results = if (nativeIndex != null) {
+            searchNative(nativeIndex, queryEmbedding, k, minSimilarity, filter)
+        } else {
+            searchFallback(normalize(queryEmbedding), k, minSimilarity, filter)
+        }
+
+        results.forEach { result -> markAccessed(result.entry.id) }
+
         Log.d(TAG, "Search completed: found ${results.size} results (min similarity: $minSimilarity)")
-        return@withLock results
+        return results
     }
-    
+
     /**
-     * Get entry by ID.
+     * Search several queries at once (one pass over the stored vectors when native).
      */
-    suspend fun get(id: String): MemoryEntry? = mutex.withLock {
-        val entry = entries[id]
-        if (entry != null) {
-            entries[id] = entry.withAccessUpdate()
+    suspend fun searchBatch(
+        queryEmbeddings: List<FloatArray>,
+        k: Int = 10,
+        minSimilarity: Float = 0.0f
+    ): List<List<SearchResult>> {
+        val index = nativeIndex
+        if (index == null || queryEmbeddings.any { it.size != dimensions }) {
+            return queryEmbeddings.map { search(it, k, minSimilarity) }
+        }
+
+        totalSearches.addAndGet(queryEmbeddings.size.toLong())
+
+        return index.searchBatch(queryEmbeddings, k, minSimilarity).map { hits ->
+            hits.mapNotNull { hit -> toResult(hit) }.also { results ->
+                results.forEach { result -> markAccessed(result.entry.id) }
+            }
         }
-        return@withLock entry
     }
-    
+
+    /**
+     * Get entry by ID.
+     */
+    suspend fun get(id: String): MemoryEntry? {
+        return markAccessed(id)?.let { withEmbedding(it) }
+    }
+
     /**
      * Delete entry by ID.
      */
     suspend fun delete(id: String): Boolean = mutex.withLock {
-        val removed = entries.remove(id) != null
+        val removed = removeEntry(id)
         if (removed) {
             Log.d(TAG, "Deleted memory: $id")
+            scheduleCompactionIfNeeded()
         }
         return@withLock removed
     }
-    
+
     /**
      * Get all entries matching a filter.
      */
-    suspend fun filter(predicate: (MemoryEntry) -> Boolean): List<MemoryEntry> = mutex.withLock {
-        return@withLock entries.values.filter(predicate)
+    suspend fun filter(predicate: (MemoryEntry) -> Boolean): List<MemoryEntry> {
+        return entries.values.filter(predicate).map { withEmbedding(it) }
     }
-    
+
     /**
      * Clear all entries.
      */
     suspend fun clear() = mutex.withLock {
         val size = entries.size
-        entries.clear()
+        clearLocked()
         Log.w(TAG, "Cleared $size memories")
     }
-    
+
+    /**
+     * Replace every entry with `replacement` in one step, e.g. entries
+     * re-embedded after [restore] found the index file damaged. Writers
+     * wait for it; searches meanwhile may see a partial index.
+     *
+     * @return number of entries inserted
+     */
+    suspend fun rebuild(replacement: List<MemoryEntry>): Int = mutex.withLock {
+        clearLocked()
+        val inserted = replacement.count { insertLocked(it) }
+        Log.i(TAG, "🔁 Rebuilt index with $inserted of ${replacement.size} memories")
+        if (isPersistent) {
+            // Rewrite the file so the damaged sealed part is gone
+            launchCompaction(nativeIndex!!)
+        }
+        return@withLock inserted
+    }
+
+    /**
+     * Drop all entries and vectors. Caller holds the mutex.
+     */
+    private fun clearLocked() {
+        entries.clear()
+        keyById.clear()
+        idByKey.clear()
+        normalizedVectors.clear()
+        dirtyIds.clear()
+        nativeIndex?.clear()
+    }
+
     /**
      * Get current size.
      */
-    suspend fun size(): Int = mutex.withLock {
-        return@withLock entries.size
+    suspend fun size(): Int {
+        return entries.size
     }
-    
+
+    /**
+     * Load the entries stored in the index file (persistent mode only).
+     * The vectors stay in the mapped file; only the entry metadata is
+     * decoded. The file's checksums are then verified in the background.
+     *
+     * Nothing is dropped when verification fails: the damaged file is
+     * copied next to it (`<name>.corrupt`) and [onCorrupt] receives the
+     * restored entries, without embeddings, so the caller can re-embed them
+     * from their source and [rebuild]. Without [onCorrupt] the entries keep
+     * being served as they are.
+     *
+     * @return number of entries restored
+     */
+    suspend fun restore(onCorrupt: (suspend (List<MemoryEntry>) -> Unit)? = null): Int = mutex.withLock {
+        val index = nativeIndex
+        if (index == null || !index.isPersistent) return@withLock 0
+
+        val start = System.currentTimeMillis()
+        var restored = 0
+        index.dumpMetadata().forEach { (key, bytes) ->
+            val entry = decodeEntry(bytes)
+            if (entry == null) {
+                index.delete(key)
+                return@forEach
+            }
+            entries[entry.id] = entry
+            keyById[entry.id] = key
+            idByKey[key] = entry.id
+            nextKey = maxOf(nextKey, key + 1)
+            restored++
+        }
+        Log.i(TAG, "📂 Restored $restored memories from ${persistFile?.name} in ${System.currentTimeMillis() - start}ms")
+
+        compactionScope.launch {
+            if (!index.verify()) {
+                Log.e(TAG, "❌ Index file ${persistFile?.name} failed its checksum, keeping a copy for recovery")
+                preserveDamagedFile()
+                onCorrupt?.invoke(entries.values.map { it.copy(embedding = NO_EMBEDDING) })
+            }
+        }
+        scheduleCompactionIfNeeded()
+        return@withLock restored
+    }
+
+    /**
+     * Copy the index file to `<name>.corrupt` before anything rewrites it.
+     */
+    private fun preserveDamagedFile() {
+        val file = persistFile ?: return
+        try {
+            file.copyTo(File(file.parentFile, "${file.name}.corrupt"), overwrite = true)
+        } catch (e: Exception) {
+            Log.e(TAG, "Cannot copy damaged index file ${file.name}", e)
+        }
+    }
+
+    /**
+     * Persist access statistics changed since the last call and flush the
+     * index file to storage (persistent mode only).
+     */
+    suspend fun sync() = mutex.withLock {
+        val index = nativeIndex
+        if (index == null || !index.isPersistent) return@withLock
+
+        val ids = dirtyIds.toList()
+        dirtyIds.removeAll(ids.toSet())
+        ids.forEach { id ->
+            val entry = entries[id] ?: return@forEach
+            val key = keyById[id] ?: return@forEach
+            index.setMetadata(key, encodeEntry(entry))
+        }
+        index.sync()
+    }
+
+    /**
+     * Flush and release the native index. The database is unusable afterwards.
+     */
+    suspend fun close() {
+        sync()
+        while (compacting.get()) {
+            delay(10)
+        }
+        compactionScope.cancel()
+        nativeIndex?.close()
+    }
+
+    /**
+     * Set the HNSW search beam width (no-op for the exact index).
+     */
+    fun setEfSearch(efSearch: Int) {
+        nativeIndex?.setEfSearch(efSearch)
+    }
+
+    /**
+     * Compare this database's index against exact search over the same
+     * vectors: recall@k and latency for each efSearch value. Queries are
+     * sampled from the stored embeddings.
+     */
+    suspend fun benchmark(
+        k: Int = 10,
+        queryCount: Int = 100,
+        efSearchValues: List<Int> = VectorIndexBenchmark.DEFAULT_EF_SEARCH
+    ): List<VectorIndexBenchmark.Result> {
+        val vectors = entries.values.map { withEmbedding(it).embedding }.filter { it.size == dimensions }
+        val queries = vectors.shuffled().take(queryCount)
+        return if (quantization != null) {
+            listOfNotNull(VectorIndexBenchmark.runQuantized(vectors, queries, k, quantization.copy(rescoreFile = null)))
+        } else {
+            VectorIndexBenchmark.run(vectors, queries, k, hnsw ?: NativeVectorIndex.HnswConfig(), efSearchValues)
+        }
+    }
+
+    /**
+     * Compact in the background once tombstones exceed COMPACTION_RATIO of
+     * the live entries (HNSW graph, index file) or, for an index file, once
+     * its append log reaches MAX_LOG_BYTES.
+     */
+    private fun scheduleCompactionIfNeeded() {
+        val index = nativeIndex ?: return
+        if (index.hnsw == null && !index.isPersistent) return
+
+        val deleted = index.deletedCount()
+        val tombstonesDue = deleted >= MIN_COMPACTION_DELETES && deleted >= index.size() * COMPACTION_RATIO
+        val logDue = index.isPersistent && index.logBytes() >= MAX_LOG_BYTES
+        if (!tombstonesDue && !logDue) return
+        launchCompaction(index)
+    }
+
+    /**
+     * Compact `index` in the background unless a compaction is running.
+     */
+    private fun launchCompaction(index: NativeVectorIndex) {
+        if (!compacting.compareAndSet(false, true)) return
+
+        compactionScope.launch {
+            try {
+                val start = System.currentTimeMillis()
+                val reclaimed = index.compact()
+                Log.i(TAG, "🧹 Compaction reclaimed $reclaimed entries in ${System.currentTimeMillis() - start}ms")
+            } finally {
+                compacting.set(false)
+            }
+        }
+    }
+
+    /**
+     * Native search. With a filter, fetch more candidates than needed and
+     * double the fetch until k results pass or the index is exhausted.
+     */
+    private fun searchNative(
+        index: NativeVectorIndex,
+        query: FloatArray,
+        k: Int,
+        minSimilarity: Float,
+        filter: ((MemoryEntry) -> Boolean)?
+    ): List<SearchResult> {
+        val total = index.size()
+        if (k <= 0 || total == 0) return emptyList()
+
+        var fetch = if (filter == null) k else minOf(k * FILTER_OVERFETCH, total)
+        while (true) {
+            val hits = index.search(query, fetch, minSimilarity)
+            val results = hits.asSequence()
+                .mapNotNull { toResult(it) }
+                .filter { filter?.invoke(it.entry) ?: true }
+                .take(k)
+                .toList()
+
+            if (results.size >= k || hits.size < fetch || fetch >= total) {
+                return results
+            }
+            fetch = minOf(fetch * 2, total)
+        }
+    }
+
+    /**
+     * Kotlin fallback: dot products against the pre-normalized vectors.
+     */
+    private fun searchFallback(
+        normalizedQuery: FloatArray,
+        k: Int,
+        minSimilarity: Float,
+        filter: ((MemoryEntry) -> Boolean)?
+    ): List<SearchResult> {
+        return entries.values
+            .asSequence()
+            .filter { filter?.invoke(it) ?: true }
+            .mapNotNull { entry ->
+                val vector = normalizedVectors[entry.id] ?: return@mapNotNull null
+                SearchResult(entry, dot(normalizedQuery, vector))
+            }
+            .filter { it.similarity >= minSimilarity }
+            .sorted()  // SearchResult orders most similar first
+            .take(k)
+            .toList()
+    }
+
+    /**
+     * Bump an entry's access statistics; persisted by the next sync().
+     */
+    private fun markAccessed(id: String): MemoryEntry? {
+        val updated = entries.computeIfPresent(id) { _, entry -> entry.withAccessUpdate() }
+        if (updated != null && nativeIndex?.isPersistent == true) {
+            dirtyIds.add(id)
+        }
+        return updated
+    }
+
+    private fun toResult(hit: NativeVectorIndex.Hit): SearchResult? {
+        val id = idByKey[hit.key] ?: return null
+        val entry = entries[id] ?: return null
+        return SearchResult(withEmbedding(entry), hit.similarity)
+    }
+
+    /**
+     * Reattach the embedding of an entry whose vector lives in the native index.
+     */
+    private fun withEmbedding(entry: MemoryEntry): MemoryEntry {
+        if (entry.embedding.isNotEmpty()) return entry
+        val key = keyById[entry.id] ?: return entry
+        val vector = nativeIndex?.getVector(key) ?: return entry
+        return entry.copy(embedding = vector)
+    }
+
+    /**
+     * Remove an entry and its vector. Caller holds the mutex.
+     */
+    private fun removeEntry(id: String): Boolean {
+        val removed = entries.remove(id) != null
+        normalizedVectors.remove(id)
+        dirtyIds.remove(id)
+        keyById.remove(id)?.let { key ->
+            idByKey.remove(key)
+            nativeIndex?.delete(key)
+        }
+        return removed
+    }
+
     /**
      * Evict least recently used entry.
      */
     private fun evictLRU() {
         val lruEntry = entries.values.minByOrNull { it.lastAccessed }
         if (lruEntry != null) {
-            entries.remove(lruEntry.id)
+            removeEntry(lruEntry.id)
             Log.d(TAG, "Evicted LRU memory: ${lruEntry.id}")
+            scheduleCompactionIfNeeded()
         }
     }
-    
+
     /**
-     * Cosine similarity between two vectors.
+     * Dot product of two equal-length vectors.
      */
-    private fun cosineSimilarity(a: FloatArray, b: FloatArray): Float {
+    private fun dot(a: FloatArray, b: FloatArray): Float {
         var dotProduct = 0f
         for (i in a.indices) {
             dotProduct += a[i] * b[i]
         }
         return dotProduct
     }
-    
+
     /**
      * Normalize vector to unit length.
      */
@@ -158,42 +516,119 @@ class VectorDB(
             sumSquares += value * value
         }
         val norm = sqrt(sumSquares)
-        
+
         return if (norm > 0f) {
             FloatArray(vector.size) { i -> vector[i] / norm }
         } else {
             vector
         }
     }
-    
+
     /**
      * Get database statistics.
      */
-    suspend fun getStats(): VectorDBStats = mutex.withLock {
-        val avgAccessCount = if (entries.isNotEmpty()) {
-            entries.values.map { it.accessCount }.average()
+    suspend fun getStats(): VectorDBStats {
+        val snapshot = entries.values.toList()
+        val avgAccessCount = if (snapshot.isNotEmpty()) {
+            snapshot.map { it.accessCount }.average()
         } else 0.0
-        
-        return@withLock VectorDBStats(
-            totalEntries = entries.size,
+
+        return VectorDBStats(
+            totalEntries = snapshot.size,
             maxCapacity = maxEntries,
             dimensions = dimensions,
-            totalSearches = totalSearches,
+            totalSearches = totalSearches.get(),
             totalInserts = totalInserts,
             avgAccessCount = avgAccessCount,
-            memoryUsageMB = estimateMemoryMB()
+            memoryUsageMB = estimateMemoryMB(snapshot.size)
         )
     }
-    
+
     /**
-     * Estimate memory usage in MB.
+     * Estimate resident memory in MB: native index (codes/vectors/graph, not
+     * counting mmap'ed pages) or the heap vectors, plus per-entry overhead.
      */
-    private fun estimateMemoryMB(): Float {
-        val vectorSizeBytes = dimensions * 4
+    private fun estimateMemoryMB(entryCount: Int): Float {
         val entryOverhead = 200
-        val totalBytes = entries.size * (vectorSizeBytes + entryOverhead)
+        val vectorBytes = nativeIndex?.memoryBytes() ?: (entryCount.toLong() * dimensions * 4)
+        val totalBytes = vectorBytes + entryCount.toLong() * entryOverhead
         return totalBytes / (1024f * 1024f)
     }
+
+    companion object {
+        // Initial candidate multiplier when a filter may reject native hits
+        private const val FILTER_OVERFETCH = 4
+
+        // Compact the HNSW graph when tombstones reach this share of live entries
+        private const val COMPACTION_RATIO = 0.2f
+        private const val MIN_COMPACTION_DELETES = 256
+
+        // Fold an index file's append log into its sealed part beyond this size
+        private const val MAX_LOG_BYTES = 8L * 1024 * 1024
+
+        private const val ENTRY_FORMAT_VERSION = 1
+
+        // Placeholder embedding for entries whose vector is held natively
+        private val NO_EMBEDDING = FloatArray(0)
+
+        /**
+         * Entry fields other than the embedding, stored as index file metadata.
+         */
+        private fun encodeEntry(entry: MemoryEntry): ByteArray {
+            val bytes = ByteArrayOutputStream(256)
+            DataOutputStream(bytes).use { out ->
+                out.writeByte(ENTRY_FORMAT_VERSION)
+                out.writeUTF(entry.id)
+                val content = entry.content.toByteArray(Charsets.UTF_8)  // may exceed writeUTF's 64 KB
+                out.writeInt(content.size)
+                out.write(content)
+                out.writeUTF(entry.contentType.name)
+                out.writeLong(entry.timestamp)
+                out.writeFloat(entry.importance)
+                out.writeInt(entry.tags.size)
+                entry.tags.forEach { out.writeUTF(it) }
+                out.writeInt(entry.metadata.size)
+                entry.metadata.forEach { (key, value) ->
+                    out.writeUTF(key)
+                    out.writeUTF(value)
+                }
+                out.writeInt(entry.accessCount)
+                out.writeLong(entry.lastAccessed)
+            }
+            return bytes.toByteArray()
+        }
+
+        /**
+         * Inverse of encodeEntry(), without the embedding. Null if unreadable.
+         */
+        private fun decodeEntry(bytes: ByteArray): MemoryEntry? = try {
+            DataInputStream(ByteArrayInputStream(bytes)).use { input ->
+                if (input.readByte().toInt() != ENTRY_FORMAT_VERSION) return null
+                val id = input.readUTF()
+                val content = ByteArray(input.readInt()).also { input.readFully(it) }.toString(Charsets.UTF_8)
+                val contentType = ContentType.values().find { it.name == input.readUTF() } ?: ContentType.UNKNOWN
+                val timestamp = input.readLong()
+                val importance = input.readFloat()
+                val tags = List(input.readInt()) { input.readUTF() }.toSet()
+                val metadata = (0 until input.readInt()).associate { input.readUTF() to input.readUTF() }
+                MemoryEntry(
+                    id = id,
+                    content = content,
+                    contentType = contentType,
+                    embedding = NO_EMBEDDING,
+                    timestamp = timestamp,
+                    importance = importance,
+                    tags = tags,
+                    metadata = metadata,
+                    accessCount = input.readInt(),
+                    lastAccessed = input.readLong()
+                )
+            }
+        } catch (e: Exception) {
+            Log.w("VectorDB", "Unreadable entry metadata: ${e.message}")
+            null
+        }
+    }
 }
 
 data class VectorDBStats(
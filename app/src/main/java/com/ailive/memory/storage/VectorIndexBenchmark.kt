@@ -0,0 +1,172 @@
+package com.ailive.memory.storage
+
+import android.util.Log
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.withContext
+
+/**
+ * Recall-vs-latency benchmark of the approximate indexes (HNSW, quantized)
+ * against exact search.
+ *
+ * Both indexes are built from the same vectors. Exact top-k results are the
+ * ground truth; the approximate results are scored by recall@k (for HNSW at
+ * each efSearch value), and per-query latency is measured for both.
+ */
+object VectorIndexBenchmark {
+    private const val TAG = "VectorIndexBenchmark"
+
+    val DEFAULT_EF_SEARCH = listOf(16, 32, 64, 128, 256)
+
+    data class Result(
+        val mode: String,
+        val vectorCount: Int,
+        val efSearch: Int,
+        val recallAtK: Float,
+        val approxMeanMs: Float,
+        val approxP95Ms: Float,
+        val exactMeanMs: Float,
+        val exactP95Ms: Float,
+        val approxBuildMs: Long,
+        val approxMemoryBytes: Long,
+        val exactMemoryBytes: Long
+    ) {
+        fun speedup(): Float = if (approxMeanMs > 0f) exactMeanMs / approxMeanMs else 0f
+        fun memoryReduction(): Float = if (approxMemoryBytes > 0) exactMemoryBytes.toFloat() / approxMemoryBytes else 0f
+    }
+
+    // Exact top-k keys and latencies for each query
+    private class GroundTruth(val keys: List<Set<Long>>, val latenciesMs: FloatArray, val memoryBytes: Long)
+
+    /**
+     * @return one result per efSearch value, or an empty list if the native
+     *         library is unavailable or there is no data
+     */
+    suspend fun run(
+        vectors: List<FloatArray>,
+        queries: List<FloatArray>,
+        k: Int = 10,
+        config: NativeVectorIndex.HnswConfig = NativeVectorIndex.HnswConfig(),
+        efSearchValues: List<Int> = DEFAULT_EF_SEARCH
+    ): List<Result> = withContext(Dispatchers.Default) {
+        if (vectors.isEmpty() || queries.isEmpty()) return@withContext emptyList()
+        val dims = vectors.first().size
+
+        val exact = NativeVectorIndex.createOrNull(dims, vectors.size) ?: return@withContext emptyList()
+        val approx = NativeVectorIndex.createOrNull(dims, vectors.size, config)
+        if (approx == null) {
+            exact.close()
+            return@withContext emptyList()
+        }
+
+        try {
+            val truth = groundTruth(exact, vectors, queries, k)
+            val buildStart = System.currentTimeMillis()
+            approx.insertBatch(LongArray(vectors.size) { it.toLong() }, vectors)
+            val buildMs = System.currentTimeMillis() - buildStart
+
+            efSearchValues.map { ef ->
+                approx.setEfSearch(ef)
+                measure("hnsw", ef, approx, queries, k, truth, buildMs)
+            }
+        } finally {
+            exact.close()
+            approx.close()
+        }
+    }
+
+    /**
+     * Quantized index (int8 / 1-bit codes + fp32 rescoring) against exact search.
+     */
+    suspend fun runQuantized(
+        vectors: List<FloatArray>,
+        queries: List<FloatArray>,
+        k: Int = 10,
+        config: NativeVectorIndex.QuantizationConfig = NativeVectorIndex.QuantizationConfig()
+    ): Result? = withContext(Dispatchers.Default) {
+        if (vectors.isEmpty() || queries.isEmpty()) return@withContext null
+        val dims = vectors.first().size
+
+        val exact = NativeVectorIndex.createOrNull(dims, vectors.size) ?: return@withContext null
+        val approx = NativeVectorIndex.createOrNull(dims, vectors.size, quantization = config)
+        if (approx == null) {
+            exact.close()
+            return@withContext null
+        }
+
+        try {
+            val truth = groundTruth(exact, vectors, queries, k)
+            val buildStart = System.currentTimeMillis()
+            approx.insertBatch(LongArray(vectors.size) { it.toLong() }, vectors)
+            val buildMs = System.currentTimeMillis() - buildStart
+
+            val mode = listOfNotNull("int8".takeIf { config.int8 }, "binary".takeIf { config.binary }).joinToString("+")
+            measure(mode, 0, approx, queries, k, truth, buildMs)
+        } finally {
+            exact.close()
+            approx.close()
+        }
+    }
+
+    private fun groundTruth(
+        exact: NativeVectorIndex,
+        vectors: List<FloatArray>,
+        queries: List<FloatArray>,
+        k: Int
+    ): GroundTruth {
+        exact.insertBatch(LongArray(vectors.size) { it.toLong() }, vectors)
+        val latencies = FloatArray(queries.size)
+        val keys = queries.mapIndexed { i, query ->
+            val start = System.nanoTime()
+            val hits = exact.search(query, k)
+            latencies[i] = (System.nanoTime() - start) / 1_000_000f
+            hits.map { it.key }.toSet()
+        }
+        return GroundTruth(keys, latencies, exact.memoryBytes())
+    }
+
+    private fun measure(
+        mode: String,
+        efSearch: Int,
+        approx: NativeVectorIndex,
+        queries: List<FloatArray>,
+        k: Int,
+        truth: GroundTruth,
+        buildMs: Long
+    ): Result {
+        val latencies = FloatArray(queries.size)
+        var found = 0
+        var expected = 0
+        queries.forEachIndexed { i, query ->
+            val start = System.nanoTime()
+            val hits = approx.search(query, k)
+            latencies[i] = (System.nanoTime() - start) / 1_000_000f
+            found += hits.count { it.key in truth.keys[i] }
+            expected += truth.keys[i].size
+        }
+
+        val result = Result(
+            mode = mode,
+            vectorCount = approx.size(),
+            efSearch = efSearch,
+            recallAtK = if (expected > 0) found.toFloat() / expected else 1f,
+            approxMeanMs = latencies.average().toFloat(),
+            approxP95Ms = percentile(latencies, 0.95f),
+            exactMeanMs = truth.latenciesMs.average().toFloat(),
+            exactP95Ms = percentile(truth.latenciesMs, 0.95f),
+            approxBuildMs = buildMs,
+            approxMemoryBytes = approx.memoryBytes(),
+            exactMemoryBytes = truth.memoryBytes
+        )
+        Log.i(TAG, "📊 $mode n=${result.vectorCount} ef=$efSearch recall@$k=${"%.3f".format(result.recallAtK)} " +
+                "approx=${"%.3f".format(result.approxMeanMs)}ms (p95 ${"%.3f".format(result.approxP95Ms)}) " +
+                "exact=${"%.3f".format(result.exactMeanMs)}ms (p95 ${"%.3f".format(result.exactP95Ms)}) " +
+                "speedup=${"%.1f".format(result.speedup())}x memory=${"%.1f".format(result.memoryReduction())}x smaller")
+        return result
+    }
+
+    private fun percentile(values: FloatArray, p: Float): Float {
+        if (values.isEmpty()) return 0f
+        val sorted = values.sorted()
+        return sorted[((sorted.size - 1) * p).toInt()]
+    }
+}
@@ -3,6 +3,7 @@ package com.ailive.personality
 import android.content.Context
 import android.util.Log
 import com.ailive.ai.llm.HybridModelManager
+import com.ailive.ai.llm.LLMBridge
 import com.ailive.audio.TTSManager
 import com.ailive.core.messaging.*
 import com.ailive.core.state.StateManager
@@ -305,7 +306,12 @@ class PersonalityEngine(
 
             // Stream with the FULL PROMPT (not just raw input!)
             Log.d(TAG, "Calling hybridModelManager.generateStreaming()...")
-            return hybridModelManager.generateStreaming(prompt, agentName = aiSettings.aiName)
+            return hybridModelManager.generateStreaming(
+                prompt,
+                agentName = aiSettings.aiName,
+                pinnedPrefix = UnifiedPrompt.systemPrefix(aiSettings.aiName),
+                speculation = speculationFor(toolContext)
+            )
 
         } catch (e: Exception) {
             Log.e(TAG, "❌ Error in generateStreamingResponse", e)
@@ -524,7 +530,12 @@ class PersonalityEngine(
         val responseText = try {
             val startTime = System.currentTimeMillis()
             var llmResponse = ""
-            hybridModelManager.generateStreaming(prompt, agentName = aiSettings.aiName).collect { chunk ->
+            hybridModelManager.generateStreaming(
+                prompt,
+                agentName = aiSettings.aiName,
+                pinnedPrefix = UnifiedPrompt.systemPrefix(aiSettings.aiName),
+                speculation = speculationFor(toolContext)
+            ).collect { chunk ->
                 llmResponse += chunk
             }
             val duration = System.currentTimeMillis() - startTime
@@ -710,6 +721,13 @@ class PersonalityEngine(
         }
     }
 
+    /**
+     * Answers built on tool output, search snippets or memory quote it, so
+     * prompt lookup drafts them well; plain chat keeps the default
+     */
+    private fun speculationFor(toolContext: Map<String, Any>): Int =
+        if (toolContext.isNotEmpty()) LLMBridge.SPECULATION_PROMPT_LOOKUP else LLMBridge.SPECULATION_AUTO
+
     private fun calculateConfidence(toolResults: List<ToolExecutionResult>): Float {
         if (toolResults.isEmpty()) return 0.7f
 
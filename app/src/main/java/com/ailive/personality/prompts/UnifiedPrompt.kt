@@ -125,6 +125,13 @@ END OF UNIFIED DIRECTIVE"""
         return "Current Time: $time on $date"
     }
 
+    /**
+     * The fixed start of every prompt made by [create] for [aiName]. The
+     * native engine keeps it in the context window when a long conversation
+     * has its oldest turns evicted.
+     */
+    fun systemPrefix(aiName: String): String = getCorePersonality(sanitizeAiName(aiName)) + "\n\n"
+
     /**
      * Create a complete prompt with context
      *
@@ -145,7 +152,7 @@ END OF UNIFIED DIRECTIVE"""
         // Build prompt with system instruction and user input
         val promptBuilder = StringBuilder()
 
-        // Add dynamic system instruction with sanitized AI name
+        // Add dynamic system instruction with sanitized AI name (same text as systemPrefix)
         promptBuilder.append(getCorePersonality(sanitizedName))
         promptBuilder.append("\n\n")
 
@@ -189,10 +196,11 @@ END OF UNIFIED DIRECTIVE"""
 
         val finalPrompt = promptBuilder.toString()
 
-        // CRITICAL: Keep prompt under 512 tokens (~1500 chars to be safe)
+        // No truncation here: cutting the end would drop the user's message, and the
+        // native engine fits long prompts into the context window itself by
+        // evicting the oldest history after the pinned system prompt
         if (finalPrompt.length > 1500) {
-            Log.w("UnifiedPrompt", "⚠️ Prompt too long (${finalPrompt.length} chars), truncating to 1500")
-            return finalPrompt.take(1500)
+            Log.w("UnifiedPrompt", "⚠️ Long prompt (${finalPrompt.length} chars), oldest history may be evicted natively")
         }
 
         return finalPrompt
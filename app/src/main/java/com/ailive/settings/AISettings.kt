@@ -77,6 +77,23 @@ class AISettings(context: Context) {
             Log.i(TAG, "Location awareness ${if (value) "enabled" else "disabled"}")
         }
 
+    // Voice activity detection - only speech reaches Whisper
+    var vadEnabled: Boolean
+        get() = prefs.getBoolean("vad_enabled", true)  // Enabled by default
+        set(value) {
+            prefs.edit().putBoolean("vad_enabled", value).apply()
+            Log.i(TAG, "Voice activity detection ${if (value) "enabled" else "disabled"}")
+        }
+
+    // VAD threshold (dB above the noise floor) - raise it in noisy places
+    var vadThresholdDb: Float
+        get() = prefs.getFloat("vad_threshold_db", 12f)
+        set(value) {
+            val clamped = value.coerceIn(3f, 30f)
+            prefs.edit().putFloat("vad_threshold_db", clamped).apply()
+            Log.i(TAG, "VAD threshold set to: ${clamped} dB")
+        }
+
     fun clear() {
         prefs.edit().clear().apply()
         Log.i(TAG, "Settings cleared")